@@ -0,0 +1,239 @@
+/*                                                     -*- linux-c -*-
+    Copyright (C) 2026 Aqualung contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+    $Id$
+*/
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <glib.h>
+
+#include "common.h"
+#include "accuraterip.h"
+
+
+/* AccurateRip leaves out the first five sectors of a disc but one
+ * frame, and the last five sectors */
+#define AR_SKIP_FIRST (5 * 588 - 1)
+#define AR_SKIP_LAST  (5 * 588)
+
+static guint32 crc32_table[256];
+static int crc32_table_ready;
+
+
+static void
+crc32_make_table(void) {
+
+	guint32 c;
+	int n, k;
+
+	for (n = 0; n < 256; n++) {
+		c = (guint32)n;
+		for (k = 0; k < 8; k++) {
+			c = (c & 1) ? 0xedb88320U ^ (c >> 1) : c >> 1;
+		}
+		crc32_table[n] = c;
+	}
+	crc32_table_ready = 1;
+}
+
+
+void
+accuraterip_init(accuraterip_t * ar, int track_sectors, int first, int last) {
+
+	if (!crc32_table_ready) {
+		crc32_make_table();
+	}
+
+	ar->v1 = 0;
+	ar->v2 = 0;
+	ar->crc32 = 0xffffffffU;
+	ar->pos = 0;
+	ar->check_from = first ? AR_SKIP_FIRST : 0;
+	ar->check_to = track_sectors * 588;
+	if (last) {
+		ar->check_to -= AR_SKIP_LAST;
+	}
+}
+
+
+/* buf holds interleaved stereo floats as produced by the CDDA decoder
+ * (sample / 32768), so the original 16 bit words are recovered exactly.
+ */
+void
+accuraterip_update(accuraterip_t * ar, const float * buf, int frames) {
+
+	guint32 crc = ar->crc32;
+	guint32 v1 = ar->v1;
+	guint32 v2 = ar->v2;
+	guint32 pos = ar->pos;
+	int i;
+
+	for (i = 0; i < frames; i++) {
+
+		long l = lrintf(buf[2*i] * 32768.0f);
+		long r = lrintf(buf[2*i+1] * 32768.0f);
+		guint32 sample;
+
+		l = (l < -32768) ? -32768 : (l > 32767) ? 32767 : l;
+		r = (r < -32768) ? -32768 : (r > 32767) ? 32767 : r;
+		sample = ((guint32)r << 16) | ((guint32)l & 0xffff);
+
+		crc = crc32_table[(crc ^ sample) & 0xff] ^ (crc >> 8);
+		crc = crc32_table[(crc ^ (sample >> 8)) & 0xff] ^ (crc >> 8);
+		crc = crc32_table[(crc ^ (sample >> 16)) & 0xff] ^ (crc >> 8);
+		crc = crc32_table[(crc ^ (sample >> 24)) & 0xff] ^ (crc >> 8);
+
+		/* frames are weighted by their 1-based position in the track */
+		if (pos >= ar->check_from && pos < ar->check_to) {
+			guint64 prod = (guint64)sample * (pos + 1);
+			v1 += (guint32)prod;
+			v2 += (guint32)prod + (guint32)(prod >> 32);
+		}
+		++pos;
+	}
+
+	ar->crc32 = crc;
+	ar->v1 = v1;
+	ar->v2 = v2;
+	ar->pos = pos;
+}
+
+
+/* sum of the decimal digits of n */
+static guint32
+digit_sum(guint32 n) {
+
+	guint32 sum = 0;
+
+	do {
+		sum += n % 10;
+		n /= 10;
+	} while (n != 0);
+
+	return sum;
+}
+
+/* The freedb (CDDB) disc id, computed from the toc as freedb does:
+ * unlike calc_cdda_hash() it counts the length from the first track,
+ * not from the start of the disc. On enhanced CDs the toc ends with
+ * the audio session, so the id is that of the audio tracks alone.
+ */
+static guint32
+freedb_disc_id(cdda_disc_t * disc) {
+
+	guint32 n = 0;
+	guint32 t;
+	int i;
+
+	for (i = 0; i < disc->n_tracks; i++) {
+		n += digit_sum((disc->toc[i] + 150) / 75);
+	}
+	t = (disc->toc[disc->n_tracks] + 150) / 75 - (disc->toc[0] + 150) / 75;
+
+	return ((n % 0xff) << 24) | (t << 8) | disc->n_tracks;
+}
+
+/* the identifier AccurateRip uses: track count, two offset sums and the freedb id */
+void
+accuraterip_disc_id(cdda_disc_t * disc, char * id, size_t id_size) {
+
+	guint32 id1 = 0;
+	guint32 id2 = 0;
+	int i;
+
+	for (i = 0; i < disc->n_tracks; i++) {
+		id1 += disc->toc[i];
+		id2 += ((disc->toc[i] > 0) ? disc->toc[i] : 1) * (i + 1);
+	}
+	id1 += disc->toc[disc->n_tracks];
+	id2 += disc->toc[disc->n_tracks] * (disc->n_tracks + 1);
+
+	snprintf(id, id_size, "%03d-%08x-%08x-%08x", disc->n_tracks,
+		 id1, id2, freedb_disc_id(disc));
+}
+
+
+/* The database is a text file with one line per known rip of a track:
+ *
+ *   <disc id> <track> <v1 crc> <v2 crc> <crc32>
+ *
+ * Several lines may exist for the same track (e.g. from different
+ * drives); a match against any of them counts.
+ */
+int
+accuraterip_db_lookup(char * dbfile, char * disc_id, int track, accuraterip_t * ar) {
+
+	FILE * f;
+	char line[MAXLEN];
+	int ret = AR_UNKNOWN;
+
+	if ((f = fopen(dbfile, "r")) == NULL) {
+		return AR_UNKNOWN;
+	}
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+
+		char id[64];
+		int no;
+		unsigned int v1, v2, crc;
+
+		if (line[0] == '#' ||
+		    sscanf(line, "%63s %d %x %x %x", id, &no, &v1, &v2, &crc) != 5) {
+			continue;
+		}
+		if (no != track || strcmp(id, disc_id) != 0) {
+			continue;
+		}
+
+		if (v2 == ar->v2) {
+			ret = AR_MATCH_V2;
+			break;
+		}
+		if (v1 == ar->v1) {
+			ret = AR_MATCH_V1;
+		} else if (ret == AR_UNKNOWN) {
+			ret = AR_MISMATCH;
+		}
+	}
+
+	fclose(f);
+	return ret;
+}
+
+
+void
+accuraterip_db_append(char * dbfile, char * disc_id, int track, accuraterip_t * ar) {
+
+	FILE * f;
+
+	if ((f = fopen(dbfile, "a")) == NULL) {
+		fprintf(stderr, "accuraterip_db_append: unable to open %s\n", dbfile);
+		return;
+	}
+
+	fprintf(f, "%s %d %08x %08x %08x\n", disc_id, track,
+		ar->v1, ar->v2, ar->crc32 ^ 0xffffffffU);
+	fclose(f);
+}
+
+
+// vim: shiftwidth=8:tabstop=8:softtabstop=8 :  
@@ -0,0 +1,57 @@
+/*                                                     -*- linux-c -*-
+    Copyright (C) 2026 Aqualung contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+    $Id$
+*/
+
+#ifndef AQUALUNG_ACCURATERIP_H
+#define AQUALUNG_ACCURATERIP_H
+
+#include <glib.h>
+
+#include "cdda.h"
+
+
+/* return values of accuraterip_db_lookup() */
+#define AR_UNKNOWN   0
+#define AR_MATCH_V1  1
+#define AR_MATCH_V2  2
+#define AR_MISMATCH  3
+
+/* Running checksums of one ripped track. */
+typedef struct {
+	guint32 v1;
+	guint32 v2;
+	guint32 crc32;
+	guint32 pos;        /* 0-based index of the next stereo frame */
+	guint32 check_from; /* only frames in [check_from, check_to) */
+	guint32 check_to;   /* go into the AccurateRip sums */
+} accuraterip_t;
+
+
+void accuraterip_init(accuraterip_t * ar, int track_sectors, int first, int last);
+void accuraterip_update(accuraterip_t * ar, const float * buf, int frames);
+
+void accuraterip_disc_id(cdda_disc_t * disc, char * id, size_t id_size);
+
+int accuraterip_db_lookup(char * dbfile, char * disc_id, int track, accuraterip_t * ar);
+void accuraterip_db_append(char * dbfile, char * disc_id, int track, accuraterip_t * ar);
+
+
+#endif /* AQUALUNG_ACCURATERIP_H */
+
+// vim: shiftwidth=8:tabstop=8:softtabstop=8 :  
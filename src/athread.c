@@ -20,21 +20,175 @@
 
 #include <config.h>
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <glib.h>
 
 #include "athread.h"
 
+#define THREAD_MAX_CPUS 1024
+
+
+int
+thread_sched_parse_policy(const gchar * str) {
+
+	if (g_ascii_strcasecmp(str, "fifo") == 0) {
+		return THREAD_SCHED_FIFO;
+	}
+	if (g_ascii_strcasecmp(str, "rr") == 0) {
+		return THREAD_SCHED_RR;
+	}
+	return -1;
+}
+
+
+static int
+parse_cpus(const gchar * cpus, guchar * mask) {
+
+	const gchar * p = cpus;
+	char * end;
+	long lo, hi;
+
+	memset(mask, 0, THREAD_MAX_CPUS);
+	while (1) {
+		lo = hi = strtol(p, &end, 10);
+		if (end == p || lo < 0) {
+			return -1;
+		}
+		if (*end == '-') {
+			p = end + 1;
+			hi = strtol(p, &end, 10);
+			if (end == p || hi < lo) {
+				return -1;
+			}
+		}
+		if (hi >= THREAD_MAX_CPUS) {
+			return -1;
+		}
+		while (lo <= hi) {
+			mask[lo++] = 1;
+		}
+		if (*end == '\0') {
+			return 0;
+		}
+		if (*end != ',') {
+			return -1;
+		}
+		p = end + 1;
+	}
+}
+
+
+gboolean
+thread_sched_valid_cpus(const gchar * cpus) {
+
+	guchar mask[THREAD_MAX_CPUS];
+
+	return parse_cpus(cpus, mask) == 0;
+}
+
+
 #ifdef HAVE_LIBPTHREAD
 #include <pthread.h>
 #include <sched.h>
 
 
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+static void
+set_thread_affinity(pthread_t thread, const gchar * name, const gchar * cpus) {
+
+	guchar mask[THREAD_MAX_CPUS];
+	cpu_set_t set;
+	int i, err;
+
+	if (parse_cpus(cpus, mask) != 0) {
+		g_warning("invalid CPU list for %s thread: %s", name, cpus);
+		return;
+	}
+	CPU_ZERO(&set);
+	for (i = 0; i < THREAD_MAX_CPUS && i < CPU_SETSIZE; i++) {
+		if (mask[i]) {
+			CPU_SET(i, &set);
+		}
+	}
+	if ((err = pthread_setaffinity_np(thread, sizeof(set), &set)) != 0) {
+		g_warning("cannot set CPU affinity of %s thread to %s: %s",
+			  name, cpus, g_strerror(err));
+	}
+}
+
+
+/* the CPUs a thread may run on, as a list like "0,2-3" */
+static gchar *
+get_thread_affinity(pthread_t thread) {
+
+	cpu_set_t set;
+	GString * str;
+	int i, first;
+
+	if (pthread_getaffinity_np(thread, sizeof(set), &set) != 0) {
+		return g_strdup("?");
+	}
+	str = g_string_new(NULL);
+	for (i = 0; i < CPU_SETSIZE; i++) {
+		if (!CPU_ISSET(i, &set)) {
+			continue;
+		}
+		first = i;
+		while (i + 1 < CPU_SETSIZE && CPU_ISSET(i + 1, &set)) {
+			++i;
+		}
+		if (str->len > 0) {
+			g_string_append_c(str, ',');
+		}
+		if (i > first) {
+			g_string_append_printf(str, "%d-%d", first, i);
+		} else {
+			g_string_append_printf(str, "%d", i);
+		}
+	}
+	return g_string_free(str, FALSE);
+}
+#endif /* HAVE_PTHREAD_SETAFFINITY_NP */
+
+
+/* print what the thread really got, which need not be what was asked */
+static void
+report_thread(pthread_t thread, const gchar * name) {
+
+	struct sched_param param;
+	int policy;
+	gchar * cpus;
+	const gchar * policy_name;
+
+	if (pthread_getschedparam(thread, &policy, &param) != 0) {
+		return;
+	}
+	switch (policy) {
+	case SCHED_FIFO: policy_name = "SCHED_FIFO"; break;
+	case SCHED_RR: policy_name = "SCHED_RR"; break;
+	default: policy_name = "SCHED_OTHER"; break;
+	}
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+	cpus = get_thread_affinity(thread);
+#else
+	cpus = g_strdup("any");
+#endif /* HAVE_PTHREAD_SETAFFINITY_NP */
+
+	printf("%s thread: %s, priority %d, CPUs %s\n",
+	       name, policy_name, param.sched_priority, cpus);
+	g_free(cpus);
+}
+
+
 void
-set_thread_priority(pthread_t thread, const gchar * name, gboolean realtime,
-		    gint priority) {
+set_thread_sched(pthread_t thread, const gchar * name,
+		 const thread_sched_t * sched) {
 
 	struct sched_param param;
 	int policy, priority_min, priority_max;
+	int priority = sched->priority;
 	int err;
 
 	if ((err = pthread_getschedparam(thread, &policy, &param)) != 0) {
@@ -43,8 +197,8 @@ set_thread_priority(pthread_t thread, const gchar * name, gboolean realtime,
 		return;
 	}
 
-	if (realtime) {
-		policy = SCHED_FIFO;
+	if (sched->realtime) {
+		policy = (sched->policy == THREAD_SCHED_RR) ? SCHED_RR : SCHED_FIFO;
 	}
 	priority_min = sched_get_priority_min(policy);
 	priority_max = sched_get_priority_max(policy);
@@ -72,6 +226,17 @@ set_thread_priority(pthread_t thread, const gchar * name, gboolean realtime,
 			  name, g_strerror(err));
 	}
 
+	if (sched->cpus != NULL) {
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+		set_thread_affinity(thread, name, sched->cpus);
+#else
+		g_warning("CPU affinity is not supported, %s thread runs on any CPU", name);
+#endif /* HAVE_PTHREAD_SETAFFINITY_NP */
+	}
+
+	if (sched->realtime || sched->priority != -1 || sched->cpus != NULL) {
+		report_thread(thread, name);
+	}
 }
 
 
@@ -79,12 +244,16 @@ set_thread_priority(pthread_t thread, const gchar * name, gboolean realtime,
 
 
 void
-set_thread_priority(GThread * thread, const gchar * name, gboolean realtime,
-		    gint priority) {
+set_thread_sched(GThread * thread, const gchar * name,
+		 const thread_sched_t * sched) {
 
-	if (realtime)
+	if (sched->realtime) {
 		g_thread_set_priority(thread, G_THREAD_PRIORITY_URGENT);
-
+		printf("%s thread: urgent priority\n", name);
+	}
+	if (sched->cpus != NULL) {
+		g_warning("CPU affinity is not supported, %s thread runs on any CPU", name);
+	}
 }
 
 
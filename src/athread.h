@@ -27,6 +27,24 @@
 #include <glib.h>
 
 
+#define THREAD_SCHED_FIFO 0
+#define THREAD_SCHED_RR   1
+
+/* How a thread should run. priority -1 keeps the default of the policy;
+ * cpus is a list like "2" or "0,4-7", NULL to run anywhere.
+ */
+typedef struct _thread_sched_t {
+	gboolean realtime;
+	gint policy;
+	gint priority;
+	gchar * cpus;
+} thread_sched_t;
+
+/* "fifo" or "rr", -1 if neither */
+int thread_sched_parse_policy(const gchar * str);
+gboolean thread_sched_valid_cpus(const gchar * cpus);
+
+
 #ifdef HAVE_LIBPTHREAD
 
 #include <pthread.h>
@@ -49,12 +67,13 @@
 	pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
 #define AQUALUNG_COND_INIT(cond) pthread_cond_init(&(cond), NULL);
 #define AQUALUNG_COND_SIGNAL(cond) pthread_cond_signal(&(cond));
+#define AQUALUNG_COND_BROADCAST(cond) pthread_cond_broadcast(&(cond));
 #define AQUALUNG_COND_TIMEDWAIT(cond, mutex, timeout) \
 	pthread_cond_timedwait(&(cond), &(mutex), &(timeout));
 #define AQUALUNG_COND_WAIT(cond, mutex) pthread_cond_wait(&(cond), &(mutex));
 
-void set_thread_priority(pthread_t thread, const gchar * name,
-			 gboolean realtime, gint priority);
+void set_thread_sched(pthread_t thread, const gchar * name,
+		      const thread_sched_t * sched);
 
 #else /* !HAVE_LIBPTHREAD */
 
@@ -74,12 +93,13 @@ void set_thread_priority(pthread_t thread, const gchar * name,
 #define AQUALUNG_COND_DECLARE_INIT(cond) GCond * cond = NULL;
 #define AQUALUNG_COND_INIT(cond) cond = NULL;
 #define AQUALUNG_COND_SIGNAL(cond) g_cond_signal(cond);
+#define AQUALUNG_COND_BROADCAST(cond) g_cond_broadcast(cond);
 #define AQUALUNG_COND_TIMEDWAIT(cond, mutex, timeout) \
 	g_cond_timed_wait(cond, mutex, timeout);
 #define AQUALUNG_COND_WAIT(cond, mutex) g_cond_wait(cond, mutex);
 
-void set_thread_priority(GThread * thread, const gchar * name,
-			 gboolean realtime, gint priority);
+void set_thread_sched(GThread * thread, const gchar * name,
+		      const thread_sched_t * sched);
 
 #endif /* !HAVE_LIBPTHREAD */
 
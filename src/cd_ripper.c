@@ -56,6 +56,7 @@
 #include "i18n.h"
 #include "cdda.h"
 #include "metadata.h"
+#include "accuraterip.h"
 #include "cd_ripper.h"
 
 
@@ -97,6 +98,7 @@ GtkWidget * ripper_hbox;
 int ripper_prog_window_visible;
 
 AQUALUNG_THREAD_DECLARE(ripper_thread_id)
+int ripper_thread_started;
 int ripper_thread_busy;
 
 int ripper_format;
@@ -117,6 +119,23 @@ int ripper_paranoia_maxretries;
 int total_sectors;
 char destdir[MAXLEN];
 
+/* read-ahead bound between the drive and the encoders: one minute of audio */
+#define RIPPER_QUEUE_SECTORS (75 * 60)
+#define RIPPER_MAX_ENCODERS 4
+
+AQUALUNG_MUTEX_DECLARE_INIT(ripper_queue_mutex)
+AQUALUNG_COND_DECLARE_INIT(ripper_queue_data)
+AQUALUNG_COND_DECLARE_INIT(ripper_queue_space)
+GList * ripper_jobs;
+int ripper_queued_sectors;
+int ripper_reading_done;
+int ripper_sectors_read;
+int ripper_sectors_encoded;
+
+GTimer * ripper_timer;
+GtkWidget * ripper_stats_label;
+guint ripper_stats_tag;
+
 
 GtkWidget *
 create_notebook_page(GtkWidget * nb, char * title) {
@@ -984,7 +1003,16 @@ ripper_prog_store_make(cdda_drive_t * drive) {
 void
 ripper_prog_window_close(GtkWidget * widget, gpointer data) {
 
+	AQUALUNG_MUTEX_LOCK(ripper_queue_mutex)
 	ripper_thread_busy = 0;
+	AQUALUNG_COND_BROADCAST(ripper_queue_data)
+	AQUALUNG_COND_BROADCAST(ripper_queue_space)
+	AQUALUNG_MUTEX_UNLOCK(ripper_queue_mutex)
+
+	if (ripper_stats_tag) {
+		g_source_remove(ripper_stats_tag);
+		ripper_stats_tag = 0;
+	}
 	unregister_toplevel_window(ripper_prog_window);
 	gtk_widget_destroy(ripper_prog_window);
 	ripper_prog_window = NULL;
@@ -1072,6 +1100,10 @@ ripper_window(void) {
         column = gtk_tree_view_column_new_with_attributes(_("Progress"), cell, "value", 3, NULL);
         gtk_tree_view_append_column(GTK_TREE_VIEW(prog_tree), GTK_TREE_VIEW_COLUMN(column));
 
+        cell = gtk_cell_renderer_text_new();
+        column = gtk_tree_view_column_new_with_attributes(_("Checksum"), cell, "text", 4, NULL);
+        gtk_tree_view_append_column(GTK_TREE_VIEW(prog_tree), GTK_TREE_VIEW_COLUMN(column));
+
         ripper_hbox = gtk_hbox_new(FALSE, 0);
         gtk_box_pack_end(GTK_BOX(vbox), ripper_hbox, FALSE, TRUE, 5);
 
@@ -1079,6 +1111,9 @@ ripper_window(void) {
 	gtk_widget_set_name(ripper_close_when_ready_check, "check_on_window");
         gtk_box_pack_start(GTK_BOX(ripper_hbox), ripper_close_when_ready_check, FALSE, TRUE, 0);
 
+	ripper_stats_label = gtk_label_new("");
+        gtk_box_pack_start(GTK_BOX(ripper_hbox), ripper_stats_label, TRUE, TRUE, 5);
+
         ripper_cancel_button = gui_stock_label_button (_("Abort"), GTK_STOCK_CANCEL);
         g_signal_connect(ripper_cancel_button, "clicked", G_CALLBACK(ripper_cancel), NULL);
         gtk_box_pack_end(GTK_BOX(ripper_hbox), ripper_cancel_button, FALSE, TRUE, 0);
@@ -1156,43 +1191,517 @@ ripper_meta_add(metadata_t * meta, int tags, int type, char * str, int val) {
 }
 
 
+/* One selected track on its way from the drive to the encoder. The
+ * ripper thread appends sectors to the chunk list; an encoder worker
+ * claims the job and drains it, possibly while the drive is already
+ * reading the next track.
+ */
+typedef struct _ripper_chunk_t {
+
+	struct _ripper_chunk_t * next;
+	int n_read;
+	float buf[2*BUFSIZE];
+
+} ripper_chunk_t;
+
+typedef struct {
+
+	int no;
+	int row; /* in ripper_prog_store */
+	char * name;
+	int track_sectors;
+	int sectors_encoded;
+	encoder_mode_t mode;
+
+	ripper_chunk_t * head;
+	ripper_chunk_t * tail;
+	int done_reading;
+	int claimed;
+	int superseded; /* being re-read, don't add to the store */
+	int add_to_store;
+
+} ripper_job_t;
+
+
+void
+ripper_job_free(ripper_job_t * job) {
+
+	ripper_chunk_t * chunk;
+
+	while ((chunk = job->head) != NULL) {
+		job->head = chunk->next;
+		free(chunk);
+	}
+
+	if (job->mode.meta != NULL) {
+		metadata_free(job->mode.meta);
+	}
+	g_free(job->name);
+	free(job);
+}
+
+
+gboolean
+ripper_store_add_track(gpointer data) {
+
+	ripper_job_t * job = (ripper_job_t *)data;
+
+	if (gtk_tree_store_iter_is_valid(music_store, &ripper_dest_record)) {
+
+		GtkTreeIter iter;
+		char sort_name[3];
+		track_data_t * track_data;
+
+		if ((track_data = (track_data_t *)calloc(1, sizeof(track_data_t))) == NULL) {
+			fprintf(stderr, "ripper_store_add_track: calloc error\n");
+			ripper_job_free(job);
+			return FALSE;
+		}
+
+		track_data->file = strdup(job->mode.filename);
+		track_data->duration = job->sectors_encoded / 75.0;
+		track_data->volume = 1.0f;
+
+		arr_snprintf(sort_name, "%02d", job->no);
+
+		gtk_tree_store_append(music_store, &iter, &ripper_dest_record);
+		gtk_tree_store_set(music_store, &iter,
+				   MS_COL_NAME, job->name,
+				   MS_COL_SORT, sort_name,
+				   MS_COL_DATA, track_data, -1);
+
+		if (options.enable_ms_tree_icons) {
+			gtk_tree_store_set(music_store, &iter, MS_COL_ICON, icon_track, -1);
+		}
+
+		music_store_mark_changed(&iter);
+	}
+
+	ripper_job_free(job);
+	return FALSE;
+}
+
+
+void
+ripper_encode_job(ripper_job_t * job) {
+
+	file_encoder_t * fenc = file_encoder_new();
+	int encoder_ok = (file_encoder_open(fenc, &job->mode) == 0);
+
+	/* Keep draining the job even if the encoder failed to open, so the
+	   ripper is never left waiting for queue space. */
+	for (;;) {
+
+		ripper_chunk_t * chunk;
+		int prog_track;
+		int prog_total;
+
+		AQUALUNG_MUTEX_LOCK(ripper_queue_mutex)
+		while (ripper_thread_busy && job->head == NULL && !job->done_reading) {
+			AQUALUNG_COND_WAIT(ripper_queue_data, ripper_queue_mutex)
+		}
+		if (!ripper_thread_busy || (chunk = job->head) == NULL) {
+			AQUALUNG_MUTEX_UNLOCK(ripper_queue_mutex)
+			break;
+		}
+		if ((job->head = chunk->next) == NULL) {
+			job->tail = NULL;
+		}
+		--ripper_queued_sectors;
+		AQUALUNG_COND_BROADCAST(ripper_queue_space)
+		AQUALUNG_MUTEX_UNLOCK(ripper_queue_mutex)
+
+		if (encoder_ok) {
+			file_encoder_write(fenc, chunk->buf, chunk->n_read);
+		}
+		free(chunk);
+
+		AQUALUNG_MUTEX_LOCK(ripper_queue_mutex)
+		++job->sectors_encoded;
+		++ripper_sectors_encoded;
+		prog_track = 100 * job->sectors_encoded / job->track_sectors;
+		prog_total = 100 * ripper_sectors_encoded / total_sectors;
+		AQUALUNG_MUTEX_UNLOCK(ripper_queue_mutex)
+
+		if ((job->sectors_encoded % 64 == 0) || (job->sectors_encoded == job->track_sectors)) {
+			aqualung_idle_add(ripper_update_status,
+				   GINT_TO_POINTER(((job->row & 0xff) << 16) |
+					      ((prog_track & 0xff) << 8) |
+					      (prog_total & 0xff)));
+		}
+	}
+
+	if (encoder_ok) {
+		file_encoder_close(fenc);
+	}
+	file_encoder_delete(fenc);
+
+	AQUALUNG_MUTEX_LOCK(ripper_queue_mutex)
+	ripper_jobs = g_list_remove(ripper_jobs, job);
+	/* only whole tracks go to the store, whether or not the
+	   progress window has been closed since */
+	if (job->superseded || !job->done_reading ||
+	    job->sectors_encoded < job->track_sectors) {
+		encoder_ok = 0;
+	}
+	/* the ripper may be waiting for this job to finish before re-reading it */
+	AQUALUNG_COND_BROADCAST(ripper_queue_space)
+	AQUALUNG_MUTEX_UNLOCK(ripper_queue_mutex)
+
+	if (encoder_ok && job->add_to_store) {
+		aqualung_idle_add(ripper_store_add_track, job);
+	} else {
+		ripper_job_free(job);
+	}
+}
+
+
+void *
+ripper_encoder_thread(void * arg) {
+
+	for (;;) {
+
+		ripper_job_t * job = NULL;
+		GList * node;
+
+		AQUALUNG_MUTEX_LOCK(ripper_queue_mutex)
+		for (;;) {
+			for (node = ripper_jobs; node; node = node->next) {
+				if (!((ripper_job_t *)node->data)->claimed) {
+					job = (ripper_job_t *)node->data;
+					break;
+				}
+			}
+			if (job != NULL || !ripper_thread_busy || ripper_reading_done) {
+				break;
+			}
+			AQUALUNG_COND_WAIT(ripper_queue_data, ripper_queue_mutex)
+		}
+		if (job == NULL || !ripper_thread_busy) {
+			AQUALUNG_MUTEX_UNLOCK(ripper_queue_mutex)
+			break;
+		}
+		job->claimed = 1;
+		AQUALUNG_MUTEX_UNLOCK(ripper_queue_mutex)
+
+		ripper_encode_job(job);
+	}
+
+	return NULL;
+}
+
+
+int
+ripper_encoder_count(void) {
+
+	int n = 1;
+
+	/* WAV output costs next to nothing, a second worker would only
+	   add another stream of writes */
+	if (ripper_format == ENC_SNDFILE_LIB) {
+		return 1;
+	}
+
+#ifdef _SC_NPROCESSORS_ONLN
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif /* _SC_NPROCESSORS_ONLN */
+
+	if (n < 1) {
+		n = 1;
+	} else if (n > RIPPER_MAX_ENCODERS) {
+		n = RIPPER_MAX_ENCODERS;
+	}
+
+	return n;
+}
+
+
+gboolean
+ripper_update_stats(gpointer data) {
+
+	char str[MAXLEN];
+	double elapsed;
+	int sectors_read;
+	int sectors_encoded;
+
+	if (!ripper_prog_window) {
+		ripper_stats_tag = 0;
+		return FALSE;
+	}
+
+	AQUALUNG_MUTEX_LOCK(ripper_queue_mutex)
+	sectors_read = ripper_sectors_read;
+	sectors_encoded = ripper_sectors_encoded;
+	AQUALUNG_MUTEX_UNLOCK(ripper_queue_mutex)
+
+	if ((elapsed = g_timer_elapsed(ripper_timer, NULL)) > 0.0) {
+		arr_snprintf(str, _("Reading: %.1fx  Encoding: %.1fx"),
+			     sectors_read / 75.0 / elapsed, sectors_encoded / 75.0 / elapsed);
+		gtk_label_set_text(GTK_LABEL(ripper_stats_label), str);
+	}
+
+	if (sectors_encoded >= total_sectors) {
+		ripper_stats_tag = 0;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+typedef struct {
+
+	int row;
+	char * text;
+
+} ripper_checksum_status_t;
+
+
+gboolean
+ripper_set_checksum_status(gpointer data) {
+
+	ripper_checksum_status_t * st = (ripper_checksum_status_t *)data;
+	GtkTreeIter iter;
+
+	if (ripper_prog_window &&
+	    gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(ripper_prog_store), &iter, NULL, st->row)) {
+		gtk_list_store_set(ripper_prog_store, &iter, 4, st->text, -1);
+	}
+
+	g_free(st->text);
+	free(st);
+	return FALSE;
+}
+
+
+void
+ripper_checksum_status(int row, char * text) {
+
+	ripper_checksum_status_t * st;
+
+	if ((st = (ripper_checksum_status_t *)malloc(sizeof(ripper_checksum_status_t))) == NULL) {
+		fprintf(stderr, "ripper_checksum_status: malloc error\n");
+		return;
+	}
+
+	st->row = row;
+	st->text = g_strdup(text);
+	aqualung_idle_add(ripper_set_checksum_status, st);
+}
+
+
+ripper_job_t *
+ripper_job_new(cdda_drive_t * drive, int no, char * name, int row) {
+
+	ripper_job_t * job;
+	char * ext = "raw";
+	int tags = 0;
+
+	if ((job = (ripper_job_t *)calloc(1, sizeof(ripper_job_t))) == NULL) {
+		fprintf(stderr, "ripper_job_new: calloc error\n");
+		return NULL;
+	}
+
+	job->no = no;
+	job->row = row;
+	job->name = g_strdup(name);
+	job->track_sectors = drive->disc.toc[no] - drive->disc.toc[no-1];
+	job->add_to_store = ripper_write_to_store;
+
+	switch (ripper_format) {
+	case ENC_SNDFILE_LIB:
+		ext = "wav";
+		tags = 0;
+		break;
+	case ENC_FLAC_LIB:
+		ext = "flac";
+		tags = META_TAG_OXC;
+		break;
+	case ENC_VORBIS_LIB:
+		ext = "ogg";
+		tags = META_TAG_OXC;
+		break;
+	case ENC_LAME_LIB:
+		ext = "mp3";
+		tags = META_TAG_ID3v1 | META_TAG_ID3v2 | META_TAG_APE;
+		break;
+	}
+
+	arr_snprintf(job->mode.filename, "%s/track%02d.%s", destdir, no, ext);
+	job->mode.file_lib = ripper_format;
+	job->mode.sample_rate = 44100;
+	job->mode.channels = 2;
+	if (job->mode.file_lib == ENC_FLAC_LIB) {
+		job->mode.clevel = ripper_bitrate;
+	} else if (job->mode.file_lib == ENC_VORBIS_LIB) {
+		job->mode.bps = ripper_bitrate * 1000;
+	} else if (job->mode.file_lib == ENC_LAME_LIB) {
+		job->mode.bps = ripper_bitrate * 1000;
+		job->mode.vbr = ripper_vbr;
+	}
+	job->mode.write_meta = ripper_meta;
+	if (job->mode.write_meta) {
+		char date[8];
+		job->mode.meta = metadata_new();
+		arr_snprintf(date, "%d", ripper_year);
+
+		ripper_meta_add(job->mode.meta, tags, META_FIELD_ARTIST, ripper_artist, 0);
+		ripper_meta_add(job->mode.meta, tags, META_FIELD_ALBUM, ripper_album, 0);
+		ripper_meta_add(job->mode.meta, tags, META_FIELD_TITLE, name, 0);
+		ripper_meta_add(job->mode.meta, tags, META_FIELD_GENRE, ripper_genre, 0);
+		ripper_meta_add(job->mode.meta, tags, META_FIELD_DATE, date, 0);
+		ripper_meta_add(job->mode.meta, tags, META_FIELD_TRACKNO, "", no);
+	}
+
+	return job;
+}
+
+
+/* Read the sectors of job into the encoder queue, checksumming the
+ * PCM stream on the way. Returns -1 if the rip cannot go on.
+ */
+int
+ripper_read_job(cdda_drive_t * drive, long hash, ripper_job_t * job,
+		int paranoia_mode, accuraterip_t * ar) {
+
+	char decoder_filename[256];
+	int sectors_read = 0;
+	file_decoder_t * fdec;
+
+	arr_snprintf(decoder_filename, "CDDA %s %lX %d", drive->device_path, hash, job->no);
+
+	fdec = file_decoder_new();
+
+	if (file_decoder_open(fdec, decoder_filename)) {
+		file_decoder_delete(fdec);
+		return -1;
+	}
+
+	cdda_decoder_set_mode(((decoder_t *)fdec->pdec),
+			      100, /* max drive speed */
+			      paranoia_mode,
+			      ripper_paranoia_maxretries);
+
+	accuraterip_init(ar, job->track_sectors, job->no == 1, job->no == drive->disc.n_tracks);
+
+	AQUALUNG_MUTEX_LOCK(ripper_queue_mutex)
+	ripper_jobs = g_list_append(ripper_jobs, job);
+	AQUALUNG_COND_BROADCAST(ripper_queue_data)
+	AQUALUNG_MUTEX_UNLOCK(ripper_queue_mutex)
+
+	while (ripper_thread_busy) {
+
+		ripper_chunk_t * chunk;
+		int n_read;
+
+		if ((chunk = (ripper_chunk_t *)malloc(sizeof(ripper_chunk_t))) == NULL) {
+			fprintf(stderr, "ripper_read_job: malloc error\n");
+			break;
+		}
+
+		chunk->next = NULL;
+		chunk->n_read = n_read = file_decoder_read(fdec, chunk->buf, BUFSIZE);
+		accuraterip_update(ar, chunk->buf, n_read);
+		++sectors_read;
+
+		/* read ahead of the encoders, but only so far */
+		AQUALUNG_MUTEX_LOCK(ripper_queue_mutex)
+		while (ripper_thread_busy && ripper_queued_sectors >= RIPPER_QUEUE_SECTORS) {
+			AQUALUNG_COND_WAIT(ripper_queue_space, ripper_queue_mutex)
+		}
+		if (job->tail != NULL) {
+			job->tail->next = chunk;
+		} else {
+			job->head = chunk;
+		}
+		job->tail = chunk;
+		++ripper_queued_sectors;
+		++ripper_sectors_read;
+		AQUALUNG_COND_BROADCAST(ripper_queue_data)
+		AQUALUNG_MUTEX_UNLOCK(ripper_queue_mutex)
+
+		/* chunk may be encoded and freed by now */
+		if ((sectors_read >= job->track_sectors) || (n_read < BUFSIZE))
+			break;
+	}
+
+	file_decoder_close(fdec);
+	file_decoder_delete(fdec);
+
+	AQUALUNG_MUTEX_LOCK(ripper_queue_mutex)
+	/* a short read ends the track early; don't let the
+	   progress bars wait for sectors that will never come */
+	total_sectors -= job->track_sectors - sectors_read;
+	job->track_sectors = sectors_read;
+	job->done_reading = 1;
+	AQUALUNG_COND_BROADCAST(ripper_queue_data)
+	AQUALUNG_MUTEX_UNLOCK(ripper_queue_mutex)
+
+	return 0;
+}
+
+
+void
+ripper_report_checksum(int row, int result, accuraterip_t * ar, char * note) {
+
+	char text[MAXLEN];
+	char * str = _("Mismatch");
+
+	switch (result) {
+	case AR_MATCH_V1:
+		str = _("Accurate (v1)");
+		break;
+	case AR_MATCH_V2:
+		str = _("Accurate (v2)");
+		break;
+	case AR_UNKNOWN:
+		str = _("Not in database");
+		break;
+	}
+
+	if (note != NULL) {
+		arr_snprintf(text, "%s, %s [%08X]", str, note, ar->crc32 ^ 0xffffffffU);
+	} else {
+		arr_snprintf(text, "%s [%08X]", str, ar->crc32 ^ 0xffffffffU);
+	}
+	ripper_checksum_status(row, text);
+}
+
+
 void *
 ripper_thread(void * arg) {
 
 	cdda_drive_t * drive = (cdda_drive_t *)arg;
 	long hash;
 	int n = 0;
+	int i;
 	int track_cnt = 0;
-	int total_sectors_read = 0;
+	int n_encoders;
+	int paranoia_full = PARANOIA_MODE_OVERLAP | PARANOIA_MODE_VERIFY | PARANOIA_MODE_NEVERSKIP;
+	char disc_id[64];
+	char * dbfile;
 	GtkTreeIter source_iter;
+	AQUALUNG_THREAD_DECLARE(encoder_ids[RIPPER_MAX_ENCODERS])
 
 
-        AQUALUNG_THREAD_DETACH()
-
 	hash = calc_cdda_hash(&drive->disc);
+	accuraterip_disc_id(&drive->disc, disc_id, CHAR_ARRAY_SIZE(disc_id));
+	dbfile = g_build_filename(options.confdir, "accuraterip.db", NULL);
+
+	n_encoders = ripper_encoder_count();
+	for (i = 0; i < n_encoders; i++) {
+		AQUALUNG_THREAD_CREATE(encoder_ids[i], NULL, ripper_encoder_thread, NULL)
+	}
 
 	while (gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(ripper_source_store), &source_iter, NULL, n++)) {
 
 		gboolean b;
 		int no;
+		int row;
+		int result;
 		char * name;
-		char * ext = "raw";
-		int tags = 0;
-		char decoder_filename[256];
-		int track_sectors = 0;
-		int track_sectors_read = 0;
-
-		file_decoder_t * fdec;
-		file_encoder_t * fenc;
-		encoder_mode_t mode;
-
-		float buf[2*BUFSIZE];
-		int n_read;
-
-		int prog_track;
-		int prog_total;
-
-		memset(&mode, 0, sizeof(encoder_mode_t));
+		ripper_job_t * job;
+		accuraterip_t ar;
 
                 gtk_tree_model_get(GTK_TREE_MODEL(ripper_source_store), &source_iter, 0, &b, -1);
 
@@ -1202,137 +1711,107 @@ ripper_thread(void * arg) {
                 gtk_tree_model_get(GTK_TREE_MODEL(ripper_source_store), &source_iter,
 				   1, &no, 2, &name, -1);
 
-		if (ripper_thread_busy == 0) {
-			return NULL;
-		}
-
-		track_sectors = drive->disc.toc[no] - drive->disc.toc[no-1];
+		row = track_cnt++;
+		job = (ripper_thread_busy) ? ripper_job_new(drive, no, name, row) : NULL;
 
-		switch (ripper_format) {
-		case ENC_SNDFILE_LIB:
-			ext = "wav";
-			tags = 0;
-			break;
-		case ENC_FLAC_LIB:
-			ext = "flac";
-			tags = META_TAG_OXC;
-			break;
-		case ENC_VORBIS_LIB:
-			ext = "ogg";
-			tags = META_TAG_OXC;
-			break;
-		case ENC_LAME_LIB:
-			ext = "mp3";
-			tags = META_TAG_ID3v1 | META_TAG_ID3v2 | META_TAG_APE;
+		if (job == NULL) {
+			g_free(name);
 			break;
 		}
 
-		arr_snprintf(decoder_filename, "CDDA %s %lX %d", drive->device_path, hash, no);
-		arr_snprintf(mode.filename, "%s/track%02d.%s", destdir, no, ext);
-		mode.file_lib = ripper_format;
-		mode.sample_rate = 44100;
-		mode.channels = 2;
-		if (mode.file_lib == ENC_FLAC_LIB) {
-			mode.clevel = ripper_bitrate;
-		} else if (mode.file_lib == ENC_VORBIS_LIB) {
-			mode.bps = ripper_bitrate * 1000;
-		} else if (mode.file_lib == ENC_LAME_LIB) {
-			mode.bps = ripper_bitrate * 1000;
-			mode.vbr = ripper_vbr;
-		}
-		mode.write_meta = ripper_meta;
-		if (mode.write_meta) {
-			mode.meta = metadata_new();
-			char date[8];
-			arr_snprintf(date, "%d", ripper_year);
-
-			ripper_meta_add(mode.meta, tags, META_FIELD_ARTIST, ripper_artist, 0);
-			ripper_meta_add(mode.meta, tags, META_FIELD_ALBUM, ripper_album, 0);
-			ripper_meta_add(mode.meta, tags, META_FIELD_TITLE, name, 0);
-			ripper_meta_add(mode.meta, tags, META_FIELD_GENRE, ripper_genre, 0);
-			ripper_meta_add(mode.meta, tags, META_FIELD_DATE, date, 0);
-			ripper_meta_add(mode.meta, tags, META_FIELD_TRACKNO, "", no);
-		}
-
-		fdec = file_decoder_new();
-		fenc = file_encoder_new();
-
-		if (file_decoder_open(fdec, decoder_filename)) {
-			return NULL;
+		/* once read, an encoder may finish and free the job at any
+		   time: only name and row are used from here on */
+		if (ripper_read_job(drive, hash, job, ripper_paranoia_mode, &ar) < 0) {
+			ripper_job_free(job);
+			g_free(name);
+			break;
 		}
 
-		if (file_encoder_open(fenc, &mode)) {
-			return NULL;
+		if (!ripper_thread_busy) {
+			g_free(name);
+			break;
 		}
 
-		cdda_decoder_set_mode(((decoder_t *)fdec->pdec),
-				      100, /* max drive speed */
-				      ripper_paranoia_mode,
-				      ripper_paranoia_maxretries);
-
-		while (ripper_thread_busy) {
-
-			n_read = file_decoder_read(fdec, buf, BUFSIZE);
-			file_encoder_write(fenc, buf, n_read);
+		result = accuraterip_db_lookup(dbfile, disc_id, no, &ar);
 
-			++track_sectors_read;
-			++total_sectors_read;
+		if (result == AR_MISMATCH && (ripper_paranoia_mode & paranoia_full) != paranoia_full) {
 
-			prog_track = 100 * track_sectors_read / track_sectors;
-			prog_total = 100 * total_sectors_read / total_sectors;
+			/* Re-read the track once with full paranoia. The first
+			   pass has to be fully encoded before the second one may
+			   write the same file. */
+			ripper_job_t * retry;
+			accuraterip_t ar_retry;
 
-		        if ((track_sectors_read % 64 == 0) || (track_sectors_read == track_sectors))
-				aqualung_idle_add(ripper_update_status,
-					   GINT_TO_POINTER(((track_cnt & 0xff) << 16) |
-						      ((prog_track & 0xff) << 8) |
-						      (prog_total & 0xff)));
+			ripper_report_checksum(row, result, &ar, _("re-reading"));
 
-			if ((track_sectors_read >= track_sectors) || (n_read < BUFSIZE))
+			retry = ripper_job_new(drive, no, name, row);
+			g_free(name);
+			if (retry == NULL) {
 				break;
-		}
-
-		if (ripper_write_to_store && ripper_thread_busy &&
-		    gtk_tree_store_iter_is_valid(music_store, &ripper_dest_record)) {
-
-			GtkTreeIter iter;
-			char sort_name[3];
-			track_data_t * track_data;
-
-			if ((track_data = (track_data_t *)calloc(1, sizeof(track_data_t))) == NULL) {
-				fprintf(stderr, "ripper_thread: calloc error\n");
-				return 0;
 			}
 
-			track_data->file = strdup(mode.filename);
-			track_data->duration = track_sectors_read / 75.0;
-			track_data->volume = 1.0f;
-
-			arr_snprintf(sort_name, "%02d", no);
+			AQUALUNG_MUTEX_LOCK(ripper_queue_mutex)
+			/* count the retry in before the first pass may finish,
+			   or the progress would reach 100% in between */
+			total_sectors += retry->track_sectors;
+			if (g_list_find(ripper_jobs, job) != NULL) {
+				job->superseded = 1;
+			} else {
+				retry->superseded = 1; /* already in the store */
+			}
+			while (ripper_thread_busy && g_list_find(ripper_jobs, job) != NULL) {
+				AQUALUNG_COND_WAIT(ripper_queue_space, ripper_queue_mutex)
+			}
+			AQUALUNG_MUTEX_UNLOCK(ripper_queue_mutex)
 
-			gtk_tree_store_append(music_store, &iter, &ripper_dest_record);
-			gtk_tree_store_set(music_store, &iter,
-					   MS_COL_NAME, name,
-					   MS_COL_SORT, sort_name,
-					   MS_COL_DATA, track_data, -1);
+			if (!ripper_thread_busy) {
+				ripper_job_free(retry);
+				break;
+			}
 
-			if (options.enable_ms_tree_icons) {
-				gtk_tree_store_set(music_store, &iter, MS_COL_ICON, icon_track, -1);
+			if (ripper_read_job(drive, hash, retry, paranoia_full, &ar_retry) < 0) {
+				ripper_job_free(retry);
+				break;
 			}
 
-			music_store_mark_changed(&iter);
+			result = accuraterip_db_lookup(dbfile, disc_id, no, &ar_retry);
+			if (result == AR_MISMATCH) {
+				accuraterip_db_append(dbfile, disc_id, no, &ar_retry);
+				ripper_report_checksum(row, result, &ar_retry,
+						       (ar_retry.v2 == ar.v2) ? _("re-read identical") :
+						       _("re-read differs"));
+			} else {
+				ripper_report_checksum(row, result, &ar_retry, _("re-read"));
+			}
+			continue;
 		}
 
-		file_decoder_close(fdec);
-		file_encoder_close(fenc);
-		file_decoder_delete(fdec);
-		file_encoder_delete(fenc);
-		if (mode.meta != NULL) {
-			metadata_free(mode.meta);
+		if (result == AR_UNKNOWN || result == AR_MISMATCH) {
+			accuraterip_db_append(dbfile, disc_id, no, &ar);
 		}
+		ripper_report_checksum(row, result, &ar, NULL);
+		g_free(name);
+	}
+
+	AQUALUNG_MUTEX_LOCK(ripper_queue_mutex)
+	ripper_reading_done = 1;
+	AQUALUNG_COND_BROADCAST(ripper_queue_data)
+	AQUALUNG_MUTEX_UNLOCK(ripper_queue_mutex)
+
+	for (i = 0; i < n_encoders; i++) {
+		AQUALUNG_THREAD_JOIN(encoder_ids[i])
+	}
 
-		++track_cnt;
+	/* jobs never claimed because the rip was aborted */
+	AQUALUNG_MUTEX_LOCK(ripper_queue_mutex)
+	while (ripper_jobs != NULL) {
+		ripper_job_free((ripper_job_t *)ripper_jobs->data);
+		ripper_jobs = g_list_delete_link(ripper_jobs, ripper_jobs);
 	}
+	ripper_queued_sectors = 0;
+	AQUALUNG_MUTEX_UNLOCK(ripper_queue_mutex)
 
+	g_free(dbfile);
 	return NULL;
 }
 
@@ -1340,14 +1819,27 @@ ripper_thread(void * arg) {
 void
 cd_ripper(cdda_drive_t * drive, GtkTreeIter * iter) {
 
+	if (ripper_prog_window != NULL) {
+		/* one rip at a time: the queue and the stores are shared */
+		gtk_window_present(GTK_WINDOW(ripper_prog_window));
+		return;
+	}
+
+	if (ripper_thread_started) {
+		/* an aborted rip may still be freeing its queue */
+		AQUALUNG_THREAD_JOIN(ripper_thread_id)
+		ripper_thread_started = 0;
+	}
+
 	if (cd_ripper_dialog(drive, iter)) {
 
 		if (ripper_prog_store == NULL) {
-			ripper_prog_store = gtk_list_store_new(4,
+			ripper_prog_store = gtk_list_store_new(5,
 							       G_TYPE_STRING,  /* track number */
 							       G_TYPE_STRING,  /* begin sector */
 							       G_TYPE_STRING,  /* length (sectors) */
-							       G_TYPE_INT);    /* progress (%) */
+							       G_TYPE_INT,     /* progress (%) */
+							       G_TYPE_STRING); /* checksum status */
 		} else {
 			gtk_list_store_clear(ripper_prog_store);
 		}
@@ -1355,7 +1847,28 @@ cd_ripper(cdda_drive_t * drive, GtkTreeIter * iter) {
 		ripper_prog_store_make(drive);
 		ripper_window();
 
+#ifndef HAVE_LIBPTHREAD
+		if (ripper_queue_mutex == NULL) {
+			ripper_queue_mutex = g_mutex_new();
+			ripper_queue_data = g_cond_new();
+			ripper_queue_space = g_cond_new();
+		}
+#endif /* !HAVE_LIBPTHREAD */
+
+		ripper_queued_sectors = 0;
+		ripper_reading_done = 0;
+		ripper_sectors_read = 0;
+		ripper_sectors_encoded = 0;
+
+		if (ripper_timer == NULL) {
+			ripper_timer = g_timer_new();
+		} else {
+			g_timer_start(ripper_timer);
+		}
+		ripper_stats_tag = aqualung_timeout_add(500, ripper_update_stats, NULL);
+
 		ripper_thread_busy = 1;
+		ripper_thread_started = 1;
                 AQUALUNG_THREAD_CREATE(ripper_thread_id, NULL, ripper_thread, drive);
 	}
 }
@@ -0,0 +1,321 @@
+/*                                                     -*- linux-c -*-
+    Copyright (C) 2026 Aqualung contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+    $Id$
+*/
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif /* __SSE__ */
+
+#include "channels.h"
+
+
+#define M_3DB 0.70710678f
+
+static const char * position_names[CHANNEL_NPOS] = {
+	"FL", "FR", "FC", "LFE", "RL", "RR", "SL", "SR", "RC", "MONO"
+};
+
+static const int default_maps[MAX_CHANNELS][MAX_CHANNELS] = {
+	{ CHANNEL_MONO },
+	{ CHANNEL_FL, CHANNEL_FR },
+	{ CHANNEL_FL, CHANNEL_FR, CHANNEL_FC },
+	{ CHANNEL_FL, CHANNEL_FR, CHANNEL_RL, CHANNEL_RR },
+	{ CHANNEL_FL, CHANNEL_FR, CHANNEL_FC, CHANNEL_RL, CHANNEL_RR },
+	{ CHANNEL_FL, CHANNEL_FR, CHANNEL_FC, CHANNEL_LFE, CHANNEL_RL, CHANNEL_RR },
+	{ CHANNEL_FL, CHANNEL_FR, CHANNEL_FC, CHANNEL_LFE, CHANNEL_RC, CHANNEL_SL, CHANNEL_SR },
+	{ CHANNEL_FL, CHANNEL_FR, CHANNEL_FC, CHANNEL_LFE, CHANNEL_RL, CHANNEL_RR, CHANNEL_SL, CHANNEL_SR }
+};
+
+
+void
+channels_default_map(int n, int * map) {
+
+	memcpy(map, default_maps[n-1], n * sizeof(int));
+}
+
+
+const char *
+channels_position_name(int pos) {
+
+	if (pos < 0 || pos >= CHANNEL_NPOS) {
+		return "?";
+	}
+	return position_names[pos];
+}
+
+
+int
+channels_is_left(int pos) {
+
+	return (pos == CHANNEL_FL || pos == CHANNEL_RL || pos == CHANNEL_SL);
+}
+
+
+int
+channels_is_right(int pos) {
+
+	return (pos == CHANNEL_FR || pos == CHANNEL_RR || pos == CHANNEL_SR);
+}
+
+
+static int
+find_position(const int * map, int n, int pos) {
+
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (map[i] == pos) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+
+int
+channels_parse_map(const char * str, int * map) {
+
+	char buf[64];
+	char * s;
+	char * saveptr;
+	int n = 0;
+	int pos;
+
+	if (strlen(str) >= sizeof(buf)) {
+		return -1;
+	}
+	strcpy(buf, str);
+
+	for (s = strtok_r(buf, ",", &saveptr); s != NULL; s = strtok_r(NULL, ",", &saveptr)) {
+		for (pos = 0; pos < CHANNEL_MONO; pos++) {
+			if (strcasecmp(s, position_names[pos]) == 0) {
+				break;
+			}
+		}
+		if (pos == CHANNEL_MONO || n == MAX_CHANNELS || find_position(map, n, pos) >= 0) {
+			return -1;
+		}
+		map[n++] = pos;
+	}
+
+	if (find_position(map, n, CHANNEL_FL) < 0 || find_position(map, n, CHANNEL_FR) < 0) {
+		return -1;
+	}
+	return n;
+}
+
+
+/* send input channel k to the output speaker at pos, if present */
+static int
+mix_route(channel_mix_t * mix, const int * out_map, int k, int pos, float gain) {
+
+	int o = find_position(out_map, mix->n_out, pos);
+
+	if (o < 0) {
+		return 0;
+	}
+	mix->m[o][k] += gain;
+	return 1;
+}
+
+void
+channel_mix_init(channel_mix_t * mix, int n_in, const int * in_map,
+		 int n_out, const int * out_map) {
+
+	int k, o;
+	float peak = 0.0f;
+
+	memset(mix, 0, sizeof(channel_mix_t));
+	mix->n_in = n_in;
+	mix->n_out = n_out;
+
+	for (k = 0; k < n_in; k++) {
+		int pos = in_map[k];
+
+		if (mix_route(mix, out_map, k, pos, 1.0f)) {
+			continue;
+		}
+
+		switch (pos) {
+		case CHANNEL_MONO:
+			mix_route(mix, out_map, k, CHANNEL_FL, 1.0f);
+			mix_route(mix, out_map, k, CHANNEL_FR, 1.0f);
+			break;
+		case CHANNEL_FC:
+			mix_route(mix, out_map, k, CHANNEL_FL, M_3DB);
+			mix_route(mix, out_map, k, CHANNEL_FR, M_3DB);
+			break;
+		case CHANNEL_RL:
+			if (!mix_route(mix, out_map, k, CHANNEL_SL, 1.0f)) {
+				mix_route(mix, out_map, k, CHANNEL_FL, M_3DB);
+			}
+			break;
+		case CHANNEL_RR:
+			if (!mix_route(mix, out_map, k, CHANNEL_SR, 1.0f)) {
+				mix_route(mix, out_map, k, CHANNEL_FR, M_3DB);
+			}
+			break;
+		case CHANNEL_SL:
+			if (!mix_route(mix, out_map, k, CHANNEL_RL, 1.0f)) {
+				mix_route(mix, out_map, k, CHANNEL_FL, M_3DB);
+			}
+			break;
+		case CHANNEL_SR:
+			if (!mix_route(mix, out_map, k, CHANNEL_RR, 1.0f)) {
+				mix_route(mix, out_map, k, CHANNEL_FR, M_3DB);
+			}
+			break;
+		case CHANNEL_RC:
+			if (find_position(out_map, n_out, CHANNEL_RL) >= 0 &&
+			    find_position(out_map, n_out, CHANNEL_RR) >= 0) {
+				mix_route(mix, out_map, k, CHANNEL_RL, M_3DB);
+				mix_route(mix, out_map, k, CHANNEL_RR, M_3DB);
+			} else if (find_position(out_map, n_out, CHANNEL_SL) >= 0 &&
+				   find_position(out_map, n_out, CHANNEL_SR) >= 0) {
+				mix_route(mix, out_map, k, CHANNEL_SL, M_3DB);
+				mix_route(mix, out_map, k, CHANNEL_SR, M_3DB);
+			} else {
+				mix_route(mix, out_map, k, CHANNEL_FL, 0.5f);
+				mix_route(mix, out_map, k, CHANNEL_FR, 0.5f);
+			}
+			break;
+		default: /* LFE is dropped when there is no subwoofer */
+			break;
+		}
+	}
+
+	/* Scale the whole matrix so that no output row sums to more than
+	   unity: full scale input on every channel can't clip a downmix.
+	   A common factor keeps the balance between the speakers. */
+	for (o = 0; o < n_out; o++) {
+		float sum = 0.0f;
+		for (k = 0; k < n_in; k++) {
+			sum += mix->m[o][k];
+		}
+		if (sum > peak) {
+			peak = sum;
+		}
+	}
+	if (peak > 1.0f) {
+		for (o = 0; o < n_out; o++) {
+			for (k = 0; k < n_in; k++) {
+				mix->m[o][k] /= peak;
+			}
+		}
+	}
+
+	mix->duplicate = (n_in == 1 && n_out == 2 &&
+			  mix->m[0][0] == 1.0f && mix->m[1][0] == 1.0f);
+
+	mix->identity = (n_in == n_out);
+	for (o = 0; o < n_out && mix->identity; o++) {
+		for (k = 0; k < n_in; k++) {
+			if (mix->m[o][k] != ((o == k) ? 1.0f : 0.0f)) {
+				mix->identity = 0;
+				break;
+			}
+		}
+	}
+}
+
+
+/* mono to stereo: every sample twice */
+static void
+mix_duplicate(const float * in, float * out, int n_frames) {
+
+	int i = 0;
+
+#ifdef __SSE__
+	for (; i + 4 <= n_frames; i += 4) {
+		__m128 x = _mm_loadu_ps(in + i);
+		_mm_storeu_ps(out + 2*i, _mm_unpacklo_ps(x, x));
+		_mm_storeu_ps(out + 2*i + 4, _mm_unpackhi_ps(x, x));
+	}
+#endif /* __SSE__ */
+	for (; i < n_frames; i++) {
+		out[2*i] = out[2*i + 1] = in[i];
+	}
+}
+
+
+/* Downmix to stereo with the input width known at compile time, so
+ * the inner loops unroll and the compiler is free to vectorize.
+ */
+#define MIX_STEREO(N)						\
+	{							\
+		float l[N], r[N];				\
+		for (k = 0; k < N; k++) {			\
+			l[k] = mix->m[0][k];			\
+			r[k] = mix->m[1][k];			\
+		}						\
+		for (i = 0; i < n_frames; i++) {		\
+			float sl = 0.0f, sr = 0.0f;		\
+			for (k = 0; k < N; k++) {		\
+				sl += l[k] * in[N*i + k];	\
+				sr += r[k] * in[N*i + k];	\
+			}					\
+			out[2*i] = sl;				\
+			out[2*i + 1] = sr;			\
+		}						\
+	}
+
+void
+channel_mix_process(channel_mix_t * mix, const float * in, float * out, int n_frames) {
+
+	int i, k, o;
+	int n_in = mix->n_in;
+	int n_out = mix->n_out;
+
+	if (mix->identity) {
+		memcpy(out, in, n_frames * n_in * sizeof(float));
+		return;
+	}
+	if (mix->duplicate) {
+		mix_duplicate(in, out, n_frames);
+		return;
+	}
+
+	if (n_out == 2) {
+		switch (n_in) {
+		case 6: MIX_STEREO(6) return;
+		case 8: MIX_STEREO(8) return;
+		}
+	}
+
+	for (i = 0; i < n_frames; i++) {
+		for (o = 0; o < n_out; o++) {
+			float sum = 0.0f;
+			for (k = 0; k < n_in; k++) {
+				sum += mix->m[o][k] * in[k];
+			}
+			out[o] = sum;
+		}
+		in += n_in;
+		out += n_out;
+	}
+}
+
+
+// vim: shiftwidth=8:tabstop=8:softtabstop=8 :
@@ -0,0 +1,79 @@
+/*                                                     -*- linux-c -*-
+    Copyright (C) 2026 Aqualung contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+    $Id$
+*/
+
+#ifndef AQUALUNG_CHANNELS_H
+#define AQUALUNG_CHANNELS_H
+
+#include "decoder/file_decoder.h"
+
+
+/* speaker positions */
+#define CHANNEL_FL   0
+#define CHANNEL_FR   1
+#define CHANNEL_FC   2
+#define CHANNEL_LFE  3
+#define CHANNEL_RL   4
+#define CHANNEL_RR   5
+#define CHANNEL_SL   6
+#define CHANNEL_SR   7
+#define CHANNEL_RC   8
+#define CHANNEL_MONO 9
+#define CHANNEL_NPOS 10
+
+typedef struct {
+	int n_in;
+	int n_out;
+	int identity; /* input passes through unchanged */
+	int duplicate; /* mono input copied to both of two outputs */
+	float m[MAX_CHANNELS][MAX_CHANNELS]; /* [out][in] gains */
+} channel_mix_t;
+
+
+/* Speaker layout decoders deliver for a file with n channels (the
+ * WAVE/FLAC channel order).
+ */
+void channels_default_map(int n, int * map);
+
+/* Parse a comma separated list of positions like "FL,FR,RL,RR".
+ * Return the number of channels, or -1 if the list is invalid or
+ * lacks FL or FR.
+ */
+int channels_parse_map(const char * str, int * map);
+
+const char * channels_position_name(int pos);
+
+/* Nonzero for positions that follow the left resp. right balance. */
+int channels_is_left(int pos);
+int channels_is_right(int pos);
+
+/* Build the matrix mapping an n_in channel stream laid out as in_map
+ * onto the n_out speakers of out_map. Downmixes are scaled so that no
+ * output can exceed full scale, e.g. 5.1 to stereo by 1/2.414 (-7.7 dB).
+ */
+void channel_mix_init(channel_mix_t * mix, int n_in, const int * in_map,
+		      int n_out, const int * out_map);
+
+/* Mix n_frames interleaved frames; in and out must not overlap. */
+void channel_mix_process(channel_mix_t * mix, const float * in, float * out, int n_frames);
+
+
+#endif /* AQUALUNG_CHANNELS_H */
+
+// vim: shiftwidth=8:tabstop=8:softtabstop=8 :
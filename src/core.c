@@ -31,6 +31,7 @@
 #include <locale.h>
 #include <math.h>
 #include <getopt.h>
+#include <time.h>
 #include <sys/stat.h>
 #include <glib.h>
 #include <glib/gstdio.h>
@@ -40,12 +41,16 @@
 #include <libxml/tree.h>
 
 #ifdef HAVE_LIBPTHREAD
-#include <time.h>
 #include <sys/time.h>
 #endif /* HAVE_LIBPTHREAD */
 
+#ifdef HAVE_MLOCKALL
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif /* HAVE_MLOCKALL */
+
 #ifdef HAVE_SRC
-#include <samplerate.h>
+#include "resampler.h"
 #endif /* HAVE_SRC */
 
 #ifdef HAVE_SNDIO
@@ -99,6 +104,7 @@
 #include "i18n.h"
 #include "metadata.h"
 #include "core.h"
+#include "rt_bench.h"
 
 
 extern options_t options;
@@ -108,6 +114,8 @@ extern options_t options;
 jack_client_t * jack_client;
 jack_port_t * out_L_port;
 jack_port_t * out_R_port;
+jack_port_t * out_ports[MAX_CHANNELS];
+int n_out_ports = 0;
 char * client_name = NULL;
 guint32 jack_nframes;
 int jack_is_shutdown;
@@ -124,6 +132,20 @@ GSList * saved_pconns_R = NULL;
 int sndio_reinit(thread_info_t * info, int verbose);
 #endif /* HAVE_SNDIO */
 
+#if defined(HAVE_SNDIO) || defined(HAVE_OSS) || defined(HAVE_WINMM)
+/* for drivers that only play stereo; the disk thread downmixes */
+void
+output_stereo_only(thread_info_t * info) {
+
+	if (info->out_channels != 2) {
+		fprintf(stderr, "This output driver plays stereo only, "
+			"downmixing %d channels.\n", info->out_channels);
+		info->out_channels = 2;
+	}
+	channels_default_map(2, info->out_map);
+}
+#endif /* sndio || oss || winmm */
+
 const size_t sample_size = sizeof(float);
 
 gint playlist_state, browser_state;
@@ -140,9 +162,16 @@ gint playlist_state, browser_state;
 snd_pcm_uframes_t alsa_buffer_size = 0;
 #endif /* HAVE_ALSA */
 
+#ifdef NULL_DRIVER
+int null_period = 1024;
+#endif /* NULL_DRIVER */
+
 /* The name of the output device e.g. "/dev/dsp" or "plughw:0,0" */
 char * device_name = NULL;
 
+/* output speaker layout set with --channel-map */
+int channel_map_given = 0;
+
 
 /***** disk thread stuff *****/
 file_decoder_t * fdec = NULL;
@@ -153,20 +182,40 @@ int output = 0; /* oss/alsa/jack */
 int src_type_parsed = 0;
 
 /* Synchronization between disk thread and output thread */
-AQUALUNG_MUTEX_DECLARE_INIT(disk_thread_lock)
-AQUALUNG_COND_DECLARE_INIT(disk_thread_wake)
 rb_t * rb; /* this is the audio stream carrier ringbuffer */
-rb_t * rb_disk2out;
-rb_t * rb_out2disk;
+msgq_t * q_disk2out;
+msgq_t * q_out2disk;
 
 /* Communication between gui thread and disk thread */
-rb_t * rb_gui2disk;
-rb_t * rb_disk2gui;
+msgq_t * q_gui2disk;
+msgq_t * q_disk2gui;
+
+/* disk, output and SRC threads that have allocated their buffers */
+volatile gint audio_threads_ready = 0;
+
+#ifdef HAVE_SRC
+/* Sample rate conversion stage: the disk thread decodes into rb_src at
+ * the file's rate and src_thread converts from there into rb. The lock
+ * covers the stage's bookkeeping only, conversion runs without it.
+ */
+#define SRC_BLOCKSIZE 4096
+rb_t * rb_src;
+AQUALUNG_MUTEX_DECLARE_INIT(src_thread_lock)
+AQUALUNG_COND_DECLARE_INIT(src_thread_wake)
+AQUALUNG_COND_DECLARE_INIT(src_thread_idle)
+resampler_t * src_state = NULL;
+double src_stage_ratio = 1.0; /* of the frames in rb_src, 1.0: disk thread writes rb */
+int src_busy = 0;
+int src_quit = 0;
+#endif /* HAVE_SRC */
 
 double left_gain = 1.0;
 double right_gain = 1.0;
 
-/* LADSPA stuff */
+/* one buffer per output channel, in output order */
+float * ch_buf[MAX_CHANNELS];
+
+/* LADSPA stuff (front left and right of ch_buf) */
 float * l_buf = NULL;
 float * r_buf = NULL;
 #ifdef HAVE_LADSPA
@@ -237,6 +286,182 @@ same_disc_next_track(char * filename, char * filename_prev) {
 #endif /* HAVE_CDDA */
  
 
+#ifdef HAVE_SRC
+/* wake src_thread after new frames went into rb_src */
+void
+src_stage_wake(void) {
+
+	AQUALUNG_MUTEX_LOCK(src_thread_lock)
+	AQUALUNG_COND_SIGNAL(src_thread_wake)
+	AQUALUNG_MUTEX_UNLOCK(src_thread_lock)
+}
+
+
+/* Called by the disk thread before it writes frames needing ratio (1.0
+ * for writing rb directly). Returns 0 while the stage still holds frames
+ * converted at another ratio.
+ */
+int
+src_stage_switch(double ratio) {
+
+	int ok = 1;
+
+	AQUALUNG_MUTEX_LOCK(src_thread_lock)
+	if (ratio != src_stage_ratio) {
+		if (src_busy || rb_read_space(rb_src) > 0) {
+			ok = 0;
+		} else {
+			src_stage_ratio = ratio;
+			if (src_state != NULL) {
+				resampler_reset(src_state);
+			}
+		}
+	}
+	AQUALUNG_MUTEX_UNLOCK(src_thread_lock)
+	return ok;
+}
+
+
+/* drop everything in the stage, returns the number of input frames dropped */
+guint32
+src_stage_flush(size_t frame_size) {
+
+	guint32 n;
+
+	AQUALUNG_MUTEX_LOCK(src_thread_lock)
+	while (src_busy) {
+		AQUALUNG_COND_WAIT(src_thread_idle, src_thread_lock)
+	}
+	n = rb_read_space(rb_src) / frame_size;
+	rb_read_advance(rb_src, n * frame_size);
+	if (src_state != NULL) {
+		resampler_reset(src_state);
+	}
+	AQUALUNG_MUTEX_UNLOCK(src_thread_lock)
+	return n;
+}
+
+
+void
+src_stage_quit(void) {
+
+	AQUALUNG_MUTEX_LOCK(src_thread_lock)
+	src_quit = 1;
+	AQUALUNG_COND_SIGNAL(src_thread_wake)
+	AQUALUNG_MUTEX_UNLOCK(src_thread_lock)
+}
+
+
+void *
+src_thread(void * arg) {
+
+	thread_info_t * info = (thread_info_t *)arg;
+	size_t frame_size = info->out_channels * sample_size;
+	float * inbuf = malloc(SRC_BLOCKSIZE * frame_size);
+	float * outbuf = malloc(SRC_BLOCKSIZE * frame_size);
+	int src_type = options.src_type;
+	int src_error;
+	resampler_t * new_state;
+	SRC_DATA src_data;
+	size_t n_in, n_out;
+	double ratio;
+
+	if ((!inbuf) || (!outbuf)) {
+		fprintf(stderr, "SRC thread: malloc error\n");
+		exit(1);
+	}
+
+	AQUALUNG_MUTEX_LOCK(src_thread_lock)
+
+	if ((src_state = resampler_new(src_type, info->out_channels, &src_error)) == NULL) {
+		fprintf(stderr, "SRC thread: error: resampler_new() failed: %s.\n",
+			resampler_strerror(src_error));
+		exit(1);
+	}
+	g_atomic_int_inc(&audio_threads_ready);
+
+	while (!src_quit) {
+
+		ratio = src_stage_ratio;
+		n_in = rb_read_space(rb_src) / frame_size;
+		n_out = rb_write_space(rb) / frame_size;
+		if (n_out > SRC_BLOCKSIZE)
+			n_out = SRC_BLOCKSIZE;
+		if (n_in > n_out / ratio)
+			n_in = n_out / ratio;
+		if (n_in > SRC_BLOCKSIZE)
+			n_in = SRC_BLOCKSIZE;
+
+		if (n_in == 0) {
+			/* nothing to convert or rb is full, look again after 10 ms */
+#ifndef HAVE_LIBPTHREAD
+			GTimeVal time;
+			GTimeVal * timeout = &time;
+			g_get_current_time(timeout);
+			g_time_val_add(timeout, 10000);
+#else /* HAVE_LIBPTHREAD */
+			struct timeval now;
+			struct timezone tz;
+			struct timespec timeout;
+			gettimeofday(&now, &tz);
+			timeout.tv_nsec = now.tv_usec * 1000 + 10000000;
+			timeout.tv_sec = now.tv_sec;
+			while (timeout.tv_nsec > 1000000000) {
+				timeout.tv_nsec -= 1000000000;
+				timeout.tv_sec += 1;
+			}
+#endif /* HAVE_LIBPTHREAD */
+			AQUALUNG_COND_TIMEDWAIT(src_thread_wake, src_thread_lock, timeout)
+			continue;
+		}
+
+		src_busy = 1;
+		AQUALUNG_MUTEX_UNLOCK(src_thread_lock)
+
+		if (src_type != options.src_type) {
+			/* keep the old converter if the new one can't be had */
+			src_type = options.src_type;
+			if ((new_state = resampler_new(src_type, info->out_channels, &src_error)) == NULL) {
+				fprintf(stderr, "SRC thread: error: resampler_new() failed: %s.\n",
+					resampler_strerror(src_error));
+			} else {
+				resampler_delete(src_state);
+				src_state = new_state;
+			}
+		}
+
+		rb_peek(rb_src, (char *)inbuf, n_in * frame_size);
+		src_data.input_frames = n_in;
+		src_data.data_in = inbuf;
+		src_data.src_ratio = ratio;
+		src_data.data_out = outbuf;
+		src_data.output_frames = n_out;
+		src_data.end_of_input = 0;
+		if ((src_error = resampler_process(src_state, &src_data))) {
+			fprintf(stderr, "SRC thread: SRC error: %s\n",
+				resampler_strerror(src_error));
+			/* drop the block rather than retry it forever */
+			src_data.input_frames_used = n_in;
+			src_data.output_frames_gen = 0;
+		}
+		rb_read_advance(rb_src, src_data.input_frames_used * frame_size);
+		rb_write(rb, (char *)outbuf, src_data.output_frames_gen * frame_size);
+
+		AQUALUNG_MUTEX_LOCK(src_thread_lock)
+		src_busy = 0;
+		AQUALUNG_COND_BROADCAST(src_thread_idle)
+	}
+
+	src_state = resampler_delete(src_state);
+	AQUALUNG_MUTEX_UNLOCK(src_thread_lock)
+
+	free(inbuf);
+	free(outbuf);
+	return 0;
+}
+#endif /* HAVE_SRC */
+
+
 /* roll back sample_offset samples, if possible */
 void
 rollback(file_decoder_t * fdec, double src_ratio, guint32 playback_offset) {
@@ -248,12 +473,17 @@ rollback(file_decoder_t * fdec, double src_ratio, guint32 playback_offset) {
 }
 
 
-/* returns number of samples in rb and output driver buffer */
+/* returns number of input samples in rb, the SRC stage and the output device */
 guint32
-flush_output(double src_ratio) {
+flush_output(thread_info_t * info, double src_ratio) {
 
-	guint32 driver_offset;
-	char send_cmd = CMD_FLUSH;
+	guint32 src_offset = 0;
+	message_t msg;
+
+#ifdef HAVE_SRC
+	/* empty the SRC stage first, so nothing refills rb behind the flush */
+	src_offset = src_stage_flush(info->out_channels * sample_size);
+#endif /* HAVE_SRC */
 
 #ifdef HAVE_JACK
 	if (jack_is_shutdown) {
@@ -261,23 +491,163 @@ flush_output(double src_ratio) {
 	}
 #endif /* HAVE_JACK */
 
-	sample_offset = rb_read_space(rb) / (2 * sample_size) * src_ratio;
+	sample_offset = rb_read_space(rb) / (info->out_channels * sample_size);
+
+	msg.cmd = CMD_FLUSH;
+	if (msgq_send(q_disk2out, &msg) < 0) {
+		fprintf(stderr, "flush_output: output queue full\n");
+		return sample_offset / src_ratio + src_offset;
+	}
+	/* the reply is posted without a wakeup, so look often */
+	while (!msgq_recv(q_out2disk, &msg))
+		msgq_wait(q_out2disk, 1);
+
+	/* rb and the device hold output frames, the SRC stage input frames */
+	return (sample_offset + msg.u.driver_offset) / src_ratio + src_offset;
+}
+
+
+/* output threads: report a finished CMD_FLUSH to the disk thread.
+ * Safe from the JACK process callback.
+ */
+void
+flush_done(guint32 driver_offset) {
+
+	message_t msg;
+
+	msg.cmd = CMD_FLUSH;
+	msg.u.driver_offset = driver_offset;
+	if (msgq_post(q_out2disk, &msg) < 0) {
+		fprintf(stderr, "flush_done: reply queue full\n");
+	}
+}
+
+
+static void
+send_to_disk(message_t * msg) {
+
+	if (msgq_send(q_gui2disk, msg) == 0) {
+		return;
+	}
+	fprintf(stderr, "disk thread queue full, command %d dropped\n", msg->cmd);
+	if (msg->cmd == CMD_CUE && msg->u.cue.filename != NULL) {
+		free(msg->u.cue.filename);
+	}
+}
+
+
+/* STATUS is sent again soon and METABLOCK belongs to the decoder, so
+ * those are dropped quietly when the GUI falls behind
+ */
+static void
+send_to_gui(message_t * msg) {
+
+	if (msgq_send(q_disk2gui, msg) == 0) {
+		return;
+	}
+	if (msg->cmd == CMD_FILEINFO) {
+		free(msg->u.fileinfo.format_str);
+	}
+	if (msg->cmd != CMD_STATUS && msg->cmd != CMD_METABLOCK) {
+		fprintf(stderr, "GUI queue full, message %d dropped\n", msg->cmd);
+	}
+}
+
+
+void
+disk_send_cmd(int cmd) {
+
+	message_t msg;
+
+	msg.cmd = cmd;
+	send_to_disk(&msg);
+}
+
+
+void
+disk_send_cue(cue_t * cue) {
+
+	message_t msg;
+
+	msg.cmd = CMD_CUE;
+	msg.u.cue = *cue;
+	send_to_disk(&msg);
+}
+
+
+void
+disk_send_seek(long long pos) {
+
+	message_t msg;
+
+	msg.cmd = CMD_SEEKTO;
+	msg.u.seek.seek_to_pos = pos;
+	send_to_disk(&msg);
+}
+
 
-	rb_write(rb_disk2out, &send_cmd, 1);
-	while (rb_read_space(rb_out2disk) < sizeof(guint32))
-		g_usleep(1000);
-	rb_read(rb_out2disk, (char *)&driver_offset, sizeof(guint32));
+/* Decode up to n frames straight into ring (rb, or rb_src ahead of the
+ * SRC stage), mixing on the way if the file's layout differs from the
+ * output. Only a frame straddling the end of the buffer goes through
+ * readbuf/mixbuf. Returns the number of frames written.
+ */
+unsigned int
+decode_to_rb(rb_t * ring, file_decoder_t * fdec, channel_mix_t * mix, float * readbuf,
+	     float * mixbuf, size_t frame_size, unsigned int n) {
+
+	rb_data_t vec[2];
+	unsigned int done = 0;
+	unsigned int want, got;
+
+	while (done < n) {
+		rb_get_write_vector(ring, vec);
+		want = vec[0].len / frame_size;
+
+		if (want == 0) {
+			if (vec[0].len + vec[1].len < frame_size) {
+				break;
+			}
+			if (file_decoder_read(fdec, readbuf, 1) == 0) {
+				break;
+			}
+			if (mix->identity) {
+				rb_write(ring, (char *)readbuf, frame_size);
+			} else {
+				channel_mix_process(mix, readbuf, mixbuf, 1);
+				rb_write(ring, (char *)mixbuf, frame_size);
+			}
+			++done;
+			continue;
+		}
+
+		if (want > n - done) {
+			want = n - done;
+		}
+		if (mix->identity) {
+			got = file_decoder_read(fdec, (float *)vec[0].buf, want);
+		} else {
+			got = file_decoder_read(fdec, readbuf, want);
+			channel_mix_process(mix, readbuf, (float *)vec[0].buf, got);
+		}
+		rb_write_advance(ring, got * frame_size);
+		done += got;
 
-	return sample_offset + driver_offset * src_ratio;
+		if (got < want) {
+			break;
+		}
+	}
+	return done;
 }
 
 
 void
 send_meta(metadata_t * meta, void * data) {
 
-	char send_cmd = CMD_METABLOCK;
-	rb_write(rb_disk2gui, &send_cmd, 1);
-	rb_write(rb_disk2gui, (char *)&meta, sizeof(metadata_t *));
+	message_t msg;
+
+	msg.cmd = CMD_METABLOCK;
+	msg.u.meta = meta;
+	send_to_gui(&msg);
 }
 
 
@@ -289,13 +659,17 @@ disk_thread(void * arg) {
 	unsigned int n_read = 0;
 	unsigned int want_read;
 	int n_src = 0;
-	int n_src_prev = 0;
 	int end_of_file = 0;
 	double src_ratio = 1.0;
-	void * readbuf = malloc(MAX_RATIO * info->rb_size * 2 * sample_size);
-	void * framebuf = malloc(MAX_RATIO * info->rb_size * 2 * sample_size);
+	int out_channels = info->out_channels;
+	size_t frame_size = out_channels * sample_size;
+	channel_mix_t mix;
+	int in_map[MAX_CHANNELS];
+	float * readbuf = malloc(info->rb_size * MAX_CHANNELS * sample_size);
+	float * mixbuf = malloc(info->rb_size * frame_size);
+	rb_t * ring;
 	size_t n_space;
-	char send_cmd, recv_cmd;
+	message_t send_msg, recv_msg;
 	char filename[RB_CONTROL_SIZE];
 #ifdef HAVE_CDDA
 	int flowthrough = 0;
@@ -303,22 +677,7 @@ disk_thread(void * arg) {
 #endif /* HAVE_CDDA */
 	seek_t seek;
 	cue_t cue;
-	int i;
-
-
-#ifdef HAVE_SRC
-	int src_type_prev;
-	SRC_STATE * src_state;
-	SRC_DATA src_data;
-	int src_error;
 
-        if ((src_state = src_new(options.src_type, 2, &src_error)) == NULL) {
-		fprintf(stderr, "disk thread: error: src_new() failed: %s.\n",
-			src_strerror(src_error));
-		exit(1);
-	}
-	src_type_prev = options.src_type;
-#endif /* HAVE_SRC */
 
 	if ((fdec = file_decoder_new()) == NULL) {
 		fprintf(stderr, "disk thread: error: file_decoder_new() failed\n");
@@ -326,12 +685,15 @@ disk_thread(void * arg) {
 	}
 	file_decoder_set_meta_cb(fdec, send_meta, NULL);
 
-	if ((!readbuf) || (!framebuf)) {
+	if ((!readbuf) || (!mixbuf)) {
 		fprintf(stderr, "disk thread: malloc error\n");
 		exit(1);
 	}
+	g_atomic_int_inc(&audio_threads_ready);
 
-	AQUALUNG_MUTEX_LOCK(disk_thread_lock)
+	info->in_channels = 2;
+	channels_default_map(2, in_map);
+	channel_mix_init(&mix, 2, in_map, out_channels, info->out_map);
 
 	filename[0] = '\0';
 #ifdef HAVE_CDDA
@@ -340,17 +702,11 @@ disk_thread(void * arg) {
 
 	while (1) {
 
-		recv_cmd = 0;
-		if (rb_read_space(rb_gui2disk) > 0) {
-			rb_read(rb_gui2disk, &recv_cmd, 1);
-			switch (recv_cmd) {
+		if (msgq_recv(q_gui2disk, &recv_msg)) {
+			switch (recv_msg.cmd) {
 			case CMD_CUE:
-				/* read the string */
-				while (rb_read_space(rb_gui2disk) < sizeof(cue_t))
-					;
+				cue = recv_msg.u.cue;
 
-				rb_read(rb_gui2disk, (void *)&cue, sizeof(cue_t));
-				
 #ifdef HAVE_CDDA
 				arr_strlcpy(filename_prev, filename);
 #endif /* HAVE_CDDA */
@@ -378,7 +734,6 @@ disk_thread(void * arg) {
 					    (fdec->pdec != NULL)) {
 
 						decoder_t * dec = (decoder_t *)fdec->pdec;
-						fileinfo_t fileinfo_sent;
 
 						cdda_decoder_reopen(dec, filename);
 						fdec->samples_left = fdec->fileinfo.total_samples;
@@ -388,13 +743,10 @@ disk_thread(void * arg) {
 
 						sample_offset = 0;
 
-						send_cmd = CMD_FILEINFO;
-						fileinfo_sent = fdec->fileinfo;
-						fileinfo_sent.format_str = strdup(fdec->fileinfo.format_str);
-						rb_write(rb_disk2gui, &send_cmd,
-								      sizeof(send_cmd));
-						rb_write(rb_disk2gui, (char *)&fileinfo_sent,
-							              sizeof(fileinfo_t));
+						send_msg.cmd = CMD_FILEINFO;
+						send_msg.u.fileinfo = fdec->fileinfo;
+						send_msg.u.fileinfo.format_str = strdup(fdec->fileinfo.format_str);
+						send_to_gui(&send_msg);
 
 						info->is_streaming = 1;
 						end_of_file = 0;
@@ -404,8 +756,8 @@ disk_thread(void * arg) {
 						fdec->samples_left = 0;
 						info->is_streaming = 0;
 						end_of_file = 1;
-						send_cmd = CMD_FILEREQ;
-						rb_write(rb_disk2gui, &send_cmd, 1);
+						send_msg.cmd = CMD_FILEREQ;
+						send_to_gui(&send_msg);
 						goto sleep;
 					} else if (!sample_rates_ok(info->out_SR,
 								    fdec->fileinfo.sample_rate)) {
@@ -416,16 +768,19 @@ disk_thread(void * arg) {
 						fdec->samples_left = 0;
 						info->is_streaming = 0;
 						end_of_file = 1;
-						send_cmd = CMD_FILEREQ;
-						rb_write(rb_disk2gui, &send_cmd, 1);
+						send_msg.cmd = CMD_FILEREQ;
+						send_to_gui(&send_msg);
 						goto sleep;
 					} else {
-						fileinfo_t fileinfo_sent;
-
 						file_decoder_set_rva(fdec, cue.voladj);
 						info->in_SR_prev = info->in_SR;
 						info->in_SR = fdec->fileinfo.sample_rate;
-						info->is_mono = fdec->fileinfo.is_mono;
+						if (info->in_channels != fdec->fileinfo.channels) {
+							info->in_channels = fdec->fileinfo.channels;
+							channels_default_map(info->in_channels, in_map);
+							channel_mix_init(&mix, info->in_channels, in_map,
+									 out_channels, info->out_map);
+						}
 						fdec->sample_pos = 0;
 #ifdef HAVE_CDDA
 						if (fdec->file_lib == CDDA_LIB) {
@@ -440,13 +795,10 @@ disk_thread(void * arg) {
 
 						sample_offset = 0;
 
-						send_cmd = CMD_FILEINFO;
-						fileinfo_sent = fdec->fileinfo;
-						fileinfo_sent.format_str = strdup(fdec->fileinfo.format_str);
-						rb_write(rb_disk2gui, &send_cmd,
-								      sizeof(send_cmd));
-						rb_write(rb_disk2gui, (char *)&fileinfo_sent,
-								      sizeof(fileinfo_t));
+						send_msg.cmd = CMD_FILEINFO;
+						send_msg.u.fileinfo = fdec->fileinfo;
+						send_msg.u.fileinfo.format_str = strdup(fdec->fileinfo.format_str);
+						send_to_gui(&send_msg);
 
 						info->is_streaming = 1;
 						end_of_file = 0;
@@ -459,7 +811,7 @@ disk_thread(void * arg) {
 					info->is_streaming = 0;
 
 					/* send a FLUSH command to output thread to stop immediately */
-					flush_output(src_ratio);
+					flush_output(info, src_ratio);
 					goto sleep;
 				}
 				break;
@@ -473,7 +825,7 @@ disk_thread(void * arg) {
 				info->is_streaming = 0;
 
 				/* send a FLUSH command to output thread */
-				playback_offset = flush_output(src_ratio);
+				playback_offset = flush_output(info, src_ratio);
 				rollback(fdec, src_ratio, playback_offset);
 				if (fdec->is_stream) {
 					file_decoder_pause(fdec);
@@ -487,18 +839,18 @@ disk_thread(void * arg) {
 				break;
 			case CMD_FINISH:
 				/* send FINISH to output thread, then goto exit */
-				send_cmd = CMD_FINISH;
-				rb_write(rb_disk2out, &send_cmd, 1);
+				send_msg.cmd = CMD_FINISH;
+				while (msgq_send(q_disk2out, &send_msg) < 0) {
+					g_usleep(10000); /* the output thread must see it */
+				}
 				goto done;
 				break;
 			case CMD_SEEKTO:
-				while (rb_read_space(rb_gui2disk) < sizeof(seek_t))
-					;
-				rb_read(rb_gui2disk, (char *)&seek, sizeof(seek_t));
+				seek = recv_msg.u.seek;
 				if (fdec->file_lib != 0) {
 					file_decoder_seek(fdec, seek.seek_to_pos);
 					/* send a FLUSH command to output thread */
-					flush_output(src_ratio);
+					flush_output(info, src_ratio);
 
 					if (fdec->is_stream && !info->is_streaming) {
 						file_decoder_pause(fdec);
@@ -507,14 +859,13 @@ disk_thread(void * arg) {
 					/* send dummy STATUS to gui, to set pos slider to zero */
 					disk_thread_status.samples_left = 0;
 					disk_thread_status.sample_offset = 0;
-					send_cmd = CMD_STATUS;
-					rb_write(rb_disk2gui, &send_cmd, sizeof(send_cmd));
-					rb_write(rb_disk2gui, (char *)&disk_thread_status,
-							      sizeof(status_t));
+					send_msg.cmd = CMD_STATUS;
+					send_msg.u.status = disk_thread_status;
+					send_to_gui(&send_msg);
 				}
 				break;
 			default:
-				fprintf(stderr, "disk thread: received unexpected command %d\n", recv_cmd);
+				fprintf(stderr, "disk thread: received unexpected command %d\n", recv_msg.cmd);
 				break;
 			}
 
@@ -525,177 +876,174 @@ disk_thread(void * arg) {
 			goto sleep;
 
 		n_read = 0;
-		n_space = rb_write_space(rb) / (2 * sample_size);
+		info->in_SR = fdec->fileinfo.sample_rate;
+		src_ratio = (double)info->out_SR / (double)info->in_SR;
+		ring = rb;
+#ifdef HAVE_SRC
+		if (info->in_SR != info->out_SR) {
+			ring = rb_src;
+		}
+		if (!src_stage_switch((ring == rb) ? 1.0 : src_ratio)) {
+			/* the stage is still converting the previous file */
+			goto flush;
+		}
+#endif /* HAVE_SRC */
+
+		n_space = rb_write_space(ring) / frame_size;
 		while (n_src < 0.95 * n_space) {
-			
-			src_ratio = (double)info->out_SR / (double)info->in_SR;
-			n_src_prev = n_src;
-			want_read = floor((n_space - n_src) / src_ratio);
 
-			if (want_read == 0)
-				break;
+			want_read = n_space - n_src;
+			if (want_read > info->rb_size)
+				want_read = info->rb_size;
 
-			if (want_read > MAX_RATIO * info->rb_size)
-				want_read = MAX_RATIO * info->rb_size;
-			
-			n_read = file_decoder_read(fdec, readbuf, want_read);
+			n_read = decode_to_rb(ring, fdec, &mix, readbuf, mixbuf,
+					      frame_size, want_read);
 			if (n_read < want_read)
 				end_of_file = 1;
-			
-			if (info->is_mono) { /* convert to stereo interleaved */
-				for (i = 2*n_read - 1; i >= 0; i--) {
-					memcpy(readbuf + i * sample_size,
-					       readbuf + i/2 * sample_size,
-					       sample_size);
-				}
+			n_src += n_read;
+#ifdef HAVE_SRC
+			if (ring == rb_src) {
+				src_stage_wake();
 			}
-			
-			info->in_SR = fdec->fileinfo.sample_rate;
-			if (info->in_SR == info->out_SR) {
-				memcpy(framebuf + n_src_prev * 2*sample_size,
-				       readbuf, n_read * 2*sample_size);
-				n_src += n_read;
-
-			} else { /* do SRC */
-#ifdef HAVE_SRC				
-				if ((info->in_SR_prev != info->in_SR) ||
-				    (src_type_prev != options.src_type)) { /* reinit SRC */
-
-					src_state = src_delete(src_state);
-					if ((src_state = src_new(options.src_type, 2, &src_error)) == NULL) {
-						fprintf(stderr, "disk thread: error: src_new() failed: "
-						       "%s.\n", src_strerror(src_error));
-						goto done;
-					}
-					info->in_SR_prev = info->in_SR;
-					src_type_prev = options.src_type;
-				}
-				
-				src_data.input_frames = n_read;
-				src_data.data_in = readbuf;
-				src_data.src_ratio = src_ratio;
-				src_data.data_out = framebuf + n_src_prev * 2*sample_size;
-				src_data.output_frames = n_space - n_src_prev;
-				src_data.end_of_input = 0;
-				if ((src_error = src_process(src_state, &src_data))) {
-					fprintf(stderr, "disk thread: SRC error: %s\n",
-					       src_strerror(src_error));
-					goto done;
-				}
-				n_src += src_data.output_frames_gen;
 #endif /* HAVE_SRC */
-			}
-			
+
 			if (end_of_file) {
 				/* send request for a new filename */
 #ifdef HAVE_CDDA
 				flowthrough = 1;
 #endif /* HAVE_CDDA */
-				send_cmd = CMD_FILEREQ;
-				rb_write(rb_disk2gui, &send_cmd, 1);
+				n_src = 0;
+				send_msg.cmd = CMD_FILEREQ;
+				send_to_gui(&send_msg);
 				goto sleep;
 			}
 		}
 
 	flush:
-		rb_write(rb, framebuf, n_src * 2*sample_size);
-
 		/* update & send STATUS */
 		fdec->sample_pos += n_read;
 		if (fdec->samples_left > n_read)
 			fdec->samples_left -= n_read;
-		sample_offset =	rb_read_space(rb) / (2 * sample_size);
+		sample_offset =	rb_read_space(rb) / frame_size;
 		disk_thread_status.sample_pos = fdec->sample_pos;
 		disk_thread_status.samples_left = fdec->samples_left;
-		disk_thread_status.sample_offset = sample_offset / src_ratio;
+		disk_thread_status.sample_offset = (sample_offset + info->out_latency) / src_ratio;
+#ifdef HAVE_SRC
+		disk_thread_status.sample_offset += rb_read_space(rb_src) / frame_size;
+#endif /* HAVE_SRC */
 		disk_thread_status.sample_rate = info->in_SR;
 		if (disk_thread_status.samples_left < 0) {
 			disk_thread_status.samples_left = 0;
 		}
 
-		if (!rb_read_space(rb_gui2disk)) {
-			send_cmd = CMD_STATUS;
-			rb_write(rb_disk2gui, &send_cmd, sizeof(send_cmd));
-			rb_write(rb_disk2gui, (char *)&disk_thread_status,
-					      sizeof(status_t));
+		if (msgq_empty(q_gui2disk)) {
+			send_msg.cmd = CMD_STATUS;
+			send_msg.u.status = disk_thread_status;
+			send_to_gui(&send_msg);
 		}
 
 		/* cleanup buffer counters */
 		n_src = 0;
-		n_src_prev = 0;
 		end_of_file = 0;
 		
 	sleep:
-		{
-			/* suspend thread, wake up after 100 ms */
-#ifndef HAVE_LIBPTHREAD
-			GTimeVal time;
-			GTimeVal * timeout = &time;
-			g_get_current_time(timeout);
-			g_time_val_add(timeout, 100000);
-#else /* HAVE_LIBPTHREAD */
-			struct timeval now;
-			struct timezone tz;
-			struct timespec timeout;
-			gettimeofday(&now, &tz);
-			timeout.tv_nsec = now.tv_usec * 1000 + 100000000;
-			timeout.tv_sec = now.tv_sec;
-			while (timeout.tv_nsec > 1000000000) {
-				timeout.tv_nsec -= 1000000000;
-				timeout.tv_sec += 1;
-			}
-#endif /* HAVE_LIBPTHREAD */
-			AQUALUNG_COND_TIMEDWAIT(disk_thread_wake, disk_thread_lock, timeout)
-		}
+		/* suspend thread until a command arrives, at most 100 ms */
+		msgq_wait(q_gui2disk, 100);
 	}
  done:
 	free(readbuf);
-	free(framebuf);
+	free(mixbuf);
 #ifdef HAVE_SRC
-	src_state = src_delete(src_state);
+	src_stage_quit();
 #endif /* HAVE_SRC */
 	file_decoder_delete(fdec);
-	AQUALUNG_MUTEX_UNLOCK(disk_thread_lock)
 	return 0;
 }
 
 
+/* allocate the output channel buffers for a driver running with bufsize frames */
+void
+alloc_output_buffers(thread_info_t * info, int bufsize, char * who) {
+
+	int k;
+
+	for (k = 0; k < info->out_channels; k++) {
+		if ((ch_buf[k] = calloc(bufsize, sizeof(float))) == NULL) {
+			fprintf(stderr, "%s: malloc error\n", who);
+			exit(1);
+		}
+		if (info->out_map[k] == CHANNEL_FL) {
+			l_buf = ch_buf[k];
+		} else if (info->out_map[k] == CHANNEL_FR) {
+			r_buf = ch_buf[k];
+		}
+	}
+#ifdef HAVE_LADSPA
+	ladspa_buflen = bufsize;
+#endif /* HAVE_LADSPA */
+	/* the drivers allocate their own buffers before this */
+	g_atomic_int_inc(&audio_threads_ready);
+}
+
+
+/* balance: sides follow their gain, centre and LFE the average */
+void
+apply_output_gain(thread_info_t * info, int n) {
+
+	int i, k;
+	float gain;
+
+	for (k = 0; k < info->out_channels; k++) {
+		if (channels_is_left(info->out_map[k])) {
+			gain = left_gain;
+		} else if (channels_is_right(info->out_map[k])) {
+			gain = right_gain;
+		} else {
+			gain = (left_gain + right_gain) / 2.0;
+		}
+		for (i = 0; i < n; i++) {
+			ch_buf[k][i] *= gain;
+		}
+	}
+}
+
+
 void
-read_and_process_output(int bufsize, int * n_avail, int flushing) {
+read_and_process_output(thread_info_t * info, int bufsize, int * n_avail, int flushing) {
 
 	guint32 i;
+	int k;
+	int n = info->out_channels;
+
 	if (*n_avail > bufsize)
 		*n_avail = bufsize;
 	
 	for (i = 0; i < *n_avail; i++) {
-		rb_read(rb, (char *)&(l_buf[i]), sample_size);
-		rb_read(rb, (char *)&(r_buf[i]), sample_size);
+		for (k = 0; k < n; k++) {
+			rb_read(rb, (char *)&(ch_buf[k][i]), sample_size);
+		}
 	}
-	for (i = *n_avail; i < bufsize; i++) {
-		l_buf[i] = 0.0f;
-		r_buf[i] = 0.0f;
+	for (k = 0; k < n; k++) {
+		for (i = *n_avail; i < bufsize; i++) {
+			ch_buf[k][i] = 0.0f;
+		}
 	}
 
 	if (flushing) {
-		for (i = 0; i < *n_avail; i++) {
-			l_buf[i] = 0.0f;
-			r_buf[i] = 0.0f;
+		for (k = 0; k < n; k++) {
+			for (i = 0; i < *n_avail; i++) {
+				ch_buf[k][i] = 0.0f;
+			}
 		}
 		return;
 	}
 
 #ifdef HAVE_LADSPA
 	if (options.ladspa_is_postfader) {
-		for (i = 0; i < *n_avail; i++) {
-			l_buf[i] *= left_gain;
-			r_buf[i] *= right_gain;
-		}
+		apply_output_gain(info, *n_avail);
 	}
 #else
-	for (i = 0; i < *n_avail; i++) {
-		l_buf[i] *= left_gain;
-		r_buf[i] *= right_gain;
-	}
+	apply_output_gain(info, *n_avail);
 #endif /* HAVE_LADSPA */
 
 	/* plugin processing */
@@ -715,26 +1063,30 @@ read_and_process_output(int bufsize, int * n_avail, int flushing) {
 	plugin_lock = 0;
 	
 	if (!options.ladspa_is_postfader) {
-		for (i = 0; i < bufsize; i++) {
-			l_buf[i] *= left_gain;
-			r_buf[i] *= right_gain;
-		}
+		apply_output_gain(info, bufsize);
 	}
 #endif /* HAVE_LADSPA */
 }
 
 /* SNDIO output thread */
 #ifdef HAVE_SNDIO
+void
+sndio_onmove(void * arg, int delta) {
+
+	thread_info_t * info = (thread_info_t *)arg;
+
+	info->sndio_delay -= delta;
+}
+
 void *
 sndio_thread(void * arg) {
 
 	guint32 i;
         thread_info_t * info = (thread_info_t *)arg;
-	guint32 driver_offset = 0;
 	int bufsize = 1024;
         int n_avail;
 	size_t bytes_written;
-	char recv_cmd;
+	message_t recv_msg;
 
 	short * sndio_short_buf;
 
@@ -747,48 +1099,38 @@ sndio_thread(void * arg) {
 	}
 	sndio_short_buf = info->sndio_short_buf;
 
-	if ((l_buf = malloc(bufsize * sizeof(float))) == NULL) {
-		fprintf(stderr, "sndio_thread: malloc error\n");
-		exit(1);
-	}
-	if ((r_buf = malloc(bufsize * sizeof(float))) == NULL) {
-		fprintf(stderr, "sndio_thread: malloc error\n");
-		exit(1);
-	}
-#ifdef HAVE_LADSPA
-	ladspa_buflen = bufsize;
-#endif /* HAVE_LADSPA */
+	alloc_output_buffers(info, bufsize, "sndio_thread");
 
 
 	while (1) {
 	sndio_wake:
-		while (rb_read_space(rb_disk2out)) {
-			rb_read(rb_disk2out, &recv_cmd, 1);
-			switch (recv_cmd) {
+		while (msgq_recv(q_disk2out, &recv_msg)) {
+			switch (recv_msg.cmd) {
 			case CMD_FLUSH:
 				while ((n_avail = rb_read_space(rb)) > 0) {
 					if (n_avail > 2*bufsize * sizeof(short))
 						n_avail = 2*bufsize * sizeof(short);
 					rb_read(rb, (char *)sndio_short_buf, n_avail);
 				}
-				rb_write(rb_out2disk, (char *)&driver_offset, sizeof(guint32));
+				/* what sndio has queued still plays */
+				flush_done(0);
 				goto sndio_wake;
 				break;
 			case CMD_FINISH:
 				goto sndio_finish;
 				break;
 			default:
-				fprintf(stderr, "sndio_thread: recv'd unknown command %d\n", recv_cmd);
+				fprintf(stderr, "sndio_thread: recv'd unknown command %d\n", recv_msg.cmd);
 				break;
 			}
 		}
 
-		if ((n_avail = rb_read_space(rb) / (2*sample_size)) == 0) {
-			g_usleep(100000);
+		if ((n_avail = rb_read_space(rb) / (info->out_channels * sample_size)) == 0) {
+			msgq_wait(q_disk2out, 100);
 			goto sndio_wake;
 		}
 
-		read_and_process_output(bufsize, &n_avail, 0);
+		read_and_process_output(info, bufsize, &n_avail, 0);
 
 		for (i = 0; i < bufsize; i++) {
 			if (l_buf[i] > 1.0)
@@ -807,6 +1149,8 @@ sndio_thread(void * arg) {
 
 		/* write data to audio device */
 		bytes_written = sio_write(sndio_hdl, sndio_short_buf, 2*n_avail * sizeof(short));
+		info->sndio_delay += bytes_written / (2 * sizeof(short));
+		info->out_latency = (info->sndio_delay > 0) ? info->sndio_delay : 0;
 		if (bytes_written != 2*n_avail * sizeof(short)) {
 			fprintf(stderr, "sndio_thread: Error writing to audio device\n");
 			if (sndio_reinit(info, 1) == 0) {
@@ -825,88 +1169,93 @@ sndio_thread(void * arg) {
 
 /* PulseAudio output thread */
 #ifdef HAVE_PULSE
+guint32
+pulse_latency(thread_info_t * info) {
+
+	pa_usec_t usec;
+	int err;
+
+	if ((usec = pa_simple_get_latency(info->pa, &err)) == (pa_usec_t)-1) {
+		return 0;
+	}
+	return usec * info->out_SR / 1000000;
+}
+
 void *
 pulse_thread(void * arg) {
 	
 	guint32 i;
+	int k;
 	thread_info_t * info = (thread_info_t *)arg;
+	int n = info->out_channels;
 	guint32 driver_offset = 0;
 	int bufsize = 1024;
         int n_avail;
 	int ret, err;
-	char recv_cmd;
+	message_t recv_msg;
 	
 	pa_simple* pa = info->pa;
 	short * pa_short_buf = NULL;
 
-	if ((info->pa_short_buf = malloc(2*bufsize * sizeof(short))) == NULL) {
+	if ((info->pa_short_buf = malloc(n*bufsize * sizeof(short))) == NULL) {
 		fprintf(stderr, "pulse_thread: malloc error\n");
 		exit(1);
 	}
 	pa_short_buf = info->pa_short_buf;
 
-	if ((l_buf = malloc(bufsize * sizeof(float))) == NULL) {
-		fprintf(stderr, "pulse_thread: malloc error\n");
-		exit(1);
-	}
-	if ((r_buf = malloc(bufsize * sizeof(float))) == NULL) {
-		fprintf(stderr, "pulse_thread: malloc error\n");
-		exit(1);
-	}
-#ifdef HAVE_LADSPA
-	ladspa_buflen = bufsize;
-#endif /* HAVE_LADSPA */
+	alloc_output_buffers(info, bufsize, "pulse_thread");
 
 	while (1) {
 	pulse_wake:
-		while (rb_read_space(rb_disk2out)) {
-			rb_read(rb_disk2out, &recv_cmd, 1);
-			switch (recv_cmd) {
+		while (msgq_recv(q_disk2out, &recv_msg)) {
+			switch (recv_msg.cmd) {
 			case CMD_FLUSH:
 				while ((n_avail = rb_read_space(rb)) > 0) {
-					if (n_avail > 2*bufsize * sizeof(short))
-						n_avail = 2*bufsize * sizeof(short);
+					if (n_avail > n*bufsize * sizeof(short))
+						n_avail = n*bufsize * sizeof(short);
 					rb_read(rb, (char *)pa_short_buf, n_avail);
 				}
-				rb_write(rb_out2disk, (char *)&driver_offset, sizeof(guint32));
+				/* report what the server held only if it is really gone */
+				driver_offset = pulse_latency(info);
+				if (pa_simple_flush(pa, &err) < 0) {
+					driver_offset = 0;
+				}
+				flush_done(driver_offset);
 				goto pulse_wake;
 				break;
 			case CMD_FINISH:
 				goto pulse_finish;
 				break;
 			default:
-				fprintf(stderr, "pulse_thread: recv'd unknown command %d\n", recv_cmd);
+				fprintf(stderr, "pulse_thread: recv'd unknown command %d\n", recv_msg.cmd);
 				break;
 			}
 		}
 
-		if ((n_avail = rb_read_space(rb) / (2*sample_size)) == 0) {
-			g_usleep(100000);
+		if ((n_avail = rb_read_space(rb) / (info->out_channels * sample_size)) == 0) {
+			msgq_wait(q_disk2out, 100);
 			goto pulse_wake;
 		}
 
-		read_and_process_output(bufsize, &n_avail, 0);
+		read_and_process_output(info, bufsize, &n_avail, 0);
 
 		for (i = 0; i < bufsize; i++) {
-			if (l_buf[i] > 1.0)
-				l_buf[i] = 1.0;
-			else if (l_buf[i] < -1.0)
-				l_buf[i] = -1.0;
-
-			if (r_buf[i] > 1.0)
-				r_buf[i] = 1.0;
-			else if (r_buf[i] < -1.0)
-				r_buf[i] = -1.0;
+			for (k = 0; k < n; k++) {
+				if (ch_buf[k][i] > 1.0)
+					ch_buf[k][i] = 1.0;
+				else if (ch_buf[k][i] < -1.0)
+					ch_buf[k][i] = -1.0;
 
-			pa_short_buf[2*i] = floorf(32767.0 * l_buf[i]);
-			pa_short_buf[2*i+1] = floorf(32767.0 * r_buf[i]);
+				pa_short_buf[n*i+k] = floorf(32767.0 * ch_buf[k][i]);
+			}
 		}
 
 		/* write data to audio device */
-		ret = pa_simple_write(pa, pa_short_buf, 2*n_avail * sizeof(short), &err);
+		ret = pa_simple_write(pa, pa_short_buf, n*n_avail * sizeof(short), &err);
 		if (ret != 0)
 			fprintf(stderr, "pulse_thread: Error writing to audio device\n%s", pa_strerror(err));
-		
+		info->out_latency = pulse_latency(info);
+
 	}
  pulse_finish:
 	return 0;
@@ -916,6 +1265,17 @@ pulse_thread(void * arg) {
 
 /* OSS output thread */
 #ifdef HAVE_OSS
+guint32
+oss_latency(int fd_oss) {
+
+	int odelay;
+
+	if (ioctl(fd_oss, SNDCTL_DSP_GETODELAY, &odelay) < 0 || odelay < 0) {
+		return 0;
+	}
+	return odelay / (2 * sizeof(short));
+}
+
 void *
 oss_thread(void * arg) {
 
@@ -925,7 +1285,7 @@ oss_thread(void * arg) {
 	int bufsize = 1024;
         int n_avail;
 	int ioctl_status;
-	char recv_cmd;
+	message_t recv_msg;
 
 	int fd_oss = info->fd_oss;
 	short * oss_short_buf;
@@ -936,48 +1296,41 @@ oss_thread(void * arg) {
 	}
 	oss_short_buf = info->oss_short_buf;
 
-	if ((l_buf = malloc(bufsize * sizeof(float))) == NULL) {
-		fprintf(stderr, "oss_thread: malloc error\n");
-		exit(1);
-	}
-	if ((r_buf = malloc(bufsize * sizeof(float))) == NULL) {
-		fprintf(stderr, "oss_thread: malloc error\n");
-		exit(1);
-	}
-#ifdef HAVE_LADSPA
-	ladspa_buflen = bufsize;
-#endif /* HAVE_LADSPA */
+	alloc_output_buffers(info, bufsize, "oss_thread");
 
 
 	while (1) {
 	oss_wake:
-		while (rb_read_space(rb_disk2out)) {
-			rb_read(rb_disk2out, &recv_cmd, 1);
-			switch (recv_cmd) {
+		while (msgq_recv(q_disk2out, &recv_msg)) {
+			switch (recv_msg.cmd) {
 			case CMD_FLUSH:
 				while ((n_avail = rb_read_space(rb)) > 0) {
 					if (n_avail > 2*bufsize * sizeof(short))
 						n_avail = 2*bufsize * sizeof(short);
 					rb_read(rb, (char *)oss_short_buf, n_avail);
 				}
-				rb_write(rb_out2disk, (char *)&driver_offset, sizeof(guint32));
+				driver_offset = oss_latency(fd_oss);
+				if (ioctl(fd_oss, SNDCTL_DSP_RESET, 0) < 0) {
+					driver_offset = 0;
+				}
+				flush_done(driver_offset);
 				goto oss_wake;
 				break;
 			case CMD_FINISH:
 				goto oss_finish;
 				break;
 			default:
-				fprintf(stderr, "oss_thread: recv'd unknown command %d\n", recv_cmd);
+				fprintf(stderr, "oss_thread: recv'd unknown command %d\n", recv_msg.cmd);
 				break;
 			}
 		}
 
-		if ((n_avail = rb_read_space(rb) / (2*sample_size)) == 0) {
-			g_usleep(100000);
+		if ((n_avail = rb_read_space(rb) / (info->out_channels * sample_size)) == 0) {
+			msgq_wait(q_disk2out, 100);
 			goto oss_wake;
 		}
 
-		read_and_process_output(bufsize, &n_avail, 0);
+		read_and_process_output(info, bufsize, &n_avail, 0);
 
 		for (i = 0; i < bufsize; i++) {
 			if (l_buf[i] > 1.0)
@@ -998,6 +1351,7 @@ oss_thread(void * arg) {
 		ioctl_status = write(fd_oss, oss_short_buf, 2*n_avail * sizeof(short));
 		if (ioctl_status != 2*n_avail * sizeof(short))
 			fprintf(stderr, "oss_thread: Error writing to audio device\n");
+		info->out_latency = oss_latency(fd_oss);
 
 	}
  oss_finish:
@@ -1009,126 +1363,124 @@ oss_thread(void * arg) {
 
 /* ALSA output thread */
 #ifdef HAVE_ALSA
+guint32
+alsa_latency(snd_pcm_t * pcm_handle) {
+
+	snd_pcm_sframes_t delay;
+
+	if (snd_pcm_delay(pcm_handle, &delay) < 0 || delay < 0) {
+		return 0;
+	}
+	return delay;
+}
+
 void *
 alsa_thread(void * arg) {
 
 	guint32 i;
+	int k;
 	guint32 driver_offset = 0;
         thread_info_t * info = (thread_info_t *)arg;
+	int n = info->out_channels;
 	snd_pcm_sframes_t n_written = 0;
 	int bufsize = info->n_frames;
         int n_avail;
-	char recv_cmd;
+	message_t recv_msg;
 
 	int is_output_32bit = info->is_output_32bit;
 	short * alsa_short_buf = NULL;
 	int * alsa_int_buf = NULL;
 	void * alsa_buf = NULL;
-	size_t alsa_sample_size = 0; /* For both channels */
+	size_t alsa_sample_size = 0; /* For all channels */
 
 	snd_pcm_t * pcm_handle = info->pcm_handle;
 
 	if (is_output_32bit) {
-		if ((info->alsa_int_buf = malloc(2*bufsize * sizeof(int))) == NULL) {
+		if ((info->alsa_int_buf = malloc(n*bufsize * sizeof(int))) == NULL) {
 			fprintf(stderr, "alsa_thread: malloc error\n");
 			exit(1);
 		}
 		alsa_int_buf = info->alsa_int_buf;
 	} else {
-		if ((info->alsa_short_buf = malloc(2*bufsize * sizeof(short))) == NULL) {
+		if ((info->alsa_short_buf = malloc(n*bufsize * sizeof(short))) == NULL) {
 			fprintf(stderr, "alsa_thread: malloc error\n");
 			exit(1);
 		}
 		alsa_short_buf = info->alsa_short_buf;
 	}
 
-	if ((l_buf = malloc(bufsize * sizeof(float))) == NULL) {
-		fprintf(stderr, "alsa_thread: malloc error\n");
-		exit(1);
-	}
-	if ((r_buf = malloc(bufsize * sizeof(float))) == NULL) {
-		fprintf(stderr, "alsa_thread: malloc error\n");
-		exit(1);
-	}
-#ifdef HAVE_LADSPA
-	ladspa_buflen = bufsize;
-#endif /* HAVE_LADSPA */
+	alloc_output_buffers(info, bufsize, "alsa_thread");
 
 
 	while (1) {
 	alsa_wake:
-		while (rb_read_space(rb_disk2out)) {
-			rb_read(rb_disk2out, &recv_cmd, 1);
-			switch (recv_cmd) {
+		while (msgq_recv(q_disk2out, &recv_msg)) {
+			switch (recv_msg.cmd) {
 			case CMD_FLUSH:
 				if (is_output_32bit) {
 					while ((n_avail = rb_read_space(rb)) > 0) {
-						if (n_avail > 2*bufsize * sizeof(int))
-							n_avail = 2*bufsize * sizeof(int);
+						if (n_avail > n*bufsize * sizeof(int))
+							n_avail = n*bufsize * sizeof(int);
 						rb_read(rb, (char *)alsa_int_buf, n_avail);
 					}
 				} else {
 					while ((n_avail = rb_read_space(rb)) > 0) {
-						if (n_avail > 2*bufsize * sizeof(short))
-							n_avail = 2*bufsize * sizeof(short);
+						if (n_avail > n*bufsize * sizeof(short))
+							n_avail = n*bufsize * sizeof(short);
 						rb_read(rb, (char *)alsa_short_buf, n_avail);
 					}
 				}
-				rb_write(rb_out2disk, (char *)&driver_offset, sizeof(guint32));
+				driver_offset = alsa_latency(pcm_handle);
+				if (snd_pcm_drop(pcm_handle) < 0 || snd_pcm_prepare(pcm_handle) < 0) {
+					driver_offset = 0;
+				}
+				flush_done(driver_offset);
 				goto alsa_wake;
 				break;
 			case CMD_FINISH:
 				goto alsa_finish;
 				break;
 			default:
-				fprintf(stderr, "alsa_thread: recv'd unknown command %d\n", recv_cmd);
+				fprintf(stderr, "alsa_thread: recv'd unknown command %d\n", recv_msg.cmd);
 				break;
 			}
 		}
 
-		if ((n_avail = rb_read_space(rb) / (2*sample_size)) == 0) {
-			g_usleep(100000);
+		if ((n_avail = rb_read_space(rb) / (info->out_channels * sample_size)) == 0) {
+			msgq_wait(q_disk2out, 100);
 			goto alsa_wake;
 		}
 
-		read_and_process_output(bufsize, &n_avail, 0);
+		read_and_process_output(info, bufsize, &n_avail, 0);
 
 		if (is_output_32bit) {
 			for (i = 0; i < bufsize; i++) {
-				if (l_buf[i] > 1.0)
-					l_buf[i] = 1.0;
-				else if (l_buf[i] < -1.0)
-					l_buf[i] = -1.0;
-
-				if (r_buf[i] > 1.0)
-					r_buf[i] = 1.0;
-				else if (r_buf[i] < -1.0)
-					r_buf[i] = -1.0;
-				
-				alsa_int_buf[2*i] = floorf(2147483647.0 * l_buf[i]);
-				alsa_int_buf[2*i+1] = floorf(2147483647.0 * r_buf[i]);
+				for (k = 0; k < n; k++) {
+					if (ch_buf[k][i] > 1.0)
+						ch_buf[k][i] = 1.0;
+					else if (ch_buf[k][i] < -1.0)
+						ch_buf[k][i] = -1.0;
+
+					alsa_int_buf[n*i+k] = floorf(2147483647.0 * ch_buf[k][i]);
+				}
 			}
 
 			alsa_buf = alsa_int_buf;
-			alsa_sample_size = sizeof(*alsa_int_buf)*2;
+			alsa_sample_size = sizeof(*alsa_int_buf)*n;
 		} else {
 			for (i = 0; i < bufsize; i++) {
-				if (l_buf[i] > 1.0)
-					l_buf[i] = 1.0;
-				else if (l_buf[i] < -1.0)
-					l_buf[i] = -1.0;
-				
-				if (r_buf[i] > 1.0)
-					r_buf[i] = 1.0;
-				else if (r_buf[i] < -1.0)
-					r_buf[i] = -1.0;
+				for (k = 0; k < n; k++) {
+					if (ch_buf[k][i] > 1.0)
+						ch_buf[k][i] = 1.0;
+					else if (ch_buf[k][i] < -1.0)
+						ch_buf[k][i] = -1.0;
 
-				alsa_short_buf[2*i] = floorf(32767.0 * l_buf[i]);
-				alsa_short_buf[2*i+1] = floorf(32767.0 * r_buf[i]);
+					alsa_short_buf[n*i+k] = floorf(32767.0 * ch_buf[k][i]);
+				}
 			}
 
 			alsa_buf = alsa_short_buf;
-			alsa_sample_size = sizeof(*alsa_short_buf)*2;
+			alsa_sample_size = sizeof(*alsa_short_buf)*n;
 		}
 
 		while (n_avail > 0) {
@@ -1169,6 +1521,7 @@ alsa_thread(void * arg) {
 				alsa_buf += alsa_sample_size*n_written;
 			}
 		}
+		info->out_latency = alsa_latency(pcm_handle);
 	}
  alsa_finish:
 	return 0;
@@ -1176,53 +1529,143 @@ alsa_thread(void * arg) {
 #endif /* HAVE_ALSA */
 
 
+/* null output thread: plays periods into thin air on the monotonic clock
+ * and records how long producing each one took
+ */
+#ifdef NULL_DRIVER
+static long
+timespec_diff_ns(struct timespec * a, struct timespec * b) {
+
+	return (a->tv_sec - b->tv_sec) * 1000000000L + (a->tv_nsec - b->tv_nsec);
+}
+
+void *
+null_thread(void * arg) {
+
+	thread_info_t * info = (thread_info_t *)arg;
+	guint32 driver_offset = 0;
+	int bufsize = null_period;
+	size_t frame_size = info->out_channels * sample_size;
+	long period_ns = 1000000000.0 * bufsize / info->out_SR;
+	int n_avail;
+	int running = 0; /* a full period was played since the last flush */
+	int underrun;
+	size_t fill;
+	message_t recv_msg;
+	struct timespec deadline, start, end;
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+	while (1) {
+		deadline.tv_nsec += period_ns;
+		while (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_nsec -= 1000000000L;
+			deadline.tv_sec += 1;
+		}
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+			;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+		while (msgq_recv(q_disk2out, &recv_msg)) {
+			switch (recv_msg.cmd) {
+			case CMD_FLUSH:
+				rb_read_advance(rb, rb_read_space(rb));
+				flush_done(driver_offset);
+				running = 0;
+				break;
+			case CMD_FINISH:
+				goto null_finish;
+				break;
+			default:
+				fprintf(stderr, "null_thread: recv'd unknown command %d\n", recv_msg.cmd);
+				break;
+			}
+		}
+
+		fill = rb_read_space(rb);
+		n_avail = fill / frame_size;
+
+		/* running dry while the disk thread should be feeding us */
+		underrun = running && info->is_streaming && n_avail < bufsize;
+		running = (n_avail >= bufsize);
+
+		read_and_process_output(info, bufsize, &n_avail, 0);
+
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		/* a device would have wanted this period by the next deadline */
+		rt_bench_period(timespec_diff_ns(&end, &start),
+				timespec_diff_ns(&start, &deadline),
+				(float)fill / rb->size,
+				underrun,
+				timespec_diff_ns(&end, &deadline) > period_ns);
+
+		/* after a miss, start counting from now as a device restarted after an xrun would */
+		if (timespec_diff_ns(&end, &deadline) > period_ns) {
+			deadline = end;
+		}
+	}
+ null_finish:
+	return 0;
+}
+#endif /* NULL_DRIVER */
+
+
 
 /* JACK output function */
 #ifdef HAVE_JACK
+guint32
+jack_latency(void) {
+
+	jack_latency_range_t range;
+
+	jack_port_get_latency_range(out_ports[0], JackPlaybackLatency, &range);
+	return range.max;
+}
+
 int
 process(guint32 nframes, void * arg) {
 
-	guint32 i;
-	guint32 driver_offset = 0;
+	thread_info_t * info = (thread_info_t *)arg;
+	int k;
 	int n_avail;
-	jack_default_audio_sample_t * out1 = jack_port_get_buffer(out_L_port, nframes);
-	jack_default_audio_sample_t * out2 = jack_port_get_buffer(out_R_port, nframes);
 
 	static int flushing = 0;
 	static int flushcnt = 0;
-	char recv_cmd;
+	message_t recv_msg;
 
 	jack_nframes = nframes;
 #ifdef HAVE_LADSPA
 	ladspa_buflen = nframes;
 #endif /* HAVE_LADSPA */
 	
-	while (rb_read_space(rb_disk2out)) {
-		rb_read(rb_disk2out, &recv_cmd, 1);
-		switch (recv_cmd) {
+	while (msgq_recv(q_disk2out, &recv_msg)) {
+		switch (recv_msg.cmd) {
 		case CMD_FLUSH:
 			flushing = 1;
 			flushcnt = rb_read_space(rb)/nframes/
-				(2*sample_size) * 1.1f;
-			rb_write(rb_out2disk, (char *)&driver_offset, sizeof(guint32));
+				(info->out_channels * sample_size) * 1.1f;
+			/* the graph plays what it has, nothing to roll back */
+			flush_done(0);
 			break;
 		case CMD_FINISH:
 			return 0;
 			break;
 		default:
-			fprintf(stderr, "jack process(): recv'd unknown command %d\n", recv_cmd);
+			fprintf(stderr, "jack process(): recv'd unknown command %d\n", recv_msg.cmd);
 			break;
 		}
 	}
 	
-	n_avail = rb_read_space(rb) / (2*sample_size);
+	n_avail = rb_read_space(rb) / (info->out_channels * sample_size);
 
-	read_and_process_output(nframes, &n_avail, flushing);
+	read_and_process_output(info, nframes, &n_avail, flushing);
 
-	for (i = 0; i < nframes; i++) {
-		out1[i] = l_buf[i];
-		out2[i] = r_buf[i];
+	for (k = 0; k < n_out_ports; k++) {
+		memcpy(jack_port_get_buffer(out_ports[k], nframes), ch_buf[k],
+		       nframes * sizeof(jack_default_audio_sample_t));
 	}
+	info->out_latency = jack_latency();
 	
 	
 	if ((flushing) && (!rb_read_space(rb) || (--flushcnt == 0))) {
@@ -1303,6 +1746,8 @@ sndio_reinit(thread_info_t * info, int verbose) {
 		sio_close(sndio_hdl);
 		return -5;
 	}
+	info->sndio_delay = 0;
+	sio_onmove(sndio_hdl, sndio_onmove, info);
 	if(sio_start(sndio_hdl) == 0) {
 		if (verbose) {
 			fprintf(stderr, "sio_start failed\n");
@@ -1316,13 +1761,14 @@ sndio_reinit(thread_info_t * info, int verbose) {
 }
 
 int
-sndio_init(thread_info_t * info, int verbose, gboolean realtime, int priority) {
+sndio_init(thread_info_t * info, int verbose, thread_sched_t * sched) {
 	int ret;
+	output_stereo_only(info);
 	if ((ret = sndio_reinit(info, verbose)) != 0) {
 		return ret;
 	}
 	AQUALUNG_THREAD_CREATE(info->sndio_thread_id, NULL, sndio_thread, info)
-	set_thread_priority(info->sndio_thread_id, "sndio output", realtime, priority);
+	set_thread_sched(info->sndio_thread_id, "sndio output", sched);
 
 	return 0;
 }
@@ -1337,11 +1783,13 @@ sndio_init(thread_info_t * info, int verbose, gboolean realtime, int priority) {
  * -N : unable to start with given params
  */
 int
-oss_init(thread_info_t * info, int verbose, gboolean realtime, int priority) {
+oss_init(thread_info_t * info, int verbose, thread_sched_t * sched) {
 
 	int ioctl_arg;
 	int ioctl_status;
 
+	output_stereo_only(info);
+
         if (info->out_SR > MAX_SAMPLERATE) {
 		if (verbose) {
 			fprintf(stderr, "\nThe sample rate you set (%ld Hz) is higher than MAX_SAMPLERATE.\n",
@@ -1410,7 +1858,7 @@ oss_init(thread_info_t * info, int verbose, gboolean realtime, int priority) {
 
 	/* start OSS output thread */
 	AQUALUNG_THREAD_CREATE(info->oss_thread_id, NULL, oss_thread, info)
-	set_thread_priority(info->oss_thread_id, "OSS output", realtime, priority);
+	set_thread_sched(info->oss_thread_id, "OSS output", sched);
 
 	return 0;
 }
@@ -1419,6 +1867,18 @@ oss_init(thread_info_t * info, int verbose, gboolean realtime, int priority) {
 
 
 #ifdef HAVE_ALSA
+/* ALSA's own surround order: FL FR RL RR FC LFE SL SR */
+void
+alsa_default_map(int n, int * map) {
+
+	static const int alsa_map[MAX_CHANNELS] = {
+		CHANNEL_FL, CHANNEL_FR, CHANNEL_RL, CHANNEL_RR,
+		CHANNEL_FC, CHANNEL_LFE, CHANNEL_SL, CHANNEL_SR
+	};
+
+	memcpy(map, alsa_map, n * sizeof(int));
+}
+
 /* return values:
  *  0 : success
  * -1 : device busy
@@ -1509,11 +1969,23 @@ alsa_init(thread_info_t * info, int verbose) {
 		info->out_SR = rate;
 	}
 
-	if (snd_pcm_hw_params_set_channels(info->pcm_handle, info->hwparams, 2) < 0) {
+	if (!channel_map_given) {
+		alsa_default_map(info->out_channels, info->out_map);
+	}
+	if (snd_pcm_hw_params_set_channels(info->pcm_handle, info->hwparams, info->out_channels) < 0) {
+		if ((info->out_channels == 2) ||
+		    (snd_pcm_hw_params_set_channels(info->pcm_handle, info->hwparams, 2) < 0)) {
+			if (verbose) {
+				fprintf(stderr, "alsa_init: error setting channels.\n");
+			}
+			return -7;
+		}
 		if (verbose) {
-			fprintf(stderr, "alsa_init: error setting channels.\n");
+			fprintf(stderr, "alsa_init: device cannot play %d channels, "
+				"falling back to stereo.\n", info->out_channels);
 		}
-		return -7;
+		info->out_channels = 2;
+		channels_default_map(2, info->out_map);
 	}
 
 	info->n_frames = 512;
@@ -1545,6 +2017,8 @@ alsa_init(thread_info_t * info, int verbose) {
 int
 jack_init(thread_info_t * info) {
 
+	int k;
+
 	if (client_name == NULL)
 		client_name = strdup("aqualung");
 
@@ -1559,21 +2033,27 @@ jack_init(thread_info_t * info) {
 		jack_client_close(jack_client);
                 return -info->out_SR;
         }
-        out_L_port = jack_port_register(jack_client, "out_L", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
-        out_R_port = jack_port_register(jack_client, "out_R", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
 
-	jack_nframes = jack_get_buffer_size(jack_client);
-	if ((l_buf = malloc(jack_nframes * sizeof(float))) == NULL) {
-		fprintf(stderr, "jack_init: malloc error\n");
-		exit(1);
-	}
-	if ((r_buf = malloc(jack_nframes * sizeof(float))) == NULL) {
-		fprintf(stderr, "jack_init: malloc error\n");
-		exit(1);
+	/* out_L and out_R keep their names, the others are named after their speaker */
+	for (k = 0; k < info->out_channels; k++) {
+		char port_name[16];
+
+		if (info->out_map[k] == CHANNEL_FL) {
+			out_L_port = out_ports[k] = jack_port_register(jack_client, "out_L",
+								       JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+		} else if (info->out_map[k] == CHANNEL_FR) {
+			out_R_port = out_ports[k] = jack_port_register(jack_client, "out_R",
+								       JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+		} else {
+			arr_snprintf(port_name, "out_%s", channels_position_name(info->out_map[k]));
+			out_ports[k] = jack_port_register(jack_client, port_name,
+							  JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+		}
 	}
-#ifdef HAVE_LADSPA
-	ladspa_buflen = jack_nframes;
-#endif /* HAVE_LADSPA */
+	n_out_ports = info->out_channels;
+
+	jack_nframes = jack_get_buffer_size(jack_client);
+	alloc_output_buffers(info, jack_nframes, "jack_init");
 	return 0;
 }
 
@@ -1585,6 +2065,35 @@ if (jack_connect(jack_client, jack_port_name(port), extport)) { \
 	fprintf(stderr, "Connected " #port " to %s\n", extport); \
 }
 
+/* surround ports go to the physical playback port at the same index */
+void
+connect_surround_ports(void) {
+
+	const char ** ports_out;
+	int k;
+
+	if (n_out_ports <= 2) {
+		return;
+	}
+	if ((ports_out = jack_get_ports(jack_client, NULL, NULL,
+					JackPortIsPhysical|JackPortIsInput)) == NULL) {
+		return;
+	}
+	for (k = 0; k < n_out_ports && ports_out[k] != NULL; k++) {
+		if (out_ports[k] == out_L_port || out_ports[k] == out_R_port) {
+			continue;
+		}
+		if (jack_connect(jack_client, jack_port_name(out_ports[k]), ports_out[k])) {
+			fprintf(stderr, "Cannot connect %s to %s.\n",
+				jack_port_short_name(out_ports[k]), ports_out[k]);
+		} else {
+			fprintf(stderr, "Connected %s to %s\n",
+				jack_port_short_name(out_ports[k]), ports_out[k]);
+		}
+	}
+	free(ports_out);
+}
+
 void
 connect_saved_ports(void) {
 
@@ -1624,6 +2133,7 @@ connect_saved_ports(void) {
 			free(ports_out);
 		}
 	}
+	connect_surround_ports();
 }
 
 void
@@ -1639,6 +2149,7 @@ jack_client_start(void) {
 		} else {
 			jack_try_connect(out_L_port, user_port1);
 			jack_try_connect(out_R_port, user_port2);
+			connect_surround_ports();
 		}
 	} else {
 		connect_saved_ports();
@@ -1655,9 +2166,19 @@ jack_client_start(void) {
  *       N = error code returned by PulseAudio.
  */
 int
-pulse_init(thread_info_t * info, int verbose, gboolean realtime, int priority) {
+pulse_init(thread_info_t * info, int verbose, thread_sched_t * sched) {
 	
 	int err = 0;
+	int k;
+	pa_channel_map pa_map;
+	static const pa_channel_position_t pa_positions[CHANNEL_NPOS] = {
+		PA_CHANNEL_POSITION_FRONT_LEFT, PA_CHANNEL_POSITION_FRONT_RIGHT,
+		PA_CHANNEL_POSITION_FRONT_CENTER, PA_CHANNEL_POSITION_LFE,
+		PA_CHANNEL_POSITION_REAR_LEFT, PA_CHANNEL_POSITION_REAR_RIGHT,
+		PA_CHANNEL_POSITION_SIDE_LEFT, PA_CHANNEL_POSITION_SIDE_RIGHT,
+		PA_CHANNEL_POSITION_REAR_CENTER, PA_CHANNEL_POSITION_MONO
+	};
+
 	if (info->out_SR > MAX_SAMPLERATE) {
 		if (verbose) {
 			fprintf(stderr, "\nThe sample rate you set (%ld Hz) is higher than MAX_SAMPLERATE.\n",
@@ -1670,11 +2191,16 @@ pulse_init(thread_info_t * info, int verbose, gboolean realtime, int priority) {
 	}
 	
 	info->pa_spec.format = PA_SAMPLE_S16NE;
-	info->pa_spec.channels = 2;
+	info->pa_spec.channels = info->out_channels;
 	info->pa_spec.rate = info->out_SR;
+
+	pa_map.channels = info->out_channels;
+	for (k = 0; k < info->out_channels; k++) {
+		pa_map.map[k] = pa_positions[info->out_map[k]];
+	}
 	
 	info->pa = pa_simple_new(NULL, "Aqualung", PA_STREAM_PLAYBACK, NULL,
-				 "Music", &info->pa_spec, NULL, NULL, &err);
+				 "Music", &info->pa_spec, &pa_map, NULL, &err);
 	if (!info->pa) {
 		if (verbose) {
 			fprintf(stderr, "Unable to initilize PulseAudio: %s\n", pa_strerror(err));
@@ -1684,7 +2210,7 @@ pulse_init(thread_info_t * info, int verbose, gboolean realtime, int priority) {
 	
 	/* start PulseAudio output thread */
 	AQUALUNG_THREAD_CREATE(info->pulse_thread_id, NULL, pulse_thread, info)
-	set_thread_priority(info->pulse_thread_id, "PulseAudio output", realtime, priority);
+	set_thread_sched(info->pulse_thread_id, "PulseAudio output", sched);
 
 	return 0;
 }
@@ -1711,23 +2237,13 @@ win32_thread(void * arg) {
         WAVEHDR whdr[nbufs];
 	int j;
         int n_avail;
-	char recv_cmd;
+	message_t recv_msg;
         MMTIME mmtime;
         DWORD samples_sent = 0;
 	int bufsize = WIN32_BUFFER_LEN / sizeof(short) / nbufs / 2;
 
 
-	if ((l_buf = calloc(1, bufsize * sizeof(float))) == NULL) {
-		fprintf(stderr, "win32_thread: malloc error\n");
-		exit(1);
-	}
-	if ((r_buf = calloc(1, bufsize * sizeof(float))) == NULL) {
-		fprintf(stderr, "win32_thread: malloc error\n");
-		exit(1);
-	}
-#ifdef HAVE_LADSPA
-	ladspa_buflen = bufsize;
-#endif /* HAVE_LADSPA */
+	alloc_output_buffers(info, bufsize, "win32_thread");
 
 	if ((short_buf = calloc(1, WIN32_BUFFER_LEN)) == NULL) {
 		fprintf(stderr, "win32_thread: malloc error\n");
@@ -1813,10 +2329,10 @@ win32_thread(void * arg) {
                         return NULL;
                 }
                 driver_offset = samples_sent - mmtime.u.sample;
+		info->out_latency = driver_offset;
 
-		while (rb_read_space(rb_disk2out)) {
-			rb_read(rb_disk2out, &recv_cmd, 1);
-			switch (recv_cmd) {
+		while (msgq_recv(q_disk2out, &recv_msg)) {
+			switch (recv_msg.cmd) {
 			case CMD_FLUSH:
 				while ((n_avail = rb_read_space(rb)) > 0) {
 					if (n_avail > 2*bufsize * sizeof(short))
@@ -1826,7 +2342,7 @@ win32_thread(void * arg) {
 				for (j = 0; j < WIN32_BUFFER_LEN / sizeof(short); j++) {
 					short_buf[j] = 0;
 				}
-				rb_write(rb_out2disk, (char *)&driver_offset, sizeof(guint32));
+				flush_done(driver_offset);
 				goto win32_wake;
 				break;
 			case CMD_FINISH:
@@ -1834,17 +2350,17 @@ win32_thread(void * arg) {
 				break;
 			default:
 				fprintf(stderr, "win32_thread: recv'd unknown command %d\n",
-					recv_cmd);
+					recv_msg.cmd);
 				break;
 			}
 		}
 
-		if ((n_avail = rb_read_space(rb) / (2*sample_size)) == 0) {
-			Sleep(100);
+		if ((n_avail = rb_read_space(rb) / (info->out_channels * sample_size)) == 0) {
+			msgq_wait(q_disk2out, 100);
 			goto win32_wake;
 		}
 
-		read_and_process_output(bufsize, &n_avail, 0);
+		read_and_process_output(info, bufsize, &n_avail, 0);
 		
 		while (!(whdr[bufcnt].dwFlags & WHDR_DONE))
 			Sleep(1);
@@ -2240,6 +2756,13 @@ print_version(void) {
 	fprintf(stderr, V_NO);
 #endif /* HAVE_PULSE */
 	fprintf(stderr, "PulseAudio\n");
+
+#ifdef NULL_DRIVER
+	fprintf(stderr, V_YES);
+#else
+	fprintf(stderr, V_NO);
+#endif /* NULL_DRIVER */
+	fprintf(stderr, "null (benchmarking)\n");
 	
 #ifdef HAVE_WINMM
 	fprintf(stderr, V_YES);
@@ -2261,11 +2784,21 @@ print_usage(void) {
 		"\nInvocation:\n"
 		"aqualung --help\n"
 		"aqualung --version\n"
-		"aqualung [--output (oss|alsa|jack|sndio|pulse|win32)] [options] [file1 [file2 ...]]\n"
+		"aqualung [--output (oss|alsa|jack|sndio|pulse|win32|null)] [options] [file1 [file2 ...]]\n"
 		
 		"\nGeneral options:\n"
 		"-D, --disk-realtime: Try to use realtime (SCHED_FIFO) scheduling for disk thread.\n"
 		"-Y, --disk-priority <int>: When running -D, set scheduler priority to <int> (defaults to 1).\n"
+		"--disk-policy (fifo|rr): Realtime policy for the disk and SRC threads (implies -D).\n"
+		"--disk-affinity <cpus>: Run the disk thread on the given CPUs, e.g. 2 or 0,4-7.\n"
+		"--src-affinity <cpus>: Run the SRC thread on the given CPUs (defaults to --disk-affinity).\n"
+		"--policy (fifo|rr): Realtime policy for the output thread (implies -R).\n"
+		"--affinity <cpus>: Run the output thread on the given CPUs (not for JACK output).\n"
+		"--mlock: Lock all memory of the program, so audio buffers are never paged out.\n"
+		"-n, --channels <int>: Number of output channels, 2 to 8 (defaults to 2). Files with\n"
+		"other layouts are mixed to fit; OSS, sndio and WIN32 outputs are stereo only.\n"
+		"-M, --channel-map <list>: Output speakers in driver order, e.g. FL,FR,RL,RR,FC,LFE\n"
+		"(out of FL FR FC LFE RL RR SL SR RC). Implies the number of channels.\n"
 		
 		"\nOptions relevant to ALSA output:\n"
 		"-d, --device <name>: Set the output device (defaults to 'default').\n"
@@ -2293,6 +2826,16 @@ print_usage(void) {
 		"\nOptions relevant to WIN32 output:\n"
 		"-r, --rate <int>: Set the output sample rate.\n"
 		
+		"\nOptions relevant to the null output (timing statistics are printed on exit):\n"
+		"-r, --rate <int>: Set the output sample rate.\n"
+		"--period <int>: Set the period size (in frames, defaults to 1024).\n"
+		"-R, --realtime: Try to use realtime (SCHED_FIFO) scheduling for the output thread.\n"
+		"-P, --priority <int>: Set scheduler priority to <int> (default is 1 when -R is used).\n"
+		"-W, --workload <list>: Play the given files without the GUI, as described by a\n"
+		"comma separated list of tracks=<int> (track changes), play=<seconds> (per track,\n"
+		"0 for whole tracks), seeks=<int> (random seeks per track), seed=<int> and\n"
+		"ladspa=<file>:<index> (plugins to run, may be repeated).\n"
+		
 		"\nOptions relevant to the Sample Rate Converter:\n"
 		"-s[<int>], --srctype[=<int>]: Choose the SRC type, or print the list of available\n"
 		"types if no number given. The default is SRC type 4 (Linear Interpolator).\n"
@@ -2404,6 +2947,72 @@ setup_app_directories(void) {
 	}
 }
 
+/* long options without a short form */
+enum {
+	OPT_POLICY = 256,
+	OPT_DISK_POLICY,
+	OPT_AFFINITY,
+	OPT_DISK_AFFINITY,
+	OPT_SRC_AFFINITY,
+	OPT_MLOCK,
+	OPT_PERIOD
+};
+
+
+/* Called once the audio threads run. It waits for them to allocate their
+ * buffers; mlockall() then faults in every page it locks, so the rings,
+ * thread stacks and those buffers are resident before playback starts.
+ * Future pages are only locked with no limit on locked memory; with a
+ * limit, allocations would start to fail once it is reached. Then what
+ * is allocated later (decoders of each file, a resampler rebuilt for a
+ * new rate, the GUI) is not locked.
+ */
+static void
+lock_memory(void) {
+
+#ifdef HAVE_MLOCKALL
+	struct rlimit limit;
+	int flags = MCL_CURRENT | MCL_FUTURE;
+	int n_threads = 2; /* disk and output */
+	int i;
+
+#ifdef HAVE_SRC
+	n_threads++;
+#endif /* HAVE_SRC */
+	for (i = 0; i < 200 && g_atomic_int_get(&audio_threads_ready) < n_threads; i++) {
+		g_usleep(10000);
+	}
+	if (g_atomic_int_get(&audio_threads_ready) < n_threads) {
+		fprintf(stderr, "lock_memory: audio threads not ready, "
+			"their buffers may not be locked\n");
+	}
+
+	if (getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+		flags = MCL_CURRENT;
+	}
+	if (mlockall(flags) == 0) {
+		printf("Memory locked: %s\n", (flags & MCL_FUTURE) ?
+		       "all current and future pages" : "all current pages");
+		return;
+	}
+	fprintf(stderr, "mlockall: %s\n", strerror(errno));
+
+	/* through rb_mlock(), so that rb_free() unlocks them again */
+	if (rb_mlock(rb) == 0
+#ifdef HAVE_SRC
+	    && rb_mlock(rb_src) == 0
+#endif /* HAVE_SRC */
+	    ) {
+		printf("Memory locked: audio ring buffers only\n");
+	} else {
+		fprintf(stderr, "mlock: %s, memory is not locked\n", strerror(errno));
+	}
+#else
+	fprintf(stderr, "Memory locking is not supported on this platform.\n");
+#endif /* HAVE_MLOCKALL */
+}
+
+
 void die_no_such_output_driver(char * outstr) {
 	fprintf(stderr,
 		"You selected %s output, but this instance of Aqualung is compiled\n"
@@ -2430,10 +3039,13 @@ main(int argc, char ** argv) {
 	int show_usage = 0;
 	char * output_str = NULL;
 	int rate = 0;
-	gboolean try_realtime = FALSE;
-	int priority = -1;
-	gboolean disk_try_realtime = FALSE;
-	int disk_priority = -1;
+	thread_sched_t out_sched = { FALSE, THREAD_SCHED_FIFO, -1, NULL };
+	thread_sched_t disk_sched = { FALSE, THREAD_SCHED_FIFO, -1, NULL };
+	thread_sched_t src_sched;
+	char * src_cpus = NULL;
+	int lock_mem = 0;
+	int n_channels = 2;
+	int channel_map[MAX_CHANNELS];
 
 	char rcmd;
 	int no_session = -1;
@@ -2446,8 +3058,11 @@ main(int argc, char ** argv) {
 	int remote_quit = 0;
 	char * voladj_arg = NULL;
 	char * custom_arg = NULL;
+#ifdef NULL_DRIVER
+	char * workload = NULL;
+#endif /* NULL_DRIVER */
 
-	char * optstring = "vho:d:c:r:b:a::RP:DY:s::l:m:N:BLUTFEC:V:Qt::";
+	char * optstring = "vho:d:c:r:b:a::RP:DY:s::n:M:W:l:m:N:BLUTFEC:V:Qt::";
 	struct option long_options[] = {
 		{ "version", 0, 0, 'v' },
 		{ "help", 0, 0, 'h' },
@@ -2461,7 +3076,17 @@ main(int argc, char ** argv) {
 		{ "priority", 1, 0, 'P' },
 		{ "disk-realtime", 0, 0, 'D' },
 		{ "disk-priority", 1, 0, 'Y' },
+		{ "policy", 1, 0, OPT_POLICY },
+		{ "disk-policy", 1, 0, OPT_DISK_POLICY },
+		{ "affinity", 1, 0, OPT_AFFINITY },
+		{ "disk-affinity", 1, 0, OPT_DISK_AFFINITY },
+		{ "src-affinity", 1, 0, OPT_SRC_AFFINITY },
+		{ "mlock", 0, 0, OPT_MLOCK },
+		{ "period", 1, 0, OPT_PERIOD },
 		{ "srctype", 2, 0, 's' },
+		{ "channels", 1, 0, 'n' },
+		{ "channel-map", 1, 0, 'M' },
+		{ "workload", 1, 0, 'W' },
                 { "show-pl", 1, 0, 'l' },
 		{ "show-ms", 1, 0, 'm' },
 		{ "tab", 2, 0, 't' },
@@ -2491,8 +3116,11 @@ main(int argc, char ** argv) {
 	gdk_threads_init();
 
 #ifndef HAVE_LIBPTHREAD
-	disk_thread_lock = g_mutex_new();
-	disk_thread_wake = g_cond_new();
+#ifdef HAVE_SRC
+	src_thread_lock = g_mutex_new();
+	src_thread_wake = g_cond_new();
+	src_thread_idle = g_cond_new();
+#endif /* HAVE_SRC */
 #endif /* !HAVE_LIBPTHREAD */
 
 	file_decoder_init();
@@ -2595,6 +3223,15 @@ main(int argc, char ** argv) {
 					free(output_str);
 					break;
 				}
+				if (strcmp(output_str, "null") == 0) {
+#ifdef NULL_DRIVER
+					output = NULL_DRIVER;
+#else
+					die_no_such_output_driver(output_str);
+#endif /* NULL_DRIVER */
+					free(output_str);
+					break;
+				}
 				fprintf(stderr, "Invalid output device: %s\n", output_str);
 				free(output_str);
 				exit(0);
@@ -2610,11 +3247,11 @@ main(int argc, char ** argv) {
 			case 'r':
 				rate = atoi(optarg);
 				break;
-#ifdef HAVE_ALSA
 			case 'b':
+#ifdef HAVE_ALSA
 				alsa_buffer_size = atoi(optarg);
-				break;
 #endif /* HAVE_ALSA */
+				break;
 			case 'a':
 #ifdef HAVE_JACK
 				auto_connect = 1;
@@ -2649,16 +3286,50 @@ main(int argc, char ** argv) {
 #endif /* HAVE_JACK */
 				break;
 			case 'R':
-				try_realtime = TRUE;
+				out_sched.realtime = TRUE;
 				break;
 			case 'P':
-				priority = atoi(optarg);
+				out_sched.priority = atoi(optarg);
 				break;
 			case 'D':
-				disk_try_realtime = TRUE;
+				disk_sched.realtime = TRUE;
 				break;
 			case 'Y':
-				disk_priority = atoi(optarg);
+				disk_sched.priority = atoi(optarg);
+				break;
+			case OPT_POLICY:
+			case OPT_DISK_POLICY: {
+				thread_sched_t * sched = (c == OPT_POLICY) ? &out_sched : &disk_sched;
+
+				if ((sched->policy = thread_sched_parse_policy(optarg)) < 0) {
+					fprintf(stderr, "Invalid scheduling policy: %s\n", optarg);
+					exit(1);
+				}
+				sched->realtime = TRUE;
+				break;
+			}
+			case OPT_AFFINITY:
+			case OPT_DISK_AFFINITY:
+			case OPT_SRC_AFFINITY:
+				if (!thread_sched_valid_cpus(optarg)) {
+					fprintf(stderr, "Invalid CPU list: %s\n", optarg);
+					exit(1);
+				}
+				if (c == OPT_AFFINITY) {
+					out_sched.cpus = strdup(optarg);
+				} else if (c == OPT_DISK_AFFINITY) {
+					disk_sched.cpus = strdup(optarg);
+				} else {
+					src_cpus = strdup(optarg);
+				}
+				break;
+			case OPT_MLOCK:
+				lock_mem = 1;
+				break;
+			case OPT_PERIOD:
+#ifdef NULL_DRIVER
+				null_period = atoi(optarg);
+#endif /* NULL_DRIVER */
 				break;
 			case 's':
 #ifdef HAVE_SRC
@@ -2669,9 +3340,9 @@ main(int argc, char ** argv) {
 					int i = 0;
 					
 					fprintf(stderr, "List of available Sample Rate Converters:\n\n");
-					while (src_get_name(i)) {
+					while (resampler_get_name(i)) {
 						fprintf(stderr, "Converter #%d: %s\n%s\n\n",
-						       i, src_get_name(i), src_get_description(i));
+						       i, resampler_get_name(i), resampler_get_description(i));
 						++i;
 					}
 					fprintf(stderr,
@@ -2702,6 +3373,25 @@ main(int argc, char ** argv) {
 				exit(1);
 #endif /* HAVE_SRC */
 				break;
+			case 'n':
+				n_channels = atoi(optarg);
+				if (n_channels < 2 || n_channels > MAX_CHANNELS) {
+					fprintf(stderr, "Invalid number of channels: %s\n", optarg);
+					exit(1);
+				}
+				break;
+			case 'M':
+				if ((n_channels = channels_parse_map(optarg, channel_map)) < 0) {
+					fprintf(stderr, "Invalid channel map: %s\n", optarg);
+					exit(1);
+				}
+				channel_map_given = 1;
+				break;
+			case 'W':
+#ifdef NULL_DRIVER
+				workload = strdup(optarg);
+#endif /* NULL_DRIVER */
+				break;
                         case 'l':
                                if(!strncmp(optarg, "yes", 3)) {
                                         playlist_state = 1;
@@ -2900,24 +3590,33 @@ main(int argc, char ** argv) {
 
 	thread_info.rb_size = RB_AUDIO_SIZE;
 
-        rb = rb_create(2*sample_size * thread_info.rb_size);
-	memset(rb->buf, 0, rb->size);
-
+	/* drivers may only lower the channel count, so size for the request */
+	thread_info.out_channels = n_channels;
+	if (channel_map_given) {
+		memcpy(thread_info.out_map, channel_map, n_channels * sizeof(int));
+	} else {
+		channels_default_map(n_channels, thread_info.out_map);
+	}
 
-	rb_disk2gui = rb_create(RB_CONTROL_SIZE);
-	memset(rb_disk2gui->buf, 0, rb_disk2gui->size);
+        rb = rb_create(thread_info.out_channels * sample_size * thread_info.rb_size);
+	memset(rb->buf, 0, rb->size);
 
-	rb_gui2disk = rb_create(RB_CONTROL_SIZE);
-	memset(rb_gui2disk->buf, 0, rb_gui2disk->size);
+#ifdef HAVE_SRC
+	rb_src = rb_create(thread_info.out_channels * sample_size * thread_info.rb_size);
+#endif /* HAVE_SRC */
 
-	rb_disk2out = rb_create(RB_CONTROL_SIZE);
-	memset(rb_disk2out->buf, 0, rb_disk2out->size);
 
-	rb_out2disk = rb_create(RB_CONTROL_SIZE);
-	memset(rb_out2disk->buf, 0, rb_out2disk->size);
+	q_disk2gui = msgq_create(CONTROL_QUEUE_LEN, sizeof(message_t));
+	q_gui2disk = msgq_create(CONTROL_QUEUE_LEN, sizeof(message_t));
+	q_disk2out = msgq_create(CONTROL_QUEUE_LEN, sizeof(message_t));
+	q_out2disk = msgq_create(CONTROL_QUEUE_LEN, sizeof(message_t));
+	if (!q_disk2gui || !q_gui2disk || !q_disk2out || !q_out2disk) {
+		fprintf(stderr, "aqualung main(): cannot create control queues\n");
+		exit(1);
+	}
 
 	thread_info.is_streaming = 0;
-	thread_info.is_mono = 0;
+	thread_info.in_channels = 2;
 	thread_info.in_SR = 0;
 
 
@@ -2963,7 +3662,7 @@ main(int argc, char ** argv) {
 		printf("Probing PulseAudio driver... ");
 		thread_info.out_SR = rate;
 
-		ret = pulse_init(&thread_info, 0, try_realtime, priority);
+		ret = pulse_init(&thread_info, 0, &out_sched);
 		if (ret == -1) {
 			printf("sample rate out of range!\n");
 		} else if (ret > 0) {
@@ -3007,7 +3706,7 @@ main(int argc, char ** argv) {
 		printf("Probing sndio driver... ");
 		thread_info.out_SR = rate;
 
-		ret = sndio_init(&thread_info, 0, try_realtime, priority);
+		ret = sndio_init(&thread_info, 0, &out_sched);
 		if (ret < 0) {
 			printf("unable to start with default params\n");
 		} else {
@@ -3028,7 +3727,7 @@ main(int argc, char ** argv) {
 		}
 		thread_info.out_SR = rate;
 
-		ret = oss_init(&thread_info, 0, try_realtime, priority);
+		ret = oss_init(&thread_info, 0, &out_sched);
 		if (ret == -1) {
 			printf("device busy\n");			
 		} else if (ret < 0) {
@@ -3111,12 +3810,14 @@ main(int argc, char ** argv) {
 #ifdef HAVE_SNDIO
 	if (output == SNDIO_DRIVER) {
 		thread_info.out_SR = rate;
+		output_stereo_only(&thread_info);
 	}
 #endif /* HAVE_SNDIO */
 
 #ifdef HAVE_OSS
 	if (output == OSS_DRIVER) {
 		thread_info.out_SR = rate;
+		output_stereo_only(&thread_info);
 	}
 #endif /* HAVE_OSS */
 
@@ -3129,18 +3830,42 @@ main(int argc, char ** argv) {
 #ifdef HAVE_WINMM
 	if (output == WIN32_DRIVER) {
 		thread_info.out_SR = rate;
+		output_stereo_only(&thread_info);
 	}
 #endif /* HAVE_WINMM */
 
+#ifdef NULL_DRIVER
+	if (output == NULL_DRIVER) {
+		if (null_period <= 0) {
+			fprintf(stderr, "Invalid period size: %d\n", null_period);
+			exit(1);
+		}
+		thread_info.out_SR = rate;
+		/* before the thread starts, so --workload can wire up plugins */
+		alloc_output_buffers(&thread_info, null_period, "null output");
+	} else if (workload != NULL) {
+		fprintf(stderr, "--workload needs the null output (-o null).\n");
+		exit(1);
+	}
+#endif /* NULL_DRIVER */
+
 	/* startup disk thread */
 	AQUALUNG_THREAD_CREATE(thread_info.disk_thread_id, NULL, disk_thread, &thread_info)
-	set_thread_priority(thread_info.disk_thread_id, "disk",
-		disk_try_realtime, disk_priority);
+	set_thread_sched(thread_info.disk_thread_id, "disk", &disk_sched);
+
+#ifdef HAVE_SRC
+	AQUALUNG_THREAD_CREATE(thread_info.src_thread_id, NULL, src_thread, &thread_info)
+	src_sched = disk_sched;
+	if (src_cpus != NULL) {
+		src_sched.cpus = src_cpus;
+	}
+	set_thread_sched(thread_info.src_thread_id, "SRC", &src_sched);
+#endif /* HAVE_SRC */
 
 #ifdef HAVE_SNDIO
 	if (output == SNDIO_DRIVER) {
 		if (!auto_driver_found) {
-			int ret = sndio_init(&thread_info, 1, try_realtime, priority);
+			int ret = sndio_init(&thread_info, 1, &out_sched);
 			if (ret < 0) {
 				exit(1);
 			}
@@ -3151,7 +3876,7 @@ main(int argc, char ** argv) {
 #ifdef HAVE_OSS
 	if (output == OSS_DRIVER) {
 		if (!auto_driver_found) {
-			int ret = oss_init(&thread_info, 1, try_realtime, priority);
+			int ret = oss_init(&thread_info, 1, &out_sched);
 			if (ret < 0) {
 				exit(1);
 			}
@@ -3162,7 +3887,7 @@ main(int argc, char ** argv) {
 #ifdef HAVE_PULSE
 	if (output == PULSE_DRIVER) {
 		if (!auto_driver_found) {
-			int ret = pulse_init(&thread_info, 1, try_realtime, priority);
+			int ret = pulse_init(&thread_info, 1, &out_sched);
 			if (ret != 0) {
 				exit(1);
 			}
@@ -3173,24 +3898,47 @@ main(int argc, char ** argv) {
 #ifdef HAVE_ALSA
 	if (output == ALSA_DRIVER) {
 		AQUALUNG_THREAD_CREATE(thread_info.alsa_thread_id, NULL, alsa_thread, &thread_info)
-		set_thread_priority(thread_info.alsa_thread_id, "ALSA output", try_realtime, priority);
+		set_thread_sched(thread_info.alsa_thread_id, "ALSA output", &out_sched);
 	}
 #endif /* HAVE_ALSA */
 
 #ifdef HAVE_WINMM
 	if (output == WIN32_DRIVER) {
 		AQUALUNG_THREAD_CREATE(thread_info.win32_thread_id, NULL, win32_thread, &thread_info)
-		set_thread_priority(thread_info.win32_thread_id,
-				    "WinMM output", try_realtime, priority);
+		set_thread_sched(thread_info.win32_thread_id, "WinMM output", &out_sched);
 	}
 #endif /* HAVE_WINMM */
 
+#ifdef NULL_DRIVER
+	if (output == NULL_DRIVER) {
+		AQUALUNG_THREAD_CREATE(thread_info.null_thread_id, NULL, null_thread, &thread_info)
+		set_thread_sched(thread_info.null_thread_id, "null output", &out_sched);
+	}
+#endif /* NULL_DRIVER */
+
+	if (lock_mem) {
+		lock_memory();
+	}
+
+#ifdef NULL_DRIVER
+	if (workload != NULL) {
+		/* no GUI: replay the workload on the files given */
+		rt_bench_run(&thread_info, workload, argv + optind, argc - optind);
+		free(workload);
+	} else {
+#endif /* NULL_DRIVER */
 	create_gui(argc, argv, optind, enqueue, rate, RB_AUDIO_SIZE * rate / 44100.0);
 	setup_app_socket();
 	run_gui(); /* control stays here until user exits program */
 	close_app_socket();
+#ifdef NULL_DRIVER
+	}
+#endif /* NULL_DRIVER */
 
 	AQUALUNG_THREAD_JOIN(thread_info.disk_thread_id)
+#ifdef HAVE_SRC
+	AQUALUNG_THREAD_JOIN(thread_info.src_thread_id)
+#endif /* HAVE_SRC */
 
 #ifdef HAVE_SNDIO
 	if (output == SNDIO_DRIVER) {
@@ -3244,9 +3992,19 @@ main(int argc, char ** argv) {
 	}
 #endif /* HAVE_WINMM */
 
+#ifdef NULL_DRIVER
+	if (output == NULL_DRIVER) {
+		AQUALUNG_THREAD_JOIN(thread_info.null_thread_id)
+		rt_bench_report(stdout, &thread_info, null_period);
+	}
+#endif /* NULL_DRIVER */
+
 #ifndef HAVE_LIBPTHREAD
-	g_mutex_free(disk_thread_lock);
-	g_cond_free(disk_thread_wake);
+#ifdef HAVE_SRC
+	g_mutex_free(src_thread_lock);
+	g_cond_free(src_thread_wake);
+	g_cond_free(src_thread_idle);
+#endif /* HAVE_SRC */
 #endif /* !HAVE_LIBPTHREAD */
 
 	if (device_name != NULL)
@@ -3255,10 +4013,13 @@ main(int argc, char ** argv) {
 	free(l_buf);
 	free(r_buf);
 	rb_free(rb);
-	rb_free(rb_disk2gui);
-	rb_free(rb_gui2disk);
-	rb_free(rb_disk2out);
-	rb_free(rb_out2disk);
+	msgq_free(q_disk2gui);
+	msgq_free(q_gui2disk);
+	msgq_free(q_disk2out);
+	msgq_free(q_out2disk);
+#ifdef HAVE_SRC
+	rb_free(rb_src);
+#endif /* HAVE_SRC */
 
 	return 0;
 }
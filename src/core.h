@@ -55,18 +55,30 @@
 #include <pulse/simple.h>
 #endif /* HAVE_PULSE */
 
+/* consumes periods on the system clock, for benchmarking */
+#ifdef HAVE_CLOCK_NANOSLEEP
+#define NULL_DRIVER 7
+#endif /* HAVE_CLOCK_NANOSLEEP */
+
 #include "athread.h"
+#include "channels.h"
+#include "msgq.h"
+#include "metadata.h"
+#include "decoder/file_decoder.h"
 
 
 #define MAX_SAMPLERATE 96000
 
 
-/* audio ringbuffer size in stereo frames */
+/* audio ringbuffer size in frames */
 #define RB_AUDIO_SIZE 32768
 
 /* control ringbuffer size in bytes */
 #define RB_CONTROL_SIZE 32768
 
+/* control queue length in messages */
+#define CONTROL_QUEUE_LEN 256
+
 
 /* SRC settings */
 #ifdef HAVE_SRC
@@ -78,11 +90,15 @@
 
 typedef struct _thread_info {
 	AQUALUNG_THREAD_DECLARE(disk_thread_id)
+#ifdef HAVE_SRC
+	AQUALUNG_THREAD_DECLARE(src_thread_id)
+#endif /* HAVE_SRC */
 
 #ifdef HAVE_SNDIO
 	AQUALUNG_THREAD_DECLARE(sndio_thread_id)
 	struct sio_hdl * sndio_hdl;
 	short * sndio_short_buf;
+	int sndio_delay; /* frames written but not yet played */
 #endif /* HAVE_SNDIO */
 
 #ifdef HAVE_OSS	
@@ -113,12 +129,23 @@ typedef struct _thread_info {
 	short * pa_short_buf;
 #endif /* HAVE_PULSE */
 
+#ifdef NULL_DRIVER
+	AQUALUNG_THREAD_DECLARE(null_thread_id)
+#endif /* NULL_DRIVER */
+
 	guint32 rb_size;
 	unsigned long in_SR;
 	unsigned long in_SR_prev;
 	unsigned long out_SR;
 	volatile int is_streaming;
-	volatile int is_mono;
+	volatile int in_channels;
+
+	/* frames queued in the output device, as last measured by the driver */
+	volatile guint32 out_latency;
+
+	/* speaker layout of the output, fixed once the driver is up */
+	int out_channels;
+	int out_map[MAX_CHANNELS];
 
 } thread_info_t;
 
@@ -158,6 +185,26 @@ typedef struct _seek_t {
 } seek_t;
 
 
+/* what travels on the control queues between gui, disk and output */
+typedef struct _message_t {
+	int cmd;
+	union {
+		cue_t cue;                 /* CMD_CUE */
+		seek_t seek;               /* CMD_SEEKTO */
+		fileinfo_t fileinfo;       /* CMD_FILEINFO */
+		status_t status;           /* CMD_STATUS */
+		metadata_t * meta;         /* CMD_METABLOCK */
+		guint32 driver_offset;     /* CMD_FLUSH, output to disk */
+	} u;
+} message_t;
+
+
+/* queue commands for the disk thread, from any thread */
+void disk_send_cmd(int cmd);
+void disk_send_cue(cue_t * cue);
+void disk_send_seek(long long pos);
+
+
 void jack_client_start(void);
 
 
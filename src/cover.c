@@ -27,16 +27,22 @@
 #include <strings.h>
 #include <dirent.h>
 #include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <glib-object.h>
 #include <gdk/gdk.h>
 #include <gdk/gdkkeysyms.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gtk/gtk.h>
 
+#include "athread.h"
+#include "common.h"
 #include "music_browser.h"
 #include "store_file.h"
 #include "options.h"
+#include "utils_gui.h"
 #include "cover.h"
 
 
@@ -55,11 +61,14 @@ gchar *cover_extensions[] = {
 gint n_extensions = sizeof(cover_extensions) / sizeof(gchar*);
 
 GtkWidget *cover_window;
-gboolean ext_flag;
-gchar temp_filename[PATH_MAX];
 gint calculated_width, calculated_height;
 gint cover_widths[N_COVER_WIDTHS] = { 50, 100, 200, 300, -1 };       /* widths in pixels */
 
+static void cover_blob_display(GtkWidget *image_area, GtkWidget *event_area, GtkWidget *align,
+			       GtkWidget *window, gint dest_width, gint dest_height,
+			       void * data, int length, gboolean hide, gboolean bevel);
+static guint cover_claim_area(GtkWidget * image_area);
+
 gchar *
 get_song_path(gchar *song_filename) {
 
@@ -78,137 +87,531 @@ get_song_path(gchar *song_filename) {
 }
 
 
-static gint
-entry_filter(const struct dirent *entry) {
-
-        gint i, len;
-        gchar *ext, *str1, *str2;
+/* Cover lookups are cached per directory, most recently used first.
+ * Each entry remembers the cover file found in the directory (if any)
+ * and the scaled, frameless pixbufs already made from it, so changing
+ * to another track of the same album neither rescans the directory nor
+ * decodes the image again. An entry is dropped when the directory's
+ * mtime changes. The cache is only ever touched from the GUI thread;
+ * prefetching for the upcoming track scans and decodes in a helper
+ * thread and hands the result over through the idle queue.
+ */
 
-        len = strlen (entry->d_name);
+#define COVER_CACHE_DIRS    32
+#define COVER_CACHE_SCALED  4
 
-        if (len < 5)                    /* 5 => a.abc */
-                return FALSE;
-
-        if ((ext = strrchr(entry->d_name, '.'))) {
- 
-                ext++; 
+typedef struct {
+	gint width;
+	gint height;
+	GdkPixbuf * pixbuf;
+} cover_scaled_t;
+
+typedef struct {
+	gchar * dir;
+	time_t dir_mtime;
+	gchar * cover;    /* NULL if the directory has no cover */
+	GSList * scaled;  /* of cover_scaled_t, most recent first */
+} cover_entry_t;
+
+typedef struct {
+	AQUALUNG_THREAD_DECLARE(thread_id)
+	gchar * dir;
+	time_t dir_mtime;
+	gboolean scanned;
+	gchar * cover;
+	gint width;
+	gint height;
+	GdkPixbuf * pixbuf;
+} cover_prefetch_t;
 
-                /* filter candidates for cover */
+static GList * cover_cache = NULL;
+static gint cover_cache_length = 0;
+static gchar * cover_prefetch_dir = NULL;
 
-                str1 = g_utf8_casefold(ext, -1);
 
-                for (i = 0; i < n_extensions; i++) {
+static time_t
+cover_mtime(const gchar * path) {
 
-                        str2 = g_utf8_casefold(cover_extensions[i], -1);
-                        
-                        if (!g_utf8_collate(str1, str2)) {
-                                g_free(str1);
-                                g_free(str2);
-                                ext_flag = TRUE;
-                                arr_strlcpy(temp_filename, entry->d_name);
-                                return TRUE;
-                        }
-                
-                        g_free (str2);
-                }
+	struct stat st;
 
-                g_free (str1);
-        }
-
-	return FALSE;
+	if (g_stat(path, &st) != 0) {
+		return (time_t)-1;
+	}
+	return st.st_mtime;
 }
 
-gchar *
-find_cover_filename(gchar *song_filename) {
+/* Returns the best cover image in dir (which ends with a '/'), or NULL.
+ * Files named after one of the templates win over any other image, in
+ * template and then extension order. Safe to call from any thread. */
+static gchar *
+cover_scan_dir(const gchar * dir) {
 
         gchar *cover_filenames[] = {
-                "cover", ".cover", 
+                "cover", ".cover",
                 "folder", ".folder",
                 "front", ".front"
         };
 
-        gint n_templates, n_file_hits, i, j, n, m;
-        gchar base_path[PATH_MAX], current_filename[PATH_MAX];
-        static gchar cover_filename[PATH_MAX];
-        static gint cover_filename_reasonable;
-	struct dirent ** d_entry;
-        gchar *str1, *str2;
+	gint n_templates = sizeof(cover_filenames) / sizeof(gchar*);
+	gint best_rank = G_MAXINT;
+	gchar * best = NULL;
+	gchar * fallback = NULL;
+	gchar * cover = NULL;
+	struct dirent * entry;
+	DIR * d;
 
+	if ((d = opendir(dir)) == NULL) {
+		return NULL;
+	}
 
-        n_templates = sizeof(cover_filenames) / sizeof(gchar*);
-        arr_strlcpy(base_path, get_song_path(song_filename));
+	while ((entry = readdir(d)) != NULL) {
 
-        if (strcmp(base_path, get_song_path(cover_filename))) {
+		gchar * name = entry->d_name;
+		gchar * ext;
+		gint i, j;
 
-                cover_filename[0] = temp_filename[0] = '\0';
-                cover_filename_reasonable = FALSE;
+		if (strlen(name) < 5) {        /* 5 => a.abc */
+			continue;
+		}
+		if ((ext = strrchr(name, '.')) == NULL) {
+			continue;
+		}
 
-                ext_flag = FALSE;
-                n_file_hits = scandir(base_path, &d_entry, entry_filter, alphasort);
+		for (j = 0; j < n_extensions; j++) {
+			if (!g_ascii_strcasecmp(ext + 1, cover_extensions[j])) {
+				break;
+			}
+		}
+		if (j == n_extensions) {
+			continue;
+		}
 
-                for (i = 0; i < n_templates; i++) {
+		if (fallback == NULL || strcmp(name, fallback) < 0) {
+			g_free(fallback);
+			fallback = g_strdup(name);
+		}
 
-                        for (j = 0; j < n_extensions; j++) {
+		for (i = 0; i < n_templates; i++) {
+
+			gint rank = i * n_extensions + j;
+			gchar * path;
+
+			if (rank >= best_rank ||
+			    strlen(cover_filenames[i]) != (size_t)(ext - name) ||
+			    g_ascii_strncasecmp(name, cover_filenames[i], ext - name)) {
+				continue;
+			}
+
+			path = g_strconcat(dir, name, NULL);
+			if (g_file_test(path, G_FILE_TEST_IS_REGULAR) == TRUE) {
+				g_free(best);
+				best = path;
+				best_rank = rank;
+			} else {
+				g_free(path);
+			}
+			break;
+		}
+	}
+	closedir(d);
 
-                                arr_strlcpy(current_filename, cover_filenames[i]);
-                                arr_strlcat(current_filename, ".");
-                                arr_strlcat(current_filename, cover_extensions[j]);
+	if (best != NULL) {
+		cover = best;
+	} else if (fallback != NULL) {
+		cover = g_strconcat(dir, fallback, NULL);
+	}
 
-                                str1 = g_utf8_casefold (current_filename, -1);
+	g_free(fallback);
+	return cover;
+}
 
-                                for (n = 0; n < n_file_hits; n++) {
+static void
+cover_scaled_size(gint width, gint height, gint dest_width, gint dest_height,
+		  gint * scaled_width, gint * scaled_height) {
 
-                                        str2 = g_utf8_casefold(d_entry[n]->d_name, -1);
+	*scaled_width =  dest_width;
+	*scaled_height = dest_height;
 
-                                        if (!g_utf8_collate(str1, str2)) {
+	if (width >= height) {
+		*scaled_height = (height * dest_height) / width;
+	} else {
+		*scaled_width = (width * dest_width) / height;
+	}
+}
 
-                                                arr_strlcpy(cover_filename, base_path);
-                                                arr_strlcat(cover_filename, d_entry[n]->d_name);
+/* The thumbnail directory is kept under COVER_THUMBNAIL_BYTES by
+ * dropping the least recently used files (by access time, or by
+ * modification time where atime is not updated). It is checked on the
+ * first thumbnail written in a session, then every
+ * COVER_THUMBNAIL_PRUNE_EVERY thumbnails.
+ */
 
-                                                if (g_file_test (cover_filename, G_FILE_TEST_IS_REGULAR) == TRUE) {
-                                                        g_free (str1);
-                                                        g_free (str2);
+#define COVER_THUMBNAIL_BYTES       (32 * 1024 * 1024)
+#define COVER_THUMBNAIL_PRUNE_EVERY 64
 
+typedef struct {
+	gchar * path;
+	time_t used;
+	off_t size;
+} cover_thumbnail_t;
 
-                                                        for (m = 0; m < n_file_hits; m++) {
-                                                                free(d_entry[m]);
-                                                        }
-                                                        free(d_entry);
+static volatile gint cover_thumbnail_countdown = 1;
 
-                                                        cover_filename_reasonable = TRUE;
 
-                                                        return cover_filename;
-                                                }
-                                        }
+static gint
+cover_thumbnail_cmp(gconstpointer a, gconstpointer b) {
 
-                                        g_free (str2);
-                                }
+	time_t ua = ((const cover_thumbnail_t *)a)->used;
+	time_t ub = ((const cover_thumbnail_t *)b)->used;
 
-                                g_free (str1);
-                        }
-                }
+	return (ua < ub) ? -1 : (ua > ub);
+}
 
-                if (n_file_hits > 0) {
-                        for (m = 0; m < n_file_hits; m++) {
-                                free(d_entry[m]);
-                        }
-                        free(d_entry);
-                }
+static void
+cover_thumbnail_prune(const gchar * thumb_dir) {
 
-                arr_strlcpy(cover_filename, base_path);
- 
-                if (ext_flag == TRUE) {
-                        arr_strlcat(cover_filename, temp_filename);
-                        cover_filename_reasonable = TRUE;
-                }
+	GDir * dir;
+	const gchar * name;
+	GSList * thumbs = NULL;
+	GSList * node;
+	off_t total = 0;
 
-        }
+	if ((dir = g_dir_open(thumb_dir, 0, NULL)) == NULL) {
+		return;
+	}
 
-        if (cover_filename_reasonable == TRUE) {
-                return cover_filename;
-        }
+	while ((name = g_dir_read_name(dir)) != NULL) {
+
+		cover_thumbnail_t * thumb;
+		struct stat st;
+		gchar * path;
+
+		if (!g_str_has_suffix(name, ".png")) {
+			continue;
+		}
+		path = g_build_filename(thumb_dir, name, NULL);
+		if (g_stat(path, &st) != 0) {
+			g_free(path);
+			continue;
+		}
+		thumb = g_new(cover_thumbnail_t, 1);
+		thumb->path = path;
+		thumb->used = (st.st_atime > st.st_mtime) ? st.st_atime : st.st_mtime;
+		thumb->size = st.st_size;
+		thumbs = g_slist_prepend(thumbs, thumb);
+		total += st.st_size;
+	}
+	g_dir_close(dir);
+
+	/* make some room, so that this doesn't run again right away */
+	if (total > COVER_THUMBNAIL_BYTES) {
+		thumbs = g_slist_sort(thumbs, cover_thumbnail_cmp);
+		for (node = thumbs; node && total > COVER_THUMBNAIL_BYTES / 4 * 3; node = node->next) {
+			cover_thumbnail_t * thumb = (cover_thumbnail_t *)node->data;
+			if (g_unlink(thumb->path) == 0) {
+				total -= thumb->size;
+			}
+		}
+	}
+
+	for (node = thumbs; node; node = node->next) {
+		g_free(((cover_thumbnail_t *)node->data)->path);
+		g_free(node->data);
+	}
+	g_slist_free(thumbs);
+}
+
+static gchar *
+cover_thumbnail_path(const gchar * cover, gint width, gint height) {
+
+	gchar * md5 = g_compute_checksum_for_string(G_CHECKSUM_MD5, cover, -1);
+	gchar name[64];
+	gchar * path;
+
+	arr_snprintf(name, "%s-%dx%d.png", md5, width, height);
+	path = g_build_filename(options.confdir, "covers", name, NULL);
+	g_free(md5);
+
+	return path;
+}
+
+/* Loads cover scaled to fit dest_width x dest_height, going through the
+ * on-disk thumbnail cache if that is enabled. Safe to call from any
+ * thread. */
+static GdkPixbuf *
+cover_load_scaled(const gchar * cover, gint dest_width, gint dest_height) {
 
-        return NULL;
+	GdkPixbuf * pixbuf;
+	gchar * thumb = NULL;
+	gint width, height;
+	gint scaled_width, scaled_height;
+
+	if (gdk_pixbuf_get_file_info(cover, &width, &height) == NULL ||
+	    width <= 0 || height <= 0) {
+		return NULL;
+	}
+	cover_scaled_size(width, height, dest_width, dest_height, &scaled_width, &scaled_height);
+
+	if (options.cover_thumbnail_cache) {
+		thumb = cover_thumbnail_path(cover, scaled_width, scaled_height);
+		if (cover_mtime(thumb) >= cover_mtime(cover) &&
+		    (pixbuf = gdk_pixbuf_new_from_file(thumb, NULL)) != NULL) {
+			g_free(thumb);
+			return pixbuf;
+		}
+	}
+
+	pixbuf = gdk_pixbuf_new_from_file_at_scale(cover, scaled_width, scaled_height, FALSE, NULL);
+
+	if (pixbuf != NULL && thumb != NULL) {
+		gchar * thumb_dir = g_path_get_dirname(thumb);
+		if (g_mkdir_with_parents(thumb_dir, S_IRUSR | S_IWUSR | S_IXUSR) == 0 &&
+		    gdk_pixbuf_save(pixbuf, thumb, "png", NULL, NULL) &&
+		    g_atomic_int_dec_and_test(&cover_thumbnail_countdown)) {
+			g_atomic_int_set(&cover_thumbnail_countdown, COVER_THUMBNAIL_PRUNE_EVERY);
+			cover_thumbnail_prune(thumb_dir);
+		}
+		g_free(thumb_dir);
+	}
+
+	g_free(thumb);
+	return pixbuf;
+}
+
+static void
+cover_entry_free(cover_entry_t * entry) {
+
+	GSList * node;
+
+	for (node = entry->scaled; node; node = node->next) {
+		cover_scaled_t * scaled = (cover_scaled_t *)node->data;
+		g_object_unref(scaled->pixbuf);
+		g_free(scaled);
+	}
+	g_slist_free(entry->scaled);
+	g_free(entry->dir);
+	g_free(entry->cover);
+	g_free(entry);
+}
+
+static cover_entry_t *
+cover_cache_lookup(const gchar * dir) {
+
+	GList * node;
+
+	for (node = cover_cache; node; node = node->next) {
+
+		cover_entry_t * entry = (cover_entry_t *)node->data;
+
+		if (strcmp(entry->dir, dir)) {
+			continue;
+		}
+
+		cover_cache = g_list_delete_link(cover_cache, node);
+		if (cover_mtime(dir) != entry->dir_mtime) {
+			--cover_cache_length;
+			cover_entry_free(entry);
+			return NULL;
+		}
+		cover_cache = g_list_prepend(cover_cache, entry);
+		return entry;
+	}
+
+	return NULL;
+}
+
+static cover_entry_t *
+cover_cache_insert(const gchar * dir, time_t dir_mtime, gchar * cover) {
+
+	cover_entry_t * entry = g_new0(cover_entry_t, 1);
+
+	entry->dir = g_strdup(dir);
+	entry->dir_mtime = dir_mtime;
+	entry->cover = cover;
+
+	cover_cache = g_list_prepend(cover_cache, entry);
+	if (++cover_cache_length > COVER_CACHE_DIRS) {
+		GList * last = g_list_last(cover_cache);
+		cover_entry_free((cover_entry_t *)last->data);
+		cover_cache = g_list_delete_link(cover_cache, last);
+		--cover_cache_length;
+	}
+
+	return entry;
+}
+
+static cover_entry_t *
+cover_cache_get(const gchar * dir) {
+
+	cover_entry_t * entry;
+	time_t dir_mtime;
+
+	if ((entry = cover_cache_lookup(dir)) != NULL) {
+		return entry;
+	}
+
+	dir_mtime = cover_mtime(dir);
+	return cover_cache_insert(dir, dir_mtime, cover_scan_dir(dir));
+}
+
+static GdkPixbuf *
+cover_entry_find_scaled(cover_entry_t * entry, gint width, gint height) {
+
+	GSList * node;
+
+	for (node = entry->scaled; node; node = node->next) {
+		cover_scaled_t * scaled = (cover_scaled_t *)node->data;
+		if (scaled->width == width && scaled->height == height) {
+			return scaled->pixbuf;
+		}
+	}
+	return NULL;
+}
+
+/* takes over the reference to pixbuf */
+static void
+cover_entry_add_scaled(cover_entry_t * entry, gint width, gint height, GdkPixbuf * pixbuf) {
+
+	cover_scaled_t * scaled = g_new(cover_scaled_t, 1);
+
+	scaled->width = width;
+	scaled->height = height;
+	scaled->pixbuf = pixbuf;
+	entry->scaled = g_slist_prepend(entry->scaled, scaled);
+
+	if (g_slist_length(entry->scaled) > COVER_CACHE_SCALED) {
+		GSList * last = g_slist_last(entry->scaled);
+		scaled = (cover_scaled_t *)last->data;
+		g_object_unref(scaled->pixbuf);
+		g_free(scaled);
+		entry->scaled = g_slist_delete_link(entry->scaled, last);
+	}
+}
+
+static GdkPixbuf *
+cover_entry_get_scaled(cover_entry_t * entry, gint width, gint height) {
+
+	GdkPixbuf * pixbuf;
+
+	if (entry->cover == NULL) {
+		return NULL;
+	}
+
+	if ((pixbuf = cover_entry_find_scaled(entry, width, height)) != NULL) {
+		return pixbuf;
+	}
+
+	if ((pixbuf = cover_load_scaled(entry->cover, width, height)) == NULL) {
+		return NULL;
+	}
+
+	cover_entry_add_scaled(entry, width, height, pixbuf);
+	return pixbuf;
+}
+
+gchar *
+find_cover_filename(gchar *song_filename) {
+
+        static gchar cover_filename[PATH_MAX];
+	cover_entry_t * entry;
+
+	entry = cover_cache_get(get_song_path(song_filename));
+	if (entry->cover == NULL) {
+		return NULL;
+	}
+
+	arr_strlcpy(cover_filename, entry->cover);
+	return cover_filename;
+}
+
+static gboolean
+cover_prefetch_done(gpointer data) {
+
+	cover_prefetch_t * prefetch = (cover_prefetch_t *)data;
+	cover_entry_t * entry;
+
+	/* a stale dir_mtime makes the next lookup drop the entry again */
+	if ((entry = cover_cache_lookup(prefetch->dir)) == NULL) {
+		entry = cover_cache_insert(prefetch->dir, prefetch->dir_mtime, prefetch->cover);
+		prefetch->cover = NULL;
+	}
+
+	if (prefetch->pixbuf != NULL &&
+	    cover_entry_find_scaled(entry, prefetch->width, prefetch->height) == NULL) {
+		cover_entry_add_scaled(entry, prefetch->width, prefetch->height, prefetch->pixbuf);
+		prefetch->pixbuf = NULL;
+	}
+
+	if (cover_prefetch_dir == prefetch->dir) {
+		cover_prefetch_dir = NULL;
+	}
+	if (prefetch->pixbuf != NULL) {
+		g_object_unref(prefetch->pixbuf);
+	}
+	g_free(prefetch->cover);
+	g_free(prefetch->dir);
+	g_free(prefetch);
+
+	return FALSE;
+}
+
+static void *
+cover_prefetch_thread(void * arg) {
+
+	cover_prefetch_t * prefetch = (cover_prefetch_t *)arg;
+
+	AQUALUNG_THREAD_DETACH();
+
+	if (!prefetch->scanned) {
+		prefetch->dir_mtime = cover_mtime(prefetch->dir);
+		prefetch->cover = cover_scan_dir(prefetch->dir);
+		prefetch->scanned = TRUE;
+	}
+
+	if (prefetch->cover != NULL) {
+		prefetch->pixbuf = cover_load_scaled(prefetch->cover, prefetch->width, prefetch->height);
+	}
+
+	aqualung_idle_add(cover_prefetch_done, prefetch);
+
+	return NULL;
+}
+
+/* Looks up and decodes the cover for song_filename in the background,
+ * so that displaying it at width x height later is a cache hit. */
+void
+cover_prefetch(gchar * song_filename, gint width, gint height) {
+
+	cover_prefetch_t * prefetch;
+	cover_entry_t * entry;
+	gchar * dir;
+
+	if (song_filename == NULL || song_filename[0] == '\0') {
+		return;
+	}
+
+	dir = get_song_path(song_filename);
+	if (dir[0] == '\0' || (cover_prefetch_dir != NULL && !strcmp(cover_prefetch_dir, dir))) {
+		return;
+	}
+
+	prefetch = g_new0(cover_prefetch_t, 1);
+	prefetch->width = width;
+	prefetch->height = height;
+
+	if ((entry = cover_cache_lookup(dir)) != NULL) {
+		if (entry->cover == NULL || cover_entry_find_scaled(entry, width, height) != NULL) {
+			g_free(prefetch);
+			return;
+		}
+		prefetch->cover = g_strdup(entry->cover);
+		prefetch->dir_mtime = entry->dir_mtime;
+		prefetch->scanned = TRUE;
+	}
+
+	prefetch->dir = cover_prefetch_dir = g_strdup(dir);
+
+	AQUALUNG_THREAD_CREATE(prefetch->thread_id, NULL, cover_prefetch_thread, prefetch)
 }
 
 
@@ -335,54 +738,25 @@ display_zoomed_cover_from_binary(GtkWidget *window, GtkWidget *event_area, void
 	}
 
 	create_zoomed_cover_window(&size, window, &image_area);
-	display_cover_from_binary(image_area, event_area, NULL, size, size, data, length, FALSE, FALSE);
-	gtk_widget_set_size_request(cover_window, calculated_width, calculated_height);
-	gtk_widget_show(cover_window);
+	/* the window is shown once the picture is decoded */
+	cover_blob_display(image_area, event_area, NULL, cover_window, size, size, data, length, FALSE, FALSE);
 }
 
 
-void 
-display_cover_from_pixbuf(GtkWidget *image_area, GtkWidget *event_area, GtkWidget *align,
-			  gint dest_width, gint dest_height,
-			  GdkPixbuf * cover_pixbuf, gboolean hide, gboolean bevel) {
-
-        GdkPixbuf * cover_pixbuf_scaled;
-	gint width = gdk_pixbuf_get_width(cover_pixbuf);
-	gint height = gdk_pixbuf_get_height(cover_pixbuf);
-        gint scaled_width, scaled_height;
-
-	if (cover_pixbuf == NULL) {
-		return;
-	}
+/* shows an already scaled pixbuf, framed, in image_area */
+static void
+display_scaled_cover(GtkWidget *image_area, GtkWidget *event_area, GtkWidget *align,
+		     GdkPixbuf * cover_pixbuf_scaled, gboolean hide, gboolean bevel) {
 
-        calculated_width = dest_width;
-        calculated_height = dest_height;
+	gint scaled_width = gdk_pixbuf_get_width(cover_pixbuf_scaled);
+	gint scaled_height = gdk_pixbuf_get_height(cover_pixbuf_scaled);
 
-	/* don't scale when orginal size is smaller than cover defaults */
-	
-	scaled_width =  dest_width;
-	scaled_height = dest_height;
-	
-	if (width >= height) {
-		scaled_height = (height * dest_height) / width;
-	} else {
-		scaled_width = (width * dest_width) / height;
-	}
-	
-	cover_pixbuf_scaled = gdk_pixbuf_scale_simple(cover_pixbuf,
-						      scaled_width, scaled_height,
-						      GDK_INTERP_TILES);
-	if (cover_pixbuf_scaled == NULL) {
-		return;
-	}
-	
 	draw_cover_frame(cover_pixbuf_scaled, scaled_width, scaled_height, bevel);
 	
 	calculated_width = scaled_width;
 	calculated_height = scaled_height;
 	
 	gtk_image_set_from_pixbuf(GTK_IMAGE(image_area), cover_pixbuf_scaled);
-	g_object_unref(cover_pixbuf_scaled);
 	
 	if (!cover_show_flag && hide == TRUE) {
 		cover_show_flag = 1;      
@@ -392,13 +766,12 @@ display_cover_from_pixbuf(GtkWidget *image_area, GtkWidget *event_area, GtkWidge
 			gtk_widget_show(align);
 		}
 	}
-
-	/* don't unref cover_pixbuf that was passed in */
 }
 
 void
 hide_cover(GtkWidget *image_area, GtkWidget *event_area, GtkWidget *align) {
 
+	cover_claim_area(image_area);
 	cover_show_flag = 0;
 	gtk_widget_hide(image_area);
 	gtk_widget_hide(event_area);
@@ -412,9 +785,10 @@ display_cover(GtkWidget *image_area, GtkWidget *event_area, GtkWidget *align,
 	      gint dest_width, gint dest_height,
               gchar *song_filename, gboolean hide, gboolean bevel) {
 
-        GdkPixbuf * cover_pixbuf = NULL;
-        gchar cover_filename[PATH_MAX];
-	char * filename = NULL;
+	cover_entry_t * entry;
+        GdkPixbuf * cover_pixbuf;
+
+	cover_claim_area(image_area);
 
         if (strlen(song_filename) == 0) {
 		if (hide == TRUE) {
@@ -423,19 +797,15 @@ display_cover(GtkWidget *image_area, GtkWidget *event_area, GtkWidget *align,
 		return;
 	}
 
-	if ((filename = find_cover_filename(song_filename)) == NULL) {
-		if (hide == TRUE) {
-			hide_cover(image_area, event_area, align);
-		}
-		return;
-	}
+	entry = cover_cache_get(get_song_path(song_filename));
 
-	arr_strlcpy(cover_filename, filename);
+	if ((cover_pixbuf = cover_entry_get_scaled(entry, dest_width, dest_height)) != NULL) {
+		/* the cached copy stays frameless */
+		cover_pixbuf = gdk_pixbuf_copy(cover_pixbuf);
+	}
 
-	if ((cover_pixbuf = gdk_pixbuf_new_from_file(cover_filename, NULL)) != NULL) {
-		display_cover_from_pixbuf(image_area, event_area, align,
-					  dest_width, dest_height,
-					  cover_pixbuf, hide, bevel);
+	if (cover_pixbuf != NULL) {
+		display_scaled_cover(image_area, event_area, align, cover_pixbuf, hide, bevel);
 		g_object_unref(cover_pixbuf);
 	} else if (hide == TRUE) {
 		hide_cover(image_area, event_area, align);
@@ -443,40 +813,319 @@ display_cover(GtkWidget *image_area, GtkWidget *event_area, GtkWidget *align,
 }
 
 
-void 
-display_cover_from_binary(GtkWidget *image_area, GtkWidget *event_area, GtkWidget *align,
-			  gint dest_width, gint dest_height,
-			  void * data, int length, gboolean hide, gboolean bevel) {
+/* Embedded pictures are decoded and scaled in a helper thread; the
+ * results are kept in a small cache keyed by a hash of the picture
+ * data, so the tracks of an album share one decode. Every display
+ * request claims its image area, and a decode finishing after the
+ * area was claimed by a later request is only cached, not shown.
+ */
+
+#define COVER_BLOB_CACHE_SIZE  16
+#define COVER_BLOB_HASH_SPAN   4096
+
+typedef struct {
+	guint32 hash;
+	int length;
+	gint width;
+	gint height;
+	GdkPixbuf * pixbuf;   /* scaled, without frame */
+} cover_blob_t;
+
+typedef struct {
+	AQUALUNG_THREAD_DECLARE(thread_id)
+	guint32 hash;
+	int length;
+	void * data;
+	gint width;
+	gint height;
+	GdkPixbuf * pixbuf;
+	guint serial;
+	gboolean hide;
+	gboolean bevel;
+	/* weak pointers, NULL once the widget is gone */
+	GtkWidget * image_area;
+	GtkWidget * event_area;
+	GtkWidget * align;
+	GtkWidget * window;
+} cover_blob_job_t;
+
+static GList * cover_blob_cache = NULL;  /* most recently used first */
+static GList * cover_blob_jobs = NULL;   /* decodes in progress */
+static guint cover_serial = 0;
+
+
+static guint
+cover_claim_area(GtkWidget * image_area) {
+
+	++cover_serial;
+	g_object_set_data(G_OBJECT(image_area), "cover_serial", GUINT_TO_POINTER(cover_serial));
+	return cover_serial;
+}
 
-        GdkPixbuf * cover_pixbuf = NULL;
-	GdkPixbufLoader * loader;
+static guint32
+cover_fnv1a(guint32 hash, const guchar * p, int n) {
 
-        if (data == NULL) {
+	int i;
+
+	for (i = 0; i < n; i++) {
+		hash = (hash ^ p[i]) * 16777619U;
+	}
+	return hash;
+}
+
+/* Hashes the head and tail of the picture plus a sparse sample of the
+ * rest, which is enough to tell covers apart without reading megabytes
+ * on the GUI thread. */
+static guint32
+cover_blob_hash(const guchar * data, int length) {
+
+	guint32 hash = 2166136261U;
+	int n = MIN(length, COVER_BLOB_HASH_SPAN);
+	int i, step;
+
+	hash = cover_fnv1a(hash, data, n);
+	if (length > 2 * COVER_BLOB_HASH_SPAN) {
+		step = (length - 2 * COVER_BLOB_HASH_SPAN) / 64 + 1;
+		for (i = COVER_BLOB_HASH_SPAN; i < length - COVER_BLOB_HASH_SPAN; i += step) {
+			hash = cover_fnv1a(hash, data + i, 1);
+		}
+	}
+	if (length > n) {
+		n = MIN(length - n, COVER_BLOB_HASH_SPAN);
+		hash = cover_fnv1a(hash, data + length - n, n);
+	}
+
+	return hash ^ (guint32)length;
+}
+
+static GdkPixbuf *
+cover_blob_cache_lookup(guint32 hash, int length, gint width, gint height) {
+
+	GList * node;
+
+	for (node = cover_blob_cache; node; node = node->next) {
+
+		cover_blob_t * blob = (cover_blob_t *)node->data;
+
+		if (blob->hash == hash && blob->length == length &&
+		    blob->width == width && blob->height == height) {
+			cover_blob_cache = g_list_delete_link(cover_blob_cache, node);
+			cover_blob_cache = g_list_prepend(cover_blob_cache, blob);
+			return blob->pixbuf;
+		}
+	}
+	return NULL;
+}
+
+static void
+cover_blob_cache_insert(guint32 hash, int length, gint width, gint height, GdkPixbuf * pixbuf) {
+
+	cover_blob_t * blob = g_new(cover_blob_t, 1);
+
+	blob->hash = hash;
+	blob->length = length;
+	blob->width = width;
+	blob->height = height;
+	blob->pixbuf = g_object_ref(pixbuf);
+	cover_blob_cache = g_list_prepend(cover_blob_cache, blob);
+
+	if (g_list_length(cover_blob_cache) > COVER_BLOB_CACHE_SIZE) {
+		GList * last = g_list_last(cover_blob_cache);
+		blob = (cover_blob_t *)last->data;
+		g_object_unref(blob->pixbuf);
+		g_free(blob);
+		cover_blob_cache = g_list_delete_link(cover_blob_cache, last);
+	}
+}
+
+static void
+cover_blob_show(GtkWidget *image_area, GtkWidget *event_area, GtkWidget *align, GtkWidget *window,
+		GdkPixbuf * pixbuf, gboolean hide, gboolean bevel) {
+
+	/* the cached copy stays frameless */
+	GdkPixbuf * framed = gdk_pixbuf_copy(pixbuf);
+
+	if (framed == NULL) {
 		return;
 	}
 
+	display_scaled_cover(image_area, event_area, align, framed, hide, bevel);
+	g_object_unref(framed);
+
+	if (window != NULL) {
+		gtk_widget_set_size_request(window, calculated_width, calculated_height);
+		gtk_widget_show(window);
+	}
+}
+
+static void
+cover_blob_job_watch(cover_blob_job_t * job, gboolean watch) {
+
+	GtkWidget ** widgets[] = { &job->image_area, &job->event_area, &job->align, &job->window };
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(widgets); i++) {
+		if (*widgets[i] == NULL) {
+			continue;
+		}
+		if (watch) {
+			g_object_add_weak_pointer(G_OBJECT(*widgets[i]), (gpointer *)widgets[i]);
+		} else {
+			g_object_remove_weak_pointer(G_OBJECT(*widgets[i]), (gpointer *)widgets[i]);
+		}
+	}
+}
+
+static gboolean
+cover_blob_done(gpointer data) {
+
+	cover_blob_job_t * job = (cover_blob_job_t *)data;
+
+	cover_blob_jobs = g_list_remove(cover_blob_jobs, job);
+
+	if (job->pixbuf != NULL) {
+		cover_blob_cache_insert(job->hash, job->length, job->width, job->height, job->pixbuf);
+	}
+
+	if (job->image_area != NULL && job->event_area != NULL &&
+	    GPOINTER_TO_UINT(g_object_get_data(G_OBJECT(job->image_area), "cover_serial")) == job->serial) {
+
+		if (job->pixbuf != NULL) {
+			cover_blob_show(job->image_area, job->event_area, job->align, job->window,
+					job->pixbuf, job->hide, job->bevel);
+		} else {
+			if (job->hide == TRUE) {
+				hide_cover(job->image_area, job->event_area, job->align);
+			}
+			if (job->window != NULL) {
+				gtk_widget_destroy(job->window);
+			}
+		}
+	}
+
+	cover_blob_job_watch(job, FALSE);
+	if (job->pixbuf != NULL) {
+		g_object_unref(job->pixbuf);
+	}
+	g_free(job);
+
+	return FALSE;
+}
+
+static void
+cover_blob_size_prepared(GdkPixbufLoader * loader, gint width, gint height, gpointer data) {
+
+	cover_blob_job_t * job = (cover_blob_job_t *)data;
+	gint scaled_width, scaled_height;
+
+	if (width <= 0 || height <= 0) {
+		return;
+	}
+
+	cover_scaled_size(width, height, job->width, job->height, &scaled_width, &scaled_height);
+	if (scaled_width > 0 && scaled_height > 0) {
+		gdk_pixbuf_loader_set_size(loader, scaled_width, scaled_height);
+	}
+}
+
+static void *
+cover_blob_thread(void * arg) {
+
+	cover_blob_job_t * job = (cover_blob_job_t *)arg;
+	GdkPixbufLoader * loader;
+
+	AQUALUNG_THREAD_DETACH();
+
+	/* let the loader scale while decoding */
 	loader = gdk_pixbuf_loader_new();
-	if (gdk_pixbuf_loader_write(loader, data, length, NULL) != TRUE) {
+	g_signal_connect(G_OBJECT(loader), "size-prepared", G_CALLBACK(cover_blob_size_prepared), job);
+
+	if (gdk_pixbuf_loader_write(loader, job->data, job->length, NULL) != TRUE) {
 		fprintf(stderr, "display_cover_from_binary: failed to load image #1\n");
-		g_object_unref(loader);
+		gdk_pixbuf_loader_close(loader, NULL);
+	} else if (gdk_pixbuf_loader_close(loader, NULL) != TRUE) {
+		fprintf(stderr, "display_cover_from_binary: failed to load image #2\n");
+	} else if ((job->pixbuf = gdk_pixbuf_loader_get_pixbuf(loader)) != NULL) {
+		/* the pixbuf is owned by loader */
+		g_object_ref(job->pixbuf);
+	}
+	g_object_unref(loader);
+
+	free(job->data);
+	job->data = NULL;
+
+	aqualung_idle_add(cover_blob_done, job);
+
+	return NULL;
+}
+
+static void
+cover_blob_display(GtkWidget *image_area, GtkWidget *event_area, GtkWidget *align,
+		   GtkWidget *window, gint dest_width, gint dest_height,
+		   void * data, int length, gboolean hide, gboolean bevel) {
+
+	cover_blob_job_t * job;
+	GdkPixbuf * pixbuf;
+	guint32 hash;
+	guint serial;
+	GList * node;
+
+	serial = cover_claim_area(image_area);
+	hash = cover_blob_hash((guchar *)data, length);
+
+	if ((pixbuf = cover_blob_cache_lookup(hash, length, dest_width, dest_height)) != NULL) {
+		cover_blob_show(image_area, event_area, align, window, pixbuf, hide, bevel);
 		return;
 	}
 
-	if (gdk_pixbuf_loader_close(loader, NULL) != TRUE) {
-		fprintf(stderr, "display_cover_from_binary: failed to load image #2\n");
-		g_object_unref(loader);
+	/* the same picture is already being decoded for this area */
+	for (node = cover_blob_jobs; node; node = node->next) {
+		job = (cover_blob_job_t *)node->data;
+		if (job->image_area == image_area && job->hash == hash && job->length == length &&
+		    job->width == dest_width && job->height == dest_height) {
+			job->serial = serial;
+			job->hide = hide;
+			job->bevel = bevel;
+			return;
+		}
+	}
+
+	job = g_new0(cover_blob_job_t, 1);
+	if ((job->data = malloc(length)) == NULL) {
+		fprintf(stderr, "display_cover_from_binary: malloc error\n");
+		g_free(job);
 		return;
 	}
+	memcpy(job->data, data, length);
+
+	job->hash = hash;
+	job->length = length;
+	job->width = dest_width;
+	job->height = dest_height;
+	job->serial = serial;
+	job->hide = hide;
+	job->bevel = bevel;
+	job->image_area = image_area;
+	job->event_area = event_area;
+	job->align = align;
+	job->window = window;
+	cover_blob_job_watch(job, TRUE);
+
+	cover_blob_jobs = g_list_prepend(cover_blob_jobs, job);
+	AQUALUNG_THREAD_CREATE(job->thread_id, NULL, cover_blob_thread, job)
+}
 
-	if ((cover_pixbuf = gdk_pixbuf_loader_get_pixbuf(loader)) != NULL) {
-		display_cover_from_pixbuf(image_area, event_area, align,
-					  dest_width, dest_height,
-					  cover_pixbuf, hide, bevel);
-		/* cover_pixbuf is owned by loader, so don't unref that manually */
-		g_object_unref(loader);
-	} else if (hide == TRUE) {
-		hide_cover(image_area, event_area, align);
-        }
+void 
+display_cover_from_binary(GtkWidget *image_area, GtkWidget *event_area, GtkWidget *align,
+			  gint dest_width, gint dest_height,
+			  void * data, int length, gboolean hide, gboolean bevel) {
+
+        if (data == NULL || length <= 0) {
+		return;
+	}
+
+	cover_blob_display(image_area, event_area, align, NULL,
+			   dest_width, dest_height, data, length, hide, bevel);
 }
 
 
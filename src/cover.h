@@ -37,10 +37,12 @@ void    display_cover           (GtkWidget *image_area, GtkWidget *event_area, G
 void    display_cover_from_binary(GtkWidget *image_area, GtkWidget *event_area, GtkWidget *align,
 				  gint dest_width, gint dest_height,
 				  void * data, int length, gboolean hide, gboolean bevel);
+void    hide_cover              (GtkWidget *image_area, GtkWidget *event_area, GtkWidget *align);
 void    display_zoomed_cover    (GtkWidget *window, GtkWidget *event_area, gchar *song_filename);
 void    display_zoomed_cover_from_binary(GtkWidget *window, GtkWidget *event_area, void * data, int length);
 void    insert_cover            (GtkTreeIter * tree_iter, GtkTextIter * text_iter, GtkTextBuffer * buffer);
 gchar * find_cover_filename     (gchar *song_filename);
+void    cover_prefetch          (gchar *song_filename, gint width, gint height);
 
 
 #endif /* AQUALUNG_COVER_H */
@@ -0,0 +1,325 @@
+/*                                                     -*- linux-c -*-
+    Copyright (C) 2026 Aqualung contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+    $Id$
+*/
+
+/* Decoder benchmark: decode every file below a corpus directory through
+ * the file_decoder API and print tab separated results, one "file" line
+ * per file and one "format" line per decoder format.
+ *
+ *   make -C src decoder_bench
+ *   src/decoder_bench [-n seeks] [-b frames] [-S seed] corpus_dir > results.tsv
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "../options.h"
+#include "file_decoder.h"
+
+
+#define BENCH_MAX_SEEKS 1000
+
+
+options_t options;
+
+/* the decoders only use this for RVA, which the benchmark leaves at 0 dB */
+float
+rva_from_replaygain(float rg) {
+
+	return 0.0f;
+}
+
+#ifdef HAVE_CDDA
+/* audio CDs are not part of a corpus directory */
+decoder_t *
+cdda_decoder_init(file_decoder_t * fdec) {
+
+	return NULL;
+}
+#endif /* HAVE_CDDA */
+
+
+typedef struct {
+	char * format;
+	int files;
+	double seconds;   /* of audio */
+	double open_ms;
+	double decode_s;
+	double in_bytes;
+	double * seek_ms;
+	int n_seeks;
+} format_stats_t;
+
+static format_stats_t * formats;
+static int n_formats;
+
+static int n_seeks = 20;
+static int blocksize = 4096;
+static unsigned int seed = 1;
+static float * buf;
+
+
+static double
+now(void) {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static long
+peak_rss_kb(void) {
+
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_maxrss;
+}
+
+
+static int
+cmp_double(const void * a, const void * b) {
+
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+
+/* v must be sorted */
+static double
+percentile(double * v, int n, double p) {
+
+	if (n == 0) {
+		return 0.0;
+	}
+	return v[(int)(p * (n - 1) + 0.5)];
+}
+
+
+static format_stats_t *
+format_stats(char * format) {
+
+	format_stats_t * fs;
+	int i;
+
+	for (i = 0; i < n_formats; i++) {
+		if (strcmp(formats[i].format, format) == 0) {
+			return formats + i;
+		}
+	}
+
+	formats = realloc(formats, (n_formats + 1) * sizeof(format_stats_t));
+	fs = formats + n_formats++;
+	memset(fs, 0, sizeof(format_stats_t));
+	fs->format = strdup(format);
+	return fs;
+}
+
+
+static void
+bench_file(char * path, off_t size) {
+
+	file_decoder_t * fdec;
+	decoder_t * dec;
+	format_stats_t * fs;
+	double t, open_ms, decode_s, seconds;
+	double seek_ms[BENCH_MAX_SEEKS];
+	unsigned long long frames = 0;
+	unsigned long long copied;
+	unsigned int n;
+	int i, ns = 0;
+
+	if ((fdec = file_decoder_new()) == NULL) {
+		return;
+	}
+
+	t = now();
+	if (file_decoder_open(fdec, path)) {
+		file_decoder_delete(fdec);
+		return;
+	}
+	open_ms = (now() - t) * 1000.0;
+
+	if (fdec->fileinfo.sample_rate == 0) {
+		fprintf(stderr, "decoder_bench: %s: zero sample rate, skipped\n", path);
+		file_decoder_delete(fdec);
+		return;
+	}
+
+	buf = realloc(buf, blocksize * MAX_CHANNELS * sizeof(float));
+
+	t = now();
+	while ((n = file_decoder_read(fdec, buf, blocksize)) > 0) {
+		frames += n;
+	}
+	decode_s = now() - t;
+	seconds = (double)frames / fdec->fileinfo.sample_rate;
+
+	dec = (decoder_t *)fdec->pdec;
+	copied = dec->out.frames_copied;
+
+	/* time from a random seek until the first block is back */
+	if (fdec->fileinfo.total_samples > 0 && !fdec->is_stream) {
+		for (i = 0; i < n_seeks; i++) {
+			unsigned long long pos = (unsigned long long)
+				((double)rand_r(&seed) / RAND_MAX * (fdec->fileinfo.total_samples - 1));
+			t = now();
+			file_decoder_seek(fdec, pos);
+			file_decoder_read(fdec, buf, blocksize);
+			seek_ms[ns++] = (now() - t) * 1000.0;
+		}
+		qsort(seek_ms, ns, sizeof(double), cmp_double);
+	}
+
+	printf("file\t%s\t%s\t%d\t%lu\t%.3f\t%.3f\t%.3f\t%.1f\t%.2f\t%.3f\t%.3f\t%.3f\t%.1f\t%ld\n",
+	       path, fdec->fileinfo.format_str, fdec->fileinfo.channels,
+	       fdec->fileinfo.sample_rate, seconds, open_ms, decode_s,
+	       (decode_s > 0.0) ? seconds / decode_s : 0.0,
+	       (decode_s > 0.0) ? size / decode_s / 1e6 : 0.0,
+	       percentile(seek_ms, ns, 0.5), percentile(seek_ms, ns, 0.9),
+	       percentile(seek_ms, ns, 1.0),
+	       (frames > 0) ? 100.0 * copied / frames : 0.0,
+	       peak_rss_kb());
+	fflush(stdout);
+
+	fs = format_stats(fdec->fileinfo.format_str);
+	fs->files++;
+	fs->seconds += seconds;
+	fs->open_ms += open_ms;
+	fs->decode_s += decode_s;
+	fs->in_bytes += size;
+	fs->seek_ms = realloc(fs->seek_ms, (fs->n_seeks + ns) * sizeof(double));
+	memcpy(fs->seek_ms + fs->n_seeks, seek_ms, ns * sizeof(double));
+	fs->n_seeks += ns;
+
+	file_decoder_delete(fdec);
+}
+
+
+static void
+bench_dir(char * dir) {
+
+	DIR * d;
+	struct dirent * entry;
+	struct stat st;
+	char path[MAXLEN];
+
+	if ((d = opendir(dir)) == NULL) {
+		fprintf(stderr, "decoder_bench: cannot open directory %s\n", dir);
+		return;
+	}
+
+	while ((entry = readdir(d)) != NULL) {
+		if (entry->d_name[0] == '.') {
+			continue;
+		}
+		arr_snprintf(path, "%s/%s", dir, entry->d_name);
+		if (stat(path, &st) != 0) {
+			continue;
+		}
+		if (S_ISDIR(st.st_mode)) {
+			bench_dir(path);
+		} else if (S_ISREG(st.st_mode)) {
+			bench_file(path, st.st_size);
+		}
+	}
+	closedir(d);
+}
+
+
+static void
+usage(void) {
+
+	fprintf(stderr,
+		"usage: decoder_bench [-n seeks] [-b frames] [-S seed] corpus_dir\n"
+		"  -n  random seeks per file (default 20, at most %d)\n"
+		"  -b  frames per file_decoder_read() call (default 4096)\n"
+		"  -S  seed for the seek positions (default 1)\n",
+		BENCH_MAX_SEEKS);
+}
+
+
+int
+main(int argc, char ** argv) {
+
+	int c, i;
+
+	while ((c = getopt(argc, argv, "n:b:S:h")) != -1) {
+		switch (c) {
+		case 'n':
+			n_seeks = atoi(optarg);
+			break;
+		case 'b':
+			blocksize = atoi(optarg);
+			break;
+		case 'S':
+			seed = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+	if (optind != argc - 1 || n_seeks < 0 || n_seeks > BENCH_MAX_SEEKS || blocksize < 1) {
+		usage();
+		return 1;
+	}
+
+	file_decoder_init();
+
+	printf("#file\tpath\tformat\tchannels\trate\tseconds\topen_ms\tdecode_s"
+	       "\tx_realtime\tin_MBps\tseek_p50_ms\tseek_p90_ms\tseek_max_ms"
+	       "\tcopied_pct\tpeak_rss_kb\n");
+	bench_dir(argv[optind]);
+
+	printf("#format\tformat\tfiles\tseconds\topen_ms_avg\tx_realtime\tin_MBps"
+	       "\tseek_p50_ms\tseek_p90_ms\tseek_p99_ms\tseek_max_ms\n");
+	for (i = 0; i < n_formats; i++) {
+		format_stats_t * fs = formats + i;
+
+		qsort(fs->seek_ms, fs->n_seeks, sizeof(double), cmp_double);
+		printf("format\t%s\t%d\t%.3f\t%.3f\t%.1f\t%.2f\t%.3f\t%.3f\t%.3f\t%.3f\n",
+		       fs->format, fs->files, fs->seconds, fs->open_ms / fs->files,
+		       (fs->decode_s > 0.0) ? fs->seconds / fs->decode_s : 0.0,
+		       (fs->decode_s > 0.0) ? fs->in_bytes / fs->decode_s / 1e6 : 0.0,
+		       percentile(fs->seek_ms, fs->n_seeks, 0.5),
+		       percentile(fs->seek_ms, fs->n_seeks, 0.9),
+		       percentile(fs->seek_ms, fs->n_seeks, 0.99),
+		       percentile(fs->seek_ms, fs->n_seeks, 1.0));
+	}
+	printf("peak_rss_kb\t%ld\n", peak_rss_kb());
+
+	return 0;
+}
+
+
+// vim: shiftwidth=8:tabstop=8:softtabstop=8 :
@@ -31,13 +31,9 @@
 #include "../metadata.h"
 #include "../metadata_api.h"
 #include "../metadata_flac.h"
-#include "../rb.h"
 #include "dec_flac.h"
 
 
-extern size_t sample_size;
-
-
 /* FLAC write callback */
 FLAC__StreamDecoderWriteStatus
 write_callback(const FLAC__StreamDecoder * decoder,
@@ -49,25 +45,29 @@ write_callback(const FLAC__StreamDecoder * decoder,
 	flac_pdata_t * pd = (flac_pdata_t *)dec->pdata;
 	file_decoder_t * fdec = dec->fdec;
 	int i, j;
-	long int scale, blocksize;
-        FLAC__int32 buf[2];
-        float fbuf[2];
+	long int blocksize;
+	float scale;
+	float * fbuf;
 
 
         if (pd->probing)
                 return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
 
         blocksize = frame->header.blocksize;
-        scale = 1 << (pd->bits_per_sample - 1);
-
-        for (i = 0; i < blocksize; i++) {
-                for (j = 0; j < pd->channels; j++) {
-                        buf[j] = *(buffer[j] + i);
-                        fbuf[j] = (float)buf[j] * fdec->voladj_lin / scale;
-                }
-                rb_write(pd->rb, (char *)fbuf,
-                                      pd->channels * sample_size);
-        }
+        scale = fdec->voladj_lin / (1 << (pd->bits_per_sample - 1));
+
+	if ((fbuf = decoder_out_begin(dec, blocksize)) == NULL) {
+		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+	}
+	for (j = 0; j < pd->channels; j++) {
+		const FLAC__int32 * in = buffer[j];
+		float * out = fbuf + j;
+		for (i = 0; i < blocksize; i++) {
+			*out = (float)in[i] * scale;
+			out += pd->channels;
+		}
+	}
+	decoder_out_commit(dec, blocksize);
 
         return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
 }
@@ -128,7 +128,7 @@ flac_decoder_init(file_decoder_t * fdec) {
 	dec->open = flac_decoder_open;
 	dec->send_metadata = flac_decoder_send_metadata;
 	dec->close = flac_decoder_close;
-	dec->read = flac_decoder_read;
+	dec->decode = flac_decoder_decode;
 	dec->seek = flac_decoder_seek;
 
 	return dec;
@@ -460,7 +460,7 @@ flac_decoder_open(decoder_t * dec, char * filename) {
 	FLAC__stream_decoder_process_until_end_of_metadata(pd->flac_decoder);
 
 	if ((!pd->error) && (pd->channels > 0)) {
-		if ((pd->channels != 1) && (pd->channels != 2)) {
+		if (pd->channels > MAX_CHANNELS) {
 			fprintf(stderr,
 				"flac_decoder_open: FLAC file with %d channels is "
 				"unsupported\n", pd->channels);
@@ -486,7 +486,7 @@ flac_decoder_open(decoder_t * dec, char * filename) {
 				goto try_flac;
 			}
 
-			pd->rb = rb_create(pd->channels * sample_size * RB_FLAC_SIZE);
+			decoder_out_init(dec, pd->channels);
 
 			fdec->fileinfo.channels = pd->channels;
 			fdec->fileinfo.sample_rate = pd->SR;
@@ -527,49 +527,29 @@ flac_decoder_close(decoder_t * dec) {
 
 	FLAC__stream_decoder_finish(pd->flac_decoder);
 	FLAC__stream_decoder_delete(pd->flac_decoder);
-	rb_free(pd->rb);
+	decoder_out_free(dec);
 }
 
 
-unsigned int
-flac_decoder_read(decoder_t * dec, float * dest, int num) {
+int
+flac_decoder_decode(decoder_t * dec) {
 
 	flac_pdata_t * pd = (flac_pdata_t *)dec->pdata;
 
-	unsigned int numread = 0;
-	unsigned int n_avail = 0;
-
 	pd->state = FLAC__stream_decoder_get_state(pd->flac_decoder);
-	while ((rb_read_space(pd->rb) < num * pd->channels * sample_size) &&
-	       (pd->state == FLAC__STREAM_DECODER_SEARCH_FOR_FRAME_SYNC ||
-		pd->state == FLAC__STREAM_DECODER_SEARCH_FOR_METADATA ||
-		pd->state == FLAC__STREAM_DECODER_READ_METADATA ||
-		pd->state == FLAC__STREAM_DECODER_READ_FRAME)) {
+	if (pd->state == FLAC__STREAM_DECODER_SEARCH_FOR_FRAME_SYNC ||
+	    pd->state == FLAC__STREAM_DECODER_SEARCH_FOR_METADATA ||
+	    pd->state == FLAC__STREAM_DECODER_READ_METADATA ||
+	    pd->state == FLAC__STREAM_DECODER_READ_FRAME) {
 		FLAC__stream_decoder_process_single(pd->flac_decoder);
-		pd->state = FLAC__stream_decoder_get_state(pd->flac_decoder);
+		return 0;
 	}
 
-	/* Have i chosen the right conditions? */
-	if ((pd->state != FLAC__STREAM_DECODER_SEARCH_FOR_FRAME_SYNC) &&
-	    (pd->state != FLAC__STREAM_DECODER_SEARCH_FOR_METADATA) &&
-	    (pd->state != FLAC__STREAM_DECODER_READ_METADATA) &&
-	    (pd->state != FLAC__STREAM_DECODER_READ_FRAME) &&
-	    (pd->state != FLAC__STREAM_DECODER_END_OF_STREAM)) {
+	if (pd->state != FLAC__STREAM_DECODER_END_OF_STREAM) {
 		fprintf(stderr, "file_decoder_read() / FLAC: decoder error: %s\n",
 			FLAC__StreamDecoderStateString[pd->state]);
-		return 0; /* this means that a new file will be opened */
-	}
-
-	n_avail = rb_read_space(pd->rb) /
-		(pd->channels * sample_size);
-
-	if (n_avail > num) {
-		n_avail = num;
 	}
-
-	rb_read(pd->rb, (char *)dest, n_avail * pd->channels * sample_size);
-	numread = n_avail;
-	return numread;
+	return 1;
 }
 
 
@@ -578,7 +558,6 @@ flac_decoder_seek(decoder_t * dec, unsigned long long seek_to_pos) {
 
 	flac_pdata_t * pd = (flac_pdata_t *)dec->pdata;
 	file_decoder_t * fdec = dec->fdec;
-	char flush_dest;
 
 
 	if (seek_to_pos == fdec->fileinfo.total_samples) {
@@ -588,9 +567,7 @@ flac_decoder_seek(decoder_t * dec, unsigned long long seek_to_pos) {
 	if (FLAC__stream_decoder_seek_absolute(pd->flac_decoder, seek_to_pos)) {
 		fdec->samples_left = fdec->fileinfo.total_samples - seek_to_pos;
 
-		/* empty flac decoder ringbuffer */
-		while (rb_read_space(pd->rb))
-			rb_read(pd->rb, &flush_dest, sizeof(char));
+		decoder_out_reset(dec);
 	} else {
 		fprintf(stderr, "flac_decoder_seek: warning: "
 			"FLAC__file_decoder_seek_absolute() failed\n");
@@ -24,17 +24,11 @@
 #include <FLAC/ordinals.h>
 #include <FLAC/stream_decoder.h>
 
-#include "../rb.h"
 #include "file_decoder.h"
 
 
-/* size of ringbuffer for decoded FLAC data (in frames) */
-#define RB_FLAC_SIZE 262144
-
-
 typedef struct _flac_pdata_t {
         FLAC__StreamDecoder * flac_decoder;
-        rb_t * rb;
         int channels;
         int SR;
         unsigned bits_per_sample;
@@ -50,7 +44,7 @@ void flac_decoder_destroy(decoder_t * dec);
 int flac_decoder_open(decoder_t * dec, char * filename);
 void flac_decoder_send_metadata(decoder_t * dec);
 void flac_decoder_close(decoder_t * dec);
-unsigned int flac_decoder_read(decoder_t * dec, float * dest, int num);
+int flac_decoder_decode(decoder_t * dec);
 void flac_decoder_seek(decoder_t * dec, unsigned long long seek_to_pos);
 
 
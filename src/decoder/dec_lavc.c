@@ -28,15 +28,12 @@
 #include <libavutil/avutil.h>
 
 #include "../common.h"
-#include "../rb.h"
 #include "dec_lavc.h"
 
 
 /* uncomment this to get some debug info */
 /* #define LAVC_DEBUG */
 
-extern size_t sample_size;
-
 /* interleaved: */
 void conv_fmt_u8(int n_samples, int sample_size, float * fsamples, AVFrame * frame) {
 	int i;
@@ -113,24 +110,32 @@ void conv_fmt_dblp(int n_samples, int channels, int sample_size, float * fsample
 
 /* Loosely based on avcodec_decode_audio3() implementation found at:
  * https://raw.github.com/FFmpeg/FFmpeg/master/libavcodec/utils.c
+ *
+ * The decoded frame is converted into room taken from
+ * decoder_out_begin(), which is returned (NULL if nothing was
+ * decoded); *n_samples_ptr is set to the number of samples in it.
  */
-int decode_audio(AVCodecContext *avctx, float *fsamples, int *frame_size_ptr, AVPacket *avpkt) {
+float * decode_audio(AVCodecContext *avctx, decoder_t * dec, int *n_samples_ptr, AVPacket *avpkt) {
 	int ret;
 	AVFrame frame = { { 0 } };
 	int got_frame = 0;
+	float * fsamples = NULL;
 	
+	*n_samples_ptr = 0;
 	ret = avcodec_decode_audio4(avctx, &frame, &got_frame, avpkt);
 	if (ret >= 0 && got_frame) {
 		int plane_size;
 		int planar = av_sample_fmt_is_planar(avctx->sample_fmt);
 		int sample_size = av_get_bytes_per_sample(avctx->sample_fmt);
-		int data_size = av_samples_get_buffer_size(&plane_size, avctx->channels,
-							   frame.nb_samples, avctx->sample_fmt, 1);
-		int n_samples = plane_size / sample_size;
-		if (*frame_size_ptr < data_size) {
-			av_log(avctx, AV_LOG_ERROR, "output buffer size is too small for "
-			       "the current frame (%d < %d)\n", *frame_size_ptr, data_size);
-			return AVERROR(EINVAL);
+		int n_samples, n_frames;
+
+		av_samples_get_buffer_size(&plane_size, avctx->channels,
+					   frame.nb_samples, avctx->sample_fmt, 1);
+		n_samples = plane_size / sample_size;
+		n_frames = planar ? n_samples : n_samples / avctx->channels;
+
+		if ((fsamples = decoder_out_begin(dec, n_frames)) == NULL) {
+			return NULL;
 		}
 
 		switch (avctx->sample_fmt) {
@@ -151,11 +156,9 @@ int decode_audio(AVCodecContext *avctx, float *fsamples, int *frame_size_ptr, AV
 				av_get_sample_fmt_name(avctx->sample_fmt));
 			exit(1); // no, we really don't want to handle this gracefully
 		}
-		*frame_size_ptr = planar ? n_samples * avctx->channels : n_samples;
-	} else {
-		*frame_size_ptr = 0;
+		*n_samples_ptr = n_frames * avctx->channels;
 	}
-	return ret;
+	return fsamples;
 }
 
 /* return 1 if reached end of stream, 0 else */
@@ -170,8 +173,8 @@ decode_lavc(decoder_t * dec) {
         int16_t samples[MAX_AUDIO_FRAME_SIZE];
         int n_bytes = MAX_AUDIO_FRAME_SIZE;
 #endif /* LIBAVCODEC_VERSION_MAJOR >= 53 */
-        float fsamples[MAX_AUDIO_FRAME_SIZE];
-	int n_samples = MAX_AUDIO_FRAME_SIZE;
+	float * fsamples;
+	int n_samples;
 	int i;
 
 	if (av_read_frame(pd->avFormatCtx, &packet) < 0)
@@ -184,18 +187,20 @@ decode_lavc(decoder_t * dec) {
 	avcodec_decode_audio3(pd->avCodecCtx, samples, &n_bytes, &packet);
 	if (n_bytes <= 0) goto end;
 	n_samples = n_bytes / 2;
+	if ((fsamples = decoder_out_begin(dec, n_samples / pd->avCodecCtx->channels)) == NULL)
+		goto end;
 	for (i = 0; i < n_samples; i++) {
 		fsamples[i] = samples[i] * fdec->voladj_lin / 32768.f;
 	}
 #else /* LIBAVCODEC_VERSION_MAJOR >= 53 */
-	decode_audio(pd->avCodecCtx, fsamples, &n_samples, &packet);
-	if (n_samples <= 0) goto end;
+	fsamples = decode_audio(pd->avCodecCtx, dec, &n_samples, &packet);
+	if (fsamples == NULL) goto end;
 	for (i = 0; i < n_samples; i++) {
 		fsamples[i] *= fdec->voladj_lin;
 	}
 #endif /* LIBAVCODEC_VERSION_MAJOR >= 53 */
 
-	rb_write(pd->rb, (char *)fsamples, n_samples * sample_size);
+	decoder_out_commit(dec, n_samples / pd->avCodecCtx->channels);
 end:
 	av_free_packet(&packet);
         return 0;
@@ -224,7 +229,7 @@ lavc_decoder_init(file_decoder_t * fdec) {
 	dec->open = lavc_decoder_open;
 	dec->send_metadata = lavc_decoder_send_metadata;
 	dec->close = lavc_decoder_close;
-	dec->read = lavc_decoder_read;
+	dec->decode = decode_lavc;
 	dec->seek = lavc_decoder_seek;
 
 	return dec;
@@ -302,15 +307,14 @@ lavc_decoder_open(decoder_t * dec, char * filename) {
 		return DECODER_OPEN_BADLIB;
 	}
 
-	if ((pd->avCodecCtx->channels != 1) && (pd->avCodecCtx->channels != 2)) {
+	if ((pd->avCodecCtx->channels < 1) || (pd->avCodecCtx->channels > MAX_CHANNELS)) {
 		fprintf(stderr,
 			"lavc_decoder_open: audio stream with %d channels is unsupported\n",
 			pd->avCodecCtx->channels);
 		return DECODER_OPEN_FERROR;
 	}
 
-        pd->is_eos = 0;
-        pd->rb = rb_create(pd->avCodecCtx->channels * sample_size * RB_LAVC_SIZE);
+	decoder_out_init(dec, pd->avCodecCtx->channels);
 
 	fdec->fileinfo.channels = pd->avCodecCtx->channels;
 	fdec->fileinfo.sample_rate = pd->avCodecCtx->sample_rate;
@@ -350,32 +354,7 @@ lavc_decoder_close(decoder_t * dec) {
 	avformat_close_input(&pd->avFormatCtx);
 #endif /* LIBAVFORMAT_VERSION_MAJOR >= 53 */
 
-	rb_free(pd->rb);
-}
-
-
-unsigned int
-lavc_decoder_read(decoder_t * dec, float * dest, int num) {
-
-	lavc_pdata_t * pd = (lavc_pdata_t *)dec->pdata;
-
-        unsigned int numread = 0;
-        unsigned int n_avail = 0;
-
-        while ((rb_read_space(pd->rb) <
-                num * pd->avCodecCtx->channels * sample_size) && (!pd->is_eos)) {
-
-                pd->is_eos = decode_lavc(dec);
-        }
-
-        n_avail = rb_read_space(pd->rb) / (pd->avCodecCtx->channels * sample_size);
-
-        if (n_avail > num)
-                n_avail = num;
-
-        rb_read(pd->rb, (char *)dest, n_avail *	pd->avCodecCtx->channels * sample_size);
-        numread = n_avail;
-        return numread;
+	decoder_out_free(dec);
 }
 
 
@@ -384,7 +363,6 @@ lavc_decoder_seek(decoder_t * dec, unsigned long long seek_to_pos) {
 	
 	lavc_pdata_t * pd = (lavc_pdata_t *)dec->pdata;
 	file_decoder_t * fdec = dec->fdec;
-	char flush_dest;
 
 	long long pos = fdec->fileinfo.total_samples - fdec->samples_left;
 	int64_t timestamp = (double)seek_to_pos / fdec->fileinfo.sample_rate
@@ -393,9 +371,7 @@ lavc_decoder_seek(decoder_t * dec, unsigned long long seek_to_pos) {
 
 	if (av_seek_frame(pd->avFormatCtx, pd->audioStream, timestamp, flags) >= 0) {
 		fdec->samples_left = fdec->fileinfo.total_samples - seek_to_pos;
-		/* empty lavc decoder ringbuffer */
-		while (rb_read_space(pd->rb))
-			rb_read(pd->rb, &flush_dest, sizeof(char));
+		decoder_out_reset(dec);
 	} else {
 		fprintf(stderr, "lavc_decoder_seek: warning: av_seek_frame() failed\n");
 	}
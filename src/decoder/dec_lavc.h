@@ -25,22 +25,18 @@
 #include <libavformat/avformat.h>
 #include <libavutil/rational.h>
 
-#include "../rb.h"
 #include "file_decoder.h"
 
 
 #define MAX_AUDIO_FRAME_SIZE 192000 // 1 second of 48khz 32bit audio
-#define RB_LAVC_SIZE (3*MAX_AUDIO_FRAME_SIZE)
 
 
 typedef struct _lavc_pdata_t {
-        rb_t * rb;
 	AVFormatContext * avFormatCtx;
 	AVCodecContext * avCodecCtx;
 	AVCodec * avCodec;
 	AVRational time_base;
 	int audioStream;
-	int is_eos;
 } lavc_pdata_t;
 
 
@@ -49,7 +45,7 @@ void lavc_decoder_destroy(decoder_t * dec);
 int lavc_decoder_open(decoder_t * dec, char * filename);
 void lavc_decoder_send_metadata(decoder_t * dec);
 void lavc_decoder_close(decoder_t * dec);
-unsigned int lavc_decoder_read(decoder_t * dec, float * dest, int num);
+int decode_lavc(decoder_t * dec);
 void lavc_decoder_seek(decoder_t * dec, unsigned long long seek_to_pos);
 
 
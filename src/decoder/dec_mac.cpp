@@ -40,14 +40,10 @@
 #include "../i18n.h"
 #include "../metadata.h"
 #include "../metadata_ape.h"
-#include "../rb.h"
 #include "file_decoder.h"
 #include "dec_mac.h"
 
 
-extern size_t sample_size;
-
-
 #define BLOCKS_PER_READ 2048
 
 
@@ -64,7 +60,7 @@ decode_mac(decoder_t * dec) {
 
 	int act_read = 0;
 	unsigned long scale = 1 << (pd->bits_per_sample - 1);
-	float fbuf[2 * BLOCKS_PER_READ];
+	float * fbuf;
 	int n = 0;
 
 	switch (pd->bits_per_sample) {
@@ -74,6 +70,9 @@ decode_mac(decoder_t * dec) {
 		if (!act_read) {
 			return 1;
 		}
+		if ((fbuf = decoder_out_begin(dec, act_read)) == NULL) {
+			return 1;
+		}
 		for (int i = 0; i < act_read; i++) {
 			for (unsigned int j = 0; j < pd->channels; j++) {
 				fbuf[n] = (float)(data8[n] * fdec->voladj_lin / scale);
@@ -88,6 +87,9 @@ decode_mac(decoder_t * dec) {
 		if (!act_read) {
 			return 1;
 		}
+		if ((fbuf = decoder_out_begin(dec, act_read)) == NULL) {
+			return 1;
+		}
 		for (int i = 0; i < act_read; i++) {
 			for (unsigned int j = 0; j < pd->channels; j++) {
 				if (pd->swap_bytes)
@@ -104,6 +106,9 @@ decode_mac(decoder_t * dec) {
 		if (!act_read) {
 			return 1;
 		}
+		if ((fbuf = decoder_out_begin(dec, act_read)) == NULL) {
+			return 1;
+		}
 		for (int i = 0; i < act_read; i++) {
 			for (unsigned int j = 0; j < pd->channels; j++) {
 				if (pd->swap_bytes)
@@ -120,8 +125,7 @@ decode_mac(decoder_t * dec) {
 		break;
 	}
 
-	rb_write(pd->rb, (char *)fbuf,
-			      act_read * pd->channels * sample_size);
+	decoder_out_commit(dec, act_read);
 
 	return 0;
 }
@@ -149,7 +153,7 @@ mac_decoder_init(file_decoder_t * fdec) {
 	dec->open = mac_decoder_open;
 	dec->send_metadata = mac_decoder_send_metadata;
 	dec->close = mac_decoder_close;
-	dec->read = mac_decoder_read;
+	dec->decode = decode_mac;
 	dec->seek = mac_decoder_seek;
 
 	return dec;
@@ -208,8 +212,7 @@ mac_decoder_open(decoder_t * dec, char * filename) {
 
 	pd->swap_bytes = bigendianp();
 
-	pd->is_eos = 0;
-	pd->rb = rb_create(pd->channels * sample_size * RB_MAC_SIZE);
+	decoder_out_init(dec, pd->channels);
 	fdec->fileinfo.channels = pd->channels;
 	fdec->fileinfo.sample_rate = pd->sample_rate;
 	fdec->fileinfo.total_samples = (unsigned long long)(pd->sample_rate / 1000.0f * pd->length_in_ms);
@@ -258,34 +261,7 @@ mac_decoder_close(decoder_t * dec) {
 	IAPEDecompress * pdecompress = (IAPEDecompress *)pd->decompress;
 
 	delete(pdecompress);
-	rb_free(pd->rb);
-}
-
-
-unsigned int
-mac_decoder_read(decoder_t * dec, float * dest, int num) {
-
-	mac_pdata_t * pd = (mac_pdata_t *)dec->pdata;
-
-	unsigned int numread = 0;
-	int n_avail = 0;
-
-
-	while ((rb_read_space(pd->rb) <
-		num * pd->channels * sample_size) && (!pd->is_eos)) {
-
-		pd->is_eos = decode_mac(dec);
-	}
-
-	n_avail = rb_read_space(pd->rb) /
-		(pd->channels * sample_size);
-
-	if (n_avail > num)
-		n_avail = num;
-
-	rb_read(pd->rb, (char *)dest, n_avail * pd->channels * sample_size);
-	numread = n_avail;
-	return numread;
+	decoder_out_free(dec);
 }
 
 
@@ -295,14 +271,10 @@ mac_decoder_seek(decoder_t * dec, unsigned long long seek_to_pos) {
 	mac_pdata_t * pd = (mac_pdata_t *)dec->pdata;
 	file_decoder_t * fdec = dec->fdec;
 	IAPEDecompress * pdecompress = (IAPEDecompress *)pd->decompress;
-	char flush_dest;
 
 	pdecompress->Seek(seek_to_pos);
 	fdec->samples_left = fdec->fileinfo.total_samples - seek_to_pos;
-
-	/* empty mac decoder ringbuffer */
-	while (rb_read_space(pd->rb))
-		rb_read(pd->rb, &flush_dest, sizeof(char));
+	decoder_out_reset(dec);
 }
 
 
@@ -21,18 +21,14 @@
 #ifndef AQUALUNG_DEC_MAC_H
 #define AQUALUNG_DEC_MAC_H
 
-#include "../rb.h"
 #include "file_decoder.h"
 
 
 /* Decoding buffer size for Monkey's Audio */
 #define MAC_BUFSIZE 9216
-/* size of ringbuffer for decoded Monkey's Audio data (in frames) */
-#define RB_MAC_SIZE 262144
 
 
 typedef struct _mac_pdata_t {
-        rb_t * rb;
 	void * decompress; /* (IAPEDecompress *) */
 	unsigned int sample_rate;
 	unsigned int bits_per_sample;
@@ -42,7 +38,6 @@ typedef struct _mac_pdata_t {
 	unsigned int block_align;
 	unsigned int compression_level;
 	int swap_bytes;
-        int is_eos;
 } mac_pdata_t;
 
 
@@ -55,7 +50,7 @@ void mac_decoder_destroy(decoder_t * dec);
 int mac_decoder_open(decoder_t * dec, char * filename);
 void mac_decoder_send_metadata(decoder_t * dec );
 void mac_decoder_close(decoder_t * dec);
-unsigned int mac_decoder_read(decoder_t * dec, float * dest, int num);
+int decode_mac(decoder_t * dec);
 void mac_decoder_seek(decoder_t * dec, unsigned long long seek_to_pos);
 
 #ifdef __cplusplus
@@ -43,13 +43,9 @@
 
 #include "../common.h"
 #include "../metadata.h"
-#include "../rb.h"
 #include "dec_mod.h"
 
 
-extern size_t sample_size;
-
-
 /* list of accepted file extensions */
 char * valid_extensions_mod[] = {
 	"669", "amf", "ams", "dbm", "dmf", "dsm", "far", "it",
@@ -205,14 +201,18 @@ decode_mod(decoder_t * dec) {
 
 	int i;
 	long bytes_read;
-        float fbuffer[MOD_BUFSIZE/2];
+	float * fbuffer;
         char buffer[MOD_BUFSIZE];
 
         if ((bytes_read = ModPlug_Read(pd->mpf, buffer, MOD_BUFSIZE)) > 0) {
+		int n = bytes_read/2 / pd->mp_settings.mChannels;
+		if ((fbuffer = decoder_out_begin(dec, n)) == NULL) {
+			return 1;
+		}
                 for (i = 0; i < bytes_read/2; i++) {
                         fbuffer[i] = *((short *)(buffer + 2*i)) * fdec->voladj_lin / 32768.f;
 		}
-                rb_write(pd->rb, (char *)fbuffer, bytes_read/2 * sample_size);
+		decoder_out_commit(dec, n);
                 return 0;
         } else {
 		return 1;
@@ -242,7 +242,7 @@ mod_decoder_init(file_decoder_t * fdec) {
 	dec->open = mod_decoder_open;
 	dec->send_metadata = mod_decoder_send_metadata;
 	dec->close = mod_decoder_close;
-	dec->read = mod_decoder_read;
+	dec->decode = decode_mod;
 	dec->seek = mod_decoder_seek;
 
 	return dec;
@@ -500,8 +500,7 @@ char *filename = NULL;
 
 	ModPlug_SetSettings(&(pd->mp_settings));
 
-	pd->is_eos = 0;
-	pd->rb = rb_create(pd->mp_settings.mChannels * sample_size * RB_MOD_SIZE);
+	decoder_out_init(dec, pd->mp_settings.mChannels);
 	fdec->fileinfo.channels = pd->mp_settings.mChannels;
 	fdec->fileinfo.sample_rate = pd->mp_settings.mFrequency;
 	fdec->file_lib = MOD_LIB;
@@ -541,35 +540,7 @@ mod_decoder_close(decoder_t * dec) {
         if (munmap(pd->fdm, pd->st.st_size) == -1)
 		fprintf(stderr, "Error while munmap()'ing MOD Audio file mapping\n");
 	close(pd->fd);
-	rb_free(pd->rb);
-}
-
-
-unsigned int
-mod_decoder_read(decoder_t * dec, float * dest, int num) {
-
-	mod_pdata_t * pd = (mod_pdata_t *)dec->pdata;
-
-	unsigned int numread = 0;
-	unsigned int n_avail = 0;
-
-	while ((rb_read_space(pd->rb) <
-		num * pd->mp_settings.mChannels * sample_size) && (!pd->is_eos)) {
-
-		pd->is_eos = decode_mod(dec);
-	}
-
-	n_avail = rb_read_space(pd->rb) /
-		(pd->mp_settings.mChannels * sample_size);
-
-	if (n_avail > num)
-		n_avail = num;
-
-	rb_read(pd->rb, (char *)dest, n_avail *
-			     pd->mp_settings.mChannels * sample_size);
-
-	numread = n_avail;
-	return numread;
+	decoder_out_free(dec);
 }
 
 
@@ -578,7 +549,6 @@ mod_decoder_seek(decoder_t * dec, unsigned long long seek_to_pos) {
 
 	mod_pdata_t * pd = (mod_pdata_t *)dec->pdata;
 	file_decoder_t * fdec = dec->fdec;
-	char flush_dest;
 
 	if (seek_to_pos == fdec->fileinfo.total_samples) {
 		--seek_to_pos;
@@ -586,9 +556,7 @@ mod_decoder_seek(decoder_t * dec, unsigned long long seek_to_pos) {
 
 	ModPlug_Seek(pd->mpf, (double)seek_to_pos / pd->mp_settings.mFrequency * 1000.0f);
 	fdec->samples_left = fdec->fileinfo.total_samples - seek_to_pos;
-	/* empty mod decoder ringbuffer */
-	while (rb_read_space(pd->rb))
-		rb_read(pd->rb, &flush_dest, sizeof(char));
+	decoder_out_reset(dec);
 }
 
 
@@ -24,24 +24,19 @@
 #include <sys/stat.h>
 #include <libmodplug/modplug.h>
 
-#include "../rb.h"
 #include "file_decoder.h"
 
 
 /* Decoding buffer size for libmodplug */
 #define MOD_BUFSIZE 8192
-/* size of ringbuffer for decoded MOD Audio data (in frames) */
-#define RB_MOD_SIZE 262144
 
 
 typedef struct _mod_pdata_t {
-        rb_t * rb;
         ModPlug_Settings mp_settings;
         ModPlugFile * mpf;
         int fd;
         void * fdm;
         struct stat st;
-        int is_eos;
 } mod_pdata_t;
 
 enum {
@@ -56,7 +51,7 @@ int is_valid_mod_extension(char * filename);
 int mod_decoder_open(decoder_t * dec, char * filename);
 void mod_decoder_send_metadata(decoder_t * dec);
 void mod_decoder_close(decoder_t * dec);
-unsigned int mod_decoder_read(decoder_t * dec, float * dest, int num);
+int decode_mod(decoder_t * dec);
 void mod_decoder_seek(decoder_t * dec, unsigned long long seek_to_pos);
 
 
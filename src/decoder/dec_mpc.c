@@ -29,14 +29,10 @@
 #include "../i18n.h"
 #include "../metadata.h"
 #include "../metadata_ape.h"
-#include "../rb.h"
 #include "file_decoder.h"
 #include "dec_mpc.h"
 
 
-extern size_t sample_size;
-
-
 /* return 1 if reached end of stream, 0 else */
 int
 decode_mpc(decoder_t * dec) {
@@ -46,6 +42,7 @@ decode_mpc(decoder_t * dec) {
 
 	int n;
 	float fval;
+	float * fbuf;
         MPC_SAMPLE_FORMAT buffer[MPC_DECODER_BUFFER_LENGTH];
 
 
@@ -71,7 +68,10 @@ decode_mpc(decoder_t * dec) {
 	}
 	pd->status = frame.samples;
 #endif /* MPC_OLD_API */
-	
+
+	if ((fbuf = decoder_out_begin(dec, pd->status)) == NULL) {
+		return 1;
+	}
 	for (n = 0; n < pd->status * pd->mpc_i.channels; n++) {
 #ifdef MPC_FIXED_POINT
                 fval = buffer[n] / (double)MPC_FIXED_POINT_SCALE * fdec->voladj_lin;
@@ -85,8 +85,9 @@ decode_mpc(decoder_t * dec) {
                         fval = 1.0f;
                 }
 		
-                rb_write(pd->rb, (char *)&fval, sample_size);
+                fbuf[n] = fval;
 	}
+	decoder_out_commit(dec, pd->status);
 	return 0;
 }
 
@@ -113,7 +114,7 @@ mpc_decoder_init_func(file_decoder_t * fdec) {
 	dec->open = mpc_decoder_open;
 	dec->send_metadata = mpc_decoder_send_metadata;
 	dec->close = mpc_decoder_close;
-	dec->read = mpc_decoder_read;
+	dec->decode = decode_mpc;
 	dec->seek = mpc_decoder_seek;
 
 	return dec;
@@ -232,8 +233,7 @@ mpc_decoder_open(decoder_t * dec, char * filename) {
 	mpc_demux_get_info(pd->mpc_d, &pd->mpc_i);
 #endif /* MPC_OLD_API */
 	
-	pd->is_eos = 0;
-	pd->rb = rb_create(pd->mpc_i.channels * sample_size * RB_MPC_SIZE);
+	decoder_out_init(dec, pd->mpc_i.channels);
 	
 	fdec->fileinfo.channels = pd->mpc_i.channels;
 	fdec->fileinfo.sample_rate = pd->mpc_i.sample_freq;
@@ -289,45 +289,16 @@ mpc_decoder_close(decoder_t * dec) {
 
 	mpc_pdata_t * pd = (mpc_pdata_t *)dec->pdata;
 
-	rb_free(pd->rb);
+	decoder_out_free(dec);
 	fclose(pd->mpc_file);
 }
 
 
-unsigned int
-mpc_decoder_read(decoder_t * dec, float * dest, int num) {
-
-	mpc_pdata_t * pd = (mpc_pdata_t *)dec->pdata;
-
-	unsigned int numread = 0;
-	unsigned int n_avail = 0;
-
-
-	while ((rb_read_space(pd->rb) <
-		num * pd->mpc_i.channels * sample_size) && (!pd->is_eos)) {
-
-		pd->is_eos = decode_mpc(dec);
-	}
-
-	n_avail = rb_read_space(pd->rb) / (pd->mpc_i.channels * sample_size);
-
-	if (n_avail > num)
-		n_avail = num;
-
-	rb_read(pd->rb, (char *)dest, n_avail *
-			     pd->mpc_i.channels * sample_size);
-
-	numread = n_avail;
-	return numread;
-}
-
-
 void
 mpc_decoder_seek(decoder_t * dec, unsigned long long seek_to_pos) {
 	
 	mpc_pdata_t * pd = (mpc_pdata_t *)dec->pdata;
 	file_decoder_t * fdec = dec->fdec;
-	char flush_dest;
 
 
 #ifdef MPC_OLD_API
@@ -336,9 +307,7 @@ mpc_decoder_seek(decoder_t * dec, unsigned long long seek_to_pos) {
 	if (mpc_demux_seek_sample(pd->mpc_d, seek_to_pos) == MPC_STATUS_OK) {
 #endif /* MPC_OLD_API */
 		fdec->samples_left = fdec->fileinfo.total_samples - seek_to_pos;
-		/* empty musepack decoder ringbuffer */
-		while (rb_read_space(pd->rb))
-			rb_read(pd->rb, &flush_dest, sizeof(char));
+		decoder_out_reset(dec);
 	} else {
 		fprintf(stderr,
 			"mpc_decoder_seek: warning: mpc_decoder_seek_sample() failed\n");
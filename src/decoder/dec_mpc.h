@@ -29,23 +29,18 @@
 #include <mpc/mpcdec.h>
 #endif /* MPC_OLD_API */
 
-#include "../rb.h"
 #include "file_decoder.h"
 
 
 /* Decoding buffer size for musepack */
 #define MPC_BUFSIZE 8192
-/* size of ringbuffer for decoded Musepack audio data (in frames) */
-#define RB_MPC_SIZE 262144
 
 
 typedef struct _mpc_pdata_t {
-        rb_t * rb;
         FILE * mpc_file;
         long int size;
         int seekable;
         int status;
-        int is_eos;
 #ifdef MPC_OLD_API
         mpc_decoder mpc_d;
         mpc_reader_file mpc_r_f;
@@ -62,7 +57,7 @@ void mpc_decoder_destroy(decoder_t * dec);
 int mpc_decoder_open(decoder_t * dec, char * filename);
 void mpc_decoder_send_metadata(decoder_t * dec);
 void mpc_decoder_close(decoder_t * dec);
-unsigned int mpc_decoder_read(decoder_t * dec, float * dest, int num);
+int decode_mpc(decoder_t * dec);
 void mpc_decoder_seek(decoder_t * dec, unsigned long long seek_to_pos);
 
 
@@ -31,6 +31,10 @@
 #include <string.h>
 #include <glib.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif /* __SSE2__ */
+
 #include "../athread.h"
 #include "../httpc.h"
 #include "../i18n.h"
@@ -39,14 +43,10 @@
 #include "../metadata_ape.h"
 #include "../metadata_id3v1.h"
 #include "../metadata_id3v2.h"
-#include "../rb.h"
 #include "file_decoder.h"
 #include "dec_mpeg.h"
 
 
-extern size_t sample_size;
-
-
 /* Uncomment this to get debug printouts */
 /* #define MPEG_DEBUG */
 
@@ -830,14 +830,11 @@ void
 pause_mpeg_stream(decoder_t * dec) {
 
 	mpeg_pdata_t * pd = (mpeg_pdata_t *)dec->pdata;
-	char flush_dest;
 
 	httpc_close(pd->session);
 
 	if (pd->session->type == HTTPC_SESSION_STREAM) {
-		/* empty mpeg decoder ringbuffer */
-		while (rb_read_space(pd->rb))
-			rb_read(pd->rb, &flush_dest, sizeof(char));
+		decoder_out_reset(dec);
 	}
 }
 
@@ -917,6 +914,50 @@ mpeg_input(void * data, struct mad_stream * stream) {
 }
 
 
+/* Convert n samples of libmad's fixed point output to interleaved
+ * float, scaled by gain. r is only read for stereo output.
+ */
+static void
+mpeg_fixed_to_float(mad_fixed_t const * l, mad_fixed_t const * r,
+		    int channels, float gain, float * out, int n) {
+
+	int i = 0;
+
+#ifdef __SSE2__
+	if (sizeof(mad_fixed_t) == sizeof(int)) {
+		__m128 g = _mm_set1_ps(gain);
+
+		if (channels == 2) {
+			for (; i + 4 <= n; i += 4) {
+				__m128 a = _mm_cvtepi32_ps(_mm_loadu_si128((__m128i const *)(l + i)));
+				__m128 b = _mm_cvtepi32_ps(_mm_loadu_si128((__m128i const *)(r + i)));
+				a = _mm_mul_ps(a, g);
+				b = _mm_mul_ps(b, g);
+				_mm_storeu_ps(out + 2*i, _mm_unpacklo_ps(a, b));
+				_mm_storeu_ps(out + 2*i + 4, _mm_unpackhi_ps(a, b));
+			}
+		} else {
+			for (; i + 4 <= n; i += 4) {
+				__m128 a = _mm_cvtepi32_ps(_mm_loadu_si128((__m128i const *)(l + i)));
+				_mm_storeu_ps(out + i, _mm_mul_ps(a, g));
+			}
+		}
+	}
+#endif /* __SSE2__ */
+
+	if (channels == 2) {
+		for (; i < n; i++) {
+			out[2*i] = (float)l[i] * gain;
+			out[2*i + 1] = (float)r[i] * gain;
+		}
+	} else {
+		for (; i < n; i++) {
+			out[i] = (float)l[i] * gain;
+		}
+	}
+}
+
+
 /* MPEG output callback */
 static
 enum mad_flow
@@ -928,10 +969,9 @@ mpeg_output(void * data, struct mad_header const * header, struct mad_pcm * pcm)
 	long pos_bytes;
 	int end_count = pcm->length;
 
-	int i = 0, j;
-	unsigned long scale = 322122547; /* (1 << 28) * 1.2 */
-        int buf[2];
-        float fbuf[2];
+	int i = 0;
+	float scale = 322122547.0f; /* (1 << 28) * 1.2 */
+	float * fbuf;
 
 	int pad = pd->mp3info.enc_padding;
 
@@ -980,18 +1020,22 @@ mpeg_output(void * data, struct mad_header const * header, struct mad_pcm * pcm)
 		}
 	}
 
-        for (; i < end_count; i++) {
-                for (j = 0; j < pd->channels; j++) {
-                        buf[j] = pd->error ? 0 : *(pcm->samples[j] + i);
-                        fbuf[j] = (double)buf[j] * fdec->voladj_lin / scale;
-                }
-		if (fdec->is_stream && pcm->channels == 1) {
-			fbuf[1] = fbuf[0];
+	if (i < end_count) {
+		int n = end_count - i;
+
+		if ((fbuf = decoder_out_begin(dec, n)) == NULL) {
+			return MAD_FLOW_STOP;
 		}
-                if (rb_write_space(pd->rb) >= pd->channels * sample_size) {
-                        rb_write(pd->rb, (char *)fbuf, pd->channels * sample_size);
+		if (pd->error) {
+			memset(fbuf, 0, n * pd->channels * sizeof(float));
+		} else {
+			/* mono frames are sent to both sides of a stereo stream */
+			mpeg_fixed_to_float(pcm->samples[0] + i,
+					    pcm->samples[(pcm->channels == 1) ? 0 : 1] + i,
+					    pd->channels, fdec->voladj_lin / scale, fbuf, n);
 		}
-        }
+		decoder_out_commit(dec, n);
+	}
 	pd->frame_counter++;
         pd->error = 0;
 
@@ -1102,7 +1146,7 @@ mpeg_decoder_init(file_decoder_t * fdec) {
 	dec->open = mpeg_decoder_open;
 	dec->send_metadata = mpeg_decoder_send_metadata;
 	dec->close = mpeg_decoder_close;
-	dec->read = mpeg_decoder_read;
+	dec->decode = mpeg_decoder_decode;
 	dec->seek = mpeg_decoder_seek;
 
 	return dec;
@@ -1143,9 +1187,8 @@ mpeg_decoder_finish_open(decoder_t * dec) {
 	}
 
 	pd->error = 0;
-	pd->is_eos = 0;
 	pd->seek_table_built = 0;
-	pd->rb = rb_create(pd->channels * sample_size * RB_MAD_SIZE);
+	decoder_out_init(dec, pd->channels);
 	fdec->fileinfo.channels = pd->channels;
 	fdec->fileinfo.sample_rate = pd->SR;
 	fdec->file_lib = MAD_LIB;
@@ -1440,22 +1483,19 @@ mpeg_decoder_close(decoder_t * dec) {
 			fprintf(stderr, "Error while munmap()'ing MPEG Audio file mapping\n");
 		close(pd->fd);
 	}
-	rb_free(pd->rb);
+	decoder_out_free(dec);
 #ifdef MPEG_DEBUG
 	printf("mpeg_decoder_close successful\n");
 #endif /* MPEG_DEBUG */
 }
 
 
-unsigned int
-mpeg_decoder_read(decoder_t * dec, float * dest, int num) {
+int
+mpeg_decoder_decode(decoder_t * dec) {
 
 	mpeg_pdata_t * pd = (mpeg_pdata_t *)dec->pdata;
 	file_decoder_t * fdec = dec->fdec;
 
-	unsigned int numread = 0;
-	unsigned int n_avail = 0;
-
 	if (!fdec->is_stream && !pd->seek_table_built) {
 #ifdef MPEG_DEBUG
 		printf("first read from mpeg file\n");
@@ -1467,21 +1507,7 @@ mpeg_decoder_read(decoder_t * dec, float * dest, int num) {
 		pd->seek_table_built = 1;
 	}
 
-	while ((rb_read_space(pd->rb) < num * pd->channels *
-		sample_size) && (!pd->is_eos)) {
-
-		pd->is_eos = decode_mpeg(dec);
-	}
-
-	n_avail = rb_read_space(pd->rb) / (pd->channels * sample_size);
-
-	if (n_avail > num)
-		n_avail = num;
-
-	rb_read(pd->rb, (char *)dest, n_avail * pd->channels * sample_size);
-
-	numread = n_avail;
-	return numread;
+	return decode_mpeg(dec);
 }
 
 
@@ -1493,7 +1519,6 @@ mpeg_decoder_seek(decoder_t * dec, unsigned long long seek_to_pos) {
 	char * bytes = (char *)pd->fdm;
 	long header;
 	mp3info_t mp3info;
-	char flush_dest;
 	int i;
 	unsigned long offset;
 	unsigned long long sample;
@@ -1523,7 +1548,7 @@ mpeg_decoder_seek(decoder_t * dec, unsigned long long seek_to_pos) {
 					* (double)seek_to_pos / pd->total_samples_est);
 			mad_stream_sync(&(pd->mpeg_stream));
 
-			pd->is_eos = decode_mpeg(dec);
+			decode_mpeg(dec);
 			/* report the real position of the decoder */
 			fdec->samples_left = fdec->fileinfo.total_samples -
 				(pd->mpeg_stream.next_frame - pd->mpeg_stream.buffer)
@@ -1580,9 +1605,7 @@ mpeg_decoder_seek(decoder_t * dec, unsigned long long seek_to_pos) {
 	fdec->samples_left = fdec->fileinfo.total_samples - sample;
 
  flush_decoder_rb:
-	/* empty mpeg decoder ringbuffer */
-	while (rb_read_space(pd->rb))
-		rb_read(pd->rb, &flush_dest, sizeof(char));
+	decoder_out_reset(dec);
 }
 
 
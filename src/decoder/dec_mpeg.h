@@ -27,13 +27,9 @@
 
 #include "../athread.h"
 #include "../httpc.h"
-#include "../rb.h"
 #include "file_decoder.h"
 
 
-/* size of ringbuffer for decoded MPEG Audio data (in frames) */
-#define RB_MAD_SIZE 262144
-
 /* for stream (non-mmap) decoding */
 #define MPEG_INBUF_SIZE (5*8192)
 
@@ -109,13 +105,11 @@ typedef struct {
 
 typedef struct _mpeg_pdata_t {
         struct mad_decoder mpeg_decoder;
-        rb_t * rb;
         FILE * mpeg_file;
         int channels;
         int SR;
         unsigned bitrate;
         int error;
-        int is_eos;
         struct stat mpeg_stat;
         long long int filesize;
 	long skip_bytes;
@@ -148,7 +142,7 @@ int mpeg_decoder_open(decoder_t * dec, char * filename);
 void mpeg_decoder_send_metadata(decoder_t * dec);
 int mpeg_stream_decoder_open(decoder_t * dec, http_session_t * session);
 void mpeg_decoder_close(decoder_t * dec);
-unsigned int mpeg_decoder_read(decoder_t * dec, float * dest, int num);
+int mpeg_decoder_decode(decoder_t * dec);
 void mpeg_decoder_seek(decoder_t * dec, unsigned long long seek_to_pos);
 
 
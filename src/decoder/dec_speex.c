@@ -28,13 +28,9 @@
 #include <ogg/ogg.h>
 #include <speex/speex_header.h>
 
-#include "../rb.h"
 #include "dec_speex.h"
 
 
-extern size_t sample_size;
-
-
 static int
 read_ogg_packet(OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data) {
 
@@ -103,7 +99,7 @@ read_ogg_packet(OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
 	} else if (pd->packetno >= 2) {
 
 		int j;
-		float output_frame[SPEEX_BUFSIZE];
+		float * output_frame;
 
 		pd->granulepos = op->granulepos;
 
@@ -114,6 +110,9 @@ read_ogg_packet(OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
 				
 				int k;
 				
+				if ((output_frame = decoder_out_begin(dec, pd->frame_size)) == NULL) {
+					break;
+				}
 				speex_decode(pd->decoder, &(pd->bits), output_frame);
 				
 				for (k = 0; k < pd->frame_size * pd->channels; k++) {
@@ -125,8 +124,7 @@ read_ogg_packet(OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
 					}
 				}
 				
-				rb_write(pd->rb, (char *)output_frame,
-						      pd->channels * pd->frame_size * sample_size);
+				decoder_out_commit(dec, pd->frame_size);
 			}
 		}
 	}
@@ -173,7 +171,7 @@ speex_dec_init(file_decoder_t * fdec) {
 	dec->open = speex_dec_open;
 	dec->send_metadata = speex_dec_send_metadata;
 	dec->close = speex_dec_close;
-	dec->read = speex_dec_read;
+	dec->decode = decode_speex;
 	dec->seek = speex_dec_seek;
 
 	return dec;
@@ -263,8 +261,7 @@ speex_dec_open(decoder_t * dec, char * filename) {
 	pd->decoder = speex_decoder_init(pd->mode);
 	speex_decoder_ctl(pd->decoder, SPEEX_SET_ENH, &enh);
 
-	pd->is_eos = 0;
-	pd->rb = rb_create(pd->channels * sample_size * RB_SPEEX_SIZE);
+	decoder_out_init(dec, pd->channels);
 	fdec->fileinfo.channels = pd->channels;
 	fdec->fileinfo.sample_rate = pd->sample_rate;
 	length_in_samples = pd->granulepos + pd->nframes - 1;
@@ -291,36 +288,7 @@ speex_dec_close(decoder_t * dec) {
 	oggz_close(pd->oggz);
 	speex_bits_destroy(&(pd->bits));
         speex_decoder_destroy(pd->decoder);
-	rb_free(pd->rb);
-}
-
-
-unsigned int
-speex_dec_read(decoder_t * dec, float * dest, int num) {
-
-	speex_pdata_t * pd = (speex_pdata_t *)dec->pdata;
-
-	unsigned int numread = 0;
-	unsigned int n_avail = 0;
-
-
-	while ((rb_read_space(pd->rb) <
-		num * pd->channels * sample_size) && (!pd->is_eos)) {
-
-		pd->is_eos = decode_speex(dec);
-	}
-
-	n_avail = rb_read_space(pd->rb) /
-		(pd->channels * sample_size);
-
-	if (n_avail > num)
-		n_avail = num;
-
-	rb_read(pd->rb, (char *)dest, n_avail *
-			     pd->channels * sample_size);
-
-	numread = n_avail;
-	return numread;
+	decoder_out_free(dec);
 }
 
 
@@ -329,7 +297,6 @@ speex_dec_seek(decoder_t * dec, unsigned long long seek_to_pos) {
 	
 	speex_pdata_t * pd = (speex_pdata_t *)dec->pdata;
 	file_decoder_t * fdec = dec->fdec;
-	char flush_dest;
 
 	if (seek_to_pos == fdec->fileinfo.total_samples)
 		--seek_to_pos;
@@ -341,9 +308,7 @@ speex_dec_seek(decoder_t * dec, unsigned long long seek_to_pos) {
 		}
 
 		fdec->samples_left = fdec->fileinfo.total_samples - seek_to_pos;
-		/* empty speex decoder ringbuffer */
-		while (rb_read_space(pd->rb))
-			rb_read(pd->rb, &flush_dest, sizeof(char));
+		decoder_out_reset(dec);
 	} else {
 		fprintf(stderr, "speex_dec_seek(): warning: oggz_seek_units() returned -1\n");
 	}
@@ -25,18 +25,10 @@
 #include <oggz/oggz.h>
 #include <speex/speex.h>
 
-#include "../rb.h"
 #include "file_decoder.h"
 
 
-/* Decoding buffer size for Speex */
-#define SPEEX_BUFSIZE 1280
-/* size of ringbuffer for decoded Speex data (in frames) */
-#define RB_SPEEX_SIZE 262144
-
-
 typedef struct _speex_pdata_t {
-        rb_t * rb;
         FILE * speex_file;
 
 	OGGZ * oggz;
@@ -55,7 +47,6 @@ typedef struct _speex_pdata_t {
 	long packetno;
 	int granulepos;
 
-        int is_eos;
 } speex_pdata_t;
 
 
@@ -64,7 +55,7 @@ void speex_dec_destroy(decoder_t * dec);
 int speex_dec_open(decoder_t * dec, char * filename);
 void speex_dec_send_metadata(decoder_t * dec);
 void speex_dec_close(decoder_t * dec);
-unsigned int speex_dec_read(decoder_t * dec, float * dest, int num);
+int decode_speex(decoder_t * dec);
 void speex_dec_seek(decoder_t * dec, unsigned long long seek_to_pos);
 
 
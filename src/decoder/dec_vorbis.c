@@ -28,16 +28,29 @@
 #include <glib.h>
 #include <ogg/ogg.h>
 
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif /* __SSE__ */
+
 #include "../httpc.h"
 #include "../metadata.h"
 #include "../metadata_api.h"
 #include "../metadata_ogg.h"
-#include "../rb.h"
 #include "file_decoder.h"
 #include "dec_vorbis.h"
 
 
-extern size_t sample_size;
+/* Vorbis channel index of each channel in WAVE order, by channel count */
+static const int vorbis_channel_order[MAX_CHANNELS][MAX_CHANNELS] = {
+	{ 0 },
+	{ 0, 1 },
+	{ 0, 2, 1 },
+	{ 0, 1, 2, 3 },
+	{ 0, 2, 1, 3, 4 },
+	{ 0, 2, 1, 5, 3, 4 },
+	{ 0, 2, 1, 6, 5, 3, 4 },
+	{ 0, 2, 1, 7, 5, 6, 3, 4 }
+};
 
 
 # if 0
@@ -105,6 +118,47 @@ vorbis_send_metadata(file_decoder_t * fdec, vorbis_pdata_t * pd) {
 	fdec->meta = meta;
 }
 
+/* Interleave n frames of planar decoder output in WAVE channel order,
+ * applying the volume adjustment on the way.
+ */
+static void
+vorbis_interleave(float ** pcm, const int * order, int channels,
+		  float gain, float * out, int n) {
+
+	int i, k;
+
+#ifdef __SSE__
+	if (channels == 2) {
+		const float * l = pcm[0];
+		const float * r = pcm[1];
+		__m128 g = _mm_set1_ps(gain);
+
+		for (i = 0; i + 4 <= n; i += 4) {
+			__m128 a = _mm_mul_ps(_mm_loadu_ps(l + i), g);
+			__m128 b = _mm_mul_ps(_mm_loadu_ps(r + i), g);
+			_mm_storeu_ps(out + 2*i, _mm_unpacklo_ps(a, b));
+			_mm_storeu_ps(out + 2*i + 4, _mm_unpackhi_ps(a, b));
+		}
+		for (; i < n; i++) {
+			out[2*i] = l[i] * gain;
+			out[2*i + 1] = r[i] * gain;
+		}
+		return;
+	}
+#endif /* __SSE__ */
+
+	for (k = 0; k < channels; k++) {
+		const float * in = pcm[order[k]];
+		float * o = out + k;
+
+		for (i = 0; i < n; i++) {
+			*o = in[i] * gain;
+			o += channels;
+		}
+	}
+}
+
+
 /* return 1 if reached end of stream, 0 else */
 int
 decode_vorbis(decoder_t * dec) {
@@ -112,16 +166,16 @@ decode_vorbis(decoder_t * dec) {
 	vorbis_pdata_t * pd = (vorbis_pdata_t *)dec->pdata;
 	file_decoder_t * fdec = dec->fdec;
 
-	int i;
-	long bytes_read;
-        float fbuffer[VORBIS_BUFSIZE/2];
-        char buffer[VORBIS_BUFSIZE];
+	int channels = pd->vi->channels;
+	long n_read;
+	float ** pcm;
+	float * fbuffer;
 	int current_section;
 
 
-	bytes_read = ov_read(&(pd->vf), buffer, VORBIS_BUFSIZE, bigendianp(), 2, 1, &current_section);
+	n_read = ov_read_float(&(pd->vf), &pcm, VORBIS_BUFSIZE, &current_section);
 
-	switch (bytes_read) {
+	switch (n_read) {
 	case 0:
 		/* end of file */
                 return 1;
@@ -132,21 +186,26 @@ decode_vorbis(decoder_t * dec) {
 			vorbis_decoder_send_metadata(dec);
 			break;
 		} else {
-			printf("dec_vorbis.c/decode_vorbis(): ov_read() returned OV_HOLE\n");
+			printf("dec_vorbis.c/decode_vorbis(): ov_read_float() returned OV_HOLE\n");
 			printf("This indicates an interruption in the Vorbis data (one of:\n");
 			printf("garbage between Ogg pages, loss of sync, or corrupt page).\n");
 		}
 		break;
 	case OV_EBADLINK:
-		printf("dec_vorbis.c/decode_vorbis(): ov_read() returned OV_EBADLINK\n");
+		printf("dec_vorbis.c/decode_vorbis(): ov_read_float() returned OV_EBADLINK\n");
 		printf("An invalid stream section was supplied to libvorbisfile.\n");
 		break;
 	default:
-                for (i = 0; i < bytes_read/2; i++) {
-                        fbuffer[i] = *((short *)(buffer + 2*i)) * fdec->voladj_lin / 32768.f;
+		if (n_read < 0) {
+			fprintf(stderr, "dec_vorbis.c/decode_vorbis(): ov_read_float() returned %ld\n", n_read);
+			return 1;
+		}
+		if ((fbuffer = decoder_out_begin(dec, n_read)) == NULL) {
+			return 1;
 		}
-                rb_write(pd->rb, (char *)fbuffer,
-                                      bytes_read/2 * sample_size);
+		vorbis_interleave(pcm, vorbis_channel_order[channels-1], channels,
+				  fdec->voladj_lin, fbuffer, n_read);
+		decoder_out_commit(dec, n_read);
 		break;
 	}
 	return 0;
@@ -175,7 +234,7 @@ vorbis_decoder_init(file_decoder_t * fdec) {
 	dec->open = vorbis_decoder_open;
 	dec->send_metadata = vorbis_decoder_send_metadata;
 	dec->close = vorbis_decoder_close;
-	dec->read = vorbis_decoder_read;
+	dec->decode = decode_vorbis;
 	dec->seek = vorbis_decoder_seek;
 
 	return dec;
@@ -232,14 +291,11 @@ void
 pause_vorbis_stream(decoder_t * dec) {
 
 	vorbis_pdata_t * pd = (vorbis_pdata_t *)dec->pdata;
-	char flush_dest;
 
 	httpc_close(pd->session);
 
 	if (pd->session->type == HTTPC_SESSION_STREAM) {
-		/* empty vorbis decoder ringbuffer */
-		while (rb_read_space(pd->rb))
-			rb_read(pd->rb, &flush_dest, sizeof(char));
+		decoder_out_reset(dec);
 	}
 }
 
@@ -259,7 +315,7 @@ vorbis_decoder_finish_open(decoder_t * dec) {
 	file_decoder_t * fdec = dec->fdec;
 
 	pd->vi = ov_info(&(pd->vf), -1);
-	if ((pd->vi->channels != 1) && (pd->vi->channels != 2)) {
+	if ((pd->vi->channels < 1) || (pd->vi->channels > MAX_CHANNELS)) {
 		fprintf(stderr,
 			"vorbis_decoder_open: Ogg Vorbis file with %d channels "
 			"is unsupported\n", pd->vi->channels);
@@ -273,8 +329,7 @@ vorbis_decoder_finish_open(decoder_t * dec) {
 		return DECODER_OPEN_FERROR;
 	}
 
-	pd->is_eos = 0;
-	pd->rb = rb_create(pd->vi->channels * sample_size * RB_VORBIS_SIZE);
+	decoder_out_init(dec, pd->vi->channels);
 	fdec->fileinfo.channels = pd->vi->channels;
 	fdec->fileinfo.sample_rate = pd->vi->rate;
 	if (fdec->is_stream && pd->session->type != HTTPC_SESSION_NORMAL) {
@@ -359,35 +414,7 @@ vorbis_decoder_close(decoder_t * dec) {
 	vorbis_pdata_t * pd = (vorbis_pdata_t *)dec->pdata;
 
 	ov_clear(&(pd->vf));
-	rb_free(pd->rb);
-}
-
-
-unsigned int
-vorbis_decoder_read(decoder_t * dec, float * dest, int num) {
-
-	vorbis_pdata_t * pd = (vorbis_pdata_t *)dec->pdata;
-
-	unsigned int numread = 0;
-	unsigned int n_avail = 0;
-
-
-	while ((rb_read_space(pd->rb) <
-		num * pd->vi->channels * sample_size) && (!pd->is_eos)) {
-
-		pd->is_eos = decode_vorbis(dec);
-	}
-
-	n_avail = rb_read_space(pd->rb) /
-		(pd->vi->channels * sample_size);
-
-	if (n_avail > num)
-		n_avail = num;
-
-	rb_read(pd->rb, (char *)dest, n_avail *
-			     pd->vi->channels * sample_size);
-	numread = n_avail;
-	return numread;
+	decoder_out_free(dec);
 }
 
 
@@ -396,16 +423,13 @@ vorbis_decoder_seek(decoder_t * dec, unsigned long long seek_to_pos) {
 
 	vorbis_pdata_t * pd = (vorbis_pdata_t *)dec->pdata;
 	file_decoder_t * fdec = dec->fdec;
-	char flush_dest;
 
 	if (fdec->is_stream && pd->session->type != HTTPC_SESSION_NORMAL)
 		return;
 
 	if (ov_pcm_seek(&(pd->vf), seek_to_pos) == 0) {
 		fdec->samples_left = fdec->fileinfo.total_samples - seek_to_pos;
-		/* empty vorbis decoder ringbuffer */
-		while (rb_read_space(pd->rb))
-			rb_read(pd->rb, &flush_dest, sizeof(char));
+		decoder_out_reset(dec);
 	} else {
 		fprintf(stderr, "vorbis_decoder_seek: warning: ov_pcm_seek() failed\n");
 	}
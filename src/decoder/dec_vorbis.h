@@ -32,22 +32,17 @@
 #endif /* _WIN32 */
 
 #include "../httpc.h"
-#include "../rb.h"
 #include "file_decoder.h"
 
 
-/* Decoding buffer size for Vorbis */
+/* most frames taken from libvorbisfile at a time */
 #define VORBIS_BUFSIZE 4096
-/* size of ringbuffer for decoded Vorbis data (in frames) */
-#define RB_VORBIS_SIZE 262144
 
 
 typedef struct _vorbis_pdata_t {
-        rb_t * rb;
         FILE * vorbis_file;
         OggVorbis_File vf;
         vorbis_info * vi;
-        int is_eos;
 	http_session_t * session;
 } vorbis_pdata_t;
 
@@ -58,7 +53,7 @@ int vorbis_decoder_open(decoder_t * dec, char * filename);
 void vorbis_decoder_send_metadata(decoder_t * dec);
 int vorbis_stream_decoder_open(decoder_t * dec, http_session_t * session);
 void vorbis_decoder_close(decoder_t * dec);
-unsigned int vorbis_decoder_read(decoder_t * dec, float * dest, int num);
+int decode_vorbis(decoder_t * dec);
 void vorbis_decoder_seek(decoder_t * dec, unsigned long long seek_to_pos);
 
 
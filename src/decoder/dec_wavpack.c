@@ -29,14 +29,10 @@
 
 #include "../metadata.h"
 #include "../metadata_ape.h"
-#include "../rb.h"
 #include "file_decoder.h"
 #include "dec_wavpack.h"
 
 
-extern size_t sample_size;
-
-
 int
 decode_wavpack(decoder_t * dec) {
 
@@ -44,9 +40,8 @@ decode_wavpack(decoder_t * dec) {
 	wavpack_pdata_t * pd = (wavpack_pdata_t *)dec->pdata;
 
 	int32_t buffer[WAVPACK_BUFSIZE];
-	uint i, j;
-
-	float fval[fdec->fileinfo.channels];
+	uint i;
+	float * fval;
 
 	pd->last_decoded_samples = WavpackUnpackSamples(pd->wpc, buffer,
 							WAVPACK_BUFSIZE / fdec->fileinfo.channels);
@@ -73,19 +68,20 @@ decode_wavpack(decoder_t * dec) {
 	if (pd->last_decoded_samples == 0)
 		return 1;
 
-	for (i = 0; i < pd->last_decoded_samples * fdec->fileinfo.channels; i += fdec->fileinfo.channels) {
-		for (j = 0; j < fdec->fileinfo.channels; j++) {
+	if ((fval = decoder_out_begin(dec, pd->last_decoded_samples)) == NULL)
+		return 1;
+
+	for (i = 0; i < pd->last_decoded_samples * fdec->fileinfo.channels; i++) {
 
-			fval[j] = buffer[i+j] * fdec->voladj_lin / pd->scale_factor_float;
+		fval[i] = buffer[i] * fdec->voladj_lin / pd->scale_factor_float;
 
-			if (fval[j] < -1.0f) {
-				fval[j] = -1.0f;
-			} else if (fval[j] > 1.0f) {
-				fval[j] = 1.0f;
-			}
+		if (fval[i] < -1.0f) {
+			fval[i] = -1.0f;
+		} else if (fval[i] > 1.0f) {
+			fval[i] = 1.0f;
 		}
-		rb_write(pd->rb, (char *)fval, fdec->fileinfo.channels * sample_size);
 	}
+	decoder_out_commit(dec, pd->last_decoded_samples);
 
 	return 0;
 }
@@ -113,7 +109,7 @@ wavpack_decoder_init(file_decoder_t * fdec) {
 	dec->open = wavpack_decoder_open;
 	dec->send_metadata = wavpack_decoder_send_metadata;
 	dec->close = wavpack_decoder_close;
-	dec->read = wavpack_decoder_read;
+	dec->decode = decode_wavpack;
 	dec->seek = wavpack_decoder_seek;
 
 	return dec;
@@ -154,9 +150,7 @@ wavpack_decoder_open(decoder_t * dec, char * filename) {
 					* fdec->fileinfo.channels;
 		pd->bits_per_sample = WavpackGetBitsPerSample(pd->wpc);
 
-		pd->rb = rb_create(fdec->fileinfo.channels * sample_size * RB_WAVPACK_SIZE);
-
-		pd->end_of_file = 0;
+		decoder_out_init(dec, fdec->fileinfo.channels);
 
 		/* It's best to calculate the scale factor in advance and store it */
 		pd->scale_factor_float = 1;
@@ -193,34 +187,7 @@ wavpack_decoder_close(decoder_t * dec) {
 	wavpack_pdata_t * pd = (wavpack_pdata_t *)dec->pdata;
 
 	WavpackCloseFile(pd->wpc);
-	rb_free(pd->rb);
-}
-
-
-unsigned int
-wavpack_decoder_read(decoder_t * dec, float * dest, int num) {
-
-	file_decoder_t * fdec = dec->fdec;
-	wavpack_pdata_t * pd = (wavpack_pdata_t *)dec->pdata;
-
-	while ((rb_read_space(pd->rb) < num * fdec->fileinfo.channels * sample_size) &&
-	       (pd->end_of_file == 0)) {
-
-			pd->end_of_file = decode_wavpack(dec);
-	}
-
-	uint actual_num = 0;
-	uint n_avail = rb_read_space(pd->rb) / (fdec->fileinfo.channels * sample_size);
-
-	if ( num > n_avail ) {
-		actual_num = n_avail;
-	} else {
-		actual_num = num;
-	}
-
-	rb_read(pd->rb, (char *)dest, actual_num * sample_size * fdec->fileinfo.channels);
-
-	return actual_num;
+	decoder_out_free(dec);
 }
 
 
@@ -229,13 +196,10 @@ wavpack_decoder_seek(decoder_t * dec, unsigned long long seek_to_pos) {
 
 	file_decoder_t * fdec = dec->fdec;
 	wavpack_pdata_t * pd = (wavpack_pdata_t *)dec->pdata;
-	char flush_dest;
 
 	if (WavpackSeekSample(pd->wpc, seek_to_pos) == 1) {
 		fdec->samples_left = fdec->fileinfo.total_samples - seek_to_pos;
-		/* Empty ringbuffer */
-		while (rb_read_space(pd->rb))
-			rb_read(pd->rb, &flush_dest, sizeof(char));
+		decoder_out_reset(dec);
 	} else {
 		fprintf(stderr, "wavpack_decoder_seek: warning: WavpackSeekSample() failed\n");
 	}
@@ -23,22 +23,18 @@
 
 #include <wavpack/wavpack.h>
 
-#include "../rb.h"
 #include "file_decoder.h"
 
 
-#define RB_WAVPACK_SIZE 262144
 #define WAVPACK_BUFSIZE 4096
 
 
 typedef struct _wavpack_pdata_t {
 	WavpackContext *wpc;
-	rb_t * rb;
 	int flags;
 	char error[100];
 	int last_decoded_samples;
 	int bits_per_sample;
-	int end_of_file;
 	float scale_factor_float;
 } wavpack_pdata_t;
 
@@ -47,7 +43,7 @@ void wavpack_decoder_destroy(decoder_t * dec);
 int wavpack_decoder_open(decoder_t * dec, char * filename);
 void wavpack_decoder_send_metadata(decoder_t * dec);
 void wavpack_decoder_close(decoder_t * dec);
-unsigned int wavpack_decoder_read(decoder_t * dec, float * dest, int num);
+int decode_wavpack(decoder_t * dec);
 void wavpack_decoder_seek(decoder_t * dec, unsigned long long seek_to_pos);
 
 
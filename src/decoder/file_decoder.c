@@ -212,12 +212,8 @@ file_decoder_delete(file_decoder_t * fdec) {
 int
 file_decoder_finalize_open(file_decoder_t * fdec, decoder_t * dec, char * filename) {
 
-	if (fdec->fileinfo.channels == 1) {
-		fdec->fileinfo.is_mono = 1;
-		goto ok_open;
-
-	} else if (fdec->fileinfo.channels == 2) {
-		fdec->fileinfo.is_mono = 0;
+	if (fdec->fileinfo.channels >= 1 && fdec->fileinfo.channels <= MAX_CHANNELS) {
+		fdec->fileinfo.is_mono = (fdec->fileinfo.channels == 1);
 		goto ok_open;
 
 	} else {
@@ -362,12 +358,8 @@ file_decoder_open(file_decoder_t * fdec, char * filename) {
 	        goto no_open;
 	}
 
-	if (fdec->fileinfo.channels == 1) {
-		fdec->fileinfo.is_mono = 1;
-		goto ok_open;
-
-	} else if (fdec->fileinfo.channels == 2) {
-		fdec->fileinfo.is_mono = 0;
+	if (fdec->fileinfo.channels >= 1 && fdec->fileinfo.channels <= MAX_CHANNELS) {
+		fdec->fileinfo.is_mono = (fdec->fileinfo.channels == 1);
 		goto ok_open;
 
 	} else {
@@ -442,12 +434,137 @@ file_decoder_close(file_decoder_t * fdec) {
 }
 
 
+void
+decoder_out_init(decoder_t * dec, int channels) {
+
+	decoder_out_t * out = &dec->out;
+
+	decoder_out_free(dec);
+	out->channels = channels;
+}
+
+
+void
+decoder_out_reset(decoder_t * dec) {
+
+	dec->out.over_pos = dec->out.over_len = 0;
+}
+
+
+void
+decoder_out_free(decoder_t * dec) {
+
+	decoder_out_t * out = &dec->out;
+
+	free(out->over);
+	out->over = NULL;
+	out->over_pos = out->over_len = out->over_size = 0;
+}
+
+
+/* move held over frames to the caller's buffer, as far as they fit */
+static void
+decoder_out_drain(decoder_out_t * out) {
+
+	int n = out->over_len - out->over_pos;
+
+	if (n > out->dest_left) {
+		n = out->dest_left;
+	}
+	if (n <= 0) {
+		return;
+	}
+
+	memcpy(out->dest, out->over + out->over_pos * out->channels,
+	       n * out->channels * sizeof(float));
+	out->dest += n * out->channels;
+	out->dest_left -= n;
+	out->frames_copied += n;
+
+	out->over_pos += n;
+	if (out->over_pos == out->over_len) {
+		out->over_pos = out->over_len = 0;
+	}
+}
+
+
+float *
+decoder_out_begin(decoder_t * dec, int n) {
+
+	decoder_out_t * out = &dec->out;
+
+	if (out->over_len == 0 && n <= out->dest_left) {
+		out->direct = 1;
+		return out->dest;
+	}
+
+	out->direct = 0;
+	if (out->over_pos > 0) {
+		memmove(out->over, out->over + out->over_pos * out->channels,
+			(out->over_len - out->over_pos) * out->channels * sizeof(float));
+		out->over_len -= out->over_pos;
+		out->over_pos = 0;
+	}
+	if (out->over_len + n > out->over_size) {
+		int size = 2 * out->over_size;
+		float * over;
+
+		if (size < out->over_len + n) {
+			size = out->over_len + n;
+		}
+		if ((over = realloc(out->over, size * out->channels * sizeof(float))) == NULL) {
+			fprintf(stderr, "decoder_out_begin: realloc error\n");
+			return NULL;
+		}
+		out->over = over;
+		out->over_size = size;
+	}
+	return out->over + out->over_len * out->channels;
+}
+
+
+void
+decoder_out_commit(decoder_t * dec, int n) {
+
+	decoder_out_t * out = &dec->out;
+
+	if (out->direct) {
+		out->dest += n * out->channels;
+		out->dest_left -= n;
+		out->frames_direct += n;
+		return;
+	}
+
+	out->over_len += n;
+	decoder_out_drain(out);
+}
+
+
 unsigned int
 file_decoder_read(file_decoder_t * fdec, float * dest, int num) {
 
 	decoder_t * dec = (decoder_t *)(fdec->pdec);
+	decoder_out_t * out = &dec->out;
+	unsigned int n;
+
+	if (dec->decode == NULL) {
+		return dec->read(dec, dest, num);
+	}
+
+	out->dest = dest;
+	out->dest_left = num;
+
+	decoder_out_drain(out);
+	while (out->dest_left > 0) {
+		if (dec->decode(dec)) {
+			break;
+		}
+	}
 
-	return dec->read(dec, dest, num);
+	n = num - out->dest_left;
+	out->dest = NULL;
+	out->dest_left = 0;
+	return n;
 }
 
 
@@ -50,6 +50,9 @@ extern "C" {
 #define FORMAT_VBR 0x0001
 #define FORMAT_UBR 0x0002
 
+/* the most channels a decoder may deliver */
+#define MAX_CHANNELS 8
+
 typedef struct _fileinfo_t {
         unsigned long long total_samples;
         unsigned long sample_rate;
@@ -91,6 +94,23 @@ typedef struct _file_decoder_t {
 } file_decoder_t;
 
 
+/* Where decoder_t.decode() puts its output: straight into the buffer
+   passed to file_decoder_read() as long as the block fits, otherwise
+   into an overflow area that is handed out on the next read. */
+typedef struct _decoder_out_t {
+	float * dest;
+	int dest_left;      /* frames */
+	int channels;
+	int direct;         /* last decoder_out_begin() returned dest */
+	float * over;
+	int over_pos;       /* frames */
+	int over_len;
+	int over_size;
+	unsigned long long frames_direct;
+	unsigned long long frames_copied;
+} decoder_out_t;
+
+
 typedef struct _decoder_t {
 
 	file_decoder_t * fdec;
@@ -103,6 +123,10 @@ typedef struct _decoder_t {
 	void (* set_rva)(struct _decoder_t * dec, float voladj);
 	void (* close)(struct _decoder_t * dec);
 	unsigned int (* read)(struct _decoder_t * dec, float * dest, int num);
+	/* Decode the next block through decoder_out_begin/commit().
+	   Return nonzero at end of stream or on error. If set, this is
+	   used instead of read(). */
+	int (* decode)(struct _decoder_t * dec);
 	void (* seek)(struct _decoder_t * dec, unsigned long long seek_to_pos);
 
 	/* optional callbacks for stream decoders */
@@ -111,6 +135,8 @@ typedef struct _decoder_t {
 
 	char format_str[MAXLEN];
 	int format_flags;
+
+	decoder_out_t out;
 } decoder_t;
 
 
@@ -120,6 +146,18 @@ typedef struct _decoder_t {
 #define DECODER_OPEN_FERROR  2
 
 
+/* Output of decoders implementing decode(): call decoder_out_init()
+ * once the channel count is known, decoder_out_reset() after seeking
+ * and decoder_out_free() on close. decoder_out_begin() returns room
+ * for n frames (NULL on allocation failure), decoder_out_commit()
+ * hands the first n of them on.
+ */
+void decoder_out_init(decoder_t * dec, int channels);
+void decoder_out_reset(decoder_t * dec);
+void decoder_out_free(decoder_t * dec);
+float * decoder_out_begin(decoder_t * dec, int n);
+void decoder_out_commit(decoder_t * dec, int n);
+
 int is_valid_extension(char ** valid_extensions, char * filename, int module);
 
 void file_decoder_init(void);
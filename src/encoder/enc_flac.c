@@ -72,14 +72,14 @@ int
 flac_encoder_open(encoder_t * enc, encoder_mode_t * mode) {
 
 	flac_pencdata_t * pd = (flac_pencdata_t *)enc->pdata;
-	int i;
 	FLAC__StreamEncoderInitStatus state;
+	int bits = (mode->bits == 24) ? 24 : 16;
 
 	pd->encoder = FLAC__stream_encoder_new();
 	if (pd->encoder == NULL)
 		return -1;
 	
-	FLAC__stream_encoder_set_bits_per_sample(pd->encoder, 16);
+	FLAC__stream_encoder_set_bits_per_sample(pd->encoder, bits);
 	FLAC__stream_encoder_set_channels(pd->encoder, mode->channels);
 	FLAC__stream_encoder_set_sample_rate(pd->encoder, mode->sample_rate);
 	FLAC__stream_encoder_set_verify(pd->encoder, true);
@@ -95,12 +95,10 @@ flac_encoder_open(encoder_t * enc, encoder_mode_t * mode) {
 
 	pd->mode = *mode;
 
-	pd->buf = (FLAC__int32 **)calloc(mode->channels, sizeof(FLAC__int32 *));
-	for (i = 0; i < mode->channels; i++) {
-		pd->buf[i] = NULL;
-	}
+	pd->buf = NULL;
 	pd->bufsize = 0;
 	pd->channels = mode->channels;
+	enc_pack_init(&pd->pack, bits, bits, mode->dither);
 	return 0;
 }
 
@@ -109,26 +107,21 @@ unsigned int
 flac_encoder_write(encoder_t * enc, float * data, int num) {
 
 	flac_pencdata_t * pd = (flac_pencdata_t *)enc->pdata;
-	int i, n = 0;
 	FLAC__bool b;
 
 	if (pd->bufsize < num) {
-		int k;
-		for (k = 0; k < pd->channels; k++) {
-			pd->buf[k] = realloc(pd->buf[k], num * sizeof(FLAC__int32));
+		free(pd->buf);
+		if ((pd->buf = (FLAC__int32 *)malloc(num * pd->channels * sizeof(FLAC__int32))) == NULL) {
+			fprintf(stderr, "enc_flac.c: flac_encoder_write() failed: malloc error\n");
+			pd->bufsize = 0;
+			return 0;
 		}
 		pd->bufsize = num;
 	}
 
-	for (i = 0; i < num; i++) {
-		int k;
-		for (k = 0; k < pd->channels; k++) {
-			pd->buf[k][i] = data[n] * (1<<15);
-			++n;
-		}
-	}
+	enc_pack_interleaved(&pd->pack, data, (int *)pd->buf, num * pd->channels);
 
-	b = FLAC__stream_encoder_process(pd->encoder, (const FLAC__int32 **)pd->buf, num);
+	b = FLAC__stream_encoder_process_interleaved(pd->encoder, pd->buf, num);
 	if (b != true) {
 		fprintf(stderr, "FLAC__stream_encoder_process returned error: %s\n",
 			FLAC__StreamEncoderStateString[FLAC__stream_encoder_get_state(pd->encoder)]);
@@ -226,13 +219,8 @@ flac_encoder_close(encoder_t * enc) {
 	FLAC__stream_encoder_finish(pd->encoder);
 	FLAC__stream_encoder_delete(pd->encoder);
 
-	if (pd->bufsize > 0) {
-		int k;
-		for (k = 0; k < pd->channels; k++) {
-			free(pd->buf[k]);
-		}
-	}
 	free(pd->buf);
+	enc_pack_free(&pd->pack);
 
 	if (pd->mode.write_meta) {
 		flac_encoder_write_meta(enc);
@@ -26,15 +26,17 @@
 #include <FLAC/stream_encoder.h>
 #endif /* HAVE_FLAC_ENC */
 
+#include "enc_pack.h"
 #include "file_encoder.h"
 
 
 #ifdef HAVE_FLAC_ENC
 typedef struct _flac_pencdata_t {
 	FLAC__StreamEncoder * encoder;
-	FLAC__int32 ** buf;
+	FLAC__int32 * buf;
 	int bufsize;
 	int channels;
+	enc_pack_t pack;
 	encoder_mode_t mode;
 } flac_pencdata_t;
 #endif /* HAVE_FLAC_ENC */
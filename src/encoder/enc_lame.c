@@ -123,6 +123,8 @@ lame_encoder_open(encoder_t * enc, encoder_mode_t * mode) {
 
 	pd->channels = mode->channels;
 	pd->rb = rb_create(mode->channels * sizeof(float) * RB_LAME_SIZE);
+	/* feed LAME 24 bit resolution through its 32 bit int interface */
+	enc_pack_init(&pd->pack, 24, 32, 0);
 
 	lame_set_num_channels(pd->gf, mode->channels);
 	lame_set_in_samplerate(pd->gf, mode->sample_rate);
@@ -163,9 +165,10 @@ lame_encoder_open(encoder_t * enc, encoder_mode_t * mode) {
 void
 lame_encode_block(lame_pencdata_t * pd) {
 
-	int i;
-	short int l[LAME_READ];
-	short int r[LAME_READ];
+	float f[2*LAME_READ];
+	int l[LAME_READ];
+	int r[LAME_READ];
+	int * lr[2] = { l, r };
 	unsigned char mp3buf[LAME_BUFSIZE];
 	int n_encoded;
 	int n_avail = rb_read_space(pd->rb) / pd->channels / sizeof(float);
@@ -173,20 +176,11 @@ lame_encode_block(lame_pencdata_t * pd) {
 	if (n_avail > LAME_READ)
 		n_avail = LAME_READ;
 
-	for (i = 0; i < n_avail; i++) {
-		float f;
-
-		rb_read(pd->rb, (char *)&f, sizeof(float));
-		l[i] = 32768.0 * f;
-		if (pd->channels == 2) {
-			rb_read(pd->rb, (char *)&f, sizeof(float));
-			r[i] = 32768.0 * f;
-		} else {
-			r[i] = l[i];
-		}
-	}
+	rb_read(pd->rb, (char *)f, n_avail * pd->channels * sizeof(float));
+	enc_pack_planar(&pd->pack, f, lr, n_avail, pd->channels);
 
-	n_encoded = lame_encode_buffer(pd->gf, l, r, n_avail, mp3buf, LAME_BUFSIZE);
+	n_encoded = lame_encode_buffer_int(pd->gf, l, (pd->channels == 2) ? r : l,
+					   n_avail, mp3buf, LAME_BUFSIZE);
 
 	if (n_encoded < 0) {
 		printf("enc_lame.c: encoding error\n");
@@ -223,6 +217,7 @@ lame_encoder_close(encoder_t * enc) {
 	int n_encoded;
 
 	lame_encode_block(pd);
+	enc_pack_free(&pd->pack);
 	
 	n_encoded = lame_encode_flush(pd->gf, mp3buf, LAME_BUFSIZE);
 
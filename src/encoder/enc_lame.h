@@ -27,6 +27,7 @@
 #endif /* HAVE_LAME */
 
 #include "../rb.h"
+#include "enc_pack.h"
 #include "file_encoder.h"
 
 
@@ -41,6 +42,7 @@ typedef struct _lame_pencdata_t {
 	rb_t * rb;
 	lame_global_flags * gf;
 	int channels;
+	enc_pack_t pack;
 } lame_pencdata_t;
 #endif /* HAVE_LAME */
 
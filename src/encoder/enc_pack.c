@@ -0,0 +1,190 @@
+/*                                                     -*- linux-c -*-
+    Copyright (C) 2026 Aqualung contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+    $Id$
+*/
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif /* __SSE2__ */
+
+#include "enc_pack.h"
+
+
+void
+enc_pack_init(enc_pack_t * pk, int bits, int container_bits, int dither) {
+
+	int i;
+
+	if (bits != 24) {
+		bits = 16;
+	}
+	if (container_bits < bits) {
+		container_bits = bits;
+	}
+
+	pk->bits = bits;
+	pk->shift = container_bits - bits;
+	pk->dither = dither;
+	pk->scale = (float)(1 << (bits - 1));
+
+	for (i = 0; i < 4; i++) {
+		pk->seed[i] = 0x9e3779b9U * (i + 1);
+		pk->prev[i] = 0.0f;
+	}
+
+	pk->tmp = NULL;
+	pk->tmp_size = 0;
+}
+
+
+void
+enc_pack_free(enc_pack_t * pk) {
+
+	free(pk->tmp);
+	pk->tmp = NULL;
+	pk->tmp_size = 0;
+}
+
+
+/* Uniform [0,1) from one xorshift32 step; the difference of successive
+   values gives highpassed triangular (TPDF) dither of +/- 1 LSB. */
+static inline float
+enc_pack_tpdf(enc_pack_t * pk, int lane) {
+
+	unsigned int x = pk->seed[lane];
+	float u, d;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	pk->seed[lane] = x;
+
+	u = (float)(x >> 8) * (1.0f / 16777216.0f);
+	d = u - pk->prev[lane];
+	pk->prev[lane] = u;
+	return d;
+}
+
+
+void
+enc_pack_interleaved(enc_pack_t * pk, const float * in, int * out, int n) {
+
+	const float lo = -pk->scale;
+	const float hi = pk->scale - 1.0f;
+	int i = 0;
+
+#ifdef __SSE2__
+	{
+		__m128 vscale = _mm_set1_ps(pk->scale);
+		__m128 vlo = _mm_set1_ps(lo);
+		__m128 vhi = _mm_set1_ps(hi);
+		__m128 vnorm = _mm_set1_ps(1.0f / 16777216.0f);
+		__m128i vshift = _mm_cvtsi32_si128(pk->shift);
+		__m128i seed = _mm_loadu_si128((__m128i *)pk->seed);
+		__m128 prev = _mm_loadu_ps(pk->prev);
+
+		for (; i + 4 <= n; i += 4) {
+
+			__m128 v = _mm_mul_ps(_mm_loadu_ps(in + i), vscale);
+			__m128i q;
+
+			if (pk->dither) {
+				__m128 u;
+
+				seed = _mm_xor_si128(seed, _mm_slli_epi32(seed, 13));
+				seed = _mm_xor_si128(seed, _mm_srli_epi32(seed, 17));
+				seed = _mm_xor_si128(seed, _mm_slli_epi32(seed, 5));
+				u = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(seed, 8)), vnorm);
+				v = _mm_add_ps(v, _mm_sub_ps(u, prev));
+				prev = u;
+			}
+
+			v = _mm_min_ps(_mm_max_ps(v, vlo), vhi);
+			q = _mm_sll_epi32(_mm_cvtps_epi32(v), vshift);
+			_mm_storeu_si128((__m128i *)(out + i), q);
+		}
+
+		_mm_storeu_si128((__m128i *)pk->seed, seed);
+		_mm_storeu_ps(pk->prev, prev);
+	}
+#endif /* __SSE2__ */
+
+	for (; i < n; i++) {
+
+		float v = in[i] * pk->scale;
+
+		if (pk->dither) {
+			v += enc_pack_tpdf(pk, i & 3);
+		}
+		if (v < lo) {
+			v = lo;
+		} else if (v > hi) {
+			v = hi;
+		}
+		out[i] = (int)((unsigned int)lrintf(v) << pk->shift);
+	}
+}
+
+
+void
+enc_pack_planar(enc_pack_t * pk, const float * in, int ** out, int frames, int channels) {
+
+	int i, k;
+	int n = frames * channels;
+	int * tmp;
+
+	if (pk->tmp_size < n) {
+		free(pk->tmp);
+		if ((pk->tmp = (int *)malloc(n * sizeof(int))) == NULL) {
+			fprintf(stderr, "enc_pack_planar(): malloc error\n");
+			pk->tmp_size = 0;
+			return;
+		}
+		pk->tmp_size = n;
+	}
+
+	tmp = pk->tmp;
+	enc_pack_interleaved(pk, in, tmp, n);
+
+	if (channels == 2) {
+		int * l = out[0];
+		int * r = out[1];
+		for (i = 0; i < frames; i++) {
+			l[i] = tmp[2*i];
+			r[i] = tmp[2*i+1];
+		}
+		return;
+	}
+
+	for (k = 0; k < channels; k++) {
+		int * o = out[k];
+		for (i = 0; i < frames; i++) {
+			o[i] = tmp[i*channels + k];
+		}
+	}
+}
+
+
+// vim: shiftwidth=8:tabstop=8:softtabstop=8 :  
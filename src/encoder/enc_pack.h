@@ -0,0 +1,59 @@
+/*                                                     -*- linux-c -*-
+    Copyright (C) 2026 Aqualung contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+    $Id$
+*/
+
+#ifndef AQUALUNG_ENC_PACK_H
+#define AQUALUNG_ENC_PACK_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* float -> integer sample packing shared by the PCM-based encoders */
+
+typedef struct _enc_pack_t {
+	int bits;  /* significant bits per sample */
+	int shift; /* left shift to place them into the output container */
+	int dither;
+	float scale;
+	unsigned int seed[4]; /* xorshift state of the four dither lanes */
+	float prev[4];
+	int * tmp; /* interleaved scratch for enc_pack_planar() */
+	int tmp_size;
+} enc_pack_t;
+
+
+/* bits: 16 or 24, container_bits: width the samples are aligned to
+   (bits for FLAC, 32 for libsndfile and LAME's int interface) */
+void enc_pack_init(enc_pack_t * pk, int bits, int container_bits, int dither);
+void enc_pack_free(enc_pack_t * pk);
+
+/* n is the number of samples (frames * channels) */
+void enc_pack_interleaved(enc_pack_t * pk, const float * in, int * out, int n);
+void enc_pack_planar(enc_pack_t * pk, const float * in, int ** out, int frames, int channels);
+
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* AQUALUNG_ENC_PACK_H */
+
+// vim: shiftwidth=8:tabstop=8:softtabstop=8 :  
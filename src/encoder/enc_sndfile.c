@@ -67,14 +67,21 @@ int
 sndfile_encoder_open(encoder_t * enc, encoder_mode_t * mode) {
 
 	sndfile_pencdata_t * pd = (sndfile_pencdata_t *)enc->pdata;
+	int bits = (mode->bits == 24) ? 24 : 16;
 
 	pd->sf_info.samplerate = mode->sample_rate;
 	pd->sf_info.channels = mode->channels;
-	pd->sf_info.format = SF_FORMAT_WAV | SF_FORMAT_PCM_16;
+	pd->sf_info.format = SF_FORMAT_WAV | ((bits == 24) ? SF_FORMAT_PCM_24 : SF_FORMAT_PCM_16);
         if ((pd->sf = sf_open(mode->filename, SFM_WRITE, &(pd->sf_info))) == NULL) {
 		return -1;
 	}
 
+	/* sf_writef_int() takes left-justified 32 bit samples */
+	pd->buf = NULL;
+	pd->bufsize = 0;
+	pd->channels = mode->channels;
+	enc_pack_init(&pd->pack, bits, 32, mode->dither);
+
 	return 0;
 }
 
@@ -85,6 +92,8 @@ sndfile_encoder_close(encoder_t * enc) {
 	sndfile_pencdata_t * pd = (sndfile_pencdata_t *)enc->pdata;
 
 	sf_close(pd->sf);
+	free(pd->buf);
+	enc_pack_free(&pd->pack);
 }
 
 
@@ -94,7 +103,18 @@ sndfile_encoder_write(encoder_t * enc, float * data, int num) {
 	sndfile_pencdata_t * pd = (sndfile_pencdata_t *)enc->pdata;
 	unsigned int numwritten = 0;
 
-	numwritten = sf_writef_float(pd->sf, data, num);
+	if (pd->bufsize < num) {
+		free(pd->buf);
+		if ((pd->buf = (int *)malloc(num * pd->channels * sizeof(int))) == NULL) {
+			fprintf(stderr, "enc_sndfile.c: sndfile_encoder_write() failed: malloc error\n");
+			pd->bufsize = 0;
+			return 0;
+		}
+		pd->bufsize = num;
+	}
+
+	enc_pack_interleaved(&pd->pack, data, pd->buf, num * pd->channels);
+	numwritten = sf_writef_int(pd->sf, pd->buf, num);
 
 	return numwritten;
 }
@@ -25,6 +25,7 @@
 #include <sndfile.h>
 #endif /* HAVE_SNDFILE_ENC */
 
+#include "enc_pack.h"
 #include "file_encoder.h"
 
 
@@ -32,6 +33,10 @@
 typedef struct _sndfile_pencdata_t {
 	SF_INFO sf_info;
 	SNDFILE * sf;
+	int * buf;
+	int bufsize;
+	int channels;
+	enc_pack_t pack;
 } sndfile_pencdata_t;
 #endif /* HAVE_SNDFILE_ENC */
 
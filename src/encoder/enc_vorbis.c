@@ -32,6 +32,22 @@
 #include "../common.h"
 #include "../metadata.h"
 #include "../rb.h"
+#include "../decoder/file_decoder.h"
+
+
+/* Vorbis channel index of each channel in WAVE order, by channel count;
+ * the same table dec_vorbis.c decodes with
+ */
+static const int vorbis_channel_order[MAX_CHANNELS][MAX_CHANNELS] = {
+	{ 0 },
+	{ 0, 1 },
+	{ 0, 2, 1 },
+	{ 0, 1, 2, 3 },
+	{ 0, 2, 1, 3, 4 },
+	{ 0, 2, 1, 5, 3, 4 },
+	{ 0, 2, 1, 6, 5, 3, 4 },
+	{ 0, 2, 1, 7, 5, 6, 3, 4 }
+};
 
 
 encoder_t *
@@ -156,10 +172,13 @@ vorbisenc_read_and_analyse(vorbisenc_pencdata_t * pd, int n_frames) {
 
 	int i, j;
 	float ** buffer = vorbis_analysis_buffer(&pd->vd, n_frames);
-	
+	const int * order = vorbis_channel_order[pd->channels-1];
+	float frame[MAX_CHANNELS];
+
 	for (i = 0; i < n_frames; i++) {
+		rb_read(pd->rb, (char *)frame, pd->channels * sizeof(float));
 		for (j = 0; j < pd->channels; j++) {
-			rb_read(pd->rb, (char *)(&(buffer[j][i])), sizeof(float));
+			buffer[order[j]][i] = frame[j];
 		}
 	}
 	vorbis_analysis_wrote(&pd->vd, n_frames);
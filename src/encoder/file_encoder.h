@@ -47,6 +47,8 @@ typedef struct _encoder_mode_t {
         int bps; /* meaningful only with Vorbis and LAME */
 	int vbr; /* meaningful only with LAME */
 	int clevel; /* 0(fastest)-8(best), meaningful only with FLAC */
+	int bits; /* 16 (default if 0) or 24, meaningful only with FLAC and WAV */
+	int dither; /* dither when requantizing to 16 bits */
 	int write_meta;
 	metadata_t * meta;
 } encoder_mode_t;
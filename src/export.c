@@ -27,7 +27,17 @@
 #include <unistd.h>
 #include <errno.h>
 #include <fnmatch.h>
+#include <fcntl.h>
 #include <sys/stat.h>
+#ifdef HAVE_SYS_IOCTL_H
+#include <sys/ioctl.h>
+#endif /* HAVE_SYS_IOCTL_H */
+#ifdef HAVE_LINUX_FS_H
+#include <linux/fs.h>
+#endif /* HAVE_LINUX_FS_H */
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif /* HAVE_SYS_SENDFILE_H */
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <glib-object.h>
@@ -39,6 +49,7 @@
 #include "i18n.h"
 #include "utils.h"
 #include "utils_gui.h"
+#include "channels.h"
 #include "decoder/file_decoder.h"
 #include "encoder/file_encoder.h"
 #include "encoder/enc_lame.h"
@@ -48,6 +59,15 @@
 
 
 #define BUFSIZE 10240
+/* of each worker's sample buffer, which plain read/write copies go through too */
+#define WORKER_BUF_BYTES (MAX_CHANNELS * BUFSIZE * sizeof(float))
+
+/* bytes moved per kernel-side copy call, between progress updates */
+#define EXPORT_COPY_CHUNK (1 << 20)
+
+#define EXPORT_COPY_RANGE    0
+#define EXPORT_COPY_SENDFILE 1
+#define EXPORT_COPY_RW       2
 
 extern GtkWidget * main_window;
 extern options_t options;
@@ -203,9 +223,13 @@ export_new(void) {
 		return NULL;
 	}
 
-#ifndef HAVE_LIBPTHREAD
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_init(&export->mutex, NULL);
+	pthread_mutex_init(&export->io_mutex, NULL);
+#else
         export->mutex = g_mutex_new();
-#endif /* !HAVE_LIBPTHREAD */
+        export->io_mutex = g_mutex_new();
+#endif /* HAVE_LIBPTHREAD */
 
 	return export;
 }
@@ -225,11 +249,23 @@ void
 export_free(export_t * export) {
 
 	GSList * node;
+	int i;
 
 #ifndef HAVE_LIBPTHREAD
 	g_mutex_free(export->mutex);
+	g_mutex_free(export->io_mutex);
 #endif /* !HAVE_LIBPTHREAD */
 
+	for (i = 0; i < export->n_workers; i++) {
+		if (export->workers[i].timer != NULL) {
+			g_timer_destroy(export->workers[i].timer);
+		}
+	}
+
+	if (export->timer != NULL) {
+		g_timer_destroy(export->timer);
+	}
+
 	for (node = export->slist; node; node = node->next) {
 		export_item_free((export_item_t *)node->data);
 	}
@@ -347,13 +383,58 @@ update_progbar_ratio(gpointer user_data) {
 
 	if (export->slot) {
 
-		char tmp[16];
+		char tmp[64];
+		GString * stats = g_string_new(NULL);
+		double ratio = 0.0;
+		double elapsed;
+		double batch_elapsed = 0.0;
+		long long bytes = 0;
+		int n_done, n_items;
+		int i;
 
 		AQUALUNG_MUTEX_LOCK(export->mutex);
-		arr_snprintf(tmp, "%d%%", (int)(export->ratio * 100));
-		gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(export->progbar), export->ratio);
+		if (export->n_items > 0) {
+			ratio = export->n_done;
+			for (i = 0; i < export->n_workers; i++) {
+				ratio += export->workers[i].ratio;
+			}
+			ratio /= export->n_items;
+		}
+		n_done = export->n_done;
+		n_items = export->n_items;
+		if (export->timer != NULL) {
+			batch_elapsed = g_timer_elapsed(export->timer, NULL);
+		}
+
+		for (i = 0; i < export->n_workers; i++) {
+
+			export_worker_t * worker = &export->workers[i];
+
+			if (worker->timer == NULL ||
+			    (elapsed = g_timer_elapsed(worker->timer, NULL)) <= 0.0) {
+				continue;
+			}
+			bytes += worker->bytes;
+			if (stats->len > 0) {
+				g_string_append_c(stats, '\n');
+			}
+			g_string_append_printf(stats, _("Worker %d: %.1fx realtime, %.1f MB/s"), i + 1,
+					       worker->audio_sec / elapsed,
+					       worker->bytes / elapsed / (1024 * 1024));
+		}
 		AQUALUNG_MUTEX_UNLOCK(export->mutex);
+
+		if (bytes > 0 && batch_elapsed > 0.0) {
+			arr_snprintf(tmp, "%d%% (%d/%d, %.1f MB/s)", (int)(ratio * 100),
+				     n_done, n_items, bytes / batch_elapsed / (1024 * 1024));
+		} else {
+			arr_snprintf(tmp, "%d%% (%d/%d)", (int)(ratio * 100), n_done, n_items);
+		}
+
+		gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(export->progbar), ratio);
 		gtk_progress_bar_set_text(GTK_PROGRESS_BAR(export->progbar), tmp);
+		aqualung_widget_set_tooltip_text(export->progbar, stats->str);
+		g_string_free(stats, TRUE);
 	}
 
 	return TRUE;
@@ -422,7 +503,7 @@ set_prog_trg_file_entry(export_t * export, char * file) {
 }
 
 
-void
+int
 export_meta_amend_frame(metadata_t * meta, int tag, int type, export_item_t * item) {
 
 	char * str;
@@ -430,13 +511,13 @@ export_meta_amend_frame(metadata_t * meta, int tag, int type, export_item_t * it
 
 	/* see whether particular frame type is available in this tag */
 	if (!meta_get_fieldname_embedded(tag, type, &str)) {
-		return;
+		return 0;
 	}
 
 	/* if yes, check for existence */
 	frame = metadata_get_frame_by_tag_and_type(meta, tag, type, NULL);
 	if (frame != NULL) {
-		return;
+		return 0;
 	}
 
 	/* not found, add it with content from export item */
@@ -466,16 +547,19 @@ export_meta_amend_frame(metadata_t * meta, int tag, int type, export_item_t * it
 	}
 
 	metadata_add_frame(meta, frame);
+	return 1;
 }
 
 
 /* Add metadata fields stored in Music Store / Playlist
  * if they were not transferred from source file metadata.
+ * Returns the number of frames added.
  */
-void
+int
 export_meta_amend_stored_fields(metadata_t * meta, int tags, export_item_t * item) {
 
 	int tag = META_TAG_MAX;
+	int n = 0;
 
 	/* iterate on possible output tags */
 	while (tag) {
@@ -486,28 +570,191 @@ export_meta_amend_stored_fields(metadata_t * meta, int tags, export_item_t * ite
 		}
 
 		if (strcmp(item->title, _("Unknown Track")) != 0) {
-			export_meta_amend_frame(meta, tag, META_FIELD_TITLE, item);
+			n += export_meta_amend_frame(meta, tag, META_FIELD_TITLE, item);
 		}
 		if (strcmp(item->artist, _("Unknown Artist")) != 0) {
-			export_meta_amend_frame(meta, tag, META_FIELD_ARTIST, item);
+			n += export_meta_amend_frame(meta, tag, META_FIELD_ARTIST, item);
 		}
 		if (strcmp(item->album, _("Unknown Album")) != 0) {
-			export_meta_amend_frame(meta, tag, META_FIELD_ALBUM, item);
+			n += export_meta_amend_frame(meta, tag, META_FIELD_ALBUM, item);
 		}
 		if (item->year != 0) {
-			export_meta_amend_frame(meta, tag, META_FIELD_DATE, item);
+			n += export_meta_amend_frame(meta, tag, META_FIELD_DATE, item);
 		}
 		if (item->no != 0) {
-			export_meta_amend_frame(meta, tag, META_FIELD_TRACKNO, item);
+			n += export_meta_amend_frame(meta, tag, META_FIELD_TRACKNO, item);
 		}
 
 		tag >>= 1;
 	}
+
+	return n;
 }
 
 
+/* Move at most len bytes at pos from fi to fo. Falls back to the next
+ * method if the kernel refuses the current one on the first chunk
+ * (e.g. copy_file_range() across filesystems on older kernels). The
+ * read/write fallback goes through buf of buf_size bytes.
+ */
+ssize_t
+export_copy_chunk(int fi, int fo, off_t pos, size_t len, int * method,
+		  char * buf, size_t buf_size) {
+
+	ssize_t n;
+
+#ifdef HAVE_COPY_FILE_RANGE
+	if (*method == EXPORT_COPY_RANGE) {
+		loff_t off_in = pos;
+		loff_t off_out = pos;
+
+		if ((n = copy_file_range(fi, &off_in, fo, &off_out, len, 0)) >= 0) {
+			return n;
+		}
+		if (pos > 0 || (errno != EXDEV && errno != ENOSYS &&
+				errno != EINVAL && errno != EOPNOTSUPP)) {
+			return -1;
+		}
+	}
+#endif /* HAVE_COPY_FILE_RANGE */
+	if (*method == EXPORT_COPY_RANGE) {
+		*method = EXPORT_COPY_SENDFILE;
+	}
+
+#ifdef HAVE_SENDFILE
+	if (*method == EXPORT_COPY_SENDFILE) {
+		off_t off = pos;
+
+		if (lseek(fo, pos, SEEK_SET) == pos &&
+		    (n = sendfile(fo, fi, &off, len)) >= 0) {
+			return n;
+		}
+		if (pos > 0 || (errno != EINVAL && errno != ENOSYS)) {
+			return -1;
+		}
+	}
+#endif /* HAVE_SENDFILE */
+	*method = EXPORT_COPY_RW;
+
+	{
+		ssize_t n_written = 0;
+
+		if (len > buf_size) {
+			len = buf_size;
+		}
+		if ((n = pread(fi, buf, len, pos)) <= 0) {
+			return n;
+		}
+		while (n_written < n) {
+			ssize_t w = pwrite(fo, buf + n_written, n - n_written, pos + n_written);
+			if (w < 0) {
+				return -1;
+			}
+			n_written += w;
+		}
+		return n;
+	}
+}
+
+
+/* Copy a file without reencoding, inside the kernel where possible:
+ * reflink it if the filesystem supports that, else use copy_file_range(),
+ * sendfile() or a plain read/write loop, in this order.
+ */
+int
+export_copy_file(export_t * export, export_worker_t * worker, char * infile, char * outfile) {
+
+	struct stat statbuf;
+	off_t pos = 0;
+	off_t reported = 0;
+	int method = EXPORT_COPY_RANGE;
+	int fi, fo;
+	int ret = 0;
+
+	if ((fi = open(infile, O_RDONLY)) < 0) {
+		fprintf(stderr, "export_copy_file: unable to open file %s: %s\n", infile, strerror(errno));
+		return -1;
+	}
+
+	if (fstat(fi, &statbuf) < 0 || statbuf.st_size == 0) {
+		close(fi);
+		return -1;
+	}
+
+	if ((fo = open(outfile, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0) {
+		fprintf(stderr, "export_copy_file: unable to open file %s: %s\n", outfile, strerror(errno));
+		close(fi);
+		return -1;
+	}
+
+#ifdef FICLONE
+	if (ioctl(fo, FICLONE, fi) == 0) {
+		pos = statbuf.st_size;
+	}
+#endif /* FICLONE */
+
+	while (pos < statbuf.st_size && !export->cancelled) {
+
+		ssize_t n = export_copy_chunk(fi, fo, pos, EXPORT_COPY_CHUNK, &method,
+					      (char *)worker->buf, WORKER_BUF_BYTES);
+
+		if (n <= 0) {
+			if (n < 0) {
+				fprintf(stderr, "export_copy_file: %s: %s\n", outfile, strerror(errno));
+			}
+			ret = -1;
+			break;
+		}
+		pos += n;
+
+		AQUALUNG_MUTEX_LOCK(export->mutex);
+		worker->ratio = (double)pos / statbuf.st_size;
+		worker->bytes += pos - reported;
+		AQUALUNG_MUTEX_UNLOCK(export->mutex);
+		reported = pos;
+	}
+
+	if (pos > reported) {
+		AQUALUNG_MUTEX_LOCK(export->mutex);
+		worker->bytes += pos - reported;
+		AQUALUNG_MUTEX_UNLOCK(export->mutex);
+	}
+
+	close(fi);
+	if (close(fo) < 0) {
+		ret = -1;
+	}
+
+	return ret;
+}
+
+
+/* Add the stored fields missing from a copied file's tags, rewriting
+ * only the tag block of the copy (in place if the format has room).
+ */
 void
-export_item(export_t * export, export_item_t * item, int index) {
+export_copy_amend_meta(export_item_t * item, char * filename) {
+
+	file_decoder_t * fdec = file_decoder_new();
+
+	if (file_decoder_open(fdec, filename) != 0) {
+		file_decoder_delete(fdec);
+		return;
+	}
+
+	if (fdec->meta != NULL && fdec->meta->writable && fdec->meta_write != NULL) {
+		if (export_meta_amend_stored_fields(fdec->meta, fdec->meta->valid_tags, item) > 0) {
+			fdec->meta_write(fdec, fdec->meta);
+		}
+	}
+
+	file_decoder_close(fdec);
+	file_decoder_delete(fdec);
+}
+
+
+void
+export_item(export_t * export, export_worker_t * worker, export_item_t * item, int index) {
 
 	file_decoder_t * fdec;
 	file_encoder_t * fenc;
@@ -516,8 +763,11 @@ export_item(export_t * export, export_item_t * item, int index) {
 	char filename[MAXLEN];
 	int tags = 0;
 	int force_copy = 0;
+	int ret;
 
-	float buf[2*BUFSIZE];
+	float * buf = worker->buf;
+	float * mixbuf = NULL;
+	channel_mix_t mix;
 	int n_read;
 	long long samples_read = 0;
 
@@ -584,7 +834,12 @@ export_item(export_t * export, export_item_t * item, int index) {
 		}
 	}
 
-	if (export_item_set_path(export, item, filename, CHAR_ARRAY_SIZE(filename), ext, index) < 0) {
+	/* the artist/record maps and directory creation are shared between workers */
+	AQUALUNG_MUTEX_LOCK(export->mutex);
+	ret = export_item_set_path(export, item, filename, CHAR_ARRAY_SIZE(filename), ext, index);
+	AQUALUNG_MUTEX_UNLOCK(export->mutex);
+
+	if (ret < 0) {
 		file_decoder_close(fdec);
 		file_decoder_delete(fdec);
 		return;
@@ -595,48 +850,19 @@ export_item(export_t * export, export_item_t * item, int index) {
 
 	if (force_copy || export->format == ENC_COPY) {
 
-		char buf[BUFSIZE];
-		size_t n_read;
-		struct stat statbuf;
-		unsigned long pos = 0;
-		int n = 0;
-		FILE * fi;
-		FILE * fo;
-
 		file_decoder_close(fdec);
 		file_decoder_delete(fdec);
-		
-		if (g_stat(item->infile, &statbuf) != -1) {
-			if (statbuf.st_size == 0) {
-				return;
-			}
-		}
 
-		if ((fi = fopen(item->infile, "rb")) == NULL) {
-			fprintf(stdout, "export_item: unable to open file %s\n", item->infile);
-			return;
-		}
+		/* Plain copies are bound by the target device, not the CPU;
+		   let only one worker copy at a time so that slow (USB) targets
+		   are not hit by several interleaved write streams. */
+		AQUALUNG_MUTEX_LOCK(export->io_mutex);
+		ret = export_copy_file(export, worker, item->infile, filename);
+		AQUALUNG_MUTEX_UNLOCK(export->io_mutex);
 
-		if ((fo = fopen(filename, "wb")) == NULL) {
-			fclose(fi);
-			fprintf(stdout, "export_item: unable to open file %s\n", filename);
-			return;
-		}
-
-		while ((n_read = fread(buf, sizeof(char), sizeof(buf), fi)) > 0 && !export->cancelled) {
-			fwrite(buf, sizeof(char), n_read, fo);
-			pos += n_read;
-
-			if (n-- == 0) {
-				n = 100;
-				AQUALUNG_MUTEX_LOCK(export->mutex);
-				export->ratio = (double)pos / statbuf.st_size;
-				AQUALUNG_MUTEX_UNLOCK(export->mutex);
-			}
+		if (ret == 0 && force_copy && export->write_meta && !export->cancelled) {
+			export_copy_amend_meta(item, filename);
 		}
-
-		fclose(fi);
-		fclose(fo);
 		return;
 	}
 
@@ -646,6 +872,35 @@ export_item(export_t * export, export_item_t * item, int index) {
 	mode.sample_rate = fdec->fileinfo.sample_rate;
 	mode.channels = fdec->fileinfo.channels;
 
+	/* keep hi-res lossless sources at 24 bits and lossless ones
+	   bit-exact; only lossy sources, which decode to more than 16
+	   bits, get dithered when requantized to 16 bits */
+	if (fdec->file_lib == FLAC_LIB || fdec->file_lib == SNDFILE_LIB ||
+	    fdec->file_lib == WAVPACK_LIB || fdec->file_lib == CDDA_LIB) {
+		int src_bits = fdec->fileinfo.bps / (mode.sample_rate * mode.channels);
+		mode.bits = (src_bits > 16) ? 24 : 16;
+		mode.dither = (mode.bits == 16 && src_bits > 16);
+	} else {
+		mode.bits = 16;
+		mode.dither = 1;
+	}
+
+	/* LAME takes mono and stereo only: fold anything wider down */
+	if (mode.file_lib == ENC_LAME_LIB && mode.channels > 2) {
+		int in_map[MAX_CHANNELS];
+		int out_map[2] = { CHANNEL_FL, CHANNEL_FR };
+
+		if ((mixbuf = (float *)malloc(2 * BUFSIZE * sizeof(float))) == NULL) {
+			fprintf(stderr, "export_item: malloc error\n");
+			file_decoder_close(fdec);
+			file_decoder_delete(fdec);
+			return;
+		}
+		channels_default_map(mode.channels, in_map);
+		channel_mix_init(&mix, mode.channels, in_map, 2, out_map);
+		mode.channels = 2;
+	}
+
 	if (mode.file_lib == ENC_FLAC_LIB) {
 		mode.clevel = export->bitrate;
 	} else if (mode.file_lib == ENC_VORBIS_LIB) {
@@ -668,18 +923,31 @@ export_item(export_t * export, export_item_t * item, int index) {
 	fenc = file_encoder_new();
 
 	if (file_encoder_open(fenc, &mode)) {
+		file_decoder_close(fdec);
+		file_decoder_delete(fdec);
+		file_encoder_delete(fenc);
+		if (mode.meta != NULL) {
+			metadata_free(mode.meta);
+		}
+		free(mixbuf);
 		return;
 	}
 
 	while (!export->cancelled) {
 
 		n_read = file_decoder_read(fdec, buf, BUFSIZE);
-		file_encoder_write(fenc, buf, n_read);
+		if (mixbuf != NULL) {
+			channel_mix_process(&mix, buf, mixbuf, n_read);
+			file_encoder_write(fenc, mixbuf, n_read);
+		} else {
+			file_encoder_write(fenc, buf, n_read);
+		}
 		
 		samples_read += n_read;
 
 		AQUALUNG_MUTEX_LOCK(export->mutex);
-		export->ratio = (double)samples_read / fdec->fileinfo.total_samples;
+		worker->ratio = (double)samples_read / fdec->fileinfo.total_samples;
+		worker->audio_sec += (double)n_read / mode.sample_rate;
 		AQUALUNG_MUTEX_UNLOCK(export->mutex);
 
 		if (n_read < BUFSIZE) {
@@ -694,32 +962,111 @@ export_item(export_t * export, export_item_t * item, int index) {
 	if (mode.meta != NULL) {
 		metadata_free(mode.meta);
 	}
+	free(mixbuf);
+}
+
+void *
+export_worker_thread(void * arg) {
+
+	export_worker_t * worker = (export_worker_t *)arg;
+	export_t * export = (export_t *)worker->export;
+
+	if ((worker->buf = (float *)malloc(WORKER_BUF_BYTES)) == NULL) {
+		fprintf(stderr, "export_worker_thread: malloc error\n");
+		return NULL;
+	}
+
+	while (!export->cancelled) {
+
+		GSList * node;
+		int index = 0;
+
+		AQUALUNG_MUTEX_LOCK(export->mutex);
+		if ((node = export->next_item) != NULL) {
+			export->next_item = node->next;
+			index = ++export->next_index;
+		}
+		AQUALUNG_MUTEX_UNLOCK(export->mutex);
+
+		if (node == NULL) {
+			break;
+		}
+
+		export_item(export, worker, (export_item_t *)node->data, index);
+
+		AQUALUNG_MUTEX_LOCK(export->mutex);
+		++export->n_done;
+		worker->ratio = 0.0;
+		AQUALUNG_MUTEX_UNLOCK(export->mutex);
+	}
+
+	AQUALUNG_MUTEX_LOCK(export->mutex);
+	g_timer_stop(worker->timer);
+	AQUALUNG_MUTEX_UNLOCK(export->mutex);
+
+	free(worker->buf);
+	worker->buf = NULL;
+
+	return NULL;
 }
 
 void *
 export_thread(void * arg) {
 
 	export_t * export = (export_t *)arg;
-	GSList * node;
-	int index = 0;
+	int i;
 
 	AQUALUNG_THREAD_DETACH();
 
-	for (node = export->slist; node; node = node->next) {
+	AQUALUNG_MUTEX_LOCK(export->mutex);
+	export->next_item = export->slist;
+	export->n_items = g_slist_length(export->slist);
+	if (export->n_workers > export->n_items) {
+		export->n_workers = export->n_items;
+	}
+	for (i = 0; i < export->n_workers; i++) {
+		export->workers[i].export = export;
+		export->workers[i].timer = g_timer_new();
+	}
+	export->timer = g_timer_new();
+	AQUALUNG_MUTEX_UNLOCK(export->mutex);
 
-		if (export->cancelled) {
-			break;
-		}
+	for (i = 0; i < export->n_workers; i++) {
+		AQUALUNG_THREAD_CREATE(export->workers[i].thread_id, NULL,
+				       export_worker_thread, &export->workers[i])
+	}
 
-		++index;
-		export_item(export, (export_item_t *)node->data, index);
+	for (i = 0; i < export->n_workers; i++) {
+		AQUALUNG_THREAD_JOIN(export->workers[i].thread_id)
 	}
 
+	AQUALUNG_MUTEX_LOCK(export->mutex);
+	g_timer_stop(export->timer);
+	AQUALUNG_MUTEX_UNLOCK(export->mutex);
+
 	aqualung_idle_add(export_finish, export);
 
 	return NULL;
 }
 
+int
+export_default_workers(void) {
+
+	int n = 1;
+
+#ifdef _SC_NPROCESSORS_ONLN
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif /* _SC_NPROCESSORS_ONLN */
+
+	if (n < 1) {
+		n = 1;
+	} else if (n > EXPORT_MAX_WORKERS) {
+		n = EXPORT_MAX_WORKERS;
+	}
+
+	return n;
+}
+
 void
 export_browse_cb(GtkButton * button, gpointer data) {
 
@@ -1063,6 +1410,8 @@ export_dialog_response(GtkDialog * dialog, gint response_id, gpointer ex) {
 	set_option_from_toggle(export->check_dir_artist, &options.export_subdir_artist);
 	set_option_from_toggle(export->check_dir_album, &options.export_subdir_album);
 	set_option_from_spin(export->dirlen_spin, &options.export_subdir_limit);
+	set_option_from_spin(export->workers_spin, &options.export_workers);
+	export->n_workers = options.export_workers;
 	set_option_from_toggle(export->vbr_check, &export->vbr);
 	options.export_vbr = export->vbr;
 	set_option_from_toggle(export->meta_check, &export->write_meta);
@@ -1161,7 +1510,7 @@ export_start(export_t * export) {
 	gtk_box_pack_start(GTK_BOX(content_area), frame, FALSE, FALSE, 2);
         gtk_container_set_border_width(GTK_CONTAINER(frame), 5);
 
-        table = gtk_table_new(4, 2, FALSE);
+        table = gtk_table_new(5, 2, FALSE);
         gtk_container_add(GTK_CONTAINER(frame), table);
 
         hbox = gtk_hbox_new(FALSE, 0);
@@ -1203,6 +1552,9 @@ export_start(export_t * export) {
 			 GTK_FILL, GTK_FILL, 5, 5);
 	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(export->meta_check), options.export_metadata);
 
+	insert_label_spin_with_limits(table, _("Parallel encoders:"), &export->workers_spin,
+				      (options.export_workers > 0) ? options.export_workers : export_default_workers(),
+				      1, EXPORT_MAX_WORKERS, 4, 5);
 
 	/* Filter */
 	frame = gtk_frame_new(_("Filter"));
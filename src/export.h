@@ -36,12 +36,39 @@ typedef struct _export_map_t {
 
 } export_map_t;
 
+#define EXPORT_MAX_WORKERS 8
+
+typedef struct {
+
+	AQUALUNG_THREAD_DECLARE(thread_id)
+
+	void * export;
+	float * buf;
+
+	/* progress of the current item and throughput counters,
+	   protected by export->mutex */
+	double ratio;
+	double audio_sec;
+	long long bytes;
+	GTimer * timer;
+
+} export_worker_t;
+
 typedef struct {
 
 	AQUALUNG_THREAD_DECLARE(thread_id)
 	AQUALUNG_MUTEX_DECLARE(mutex)
+	AQUALUNG_MUTEX_DECLARE(io_mutex)
 
 	GSList * slist;
+	GSList * next_item;
+	int next_index;
+	int n_items;
+	int n_done;
+
+	int n_workers;
+	export_worker_t workers[EXPORT_MAX_WORKERS];
+	GTimer * timer; /* wall time of the whole batch */
 
 	char outdir[MAXLEN];
 	char template[MAXLEN];
@@ -65,13 +92,13 @@ typedef struct {
 	int progbar_tag;
 	char file1[MAXLEN];
 	char file2[MAXLEN];
-	double ratio;
 
 	GtkWidget * dialog;
 	GtkWidget * format_combo;
 	GtkWidget * check_dir_artist;
 	GtkWidget * check_dir_album;
 	GtkWidget * dirlen_spin;
+	GtkWidget * workers_spin;
 	GtkWidget * bitrate_scale;
 	GtkWidget * bitrate_label;
 	GtkWidget * bitrate_value_label;
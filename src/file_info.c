@@ -1838,8 +1838,10 @@ fi_set_common_entries(fi_t * fi) {
 
 	if (fi->fileinfo.is_mono) {
 		arr_strlcpy(str, _("MONO"));
-	} else {
+	} else if (fi->fileinfo.channels == 2) {
 		arr_strlcpy(str, _("STEREO"));
+	} else {
+		arr_snprintf(str, _("%d CHANNELS"), fi->fileinfo.channels);
 	}
 	gtk_entry_set_text(GTK_ENTRY(fi->entry_ch), str);
 
@@ -1906,6 +1908,7 @@ fi_media_init(fi_t * fi) {
 
 		fi->fileinfo.format_str = _("Audio CD");
 		fi->fileinfo.sample_rate = 44100;
+		fi->fileinfo.channels = 2;
 		fi->fileinfo.is_mono = 0;
 		fi->fileinfo.format_flags = 0;
 		fi->fileinfo.bps = 2*16*44100;
@@ -1930,6 +1933,7 @@ fi_media_init(fi_t * fi) {
 
 		fi->fileinfo.format_str = fi->dec->format_str;
 		fi->fileinfo.sample_rate = fi->fdec->fileinfo.sample_rate;
+		fi->fileinfo.channels = fi->fdec->fileinfo.channels;
 		fi->fileinfo.is_mono = fi->fdec->fileinfo.is_mono;
 		fi->fileinfo.format_flags = fi->fdec->fileinfo.format_flags;
 		fi->fileinfo.bps = fi->fdec->fileinfo.bps;
@@ -39,7 +39,7 @@
 #endif /* HAVE_JACK */
 
 #ifdef HAVE_SRC
-#include <samplerate.h>
+#include "resampler.h"
 #endif /* HAVE_SRC */
 
 #ifdef HAVE_LADSPA
@@ -108,10 +108,7 @@ PangoFontDescription *fd_songinfo;
 PangoFontDescription *fd_statusbar;
 
 /* Communication between gui thread and disk thread */
-extern AQUALUNG_MUTEX_DECLARE(disk_thread_lock)
-extern AQUALUNG_COND_DECLARE(disk_thread_wake)
-extern rb_t * rb_gui2disk;
-extern rb_t * rb_disk2gui;
+extern msgq_t * q_disk2gui;
 
 #ifdef HAVE_JACK
 extern jack_client_t * jack_client;
@@ -146,7 +143,6 @@ char win_title[MAXLEN];
 /* current application title when a file is playing */
 char playing_app_title[MAXLEN];
 
-char send_cmd, recv_cmd;
 char command[RB_CONTROL_SIZE];
 fileinfo_t fileinfo;
 status_t status;
@@ -242,6 +238,7 @@ GtkWidget * playlist_toggle;
 
 guint timeout_tag;
 guint vol_bal_timeout_tag = 0;
+guint stream_stats_timeout_tag = 0;
 
 gint timeout_callback(gpointer data);
 
@@ -319,6 +316,8 @@ gint pause_event(GtkWidget * widget, GdkEvent * event, gpointer data);
 gint stop_event(GtkWidget * widget, GdkEvent * event, gpointer data);
 gint next_event(GtkWidget * widget, GdkEvent * event, gpointer data);
 
+int choose_adjacent_track(GtkTreeStore * store, GtkTreeIter * piter);
+
 void load_config(void);
 
 void playlist_toggled(GtkWidget * widget, gpointer data);
@@ -337,16 +336,6 @@ extern gint playlist_state;
 extern gint browser_state;
 
 
-void
-try_waking_disk_thread(void) {
-
-	if (AQUALUNG_MUTEX_TRYLOCK(disk_thread_lock)) {
-		AQUALUNG_COND_SIGNAL(disk_thread_wake)
-		AQUALUNG_MUTEX_UNLOCK(disk_thread_lock)
-	}
-}
-
-
 void
 set_title_label(char * str) {
 
@@ -397,10 +386,9 @@ set_title_label(char * str) {
 
 void
 hide_cover_thumbnail(void) {
-        cover_show_flag = 0;
-        gtk_widget_hide(cover_image_area);
-        gtk_widget_hide(c_event_box);
-        gtk_widget_hide(cover_align);
+
+	/* also keeps a pending embedded picture decode from showing up */
+	hide_cover(cover_image_area, c_event_box, cover_align);
 }
 
 void
@@ -448,6 +436,36 @@ set_bps_label(int bps, int format_flags) {
 }
 
 
+gint
+stream_stats_timeout_callback(gpointer data) {
+
+	static int had_stats = 0;
+	httpc_stats_t stats;
+	char str[MAXLEN];
+
+	if (!httpc_get_stream_stats(&stats)) {
+		if (had_stats) {
+			aqualung_widget_set_tooltip_text(label_bps, NULL);
+			had_stats = 0;
+		}
+		return TRUE;
+	}
+
+	arr_snprintf(str, _("Stream buffer: %d%% of %d KiB%s\n"
+			    "Received: %d kbit/s\n"
+			    "Rebuffered %d, reconnected %d times"),
+		     (int)(100.0 * stats.buffer_fill / stats.buffer_size),
+		     stats.buffer_size / 1024,
+		     stats.buffering ? _(" (buffering)") :
+		     (stats.buffer_fill < stats.low_water) ? _(" (low)") : "",
+		     stats.kbps, stats.rebuffers, stats.reconnects);
+	aqualung_widget_set_tooltip_text(label_bps, str);
+	had_stats = 1;
+
+	return TRUE;
+}
+
+
 void
 set_samplerate_label(int sr) {
 
@@ -515,6 +533,11 @@ set_output_label(int output, int out_SR) {
 		arr_snprintf(str, "%s Win32 @ %d Hz", _("Output:"), out_SR);
 		break;
 #endif /* HAVE_WINMM */
+#ifdef NULL_DRIVER
+	case NULL_DRIVER:
+		arr_snprintf(str, "%s null @ %d Hz", _("Output:"), out_SR);
+		break;
+#endif /* NULL_DRIVER */
 	default:
 		arr_strlcpy(str, _("No output"));
 		break;
@@ -532,7 +555,7 @@ set_src_type_label(int src_type) {
 
 	arr_strlcpy(str, _("SRC Type: "));
 #ifdef HAVE_SRC
-	arr_strlcat(str, src_get_name(src_type));
+	arr_strlcat(str, resampler_get_name(src_type));
 #else
 	arr_strlcat(str, _("None"));
 #endif /* HAVE_SRC */
@@ -682,6 +705,15 @@ refresh_displays(void) {
 							      48, 48, pldata->file, TRUE, TRUE);
 					}
 				}
+
+				/* have the cover ready by the time the next track starts */
+				if (choose_adjacent_track(pl->store, &iter)) {
+					playlist_data_t * next_pldata;
+					gtk_tree_model_get(GTK_TREE_MODEL(pl->store), &iter, PL_COL_DATA, &next_pldata, -1);
+					if (!httpc_is_url(next_pldata->file)) {
+						cover_prefetch(next_pldata->file, 48, 48);
+					}
+				}
                         }
 		}
 	} else if (!is_file_loaded) {
@@ -760,9 +792,7 @@ restore_window_position(void) {
 gboolean
 main_window_close(GtkWidget * widget, GdkEvent * event, gpointer data) {
 
-	send_cmd = CMD_FINISH;
-	rb_write(rb_gui2disk, &send_cmd, 1);
-	try_waking_disk_thread();
+	disk_send_cmd(CMD_FINISH);
 
 #ifdef HAVE_CDDA
 	cdda_shutdown();
@@ -1019,14 +1049,8 @@ void
 seek_song(void) {
 
 	if (is_file_loaded && allow_seeks && refresh_scale == 0 && total_samples != 0) {
-		seek_t seek;
-
 		refresh_scale = 1;
-		send_cmd = CMD_SEEKTO;
-		seek.seek_to_pos = gtk_adjustment_get_value(GTK_ADJUSTMENT(adj_pos)) / 100.0f * total_samples;
-		rb_write(rb_gui2disk, &send_cmd, 1);
-		rb_write(rb_gui2disk, (char *)&seek, sizeof(seek_t));
-		try_waking_disk_thread();
+		disk_send_seek(gtk_adjustment_get_value(GTK_ADJUSTMENT(adj_pos)) / 100.0f * total_samples);
 		refresh_scale_suppress = 2;
         }
 }
@@ -1162,13 +1186,7 @@ main_window_key_pressed(GtkWidget * widget, GdkEventKey * event) {
 		break;
 	case GDK_BackSpace:
 		if (allow_seeks && total_samples != 0) {
-			seek_t seek;
-
-			send_cmd = CMD_SEEKTO;
-			seek.seek_to_pos = 0.0f;
-			rb_write(rb_gui2disk, &send_cmd, 1);
-			rb_write(rb_gui2disk, (char *)&seek, sizeof(seek_t));
-			try_waking_disk_thread();
+			disk_send_seek(0);
 			refresh_scale_suppress = 2;
 		}
 
@@ -1430,8 +1448,6 @@ scale_button_press_event(GtkWidget * widget, GdkEventButton * event) {
 static gint
 scale_button_release_event(GtkWidget * widget, GdkEventButton * event) {
 
-	seek_t seek;
-
 	if (is_file_loaded) {
 
 		if (!allow_seeks)
@@ -1443,12 +1459,8 @@ scale_button_release_event(GtkWidget * widget, GdkEventButton * event) {
 		if (refresh_scale == 0) {
 			refresh_scale = 1;
 
-			send_cmd = CMD_SEEKTO;
-			seek.seek_to_pos = gtk_adjustment_get_value(GTK_ADJUSTMENT(adj_pos))
-				/ 100.0f * total_samples;
-			rb_write(rb_gui2disk, &send_cmd, 1);
-			rb_write(rb_gui2disk, (char *)&seek, sizeof(seek_t));
-			try_waking_disk_thread();
+			disk_send_seek(gtk_adjustment_get_value(GTK_ADJUSTMENT(adj_pos))
+				       / 100.0f * total_samples);
 			refresh_scale_suppress = 2;
 		}
 	}
@@ -1917,7 +1929,6 @@ prev_event(GtkWidget * widget, GdkEvent * event, gpointer data) {
 
 	GtkTreeIter iter;
 	GtkTreePath * p;
-	char cmd;
 	cue_t cue;
 	playlist_t * pl;
 
@@ -1983,11 +1994,8 @@ prev_event(GtkWidget * widget, GdkEvent * event, gpointer data) {
 			toggle_noeffect(PLAY, TRUE);
 		}
 
-		cmd = CMD_CUE;
-		flush_rb_disk2gui();
-		rb_write(rb_gui2disk, &cmd, sizeof(char));
-		rb_write(rb_gui2disk, (void *)&cue, sizeof(cue_t));
-		try_waking_disk_thread();
+		flush_disk2gui();
+		disk_send_cue(&cue);
 	}
 	return FALSE;
 }
@@ -1998,7 +2006,6 @@ next_event(GtkWidget * widget, GdkEvent * event, gpointer data) {
 
 	GtkTreeIter iter;
 	GtkTreePath * p;
-	char cmd;
 	cue_t cue;
 	playlist_t * pl;
 
@@ -2064,11 +2071,8 @@ next_event(GtkWidget * widget, GdkEvent * event, gpointer data) {
 			toggle_noeffect(PLAY, TRUE);
 		}
 
-		cmd = CMD_CUE;
-		flush_rb_disk2gui();
-		rb_write(rb_gui2disk, &cmd, sizeof(char));
-		rb_write(rb_gui2disk, (void *)&cue, sizeof(cue_t));
-		try_waking_disk_thread();
+		flush_disk2gui();
+		disk_send_cue(&cue);
 	}
 	return FALSE;
 }
@@ -2079,7 +2083,6 @@ play_event(GtkWidget * widget, GdkEvent * event, gpointer data) {
 
 	GtkTreeIter iter;
 	GtkTreePath * p;
-	char cmd;
 	cue_t cue;
 	playlist_t * pl;
 
@@ -2088,16 +2091,13 @@ play_event(GtkWidget * widget, GdkEvent * event, gpointer data) {
 		if (!options.combine_play_pause) {
 			toggle_noeffect(PAUSE, FALSE);
 		}
-		send_cmd = CMD_RESUME;
-		rb_write(rb_gui2disk, &send_cmd, 1);
-		try_waking_disk_thread();
+		disk_send_cmd(CMD_RESUME);
 		return FALSE;
 	}
 	if (options.combine_play_pause && is_file_loaded) {
 		return pause_event(widget, event, data);
 	}
 
-	cmd = CMD_CUE;
 	cue.filename = NULL;
 
 	while ((pl = playlist_get_playing()) != NULL) {
@@ -2134,10 +2134,8 @@ play_event(GtkWidget * widget, GdkEvent * event, gpointer data) {
 	if (cue.filename == NULL) {
 		stop_event(NULL, NULL, NULL);
 	} else {
-		flush_rb_disk2gui();
-		rb_write(rb_gui2disk, &cmd, sizeof(char));
-		rb_write(rb_gui2disk, (void *)&cue, sizeof(cue_t));
-		try_waking_disk_thread();
+		flush_disk2gui();
+		disk_send_cue(&cue);
 	}
 	return FALSE;
 }
@@ -2156,17 +2154,14 @@ pause_event(GtkWidget * widget, GdkEvent * event, gpointer data) {
 	if (!is_paused) {
 		is_paused = 1;
 		toggle_noeffect(PLAY, FALSE);
-		send_cmd = CMD_PAUSE;
-		rb_write(rb_gui2disk, &send_cmd, 1);
+		disk_send_cmd(CMD_PAUSE);
 
 	} else {
 		is_paused = 0;
 		toggle_noeffect(PLAY, TRUE);
-		send_cmd = CMD_RESUME;
-		rb_write(rb_gui2disk, &send_cmd, 1);
+		disk_send_cmd(CMD_RESUME);
 	}
 
-	try_waking_disk_thread();
 	return FALSE;
 }
 
@@ -2174,7 +2169,6 @@ pause_event(GtkWidget * widget, GdkEvent * event, gpointer data) {
 gint
 stop_event(GtkWidget * widget, GdkEvent * event, gpointer data) {
 
-	char cmd;
 	cue_t cue;
 
 	is_file_loaded = 0;
@@ -2190,12 +2184,9 @@ stop_event(GtkWidget * widget, GdkEvent * event, gpointer data) {
 	is_paused = 0;
 	allow_seeks = 1;
 
-	cmd = CMD_CUE;
 	cue.filename = NULL;
-	flush_rb_disk2gui();
-        rb_write(rb_gui2disk, &cmd, sizeof(char));
-        rb_write(rb_gui2disk, (void *)&cue, sizeof(cue_t));
-	try_waking_disk_thread();
+	flush_disk2gui();
+	disk_send_cue(&cue);
 
  	show_scale_pos(TRUE);
 
@@ -3776,6 +3767,7 @@ create_gui(int argc, char ** argv, int optind, int enqueue,
 
 	/* set timeout function */
 	timeout_tag = aqualung_timeout_add(TIMEOUT_PERIOD, timeout_callback, NULL);
+	stream_stats_timeout_tag = aqualung_timeout_add(1000, stream_stats_timeout_callback, NULL);
 
 	/* re-apply skin to override possible WM theme */
 	if (!options.disable_skin_support_settings) {
@@ -3913,6 +3905,7 @@ process_metablock(metadata_t * meta) {
 			gtk_tree_model_get(GTK_TREE_MODEL(pl->store), &iter, PL_COL_DATA, &data, -1);
 
 			free_strdup(&data->title, buf);
+			playlist_data_reset_fold(data);
 			gtk_tree_store_set(pl->store, &iter, PL_COL_NAME, buf, -1);
 
 			gtk_tree_path_free(p);
@@ -3921,19 +3914,21 @@ process_metablock(metadata_t * meta) {
 }
 
 void
-flush_rb_disk2gui(void) {
+flush_disk2gui(void) {
 
-	char recv_cmd;
+	message_t msg;
 
-	while (rb_read_space(rb_disk2gui)) {
-		rb_read(rb_disk2gui, &recv_cmd, 1);
+	while (msgq_recv(q_disk2gui, &msg)) {
+		if (msg.cmd == CMD_FILEINFO && msg.u.fileinfo.format_str != NULL) {
+			free(msg.u.fileinfo.format_str);
+		}
 	}
 }
 
 gint
 timeout_callback(gpointer data) {
 
-	char cmd;
+	message_t msg;
 	cue_t cue;
 	static double left_gain_shadow;
 	static double right_gain_shadow;
@@ -3944,15 +3939,12 @@ timeout_callback(gpointer data) {
 #ifdef HAVE_JACK
 	static int jack_popup_beenthere = 0;
 #endif /* HAVE_JACK */
-	metadata_t * meta;
 
 
-	while (rb_read_space(rb_disk2gui)) {
-		rb_read(rb_disk2gui, &recv_cmd, 1);
-		switch (recv_cmd) {
+	while (msgq_recv(q_disk2gui, &msg)) {
+		switch (msg.cmd) {
 
 		case CMD_FILEREQ:
-			cmd = CMD_CUE;
 			cue.filename = NULL;
 			cue.voladj = 0.0f;
 
@@ -3962,24 +3954,18 @@ timeout_callback(gpointer data) {
 			decide_next_track(&cue);
 
 			if (cue.filename != NULL) {
-				rb_write(rb_gui2disk, &cmd, sizeof(char));
-				rb_write(rb_gui2disk, (void *)&cue, sizeof(cue_t));
+				disk_send_cue(&cue);
 			} else {
-				send_cmd = CMD_STOPWOFL;
-				rb_write(rb_gui2disk, &send_cmd, sizeof(char));
+				disk_send_cmd(CMD_STOPWOFL);
 			}
-
-			try_waking_disk_thread();
 			break;
 
 		case CMD_FILEINFO:
-			while (rb_read_space(rb_disk2gui) < sizeof(fileinfo_t))
-				;
 			if (fileinfo.format_str != NULL) { /* free previous format_str, if there is one */
 				free(fileinfo.format_str);
 				fileinfo.format_str = NULL;
 			}
-			rb_read(rb_disk2gui, (char *)&fileinfo, sizeof(fileinfo_t));
+			fileinfo = msg.u.fileinfo;
 
 			sample_pos = 0;
 			total_samples = fileinfo.total_samples;
@@ -3991,23 +3977,16 @@ timeout_callback(gpointer data) {
 			break;
 
 		case CMD_STATUS:
-			while (rb_read_space(rb_disk2gui) < sizeof(status_t))
-				;
-			rb_read(rb_disk2gui, (char *)&status, sizeof(status_t));
+			status = msg.u.status;
 
 			sample_pos = total_samples - status.samples_left;
 #ifdef HAVE_LOOP
+			/* compare what is being heard, not what was decoded */
 			if (options.repeat_on &&
 			    (sample_pos < total_samples * options.loop_range_start ||
-			     sample_pos > total_samples * options.loop_range_end)) {
+			     sample_pos > total_samples * options.loop_range_end + status.sample_offset)) {
 
-				seek_t seek;
-
-				send_cmd = CMD_SEEKTO;
-				seek.seek_to_pos = options.loop_range_start * total_samples;
-				rb_write(rb_gui2disk, &send_cmd, 1);
-				rb_write(rb_gui2disk, (char *)&seek, sizeof(seek_t));
-				try_waking_disk_thread();
+				disk_send_seek(options.loop_range_start * total_samples);
 				refresh_scale_suppress = 2;
 			}
 #endif /* HAVE_LOOP */
@@ -4074,15 +4053,11 @@ timeout_callback(gpointer data) {
 			break;
 
 		case CMD_METABLOCK:
-			while (rb_read_space(rb_disk2gui) < sizeof(metadata_t *))
-				;
-			rb_read(rb_disk2gui, (char *)&meta, sizeof(metadata_t *));
-
-			process_metablock(meta);
+			process_metablock(msg.u.meta);
 			break;
 
 		default:
-			fprintf(stderr, "gui: unexpected command %d recv'd from disk\n", recv_cmd);
+			fprintf(stderr, "gui: unexpected command %d recv'd from disk\n", msg.cmd);
 			break;
 		}
 	}
@@ -32,11 +32,14 @@
 #include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <time.h>
 #include <netinet/in.h>
 #include <netdb.h> 
 
+#include "athread.h"
 #include "metadata.h"
 #include "options.h"
+#include "rb.h"
 #include "version.h"
 #include "httpc.h"
 
@@ -44,6 +47,73 @@
 /* Uncomment this to get debug printouts */
 /* #define HTTPC_DEBUG */
 
+/* smallest amount of free space the reader thread waits for */
+#define HTTPC_READAHEAD_BLOCK    4096
+/* give up after this many failed reconnects in a row */
+#define HTTPC_RECONNECT_RETRIES  3
+/* stall timeout while the buffer is below the low-water mark */
+#define HTTPC_STALL_TIMEOUT      2
+/* metadata blocks held back until the decoder reaches them */
+#define HTTPC_META_QUEUE         8
+
+typedef struct {
+	long long pos;
+	char buf[HTTPC_META_MAX + 1];
+} httpc_meta_block_t;
+
+typedef struct _httpc_readahead {
+	AQUALUNG_THREAD_DECLARE(thread_id)
+	AQUALUNG_MUTEX_DECLARE(mutex)
+	AQUALUNG_COND_DECLARE(data_cond)
+	AQUALUNG_COND_DECLARE(space_cond)
+
+	rb_t * rb;
+	int size;
+	int prebuffer;
+	int low_water;
+	int block;
+
+	int buffering;
+	int quit;
+	int done;
+
+	/* stream position of the consumer, and of pending metadata */
+	long long written;
+	long long consumed;
+	int headers_changed;
+	int meta_head;
+	int meta_count;
+	httpc_meta_block_t meta[HTTPC_META_QUEUE];
+
+	GTimer * timer;
+	long long rate_bytes;
+	int kbps;
+	int rebuffers;
+	int reconnects;
+} httpc_readahead_t;
+
+/* idle keep-alive connections */
+#define HTTPC_POOL_SIZE          8
+#define HTTPC_POOL_IDLE_TIME     15
+
+typedef struct {
+	char host[1024];
+	int port;
+	int sock;
+	time_t since;
+} httpc_idle_conn_t;
+
+AQUALUNG_MUTEX_DECLARE_INIT(httpc_pool_lock)
+static httpc_idle_conn_t httpc_pool[HTTPC_POOL_SIZE];
+static int httpc_pool_count = 0;
+
+/* the session most recently handed a reader thread, for the GUI */
+AQUALUNG_MUTEX_DECLARE_INIT(httpc_active_lock)
+static httpc_readahead_t * httpc_active = NULL;
+
+static void httpc_readahead_start(http_session_t * session);
+static void httpc_readahead_stop(http_session_t * session);
+
 extern options_t options;
 
 int httpc_is_url(const char * str) {
@@ -82,6 +152,10 @@ free_headers(http_header_t * headers) {
 		free(headers->icy_name);
 	if (headers->icy_description != NULL)
 		free(headers->icy_description);
+	if (headers->etag != NULL)
+		free(headers->etag);
+	if (headers->last_modified != NULL)
+		free(headers->last_modified);
 }
 
 
@@ -207,6 +281,83 @@ open_socket(char * hostname, unsigned short portnum) {
 	return s;
 }
 
+static void
+httpc_pool_lock_init(void) {
+
+#ifndef HAVE_LIBPTHREAD
+	if (httpc_pool_lock == NULL) {
+		httpc_pool_lock = g_mutex_new();
+	}
+#endif /* !HAVE_LIBPTHREAD */
+}
+
+/* Return an idle connection to host:port, or -1 if there is none. */
+int
+httpc_pool_take(char * host, int port) {
+
+	time_t now = time(NULL);
+	int sock = -1;
+	int i;
+
+	httpc_pool_lock_init();
+	AQUALUNG_MUTEX_LOCK(httpc_pool_lock)
+	i = 0;
+	while (i < httpc_pool_count) {
+		httpc_idle_conn_t * conn = httpc_pool + i;
+
+		if (now - conn->since > HTTPC_POOL_IDLE_TIME) {
+			close(conn->sock);
+		} else if (sock < 0 && conn->port == port && strcmp(conn->host, host) == 0) {
+			char c;
+			/* an idle socket that is readable was closed by the server */
+			if (recv(conn->sock, &c, 1, MSG_PEEK | MSG_DONTWAIT) < 0 &&
+			    (errno == EAGAIN || errno == EWOULDBLOCK)) {
+				sock = conn->sock;
+			} else {
+				close(conn->sock);
+			}
+		} else {
+			++i;
+			continue;
+		}
+		httpc_pool[i] = httpc_pool[--httpc_pool_count];
+	}
+	AQUALUNG_MUTEX_UNLOCK(httpc_pool_lock)
+
+#ifdef HTTPC_DEBUG
+	if (sock >= 0) {
+		printf("reusing connection to %s:%d\n", host, port);
+	}
+#endif /* HTTPC_DEBUG */
+	return sock;
+}
+
+void
+httpc_pool_put(char * host, int port, int sock) {
+
+	httpc_idle_conn_t * conn;
+
+	httpc_pool_lock_init();
+	AQUALUNG_MUTEX_LOCK(httpc_pool_lock)
+	if (httpc_pool_count == HTTPC_POOL_SIZE) {
+		/* evict the connection idle for the longest time */
+		int i, oldest = 0;
+		for (i = 1; i < httpc_pool_count; i++) {
+			if (httpc_pool[i].since < httpc_pool[oldest].since) {
+				oldest = i;
+			}
+		}
+		close(httpc_pool[oldest].sock);
+		httpc_pool[oldest] = httpc_pool[--httpc_pool_count];
+	}
+	conn = httpc_pool + httpc_pool_count++;
+	g_strlcpy(conn->host, host, sizeof(conn->host));
+	conn->port = port;
+	conn->sock = sock;
+	conn->since = time(NULL);
+	AQUALUNG_MUTEX_UNLOCK(httpc_pool_lock)
+}
+
 int
 read_socket(int s, char * buf, int n) {
 	
@@ -232,6 +383,18 @@ read_socket(int s, char * buf, int n) {
 	return bcount;
 }
 
+/* Read whatever is available (at most n bytes) after waiting no more
+ * than timeout seconds for the socket to become readable.
+ */
+int
+recv_socket(int s, char * buf, int n, int timeout) {
+
+	if (!sock_can_read(s, timeout)) {
+		return -1;
+	}
+	return recv(s, buf, n, 0);
+}
+
 int
 read_sock_line(int s, char * buf, int n) {
 	
@@ -342,7 +505,11 @@ parse_http_headers(http_session_t * session) {
 	int s = session->sock;
 	http_header_t * header = &session->headers;
 	
-	read_sock_line(s, line, sizeof(line));
+	line[0] = '\0';
+	if (read_sock_line(s, line, sizeof(line)) <= 0) {
+		/* no response at all, e.g. a stale keep-alive connection */
+		return -4;
+	}
 #ifdef HTTPC_DEBUG
 	printf("line = '%s'\n", line);
 #endif /* HTTPC_DEBUG */
@@ -357,6 +524,7 @@ parse_http_headers(http_session_t * session) {
 	}
 
 	header->status = strdup(line);
+	header->connection_close = (strstr(line, "HTTP/1.1") != line);
 	
 	while (1) {
 		char new_name[1024];
@@ -389,6 +557,13 @@ parse_http_headers(http_session_t * session) {
 			} else {
 				header->content_length = l;
 			}
+		} else if (strcasecmp(name, "content-range") == 0) {
+			int l;
+			if (sscanf(value, "bytes %*d-%*d/%d", &l) == 1) {
+				header->content_total = l;
+			}
+		} else if (strcasecmp(name, "connection") == 0) {
+			header->connection_close = (strcasecmp(value, "close") == 0);
 		} else if (strcasecmp(name, "content-type") == 0) {
 			header->content_type = strdup(value);
 		} else if (strcasecmp(name, "transfer-encoding") == 0) {
@@ -423,6 +598,10 @@ parse_http_headers(http_session_t * session) {
 			header->icy_name = strdup(value);
 		} else if (strcasecmp(name, "icy-description") == 0) {
 			header->icy_description = strdup(value);
+		} else if (strcasecmp(name, "etag") == 0) {
+			header->etag = strdup(value);
+		} else if (strcasecmp(name, "last-modified") == 0) {
+			header->last_modified = strdup(value);
 		}
 #ifdef HTTPC_DEBUG
 		printf("name = '%s'  value = '%s'\n", name, value);
@@ -446,17 +625,28 @@ parse_chunk_size(char * line) {
 }
 
 void
-make_http_request_text(char * host, int port, char * path,
-		       int use_proxy, char * proxy,
-		       long long start_byte, char * msg, int msg_len) {
+make_http_request_text(http_session_t * session, char * host, int port, char * path,
+		       int use_proxy, char * proxy, long long start_byte,
+		       char * msg, int msg_len) {
 
 	char extra_header[1024];
+	char * connection = session->keep_alive ? "keep-alive" : "close";
 	
 	if (start_byte != 0) {
 		arr_snprintf(extra_header, "Range: bytes=%lld-\r\n", start_byte);
 	} else {
 		extra_header[0] = '\0';
 	}
+	if (session->if_none_match != NULL) {
+		arr_strlcat(extra_header, "If-None-Match: ");
+		arr_strlcat(extra_header, session->if_none_match);
+		arr_strlcat(extra_header, "\r\n");
+	}
+	if (session->if_modified_since != NULL) {
+		arr_strlcat(extra_header, "If-Modified-Since: ");
+		arr_strlcat(extra_header, session->if_modified_since);
+		arr_strlcat(extra_header, "\r\n");
+	}
 
 	if (!use_proxy) {
 		if (port == 80) {
@@ -466,8 +656,8 @@ make_http_request_text(char * host, int port, char * path,
 				 "User-Agent: Aqualung/%s\r\n"
 				 "icy-metadata: 1\r\n"
 				 "%s"
-				 "Connection: close\r\n\r\n",
-				 path, host, AQUALUNG_VERSION, extra_header);
+				 "Connection: %s\r\n\r\n",
+				 path, host, AQUALUNG_VERSION, extra_header, connection);
 		} else {
 			snprintf(msg, msg_len,
 				 "GET %s HTTP/1.1\r\n"
@@ -475,8 +665,8 @@ make_http_request_text(char * host, int port, char * path,
 				 "User-Agent: Aqualung/%s\r\n"
 				 "icy-metadata: 1\r\n"
 				 "%s"
-				 "Connection: close\r\n\r\n",
-				 path, host, port, AQUALUNG_VERSION, extra_header);
+				 "Connection: %s\r\n\r\n",
+				 path, host, port, AQUALUNG_VERSION, extra_header, connection);
 		}
 	} else {
 		if (port == 80) {
@@ -486,8 +676,8 @@ make_http_request_text(char * host, int port, char * path,
 				 "User-Agent: Aqualung/%s\r\n"
 				 "icy-metadata: 1\r\n"
 				 "%s"
-				 "Connection: close\r\n\r\n",
-				 host, path, host, AQUALUNG_VERSION, extra_header);
+				 "Connection: %s\r\n\r\n",
+				 host, path, host, AQUALUNG_VERSION, extra_header, connection);
 		} else {
 			snprintf(msg, msg_len,
 				 "GET http://%s:%d%s HTTP/1.1\r\n"
@@ -495,8 +685,8 @@ make_http_request_text(char * host, int port, char * path,
 				 "User-Agent: Aqualung/%s\r\n"
 				 "icy-metadata: 1\r\n"
 				 "%s"
-				 "Connection: close\r\n\r\n",
-				 host, port, path, host, port, AQUALUNG_VERSION, extra_header);
+				 "Connection: %s\r\n\r\n",
+				 host, port, path, host, port, AQUALUNG_VERSION, extra_header, connection);
 		}
 	}
 }
@@ -518,11 +708,14 @@ httpc_del(http_session_t * session) {
 		return;
 	}
 
+	httpc_readahead_stop(session);
 	free(session->URL);
 	if (session->proxy != NULL)
 		free(session->proxy);
 	if (session->noproxy_domains != NULL)
 		free(session->noproxy_domains);
+	if (session->conn_host != NULL)
+		free(session->conn_host);
 	free_headers(&session->headers);
 	free(session);
 }
@@ -530,11 +723,18 @@ httpc_del(http_session_t * session) {
 void
 httpc_close(http_session_t * session) {
 
+	httpc_readahead_stop(session);
 	if (session->is_active) {
+		if (session->keep_alive && !session->headers.connection_close &&
+		    ((session->type == HTTPC_SESSION_NORMAL && session->body_left == 0) ||
+		     (session->type == HTTPC_SESSION_CHUNKED && session->end_of_data))) {
+			httpc_pool_put(session->conn_host, session->conn_port, session->sock);
+		} else {
 #ifdef HTTPC_DEBUG
-		printf("closing HTTP connection\n");
+			printf("closing HTTP connection\n");
 #endif /* HTTPC_DEBUG */
-		close(session->sock);
+			close(session->sock);
+		}
 		session->is_active = 0;
 	}
 }
@@ -568,18 +768,30 @@ noproxy_for_host(const char * noproxy_domains, const char * host) {
 }
 
 
-int
-httpc_init(http_session_t * session, file_decoder_t * fdec,
-	   char * URL, int use_proxy, char * proxy, int proxy_port,
-	   char * noproxy_domains, long long start_byte) {
+static int
+httpc_connect(http_session_t * session, char * URL,
+	      int use_proxy, char * proxy, int proxy_port,
+	      char * noproxy_domains, long long start_byte) {
 	
 	char * p;
 	char host[1024];
 	char port_str[8];
 	int port;
 	char msg_buf[1024];
+	int keep_alive = session->keep_alive;
+	char * if_none_match = session->if_none_match;
+	char * if_modified_since = session->if_modified_since;
+	int reused = 0;
+	int ret;
 	
+	/* left over from the previous connection on redirect or reconnect */
+	if (session->conn_host != NULL)
+		free(session->conn_host);
+
 	memset(session, 0, sizeof(http_session_t));
+	session->keep_alive = keep_alive;
+	session->if_none_match = if_none_match;
+	session->if_modified_since = if_modified_since;
 	
 	if (!httpc_is_url(URL))
 		return HTTPC_URL_ERROR;
@@ -631,46 +843,82 @@ httpc_init(http_session_t * session, file_decoder_t * fdec,
 		}
 	}
 	
-	make_http_request_text(host, port, URL, use_proxy, proxy,
-			       start_byte, msg_buf, sizeof(msg_buf));
+	make_http_request_text(session, host, port, URL, use_proxy, proxy, start_byte,
+			       msg_buf, sizeof(msg_buf));
 #ifdef HTTPC_DEBUG
 	printf("%s\n", msg_buf);
 #endif /* HTTPC_DEBUG */
 	
 	if (!use_proxy || noproxy_for_host(noproxy_domains, host)) {
-		session->sock = open_socket(host, port);
+		session->conn_host = strdup(host);
+		session->conn_port = port;
 	} else {
-		session->sock = open_socket(proxy, proxy_port);
+		session->conn_host = strdup(proxy);
+		session->conn_port = proxy_port;
+	}
+
+	session->sock = -1;
+	if (keep_alive) {
+		session->sock = httpc_pool_take(session->conn_host, session->conn_port);
+		reused = (session->sock >= 0);
+	}
+	if (session->sock < 0) {
+		session->sock = open_socket(session->conn_host, session->conn_port);
 	}
 
 	if (session->sock < 0) {
 		return HTTPC_CONNECTION_ERROR;
 	}
 
-	write_socket(session->sock, msg_buf, strlen(msg_buf));
+	ret = -4;
+	if (write_socket(session->sock, msg_buf, strlen(msg_buf)) >= 0) {
+		ret = parse_http_headers(session);
+	}
+	if (ret == -4 && reused) {
+		/* the server dropped the idle connection meanwhile */
+		close(session->sock);
+		free_headers(&session->headers);
+		memset(&session->headers, 0, sizeof(http_header_t));
+		session->sock = open_socket(session->conn_host, session->conn_port);
+		if (session->sock < 0) {
+			return HTTPC_CONNECTION_ERROR;
+		}
+		ret = -4;
+		if (write_socket(session->sock, msg_buf, strlen(msg_buf)) >= 0) {
+			ret = parse_http_headers(session);
+		}
+	}
 	
-	if (parse_http_headers(session) != 0) {
+	if (ret != 0) {
 		close(session->sock);
 #ifdef HTTPC_DEBUG
 		printf("http header error, server error or resource not found\n");
 #endif /* HTTPC_DEBUG */
-		return HTTPC_HEADER_ERROR;
+		if (ret == -4) {
+			return HTTPC_CONNECTION_ERROR;
+		}
+		return (ret == -2) ? HTTPC_SERVER_ERROR : HTTPC_HEADER_ERROR;
 	}
 
-	if (check_http_response(session->headers.status, "30")) {
+	if (check_http_response(session->headers.status, "304")) {
+		/* cached copy is still valid, no body follows */
+		session->type = HTTPC_SESSION_NORMAL;
+		session->is_active = 1;
+		session->body_left = 0;
+		return HTTPC_NOT_MODIFIED;
+	} else if (check_http_response(session->headers.status, "30")) {
 		/* redirect */
 		if (session->headers.location != NULL) {
 			char * location = strdup(session->headers.location);
-			int ret;
 #ifdef HTTPC_DEBUG
 			printf("redirecting to %s\n", session->headers.location);
 #endif /* HTTPC_DEBUG */
 			close(session->sock);
 			free(session->URL);
 			free_headers(&session->headers);
-			ret = httpc_init(session, fdec,
-					 location, use_proxy, proxy,
-					 proxy_port, noproxy_domains, 0L);
+			ret = httpc_connect(session, location,
+					    use_proxy, proxy, proxy_port,
+					    noproxy_domains, start_byte);
 			free(location);
 			return ret;
 		} else {
@@ -684,7 +932,6 @@ httpc_init(http_session_t * session, file_decoder_t * fdec,
 		   (strcasecmp(session->headers.content_type, "audio/x-mpegurl") == 0)) {
 		
 		char buf[1024];
-		int ret;
 		read_sock_line(session->sock, buf, sizeof(buf));
 #ifdef HTTPC_DEBUG
 		printf("following x-mpegurl to %s\n", buf);
@@ -692,9 +939,9 @@ httpc_init(http_session_t * session, file_decoder_t * fdec,
 		close(session->sock);
 		free(session->URL);
 		free_headers(&session->headers);
-		ret = httpc_init(session, fdec,
-				 buf, use_proxy, proxy, proxy_port,
-				 noproxy_domains, 0L);
+		ret = httpc_connect(session, buf,
+				    use_proxy, proxy, proxy_port,
+				    noproxy_domains, 0L);
 		return ret;
 	}
 
@@ -709,13 +956,17 @@ httpc_init(http_session_t * session, file_decoder_t * fdec,
 
 	session->is_active = 1;
 	session->byte_pos = start_byte;
-
-	session->fdec = fdec;
-	if (fdec != NULL && fdec->meta_cb != NULL) {
-		fdec->meta = metadata_new();
-		fdec->meta->fdec = fdec;
-		httpc_add_headers_meta(session, fdec->meta);
-		fdec->meta_cb(fdec->meta, fdec->meta_cbdata);
+	session->body_left = session->headers.content_length;
+
+	if (start_byte > 0 && session->type == HTTPC_SESSION_NORMAL) {
+		if (!check_http_response(session->headers.status, "206")) {
+			/* Range ignored, we get the whole resource */
+			session->byte_pos = 0;
+		} else if (session->headers.content_total > 0) {
+			session->headers.content_length = session->headers.content_total;
+		} else {
+			session->headers.content_length += start_byte;
+		}
 	}
 
 #ifdef HTTPC_DEBUG
@@ -724,6 +975,67 @@ httpc_init(http_session_t * session, file_decoder_t * fdec,
 	return 0;
 }
 
+/* Hand meta to the decoder's metadata callback. The callback may
+ * take its time, so callers must not hold any lock of the session.
+ */
+static void
+httpc_dispatch_meta(http_session_t * session, metadata_t * meta) {
+
+	file_decoder_t * fdec = session->fdec;
+
+	if (meta != NULL) {
+		fdec->meta = meta;
+		fdec->meta_cb(meta, fdec->meta_cbdata);
+	}
+}
+
+static metadata_t *
+httpc_headers_meta(http_session_t * session) {
+
+	file_decoder_t * fdec = session->fdec;
+	metadata_t * meta;
+
+	if (fdec == NULL || fdec->meta_cb == NULL) {
+		return NULL;
+	}
+
+	meta = metadata_new();
+	meta->fdec = fdec;
+	httpc_add_headers_meta(session, meta);
+	return meta;
+}
+
+static void
+httpc_send_headers_meta(http_session_t * session) {
+
+	httpc_dispatch_meta(session, httpc_headers_meta(session));
+}
+
+int
+httpc_init(http_session_t * session, file_decoder_t * fdec,
+	   char * URL, int use_proxy, char * proxy, int proxy_port,
+	   char * noproxy_domains, long long start_byte) {
+
+	int ret;
+
+	if ((ret = httpc_connect(session, URL, use_proxy, proxy, proxy_port,
+				 noproxy_domains, start_byte)) != HTTPC_OK) {
+		return ret;
+	}
+
+	session->fdec = fdec;
+	httpc_send_headers_meta(session);
+
+	/* only audio streams are worth a reader thread; downloads
+	   and seekable files are read synchronously */
+	if (fdec != NULL && session->type == HTTPC_SESSION_STREAM &&
+	    options.inet_readahead_kb > 0) {
+		httpc_readahead_start(session);
+	}
+
+	return 0;
+}
+
 int
 httpc_read_normal(http_session_t * session, char * buf, int num) {
 
@@ -749,6 +1061,7 @@ httpc_read_normal(http_session_t * session, char * buf, int num) {
 		return -1;
 	}
 	session->byte_pos += n_read;
+	session->body_left -= n_read;
 	return n_read;
 }
 
@@ -803,6 +1116,9 @@ httpc_read_chunked(http_session_t * session, char * buf, int num) {
 #ifdef HTTPC_DEBUG
 				printf("end of data\n");
 #endif /* HTTPC_DEBUG */
+				/* skip the trailer so the connection can be reused */
+				while (read_sock_line(sock, line, sizeof(line)) > 0)
+					;
 				session->end_of_data = 1;
 			}
 		}
@@ -835,32 +1151,58 @@ httpc_add_headers_meta(http_session_t * session, metadata_t * meta) {
 	}
 }
 
-int
-httpc_demux(http_session_t * session) {
+/* Read an ICY metadata block into session->meta_buf.
+ * Return its length, or -1 on error.
+ */
+static int
+httpc_demux_read(http_session_t * session) {
 
 	int meta_len;
-	char meta_len_buf;
-	char * meta_buf;
+	unsigned char meta_len_buf;
 
-	if (read_socket(session->sock, &meta_len_buf, 1) != 1)
+	if (read_socket(session->sock, (char *)&meta_len_buf, 1) != 1)
 		return -1;
 
 	meta_len = 16 * meta_len_buf;
-	meta_buf = calloc(meta_len+1, 1);
-	if (read_socket(session->sock, meta_buf, meta_len) != meta_len)
+	if (read_socket(session->sock, session->meta_buf, meta_len) != meta_len)
 		return -1;
 
-	meta_buf[meta_len] = '\0';
+	session->meta_buf[meta_len] = '\0';
+	return meta_len;
+}
 
-	if (meta_len > 0 && session->fdec != NULL && session->fdec->meta_cb != NULL) {
-		metadata_t * meta = metadata_from_mpeg_stream_data(meta_buf);
-		meta->fdec = session->fdec;
-		session->fdec->meta = meta;
-		httpc_add_headers_meta(session, meta);
-		session->fdec->meta_cb(meta, session->fdec->meta_cbdata);
+static metadata_t *
+httpc_stream_meta(http_session_t * session, char * meta_buf) {
+
+	metadata_t * meta;
+
+	if (session->fdec == NULL || session->fdec->meta_cb == NULL) {
+		return NULL;
 	}
 
-	free(meta_buf);
+	meta = metadata_from_mpeg_stream_data(meta_buf);
+	meta->fdec = session->fdec;
+	httpc_add_headers_meta(session, meta);
+	return meta;
+}
+
+static void
+httpc_send_meta(http_session_t * session, char * meta_buf) {
+
+	httpc_dispatch_meta(session, httpc_stream_meta(session, meta_buf));
+}
+
+int
+httpc_demux(http_session_t * session) {
+
+	int meta_len;
+
+	if ((meta_len = httpc_demux_read(session)) < 0)
+		return -1;
+
+	if (meta_len > 0) {
+		httpc_send_meta(session, session->meta_buf);
+	}
 	return 0;
 }
 
@@ -922,6 +1264,363 @@ httpc_read_stream(http_session_t * session, char * buf, int num) {
 	}
 }
 
+/* Called on the reader thread when the stream stalled or the server
+ * dropped the connection: open a fresh connection to the same URL and
+ * splice it into the session, so the decoder only sees a discontinuity.
+ */
+static int
+httpc_readahead_reopen(http_session_t * session) {
+
+	httpc_readahead_t * ra = session->readahead;
+	http_session_t * fresh;
+	int ret;
+
+	if ((fresh = httpc_new()) == NULL)
+		return HTTPC_CONNECTION_ERROR;
+
+	ret = httpc_connect(fresh, session->URL,
+			    session->use_proxy, session->proxy,
+			    session->proxy_port, session->noproxy_domains, 0L);
+	if (ret == HTTPC_OK && fresh->type != HTTPC_SESSION_STREAM) {
+		close(fresh->sock);
+		ret = HTTPC_HEADER_ERROR;
+	}
+	if (ret != HTTPC_OK) {
+		fprintf(stderr, "httpc: reconnecting stream failed, ret = %d\n", ret);
+		httpc_del(fresh);
+		return ret;
+	}
+
+	AQUALUNG_MUTEX_LOCK(ra->mutex)
+	if (session->is_active) {
+		close(session->sock);
+	}
+	if (ra->quit) {
+		close(fresh->sock);
+		session->is_active = 0;
+	} else {
+		session->sock = fresh->sock;
+		session->is_active = 1;
+	}
+	free_headers(&session->headers);
+	session->headers = fresh->headers;
+	memset(&fresh->headers, 0, sizeof(http_header_t));
+	session->metapos = 0;
+	ra->headers_changed = 1;
+	++ra->reconnects;
+	AQUALUNG_MUTEX_UNLOCK(ra->mutex)
+
+	httpc_del(fresh);
+	return HTTPC_OK;
+}
+
+static void
+httpc_readahead_account(httpc_readahead_t * ra, int n) {
+
+	double elapsed;
+
+	AQUALUNG_MUTEX_LOCK(ra->mutex)
+	ra->written += n;
+	ra->rate_bytes += n;
+	elapsed = g_timer_elapsed(ra->timer, NULL);
+	if (elapsed >= 1.0) {
+		ra->kbps = 8.0 * ra->rate_bytes / elapsed / 1000.0;
+		ra->rate_bytes = 0;
+		g_timer_start(ra->timer);
+	}
+	if (ra->buffering && rb_read_space(ra->rb) >= ra->prebuffer) {
+		ra->buffering = 0;
+	}
+	if (!ra->buffering) {
+		AQUALUNG_COND_SIGNAL(ra->data_cond)
+	}
+	AQUALUNG_MUTEX_UNLOCK(ra->mutex)
+}
+
+/* If the queue is full, the oldest block is dropped: it would be
+ * superseded by the time it reaches the decoder anyway.
+ */
+static void
+httpc_readahead_queue_meta(httpc_readahead_t * ra, char * buf, int len) {
+
+	httpc_meta_block_t * block;
+
+	AQUALUNG_MUTEX_LOCK(ra->mutex)
+	if (ra->meta_count == HTTPC_META_QUEUE) {
+		ra->meta_head = (ra->meta_head + 1) % HTTPC_META_QUEUE;
+		--ra->meta_count;
+	}
+	block = &ra->meta[(ra->meta_head + ra->meta_count) % HTTPC_META_QUEUE];
+	memcpy(block->buf, buf, len + 1);
+	block->pos = ra->written;
+	++ra->meta_count;
+	AQUALUNG_MUTEX_UNLOCK(ra->mutex)
+}
+
+static void *
+httpc_readahead_thread(void * arg) {
+
+	http_session_t * session = (http_session_t *)arg;
+	httpc_readahead_t * ra = session->readahead;
+	int failures = 0;
+
+	while (1) {
+		rb_data_t vec[2];
+		int metaint;
+		int timeout;
+		int n;
+
+		AQUALUNG_MUTEX_LOCK(ra->mutex)
+		while (!ra->quit && rb_write_space(ra->rb) < ra->block) {
+			AQUALUNG_COND_WAIT(ra->space_cond, ra->mutex)
+		}
+		if (ra->quit) {
+			AQUALUNG_MUTEX_UNLOCK(ra->mutex)
+			break;
+		}
+		AQUALUNG_MUTEX_UNLOCK(ra->mutex)
+
+		metaint = session->headers.icy_metaint;
+		if (metaint > 0 && session->metapos == metaint) {
+			n = httpc_demux_read(session);
+			if (n >= 0) {
+				session->metapos = 0;
+				if (n > 0) {
+					httpc_readahead_queue_meta(ra, session->meta_buf, n);
+				}
+				continue;
+			}
+		} else {
+			/* receive straight into the ring buffer */
+			rb_get_write_vector(ra->rb, vec);
+			n = vec[0].len;
+			if (metaint > 0 && n > metaint - session->metapos) {
+				n = metaint - session->metapos;
+			}
+			timeout = options.inet_timeout;
+			if (rb_read_space(ra->rb) < ra->low_water &&
+			    timeout > HTTPC_STALL_TIMEOUT) {
+				timeout = HTTPC_STALL_TIMEOUT;
+			}
+			n = recv_socket(session->sock, vec[0].buf, n, timeout);
+			if (n > 0) {
+				rb_write_advance(ra->rb, n);
+				session->metapos += n;
+				httpc_readahead_account(ra, n);
+				failures = 0;
+				continue;
+			}
+		}
+
+		if (ra->quit) {
+			break;
+		}
+
+		/* stalled or dropped by the server */
+		if (++failures > HTTPC_RECONNECT_RETRIES) {
+			fprintf(stderr, "httpc: giving up on stream %s\n", session->URL);
+			break;
+		}
+		if (failures > 1) {
+			int i;
+			for (i = 0; i < 10 && !ra->quit; i++) {
+				g_usleep(100000);
+			}
+		}
+		httpc_readahead_reopen(session);
+	}
+
+	AQUALUNG_MUTEX_LOCK(ra->mutex)
+	ra->done = 1;
+	ra->buffering = 0;
+	AQUALUNG_COND_SIGNAL(ra->data_cond)
+	AQUALUNG_MUTEX_UNLOCK(ra->mutex)
+
+	return NULL;
+}
+
+static void
+httpc_readahead_start(http_session_t * session) {
+
+	httpc_readahead_t * ra;
+
+	if ((ra = (httpc_readahead_t *)calloc(1, sizeof(httpc_readahead_t))) == NULL) {
+		fprintf(stderr, "httpc_readahead_start: calloc error\n");
+		return;
+	}
+
+	if ((ra->rb = rb_create(options.inet_readahead_kb * 1024)) == NULL) {
+		fprintf(stderr, "httpc_readahead_start: rb_create error\n");
+		free(ra);
+		return;
+	}
+
+	ra->size = rb_write_space(ra->rb);
+	ra->prebuffer = (long long)ra->size * options.inet_prebuffer / 100;
+	ra->low_water = ra->size / 8;
+	ra->block = (ra->size < HTTPC_READAHEAD_BLOCK) ? ra->size : HTTPC_READAHEAD_BLOCK;
+	ra->buffering = (ra->prebuffer > 0);
+	ra->timer = g_timer_new();
+
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_init(&ra->mutex, NULL);
+	pthread_cond_init(&ra->data_cond, NULL);
+	pthread_cond_init(&ra->space_cond, NULL);
+#else
+	ra->mutex = g_mutex_new();
+	ra->data_cond = g_cond_new();
+	ra->space_cond = g_cond_new();
+	if (httpc_active_lock == NULL) {
+		httpc_active_lock = g_mutex_new();
+	}
+#endif /* HAVE_LIBPTHREAD */
+
+	session->readahead = ra;
+	AQUALUNG_THREAD_CREATE(ra->thread_id, NULL, httpc_readahead_thread, session)
+
+	AQUALUNG_MUTEX_LOCK(httpc_active_lock)
+	httpc_active = ra;
+	AQUALUNG_MUTEX_UNLOCK(httpc_active_lock)
+}
+
+static void
+httpc_readahead_stop(http_session_t * session) {
+
+	httpc_readahead_t * ra = session->readahead;
+
+	if (ra == NULL) {
+		return;
+	}
+
+	AQUALUNG_MUTEX_LOCK(httpc_active_lock)
+	if (httpc_active == ra) {
+		httpc_active = NULL;
+	}
+	AQUALUNG_MUTEX_UNLOCK(httpc_active_lock)
+
+	/* shutting down the socket wakes the reader up from select() */
+	AQUALUNG_MUTEX_LOCK(ra->mutex)
+	ra->quit = 1;
+	if (session->is_active) {
+		shutdown(session->sock, SHUT_RDWR);
+	}
+	AQUALUNG_COND_SIGNAL(ra->space_cond)
+	AQUALUNG_MUTEX_UNLOCK(ra->mutex)
+
+	AQUALUNG_THREAD_JOIN(ra->thread_id)
+
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_destroy(&ra->mutex);
+	pthread_cond_destroy(&ra->data_cond);
+	pthread_cond_destroy(&ra->space_cond);
+#else
+	g_mutex_free(ra->mutex);
+	g_cond_free(ra->data_cond);
+	g_cond_free(ra->space_cond);
+#endif /* HAVE_LIBPTHREAD */
+	g_timer_destroy(ra->timer);
+	rb_free(ra->rb);
+	free(ra);
+	session->readahead = NULL;
+}
+
+static int
+httpc_read_readahead(http_session_t * session, char * buf, int num) {
+
+	httpc_readahead_t * ra = session->readahead;
+	metadata_t * pending[HTTPC_META_QUEUE + 1];
+	int n_pending = 0;
+	int n_read;
+	int i;
+
+	AQUALUNG_MUTEX_LOCK(ra->mutex)
+	if (!ra->buffering && !ra->done && rb_read_space(ra->rb) == 0) {
+		/* ran dry: wait for the prebuffer to fill up again */
+		ra->buffering = (ra->prebuffer > 0);
+		++ra->rebuffers;
+	}
+	while (!ra->done && (ra->buffering || rb_read_space(ra->rb) == 0)) {
+		AQUALUNG_COND_WAIT(ra->data_cond, ra->mutex)
+	}
+
+	n_read = rb_read(ra->rb, buf, num);
+	ra->consumed += n_read;
+
+	/* build the metadata while the headers can't be swapped by a
+	   reconnect, but run the callbacks after unlocking */
+	if (ra->headers_changed) {
+		ra->headers_changed = 0;
+		pending[n_pending++] = httpc_headers_meta(session);
+	}
+	while (ra->meta_count > 0 && ra->consumed >= ra->meta[ra->meta_head].pos) {
+		pending[n_pending++] = httpc_stream_meta(session, ra->meta[ra->meta_head].buf);
+		ra->meta_head = (ra->meta_head + 1) % HTTPC_META_QUEUE;
+		--ra->meta_count;
+	}
+
+	if (rb_write_space(ra->rb) >= ra->block) {
+		AQUALUNG_COND_SIGNAL(ra->space_cond)
+	}
+	AQUALUNG_MUTEX_UNLOCK(ra->mutex)
+
+	for (i = 0; i < n_pending; i++) {
+		httpc_dispatch_meta(session, pending[i]);
+	}
+
+	return n_read;
+}
+
+static void
+httpc_readahead_stats(httpc_readahead_t * ra, httpc_stats_t * stats) {
+
+	double elapsed;
+
+	AQUALUNG_MUTEX_LOCK(ra->mutex)
+	stats->buffer_size = ra->size;
+	stats->buffer_fill = rb_read_space(ra->rb);
+	stats->low_water = ra->low_water;
+	stats->buffering = ra->buffering;
+	stats->rebuffers = ra->rebuffers;
+	stats->reconnects = ra->reconnects;
+	stats->kbps = ra->kbps;
+	/* don't keep showing the last rate while nothing arrives */
+	elapsed = g_timer_elapsed(ra->timer, NULL);
+	if (elapsed >= 2.0) {
+		stats->kbps = 8.0 * ra->rate_bytes / elapsed / 1000.0;
+	}
+	AQUALUNG_MUTEX_UNLOCK(ra->mutex)
+}
+
+int
+httpc_get_stats(http_session_t * session, httpc_stats_t * stats) {
+
+	if (session->readahead == NULL) {
+		return 0;
+	}
+	httpc_readahead_stats(session->readahead, stats);
+	return 1;
+}
+
+int
+httpc_get_stream_stats(httpc_stats_t * stats) {
+
+	int ret = 0;
+
+#ifndef HAVE_LIBPTHREAD
+	if (httpc_active_lock == NULL) {
+		return 0;
+	}
+#endif /* !HAVE_LIBPTHREAD */
+
+	AQUALUNG_MUTEX_LOCK(httpc_active_lock)
+	if (httpc_active != NULL) {
+		httpc_readahead_stats(httpc_active, stats);
+		ret = 1;
+	}
+	AQUALUNG_MUTEX_UNLOCK(httpc_active_lock)
+	return ret;
+}
+
 int
 httpc_read(http_session_t * session, char * buf, int num) {
 
@@ -931,6 +1630,9 @@ httpc_read(http_session_t * session, char * buf, int num) {
 	case HTTPC_SESSION_CHUNKED:
 		return httpc_read_chunked(session, buf, num);
 	case HTTPC_SESSION_STREAM:
+		if (session->readahead != NULL) {
+			return httpc_read_readahead(session, buf, num);
+		}
 		return httpc_read_stream(session, buf, num);
 	default:
 		fprintf(stderr, "httpc_read: unknown session type = %d\n", session->type);
@@ -950,7 +1652,9 @@ httpc_reconnect(http_session_t * session) {
 	long long start_byte = 0L;
 	int content_length = 0;
 	int ret;
-	
+
+	httpc_readahead_stop(session);
+
 	URL = strdup(session->URL);
 	if (session->use_proxy) {
 		use_proxy = session->use_proxy;
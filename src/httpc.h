@@ -30,15 +30,21 @@
 #define HTTPC_CONNECTION_ERROR -2
 #define HTTPC_HEADER_ERROR     -3
 #define HTTPC_REDIRECT_ERROR   -4
+#define HTTPC_SERVER_ERROR     -5
+#define HTTPC_NOT_MODIFIED      1
 
 #define HTTPC_SESSION_NORMAL  1
 #define HTTPC_SESSION_CHUNKED 2
 #define HTTPC_SESSION_STREAM  3
 
+/* largest ICY metadata block: length byte * 16 */
+#define HTTPC_META_MAX        (255 * 16)
+
 typedef struct {
 	char * status;
 	char * location;
 	int content_length;
+	int content_total; /* from Content-Range, if any */
 	char * content_type;
 	char * transfer_encoding;
 	int icy_metaint;
@@ -46,6 +52,9 @@ typedef struct {
 	char * icy_genre;
 	char * icy_name;
 	char * icy_description;
+	int connection_close; /* server won't keep the connection open */
+	char * etag;
+	char * last_modified;
 } http_header_t;
 
 typedef struct {
@@ -55,6 +64,18 @@ typedef struct {
 	char * proxy;
 	int proxy_port;
 	char * noproxy_domains;
+
+	/* ask for a persistent connection; set after httpc_new() */
+	int keep_alive;
+
+	/* validators of a cached copy for a conditional request (owned
+	   by the caller, may be NULL); set after httpc_new() */
+	char * if_none_match;
+	char * if_modified_since;
+
+	/* host and port the socket is connected to (proxy, if used) */
+	char * conn_host;
+	int conn_port;
 	
 	int sock;
 	int is_active;
@@ -64,6 +85,7 @@ typedef struct {
 	
 	/* variables for normal download: */
 	long long byte_pos;
+	long long body_left; /* unread body bytes of the current response */
 	
 	/* variables for chunked download: */
 	char * chunk_buf;
@@ -73,11 +95,26 @@ typedef struct {
 
 	/* variables for stream download: */
 	int metapos;
+	char meta_buf[HTTPC_META_MAX + 1];
+
+	/* network reader thread filling a ring buffer ahead of the
+	   decoder, NULL if the session is read synchronously */
+	struct _httpc_readahead * readahead;
 
 	/* file decoder that uses us - if that is the case */
 	file_decoder_t * fdec;
 } http_session_t;
 
+typedef struct {
+	int buffer_size;  /* bytes */
+	int buffer_fill;  /* bytes */
+	int low_water;    /* bytes */
+	int kbps;         /* network receive rate */
+	int buffering;    /* nonzero while waiting for the prebuffer */
+	int rebuffers;
+	int reconnects;
+} httpc_stats_t;
+
 
 int httpc_is_url(const char * str);
 
@@ -95,6 +132,21 @@ void httpc_del(http_session_t * session);
  *                 should be 0L for most cases.
  *
  *  Return: one of HTTPC_*
+ *
+ *  A request the server answered with 4xx or malformed headers gives
+ *  HTTPC_HEADER_ERROR, a 5xx answer HTTPC_SERVER_ERROR, no answer at
+ *  all HTTPC_CONNECTION_ERROR.
+ *
+ *  If the server ignored start_byte and sends the resource from the
+ *  beginning, httpc_tell() returns 0 afterwards.
+ *
+ *  If if_none_match or if_modified_since is set and the server
+ *  answers 304, HTTPC_NOT_MODIFIED is returned and there is no body
+ *  to read; the session still has to be closed.
+ *
+ *  Sessions with keep_alive set hand their socket over to a shared
+ *  pool of idle connections when closed after reading the whole
+ *  response; the next request to the same host picks it up again.
  */
 int httpc_init(http_session_t * session, file_decoder_t * fdec, char * URL,
 	       int use_proxy, char * proxy, int proxy_port,
@@ -107,6 +159,16 @@ void httpc_close(http_session_t * session);
 
 int httpc_reconnect(http_session_t * session);
 
+/* Buffer statistics of a read-ahead session. Return 0 (and leave
+ * stats untouched) if the session is read synchronously.
+ */
+int httpc_get_stats(http_session_t * session, httpc_stats_t * stats);
+
+/* Same, for the most recently started read-ahead session; safe to
+ * call from the GUI thread.
+ */
+int httpc_get_stream_stats(httpc_stats_t * stats);
+
 void httpc_add_headers_meta(http_session_t * session, metadata_t * meta);
 
 
@@ -0,0 +1,292 @@
+/*                                                     -*- linux-c -*-
+    Copyright (C) 2026 Aqualung contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+    $Id$
+*/
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#ifdef HAVE_SYS_EVENTFD_H
+#include <stdint.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#endif /* HAVE_SYS_EVENTFD_H */
+
+#include "msgq.h"
+
+
+/* Every slot carries a sequence number telling whose turn it is: equal
+ * to the position when free for the sender at that position, position+1
+ * once the message is in and the receiver may take it. Senders claim a
+ * position with a compare and swap, so a slot is filled by one thread
+ * only and published by the store of its sequence number.
+ */
+#define MSGQ_HEADER 16  /* keeps the payload aligned for long long and pointers */
+
+typedef struct _msgq_slot_t {
+	volatile gint seq;
+} msgq_slot_t;
+
+struct _msgq_t {
+	char * slots;
+	size_t slot_size;
+	size_t msg_size;
+	guint mask;
+
+	volatile gint send_pos;
+	volatile gint recv_pos;
+
+	volatile gint waiting;  /* the receiver is about to sleep */
+#ifdef HAVE_SYS_EVENTFD_H
+	int efd;
+#else
+	GMutex * lock;
+	GCond * cond;
+#endif /* HAVE_SYS_EVENTFD_H */
+
+	volatile gint max_depth;
+	volatile gint n_sent;
+	volatile gint n_full;
+};
+
+
+static msgq_slot_t *
+slot_at(msgq_t * q, guint pos) {
+
+	return (msgq_slot_t *)(q->slots + (pos & q->mask) * q->slot_size);
+}
+
+
+msgq_t *
+msgq_create(size_t n_msgs, size_t msg_size) {
+
+	msgq_t * q;
+	guint n = 1;
+	guint i;
+
+	while (n < n_msgs) {
+		n <<= 1;
+	}
+
+	if ((q = calloc(1, sizeof(msgq_t))) == NULL) {
+		return NULL;
+	}
+	q->msg_size = msg_size;
+	q->slot_size = MSGQ_HEADER + (msg_size + MSGQ_HEADER - 1) / MSGQ_HEADER * MSGQ_HEADER;
+	q->mask = n - 1;
+	if ((q->slots = calloc(n, q->slot_size)) == NULL) {
+		free(q);
+		return NULL;
+	}
+	for (i = 0; i < n; i++) {
+		slot_at(q, i)->seq = i;
+	}
+
+#ifdef HAVE_SYS_EVENTFD_H
+	if ((q->efd = eventfd(0, EFD_NONBLOCK)) < 0) {
+		perror("msgq_create: eventfd");
+		free(q->slots);
+		free(q);
+		return NULL;
+	}
+#else
+	q->lock = g_mutex_new();
+	q->cond = g_cond_new();
+#endif /* HAVE_SYS_EVENTFD_H */
+
+	return q;
+}
+
+
+void
+msgq_free(msgq_t * q) {
+
+#ifdef HAVE_SYS_EVENTFD_H
+	close(q->efd);
+#else
+	g_mutex_free(q->lock);
+	g_cond_free(q->cond);
+#endif /* HAVE_SYS_EVENTFD_H */
+	free(q->slots);
+	free(q);
+}
+
+
+static void
+msgq_wake(msgq_t * q) {
+
+#ifdef HAVE_SYS_EVENTFD_H
+	uint64_t one = 1;
+
+	if (write(q->efd, &one, sizeof(one)) < 0) {
+		; /* counter full: the receiver is awake anyway */
+	}
+#else
+	/* If the lock is busy, either another sender is signalling or the
+	 * receiver is checking the queue and will find the message; only a
+	 * receiver about to enter the wait can miss it, until its timeout.
+	 */
+	if (g_mutex_trylock(q->lock)) {
+		g_cond_signal(q->cond);
+		g_mutex_unlock(q->lock);
+	}
+#endif /* HAVE_SYS_EVENTFD_H */
+}
+
+
+int
+msgq_post(msgq_t * q, const void * msg) {
+
+	msgq_slot_t * slot;
+	guint pos = g_atomic_int_get(&q->send_pos);
+	gint diff, depth, max;
+
+	while (1) {
+		slot = slot_at(q, pos);
+		diff = (gint)((guint)g_atomic_int_get(&slot->seq) - pos);
+		if (diff == 0) {
+			if (g_atomic_int_compare_and_exchange(&q->send_pos, pos, pos + 1)) {
+				break;
+			}
+		} else if (diff < 0) {
+			g_atomic_int_inc(&q->n_full);
+			return -1;
+		}
+		pos = g_atomic_int_get(&q->send_pos);
+	}
+
+	memcpy((char *)slot + MSGQ_HEADER, msg, q->msg_size);
+	g_atomic_int_set(&slot->seq, pos + 1);
+
+	g_atomic_int_inc(&q->n_sent);
+	depth = (gint)(pos + 1 - (guint)g_atomic_int_get(&q->recv_pos));
+	while (depth > (max = g_atomic_int_get(&q->max_depth))) {
+		if (g_atomic_int_compare_and_exchange(&q->max_depth, max, depth)) {
+			break;
+		}
+	}
+	return 0;
+}
+
+
+int
+msgq_send(msgq_t * q, const void * msg) {
+
+	if (msgq_post(q, msg) < 0) {
+		return -1;
+	}
+	if (g_atomic_int_get(&q->waiting)) {
+		msgq_wake(q);
+	}
+	return 0;
+}
+
+
+int
+msgq_recv(msgq_t * q, void * msg) {
+
+	msgq_slot_t * slot;
+	guint pos = g_atomic_int_get(&q->recv_pos);
+	gint diff;
+
+	while (1) {
+		slot = slot_at(q, pos);
+		diff = (gint)((guint)g_atomic_int_get(&slot->seq) - (pos + 1));
+		if (diff == 0) {
+			if (g_atomic_int_compare_and_exchange(&q->recv_pos, pos, pos + 1)) {
+				break;
+			}
+		} else if (diff < 0) {
+			return 0;
+		}
+		pos = g_atomic_int_get(&q->recv_pos);
+	}
+
+	memcpy(msg, (char *)slot + MSGQ_HEADER, q->msg_size);
+	g_atomic_int_set(&slot->seq, pos + q->mask + 1);
+	return 1;
+}
+
+
+int
+msgq_empty(msgq_t * q) {
+
+	guint pos = g_atomic_int_get(&q->recv_pos);
+
+	return (guint)g_atomic_int_get(&slot_at(q, pos)->seq) != pos + 1;
+}
+
+
+int
+msgq_wait(msgq_t * q, int timeout_ms) {
+
+	if (!msgq_empty(q)) {
+		return 1;
+	}
+
+	/* a sender that finds waiting set wakes us; one that published
+	 * before we set it is caught by looking again
+	 */
+	g_atomic_int_set(&q->waiting, 1);
+	if (msgq_empty(q)) {
+#ifdef HAVE_SYS_EVENTFD_H
+		struct pollfd pfd;
+		uint64_t n;
+
+		pfd.fd = q->efd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if (poll(&pfd, 1, timeout_ms) > 0) {
+			if (read(q->efd, &n, sizeof(n)) < 0) {
+				; /* already drained */
+			}
+		}
+#else
+		GTimeVal timeout;
+
+		g_get_current_time(&timeout);
+		g_time_val_add(&timeout, timeout_ms * 1000);
+		g_mutex_lock(q->lock);
+		if (msgq_empty(q)) {
+			g_cond_timed_wait(q->cond, q->lock, &timeout);
+		}
+		g_mutex_unlock(q->lock);
+#endif /* HAVE_SYS_EVENTFD_H */
+	}
+	g_atomic_int_set(&q->waiting, 0);
+
+	return !msgq_empty(q);
+}
+
+
+void
+msgq_get_stats(msgq_t * q, msgq_stats_t * stats) {
+
+	stats->depth = (guint)g_atomic_int_get(&q->send_pos) - (guint)g_atomic_int_get(&q->recv_pos);
+	stats->max_depth = g_atomic_int_get(&q->max_depth);
+	stats->n_sent = g_atomic_int_get(&q->n_sent);
+	stats->n_full = g_atomic_int_get(&q->n_full);
+}
+
+
+// vim: shiftwidth=8:tabstop=8:softtabstop=8 :
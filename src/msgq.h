@@ -0,0 +1,74 @@
+/*                                                     -*- linux-c -*-
+    Copyright (C) 2026 Aqualung contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+    $Id$
+*/
+
+#ifndef AQUALUNG_MSGQ_H
+#define AQUALUNG_MSGQ_H
+
+#include <stddef.h>
+
+
+/* Bounded queue of fixed size messages. Any number of threads may send;
+ * a message becomes visible to the receiver whole or not at all. One
+ * thread receives and may block in msgq_wait() until something arrives.
+ * Receiving never blocks and takes no lock.
+ */
+typedef struct _msgq_t msgq_t;
+
+typedef struct _msgq_stats_t {
+	unsigned int depth;      /* messages waiting right now */
+	unsigned int max_depth;  /* most ever waiting at once */
+	unsigned int n_sent;
+	unsigned int n_full;     /* sends refused because the queue was full */
+} msgq_stats_t;
+
+/* n_msgs is rounded up to a power of two */
+msgq_t * msgq_create(size_t n_msgs, size_t msg_size);
+void msgq_free(msgq_t * q);
+
+/* Returns 0 on success, -1 if the queue is full. Never waits, but
+ * waking a sleeping receiver costs a write() to an eventfd, or a
+ * trylock and signal where there is none.
+ */
+int msgq_send(msgq_t * q, const void * msg);
+
+/* Like msgq_send(), with no system call and no lock, for realtime
+ * callbacks. The receiver is not woken: it finds the message on its
+ * next msgq_recv(), at the latest when its msgq_wait() times out.
+ */
+int msgq_post(msgq_t * q, const void * msg);
+
+/* Copies the oldest message to msg and returns 1, or returns 0 if the
+ * queue is empty.
+ */
+int msgq_recv(msgq_t * q, void * msg);
+
+int msgq_empty(msgq_t * q);
+
+/* Sleep until a message is waiting or timeout_ms passed. Returns 1 if
+ * the queue is not empty.
+ */
+int msgq_wait(msgq_t * q, int timeout_ms);
+
+void msgq_get_stats(msgq_t * q, msgq_stats_t * stats);
+
+
+#endif /* AQUALUNG_MSGQ_H */
+
+// vim: shiftwidth=8:tabstop=8:softtabstop=8 :
@@ -800,6 +800,7 @@ music_store_mark_changed(GtkTreeIter * iter) {
 	char * pname;
 	store_t * data;
 
+	search_index_invalidate();
 	music_store_selection_changed(STORE_TYPE_FILE);
 
 	path = gtk_tree_model_get_path(GTK_TREE_MODEL(music_store), iter);
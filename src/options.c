@@ -52,7 +52,7 @@
 #endif /* HAVE_JACK */
 
 #ifdef HAVE_SRC
-#include <samplerate.h>
+#include "resampler.h"
 #endif /* HAVE_SRC */
 
 #include "ext_lua.h"
@@ -128,6 +128,7 @@ GtkWidget * combo_cwidth;
 GtkWidget * check_magnify_smaller_images;
 GtkWidget * check_dont_show_cover;
 GtkWidget * check_use_external_cover_first;
+GtkWidget * check_cover_thumbnail_cache;
 GtkWidget * check_show_cover_for_ms_tracks_only;
 
 #ifdef HAVE_SYSTRAY
@@ -247,6 +248,8 @@ GtkWidget * inet_label_noproxy_domains;
 GtkWidget * inet_entry_noproxy_domains;
 GtkWidget * inet_help_noproxy_domains;
 GtkWidget * inet_spinner_timeout;
+GtkWidget * inet_spinner_readahead;
+GtkWidget * inet_spinner_prebuffer;
 
 
 GtkWidget * check_disable_skin_support;
@@ -584,6 +587,7 @@ options_window_accept(void) {
 	set_option_from_toggle(check_magnify_smaller_images, &options.magnify_smaller_images);
 	set_option_from_toggle(check_dont_show_cover, &options.dont_show_cover);
 	set_option_from_toggle(check_use_external_cover_first, &options.use_external_cover_first);
+	set_option_from_toggle(check_cover_thumbnail_cache, &options.cover_thumbnail_cache);
         set_option_from_toggle(check_show_cover_for_ms_tracks_only, &options.show_cover_for_ms_tracks_only);
 
 	options.magnify_smaller_images = !options.magnify_smaller_images;
@@ -734,6 +738,8 @@ options_window_accept(void) {
 	set_option_from_spin(inet_spinner_proxy_port, &options.inet_proxy_port);
 	set_option_from_entry(inet_entry_noproxy_domains, options.inet_noproxy_domains, CHAR_ARRAY_SIZE(options.inet_noproxy_domains));
 	set_option_from_spin(inet_spinner_timeout, &options.inet_timeout);
+	set_option_from_spin(inet_spinner_readahead, &options.inet_readahead_kb);
+	set_option_from_spin(inet_spinner_prebuffer, &options.inet_prebuffer);
 
 
 	/* Appearance */
@@ -811,7 +817,7 @@ void
 changed_src_type(GtkWidget * widget, gpointer * data) {
 
 	options.src_type = gtk_combo_box_get_active(GTK_COMBO_BOX(combo_src));
-	gtk_label_set_text(GTK_LABEL(label_src), src_get_description(options.src_type));
+	gtk_label_set_text(GTK_LABEL(label_src), resampler_get_description(options.src_type));
 	set_src_type_label(options.src_type);
 }
 #endif /* HAVE_SRC */
@@ -1982,6 +1988,7 @@ create_options_window(void) {
 	GtkWidget * table_inet;
 	GtkWidget * inet_hbox_timeout;
 	GtkWidget * inet_label_timeout;
+	GtkWidget * inet_hbox_readahead;
 
         GtkSizeGroup * label_size;
 
@@ -2350,6 +2357,13 @@ create_options_window(void) {
 	}
 	gtk_box_pack_start(GTK_BOX(vbox_cart), check_use_external_cover_first, FALSE, FALSE, 0);
 
+        check_cover_thumbnail_cache = gtk_check_button_new_with_label(_("Keep scaled cover images in a disk cache"));
+	gtk_widget_set_name(check_cover_thumbnail_cache, "check_on_notebook");
+	if (options.cover_thumbnail_cache) {
+		gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(check_cover_thumbnail_cache), TRUE);
+	}
+	gtk_box_pack_start(GTK_BOX(vbox_cart), check_cover_thumbnail_cache, FALSE, FALSE, 0);
+
 	frame_misc = gtk_frame_new(_("Miscellaneous"));
 	gtk_box_pack_start(GTK_BOX(vbox_miscellaneous_tab), frame_misc, FALSE, TRUE, 0);
 
@@ -2810,8 +2824,8 @@ create_options_window(void) {
 	{
 		int i = 0;
 
-		while (src_get_name(i)) {
-                        gtk_combo_box_append_text (GTK_COMBO_BOX (combo_src), src_get_name(i));
+		while (resampler_get_name(i)) {
+                        gtk_combo_box_append_text (GTK_COMBO_BOX (combo_src), resampler_get_name(i));
 			++i;
 		}
 
@@ -2820,7 +2834,7 @@ create_options_window(void) {
 	gtk_combo_box_set_active (GTK_COMBO_BOX (combo_src), options.src_type);
 	g_signal_connect(combo_src, "changed", G_CALLBACK(changed_src_type), NULL);
 
-	gtk_label_set_text(GTK_LABEL(label_src), src_get_description(options.src_type));
+	gtk_label_set_text(GTK_LABEL(label_src), resampler_get_description(options.src_type));
 #else
 	gtk_label_set_text(GTK_LABEL(label_src),
 			   _("Aqualung is compiled without Sample Rate Converter support.\n"
@@ -3419,6 +3433,32 @@ create_options_window(void) {
 	gtk_box_pack_start(GTK_BOX(hbox), inet_label_timeout, FALSE, FALSE, 0);
 	gtk_box_pack_start(GTK_BOX(inet_hbox_timeout), hbox, FALSE, FALSE, 5);
 
+	inet_hbox_readahead = gtk_hbox_new(FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox_inet), inet_hbox_readahead, FALSE, FALSE, 5);
+
+	inet_label_timeout = gtk_label_new(_("Stream read-ahead buffer:"));
+	hbox = gtk_hbox_new(FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(hbox), inet_label_timeout, FALSE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(inet_hbox_readahead), hbox, FALSE, FALSE, 5);
+
+	inet_spinner_readahead = gtk_spin_button_new_with_range(0, 8192, 32);
+	gtk_spin_button_set_value(GTK_SPIN_BUTTON(inet_spinner_readahead), options.inet_readahead_kb);
+	gtk_box_pack_start(GTK_BOX(inet_hbox_readahead), inet_spinner_readahead, FALSE, FALSE, 5);
+
+	inet_label_timeout = gtk_label_new(_("KiB, start playback at"));
+	hbox = gtk_hbox_new(FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(hbox), inet_label_timeout, FALSE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(inet_hbox_readahead), hbox, FALSE, FALSE, 5);
+
+	inet_spinner_prebuffer = gtk_spin_button_new_with_range(0, 100, 5);
+	gtk_spin_button_set_value(GTK_SPIN_BUTTON(inet_spinner_prebuffer), options.inet_prebuffer);
+	gtk_box_pack_start(GTK_BOX(inet_hbox_readahead), inet_spinner_prebuffer, FALSE, FALSE, 5);
+
+	inet_label_timeout = gtk_label_new(_("% full"));
+	hbox = gtk_hbox_new(FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(hbox), inet_label_timeout, FALSE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(inet_hbox_readahead), hbox, FALSE, FALSE, 5);
+
 	if (options.inet_use_proxy) {
 		gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(inet_radio_direct), FALSE);
 		gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(inet_radio_proxy), TRUE);
@@ -3842,6 +3882,7 @@ save_config(void) {
 	SAVE_INT(cover_width);
 	SAVE_INT(dont_show_cover);
 	SAVE_INT(use_external_cover_first);
+	SAVE_INT(cover_thumbnail_cache);
 	SAVE_INT(show_cover_for_ms_tracks_only);
 	SAVE_INT(use_systray);
 	SAVE_INT(systray_start_minimized);
@@ -3931,6 +3972,8 @@ save_config(void) {
 	SAVE_INT(inet_proxy_port);
 	SAVE_STR(inet_noproxy_domains);
 	SAVE_INT(inet_timeout);
+	SAVE_INT(inet_readahead_kb);
+	SAVE_INT(inet_prebuffer);
 	SAVE_FLOAT(loop_range_start);
 	SAVE_FLOAT(loop_range_end);
 	SAVE_INT(wm_systray_warn);
@@ -3951,6 +3994,7 @@ save_config(void) {
 	SAVE_INT(export_filter_same);
 	SAVE_INT(export_excl_enabled);
 	SAVE_STR(export_excl_pattern);
+	SAVE_INT(export_workers);
 	SAVE_INT(batch_tag_flags);
 	SAVE_STR(ext_title_format_file);
 
@@ -4167,6 +4211,8 @@ load_config(void) {
 	options.inet_proxy_port = 8080;
 	options.inet_noproxy_domains[0] = '\0';
 	options.inet_timeout = 5;
+	options.inet_readahead_kb = 256;
+	options.inet_prebuffer = 25;
 
 	options.time_idx[0] = 0;
 	options.time_idx[1] = 1;
@@ -4256,6 +4302,7 @@ load_config(void) {
 		LOAD_INT(cover_width);
 		LOAD_INT(dont_show_cover);
 		LOAD_INT(use_external_cover_first);
+		LOAD_INT(cover_thumbnail_cache);
 		LOAD_INT(show_cover_for_ms_tracks_only);
 		LOAD_INT(use_systray);
 		LOAD_INT(systray_start_minimized);
@@ -4338,6 +4385,8 @@ load_config(void) {
 		LOAD_INT(inet_proxy_port);
 		LOAD_STR(inet_noproxy_domains);
 		LOAD_INT(inet_timeout);
+		LOAD_INT(inet_readahead_kb);
+		LOAD_INT(inet_prebuffer);
 		LOAD_FLOAT(loop_range_start);
 		LOAD_FLOAT(loop_range_end);
 		LOAD_INT(wm_systray_warn);
@@ -4358,6 +4407,7 @@ load_config(void) {
 		LOAD_INT(export_filter_same);
 		LOAD_INT(export_excl_enabled);
 		LOAD_STR(export_excl_pattern);
+		LOAD_INT(export_workers);
 		LOAD_INT(batch_tag_flags);
 		LOAD_STR(ext_title_format_file);
 
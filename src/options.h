@@ -100,6 +100,7 @@ typedef struct {
 	int export_filter_same;
 	int export_excl_enabled;
 	char export_excl_pattern[MAXLEN];
+	int export_workers;
 
 	int batch_tag_flags;
 
@@ -164,6 +165,7 @@ typedef struct {
 	int ms_confirm_removal;
 	int cover_width;
 	int magnify_smaller_images;
+	int cover_thumbnail_cache;
 
 	/* DSP */
 	int ladspa_is_postfader;
@@ -212,6 +214,8 @@ typedef struct {
 	int inet_proxy_port;
 	char inet_noproxy_domains[MAXLEN];
 	int inet_timeout;
+	int inet_readahead_kb;
+	int inet_prebuffer;
 
 	/* Appearance */
 	int disable_skin_support_settings;
@@ -81,8 +81,6 @@ extern int is_file_loaded;
 extern int is_paused;
 extern int allow_seeks;
 
-extern rb_t * rb_gui2disk;
-
 extern GtkWidget * playlist_toggle;
 
 
@@ -226,6 +224,7 @@ playlist_data_new() {
 	data->album = NULL;
 	data->title = NULL;
 	data->display = NULL;
+	data->fold = NULL;
 	data->file = NULL;
 
 	return data;
@@ -249,6 +248,7 @@ playlist_data_copy_noalloc(playlist_data_t * dest, playlist_data_t * src) {
 	if (src->file) {
 		free_strdup(&dest->file, src->file);
 	}
+	playlist_data_reset_fold(dest);
 
 	dest->voladj = src->voladj;
 	dest->duration = src->duration;
@@ -296,6 +296,7 @@ playlist_data_free(playlist_data_t * data) {
 		free(data->file);
 		data->file = NULL;
 	}
+	playlist_data_reset_fold(data);
 	free(data);
 }
 
@@ -809,6 +810,7 @@ playlist_reset_display_names(void) {
 			if (!gtk_tree_model_iter_has_child(GTK_TREE_MODEL(pl->store), &iter)) {
 				gtk_tree_model_get(GTK_TREE_MODEL(pl->store), &iter, PL_COL_DATA, &data, -1);
 				if (!httpc_is_url(data->file)) {
+					playlist_data_reset_fold(data);
 					playlist_data_get_display_name(list_str, CHAR_ARRAY_SIZE(list_str), data);
 					gtk_tree_store_set(pl->store, &iter, PL_COL_NAME, list_str, -1);
 				}
@@ -1183,7 +1185,6 @@ playlist_start_playback_at_path(playlist_t * pl, GtkTreePath * path) {
 
 	GtkTreeIter iter;
 	GtkTreePath * p;
-	gchar cmd;
 	cue_t cue;
 
 	playlist_t * plist = NULL;
@@ -1237,11 +1238,8 @@ playlist_start_playback_at_path(playlist_t * pl, GtkTreePath * path) {
 		toggle_noeffect(PAUSE, FALSE);
 	}
 
-	cmd = CMD_CUE;
-	flush_rb_disk2gui();
-	rb_write(rb_gui2disk, &cmd, sizeof(char));
-	rb_write(rb_gui2disk, (void *)&cue, sizeof(cue_t));
-	try_waking_disk_thread();
+	flush_disk2gui();
+	disk_send_cue(&cue);
 }
 
 
@@ -1629,6 +1627,37 @@ playlist_data_get_display_name(char * list_str, size_t list_str_size, playlist_d
 	}
 }
 
+/* The text playlist searches match against: "artist: album" for album
+   nodes, the display name otherwise. */
+void
+playlist_data_get_search_text(char * text, size_t text_size, playlist_data_t * pldata, int album_node) {
+
+	if (album_node) {
+		snprintf(text, text_size, "%s: %s", pldata->artist, pldata->album);
+	} else {
+		playlist_data_get_display_name(text, text_size, pldata);
+	}
+}
+
+const char *
+playlist_data_get_fold(playlist_data_t * pldata, int album_node) {
+
+	if (pldata->fold == NULL) {
+		char text[MAXLEN];
+		playlist_data_get_search_text(text, CHAR_ARRAY_SIZE(text), pldata, album_node);
+		pldata->fold = g_utf8_casefold(text, -1);
+	}
+
+	return pldata->fold;
+}
+
+void
+playlist_data_reset_fold(playlist_data_t * pldata) {
+
+	g_free(pldata->fold);
+	pldata->fold = NULL;
+}
+
 gboolean
 add_file_to_playlist(gpointer data) {
 
@@ -2361,6 +2390,7 @@ plist__reread_file_meta_foreach(playlist_t * pl, GtkTreeIter * iter, void * user
 	free_strdup(&data->album, tmp->album);
 	free_strdup(&data->title, tmp->title);
 	free_strdup(&data->display, tmp->display);
+	playlist_data_reset_fold(data);
 
 	data->voladj = tmp->voladj;
 	data->duration = tmp->duration;
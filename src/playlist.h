@@ -172,6 +172,7 @@ typedef struct {
 	char * title;   /* NULL for album nodes */
 	char * file;    /* NULL for album nodes */
 	char * display; /* Already formatted title ready for display */
+	char * fold;    /* Case-folded search text, built on demand */
 	float voladj;   /* volume adjustment [dB] */
 	float duration; /* length in seconds */
 	unsigned size;  /* file size in bytes */
@@ -184,6 +185,9 @@ typedef struct {
 
 playlist_data_t * playlist_data_new(void);
 void playlist_data_get_display_name(char * list_str, size_t list_str_size, playlist_data_t * pldata);
+void playlist_data_get_search_text(char * text, size_t text_size, playlist_data_t * pldata, int album_node);
+const char * playlist_data_get_fold(playlist_data_t * pldata, int album_node);
+void playlist_data_reset_fold(playlist_data_t * pldata);
 
 #define PL_IS_SET_FLAG(plist, flag) (plist->flags & flag)
 #define PL_SET_FLAG(plist, flag) (plist->flags |= flag)
@@ -59,6 +59,10 @@ void hide_fxbuilder(void);
 void save_plugin_data(void);
 void load_plugin_data(void);
 
+plugin_instance * instantiate(char * filename, int index);
+void connect_port(plugin_instance * instance);
+void activate(plugin_instance * instance);
+
 
 #endif /* AQUALUNG_PLUGIN_H */
 
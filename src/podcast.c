@@ -23,7 +23,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
 #include <sys/stat.h>
 #include <glib.h>
 #include <libxml/globals.h>
@@ -42,6 +45,44 @@
 
 #define BUFSIZE 10240
 
+/* downloads are written to disk in blocks of this size */
+#define PODCAST_WRITE_SIZE (256 * 1024)
+/* seconds between progress reports of a download */
+#define PODCAST_PROGRESS_INTERVAL 0.5
+
+/* enclosures downloaded at the same time per podcast */
+#define PODCAST_DOWNLOAD_WORKERS 3
+/* connections to the same host, shared by all podcasts */
+#define PODCAST_HOST_CONNECTIONS 2
+/* feeds refreshed at the same time */
+#define PODCAST_REFRESH_WORKERS 4
+
+struct _podcast_fetch_t;
+
+typedef struct {
+	AQUALUNG_THREAD_DECLARE(thread_id)
+	struct _podcast_fetch_t * fetch;
+	podcast_item_t * item; /* being downloaded, or NULL */
+	int percent;
+} podcast_worker_t;
+
+typedef struct _podcast_fetch_t {
+	AQUALUNG_MUTEX_DECLARE(mutex)
+	podcast_download_t * pd;
+	GSList * list;
+	int n_failed;
+	int n_workers;
+	podcast_worker_t workers[PODCAST_DOWNLOAD_WORKERS];
+} podcast_fetch_t;
+
+AQUALUNG_MUTEX_DECLARE_INIT(podcast_hosts_mutex)
+AQUALUNG_COND_DECLARE_INIT(podcast_hosts_cond)
+static GHashTable * podcast_hosts = NULL;
+
+AQUALUNG_MUTEX_DECLARE_INIT(podcast_refresh_mutex)
+static GSList * podcast_refresh_queue = NULL;
+static int podcast_refresh_workers = 0;
+
 extern options_t options;
 
 
@@ -91,6 +132,12 @@ podcast_free(podcast_t * podcast) {
 	if (podcast->url) {
 		free(podcast->url);
 	}
+	if (podcast->etag) {
+		free(podcast->etag);
+	}
+	if (podcast->last_modified) {
+		free(podcast->last_modified);
+	}
 
 	g_slist_free(podcast->items);
 
@@ -318,27 +365,87 @@ parse_atom_date(char * str) {
 	return tval.tv_sec;
 }
 
+/* Write len bytes of buf at offset pos of fd. */
+static int
+podcast_write_block(int fd, char * buf, int len, long long pos) {
+
+	while (len > 0) {
+		ssize_t n = pwrite(fd, buf, len, pos);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		buf += n;
+		len -= n;
+		pos += n;
+	}
+	return 0;
+}
+
+/* A .part whose size is wrong would be resumed at the wrong offset. */
+static int
+podcast_truncate(int fd, off_t length, char * part) {
+
+	if (ftruncate(fd, length) < 0) {
+		fprintf(stderr, "podcast_generic_download: unable to truncate %s: %s\n",
+			part, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+/* Download url to path through path.part. With resume set, a .part
+ * left over by an earlier failed attempt is continued with a Range
+ * request, and kept for next time if this attempt fails as well.
+ *
+ * Space for the announced Content-Length is reserved in one go where
+ * fallocate() can do so without growing the file: the size of a .part
+ * must always be the amount received, even after a crash, as resuming
+ * continues from its end. The file is written in PODCAST_WRITE_SIZE
+ * blocks at aligned offsets, read directly from the connection into the
+ * block buffer. callback is called at most every
+ * PODCAST_PROGRESS_INTERVAL seconds.
+ */
 int
-podcast_generic_download(podcast_t * podcast, char * url, char * path,
-			 void (* callback)(podcast_download_t *), podcast_download_t * pd) {
+podcast_generic_download(podcast_t * podcast, char * url, char * path, int resume,
+			 void (* callback)(void *, int), void * cbdata) {
 
 	http_session_t * session;
-	char buf[BUFSIZE];
-	FILE * out;
+	void * block;
+	char * buf;
+	char part[MAXLEN];
+	GTimer * timer;
+	int fd;
 	long long pos = 0;
-	int n_read;
+	int fill;
+	int n_read = 0;
 	int ret;
 	int credit = 5;
 	int penalty = 0;
+	int write_error = 0;
 	int content_length = 0;
 	int percent = 0;
 	int _percent = 0;
 
 
-	if ((out = fopen(path, "wb")) == NULL) {
-		fprintf(stderr, "podcast_generic_download: unable to open file %s\n", path);
+	arr_snprintf(part, "%s.part", path);
+
+	if ((fd = open(part, O_WRONLY | O_CREAT | (resume ? 0 : O_TRUNC), 0644)) < 0) {
+		fprintf(stderr, "podcast_generic_download: unable to open file %s\n", part);
+		return -1;
+	}
+
+	if (posix_memalign(&block, 4096, PODCAST_WRITE_SIZE) != 0) {
+		fprintf(stderr, "podcast_generic_download: posix_memalign error\n");
+		close(fd);
 		return -1;
 	}
+	buf = (char *)block;
+
+	pos = lseek(fd, 0, SEEK_END);
+	timer = g_timer_new();
 
 	while (credit > 0) {
 
@@ -347,54 +454,125 @@ podcast_generic_download(podcast_t * podcast, char * url, char * path,
 		}
 
 		if ((session = httpc_new()) == NULL) {
-			fclose(out);
-			unlink(path);
-			return -1;
+			write_error = 1;
+			break;
 		}
 
+		session->keep_alive = 1;
 		if ((ret = httpc_init(session, NULL, url,
 				      options.inet_use_proxy,
 				      options.inet_proxy,
 				      options.inet_proxy_port,
-				      options.inet_noproxy_domains, 0L)) != HTTPC_OK) {
+				      options.inet_noproxy_domains, pos)) != HTTPC_OK) {
 
 			fprintf(stderr, "podcast_generic_download: httpc_init failed, ret = %d\n", ret);
 			httpc_del(session);
 			--credit;
+			/* The server refused the request (e.g. 416 for a stale
+			   .part): start over. Network trouble and server errors
+			   keep what we have and retry from pos. */
+			if (pos > 0 && ret == HTTPC_HEADER_ERROR) {
+				if (podcast_truncate(fd, 0, part) < 0) {
+					write_error = 1;
+					resume = 0;
+					break;
+				}
+				pos = 0;
+			}
 			continue;
 		}
 
+		if (pos > 0 && httpc_tell(session) != pos) {
+			/* no Range support, start over */
+			if (podcast_truncate(fd, 0, part) < 0) {
+				httpc_close(session);
+				httpc_del(session);
+				write_error = 1;
+				resume = 0;
+				break;
+			}
+			pos = 0;
+		}
+
 		content_length = session->headers.content_length;
 
-		if (httpc_seek(session, pos, SEEK_SET) < -1) {
-			fprintf(stderr, "httpc_seek failed\n");
-			--credit;
-			continue;
+#if defined(HAVE_FALLOCATE) && defined(FALLOC_FL_KEEP_SIZE)
+		if (content_length > pos &&
+		    fallocate(fd, FALLOC_FL_KEEP_SIZE, pos, content_length - pos) < 0 &&
+		    errno == ENOSPC) {
+			fprintf(stderr, "podcast_generic_download: no space left for %s\n", part);
+			httpc_close(session);
+			httpc_del(session);
+			/* give back whatever part of the range was reserved */
+			if (podcast_truncate(fd, pos, part) < 0) {
+				resume = 0;
+			}
+			write_error = 1;
+			break;
 		}
+#endif /* HAVE_FALLOCATE && FALLOC_FL_KEEP_SIZE */
 
 		penalty = 1;
-		while ((n_read = httpc_read(session, buf, BUFSIZE)) > 0) {
+		fill = 0;
+		while (1) {
+
+			/* fill the block up to the next aligned offset */
+			int room = PODCAST_WRITE_SIZE - (int)((pos + fill) % PODCAST_WRITE_SIZE);
+
+			if ((n_read = httpc_read(session, buf + fill, room)) <= 0) {
+				break;
+			}
 
 			if (podcast->state == PODCAST_STATE_ABORTED) {
 				break;
 			}
 
-			pos += n_read;
 			penalty = 0;
-			fwrite(buf, sizeof(char), n_read, out);
+			fill += n_read;
+
+			if (n_read == room) {
+				if (podcast_write_block(fd, buf, fill, pos) < 0) {
+					write_error = 1;
+					break;
+				}
+				pos += fill;
+				fill = 0;
+			}
 
-			if (callback != NULL && content_length > 0) {
-				_percent = (int)((100.0 * pos) / content_length);
+			if (callback != NULL && content_length > 0 &&
+			    g_timer_elapsed(timer, NULL) >= PODCAST_PROGRESS_INTERVAL) {
+				_percent = (int)((100.0 * (pos + fill)) / content_length);
 				if (_percent > percent) {
-					pd->percent = percent = _percent;
-					callback(pd);
+					percent = _percent;
+					callback(cbdata, percent);
 				}
+				g_timer_start(timer);
 			}
 		}
 
+		if (fill > 0 && !write_error) {
+			if (podcast_write_block(fd, buf, fill, pos) < 0) {
+				write_error = 1;
+			} else {
+				pos += fill;
+			}
+		}
+
+		/* drop what was reserved but not received */
+		if (podcast_truncate(fd, pos, part) < 0) {
+			write_error = 1;
+			resume = 0;
+		}
+
 		httpc_close(session);
 		httpc_del(session);
 
+		if (write_error) {
+			fprintf(stderr, "podcast_generic_download: unable to write %s: %s\n",
+				part, strerror(errno));
+			break;
+		}
+
 		if (podcast->state == PODCAST_STATE_ABORTED) {
 			break;
 		}
@@ -407,14 +585,30 @@ podcast_generic_download(podcast_t * podcast, char * url, char * path,
 		break;
 	}
 
-	if (podcast->state == PODCAST_STATE_ABORTED || credit == 0) {
+	g_timer_destroy(timer);
+	free(block);
+
+	if (close(fd) < 0) {
+		write_error = 1;
+	}
 
-		fclose(out);
-		unlink(path);
+	if (podcast->state == PODCAST_STATE_ABORTED || credit == 0 || write_error) {
+		if (podcast->state == PODCAST_STATE_ABORTED || !resume) {
+			unlink(part);
+		}
 		return -1;
 	}
 
-	fclose(out);
+	if (callback != NULL && percent < 100) {
+		callback(cbdata, 100);
+	}
+
+	if (rename(part, path) < 0) {
+		fprintf(stderr, "podcast_generic_download: unable to rename %s: %s\n",
+			part, strerror(errno));
+		unlink(part);
+		return -1;
+	}
 	return 0;
 }
 
@@ -443,38 +637,143 @@ string_remove_html(char * str) {
 	str[j] = '\0';
 }
 
-void
-parse_rss_item(podcast_t * podcast, GSList ** list, xmlDocPtr doc, xmlNodePtr item) {
+enum {
+	PODCAST_FEED_UNKNOWN = 0,
+	PODCAST_FEED_RSS,
+	PODCAST_FEED_ATOM,
+	PODCAST_FEED_OTHER
+};
 
-	podcast_item_t * pitem;
-	xmlNodePtr node;
+/* where the text of the current element goes */
+enum {
+	PODCAST_TEXT_NONE = 0,
+	PODCAST_TEXT_STR,      /* replaces *text_dest */
+	PODCAST_TEXT_STR_KEEP, /* only if *text_dest is still unset */
+	PODCAST_TEXT_RSS_DATE,
+	PODCAST_TEXT_ATOM_DATE
+};
+
+/* State of the streaming (SAX) feed parser. */
+typedef struct {
+
+	xmlParserCtxtPtr ctxt;
+	int format;
+
+	int depth;          /* of the current element */
+	int channel_depth;  /* rss channel or atom feed, 0 outside */
+	int channel_done;   /* only the first rss channel counts */
+	int author_depth;   /* atom feed author, 0 outside */
+	int author_done;
+
+	podcast_item_t * item; /* being parsed, or NULL */
+	int item_depth;
+
+	int text_type;
+	int text_depth;
+	char ** text_dest;
+	GString * text;
+
+	/* handed over to the podcast only if the whole feed parses */
+	char * title;
+	char * author;
+	char * desc;
+	GSList * items;
+
+} podcast_feed_parser_t;
 
-	if ((pitem = podcast_item_new()) == NULL) {
-		return;
-	}
 
-	for (node = item->xmlChildrenNode; node != NULL; node = node->next) {
-		if (!xmlStrcmp(node->name, (const xmlChar *)"title")) {
-                        pitem->title = (char *)xmlNodeListGetString(doc, node->xmlChildrenNode, 1);
-		} else if (!xmlStrcmp(node->name, (const xmlChar *)"description")) {
-                        pitem->desc = (char *)xmlNodeListGetString(doc, node->xmlChildrenNode, 1);
-		} else if (!xmlStrcmp(node->name, (const xmlChar *)"summary")) {
-			if (pitem->desc == NULL) {
-				pitem->desc = (char *)xmlNodeListGetString(doc, node->xmlChildrenNode, 1);
+static char *
+podcast_feed_attr(int nb_attributes, const xmlChar ** attributes, char * name) {
+
+	int i;
+
+	/* localname, prefix, URI, value, end */
+	for (i = 0; i < nb_attributes; i++, attributes += 5) {
+		if (!xmlStrcmp(attributes[0], (const xmlChar *)name)) {
+			const char * src = (const char *)attributes[3];
+			const char * end = (const char *)attributes[4];
+			char * value;
+			int j = 0;
+
+			if ((value = (char *)malloc(end - src + 1)) == NULL) {
+				return NULL;
 			}
-		} else if (!xmlStrcmp(node->name, (const xmlChar *)"enclosure")) {
-			xmlChar * len;
-			if ((len = xmlGetProp(node, (const xmlChar *)"length")) != NULL) {
-				sscanf((char *)len, "%u", &pitem->size);
-				xmlFree(len);
+			/* without entity substitution, libxml passes '&' on as "&#38;" */
+			while (src < end) {
+				if (end - src >= 5 && !strncmp(src, "&#38;", 5)) {
+					value[j++] = '&';
+					src += 5;
+				} else {
+					value[j++] = *src++;
+				}
 			}
-			pitem->url = (char *)xmlGetProp(node, (const xmlChar *)"url");
-		} else if (!xmlStrcmp(node->name, (const xmlChar *)"pubDate")) {
-			xmlChar * tmp = xmlNodeListGetString(doc, node->xmlChildrenNode, 1);
-			pitem->date = parse_rss_date((char *)tmp);
-			xmlFree(tmp);
+			value[j] = '\0';
+			return value;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+podcast_feed_attr_size(int nb_attributes, const xmlChar ** attributes, unsigned * size) {
+
+	char * len;
+
+	if ((len = podcast_feed_attr(nb_attributes, attributes, "length")) != NULL) {
+		sscanf(len, "%u", size);
+		free(len);
+	}
+}
+
+static void
+podcast_feed_text_begin(podcast_feed_parser_t * p, int type, char ** dest) {
+
+	p->text_type = type;
+	p->text_depth = p->depth;
+	p->text_dest = dest;
+	g_string_truncate(p->text, 0);
+}
+
+static void
+podcast_feed_text_end(podcast_feed_parser_t * p) {
+
+	char * str = (p->text->len > 0) ? strdup(p->text->str) : NULL;
+
+	switch (p->text_type) {
+	case PODCAST_TEXT_STR:
+		if (*p->text_dest) {
+			free(*p->text_dest);
 		}
+		*p->text_dest = str;
+		str = NULL;
+		break;
+	case PODCAST_TEXT_STR_KEEP:
+		if (*p->text_dest == NULL) {
+			*p->text_dest = str;
+			str = NULL;
+		}
+		break;
+	case PODCAST_TEXT_RSS_DATE:
+		p->item->date = parse_rss_date(str ? str : "");
+		break;
+	case PODCAST_TEXT_ATOM_DATE:
+		p->item->date = parse_atom_date(str ? str : "");
+		break;
+	}
+
+	if (str) {
+		free(str);
 	}
+	p->text_type = PODCAST_TEXT_NONE;
+}
+
+static void
+podcast_feed_item_end(podcast_feed_parser_t * p) {
+
+	podcast_item_t * pitem = p->item;
+
+	p->item = NULL;
 
 	if (pitem->url == NULL) {
 		podcast_item_free(pitem);
@@ -487,156 +786,244 @@ parse_rss_item(podcast_t * podcast, GSList ** list, xmlDocPtr doc, xmlNodePtr it
 		pitem->title = strdup(_("Untitled"));
 	}
 
-	if (g_slist_find_custom(*list, pitem->url, podcast_item_compare_url) == NULL) {
-		*list = g_slist_prepend(*list, pitem);
+	if (g_slist_find_custom(p->items, pitem->url, podcast_item_compare_url) == NULL) {
+		p->items = g_slist_prepend(p->items, pitem);
 	} else {
 		podcast_item_free(pitem);
 	}
 }
 
-void
-parse_rss(podcast_t * podcast, GSList ** list, xmlDocPtr doc, xmlNodePtr rss) {
+static void
+podcast_rss_start(podcast_feed_parser_t * p, char * name,
+		  int nb_attributes, const xmlChar ** attributes) {
 
-	xmlNodePtr channel;
-	xmlNodePtr node;
+	if (p->channel_depth == 0) {
+		if (p->depth == 2 && !p->channel_done && !strcmp(name, "channel")) {
+			p->channel_depth = p->depth;
+		}
+		return;
+	}
 
+	if (p->item != NULL) {
+		podcast_item_t * pitem = p->item;
 
-	for (channel = rss->xmlChildrenNode; channel != NULL; channel = channel->next) {
-		if (!xmlStrcmp(channel->name, (const xmlChar *)"channel")) {
-			break;
+		if (p->depth != p->item_depth + 1) {
+			return;
 		}
+
+		if (!strcmp(name, "title")) {
+			podcast_feed_text_begin(p, PODCAST_TEXT_STR, &pitem->title);
+		} else if (!strcmp(name, "description")) {
+			podcast_feed_text_begin(p, PODCAST_TEXT_STR, &pitem->desc);
+		} else if (!strcmp(name, "summary")) {
+			podcast_feed_text_begin(p, PODCAST_TEXT_STR_KEEP, &pitem->desc);
+		} else if (!strcmp(name, "enclosure")) {
+			podcast_feed_attr_size(nb_attributes, attributes, &pitem->size);
+			if (pitem->url) {
+				free(pitem->url);
+			}
+			pitem->url = podcast_feed_attr(nb_attributes, attributes, "url");
+		} else if (!strcmp(name, "pubDate")) {
+			podcast_feed_text_begin(p, PODCAST_TEXT_RSS_DATE, NULL);
+		}
+		return;
 	}
 
-	if (channel == NULL) {
-		fprintf(stderr, "parse_rss: no channel found\n");
+	if (p->depth != p->channel_depth + 1) {
 		return;
 	}
 
-	for (node = channel->xmlChildrenNode; node != NULL; node = node->next) {
+	if (!strcmp(name, "title")) {
+		podcast_feed_text_begin(p, PODCAST_TEXT_STR, &p->title);
+	} else if (!strcmp(name, "author")) {
+		podcast_feed_text_begin(p, PODCAST_TEXT_STR, &p->author);
+	} else if (!strcmp(name, "description")) {
+		podcast_feed_text_begin(p, PODCAST_TEXT_STR, &p->desc);
+	} else if (!strcmp(name, "summary")) {
+		podcast_feed_text_begin(p, PODCAST_TEXT_STR_KEEP, &p->desc);
+	} else if (!strcmp(name, "item")) {
+		p->item = podcast_item_new();
+		p->item_depth = p->depth;
+	}
+}
+
+static void
+podcast_atom_start(podcast_feed_parser_t * p, char * name,
+		   int nb_attributes, const xmlChar ** attributes) {
 
-		if (!xmlStrcmp(node->name, (const xmlChar *)"title")) {
-			if (podcast->title) {
-				free(podcast->title);
-			}
-                        podcast->title = (char *)xmlNodeListGetString(doc, node->xmlChildrenNode, 1);
-		} else if (!xmlStrcmp(node->name, (const xmlChar *)"author")) {
-			if (podcast->author) {
-				free(podcast->author);
-			}
-                        podcast->author = (char *)xmlNodeListGetString(doc, node->xmlChildrenNode, 1);
-		} else if (!xmlStrcmp(node->name, (const xmlChar *)"description")) {
-			if (podcast->desc) {
-				free(podcast->desc);
+	if (p->item != NULL) {
+		podcast_item_t * pitem = p->item;
+
+		if (p->depth != p->item_depth + 1) {
+			return;
+		}
+
+		if (!strcmp(name, "title")) {
+			podcast_feed_text_begin(p, PODCAST_TEXT_STR, &pitem->title);
+		} else if (!strcmp(name, "summary")) {
+			podcast_feed_text_begin(p, PODCAST_TEXT_STR, &pitem->desc);
+		} else if (pitem->url == NULL && !strcmp(name, "link")) {
+			char * rel = podcast_feed_attr(nb_attributes, attributes, "rel");
+			if (rel != NULL && !strcmp(rel, "enclosure")) {
+				podcast_feed_attr_size(nb_attributes, attributes, &pitem->size);
+				pitem->url = podcast_feed_attr(nb_attributes, attributes, "href");
 			}
-                        podcast->desc = (char *)xmlNodeListGetString(doc, node->xmlChildrenNode, 1);
-		} else if (!xmlStrcmp(node->name, (const xmlChar *)"summary")) {
-			if (podcast->desc == NULL) {
-				podcast->desc = (char *)xmlNodeListGetString(doc, node->xmlChildrenNode, 1);
+			if (rel != NULL) {
+				free(rel);
 			}
+		} else if (!strcmp(name, "updated") ||  /* Atom 1.0 */
+			   !strcmp(name, "modified")) { /* Atom 0.3 */
+			podcast_feed_text_begin(p, PODCAST_TEXT_ATOM_DATE, NULL);
 		}
+		return;
 	}
 
-	if (podcast->title == NULL) {
-		podcast->title = strdup(_("Untitled"));
+	if (p->author_depth > 0) {
+		if (p->depth == p->author_depth + 1 && !p->author_done && !strcmp(name, "name")) {
+			podcast_feed_text_begin(p, PODCAST_TEXT_STR, &p->author);
+			p->author_done = 1;
+		}
+		return;
 	}
 
-	string_remove_html(podcast->desc);
+	if (p->depth != p->channel_depth + 1) {
+		return;
+	}
 
-	for (node = channel->xmlChildrenNode; node != NULL; node = node->next) {
-		if (!xmlStrcmp(node->name, (const xmlChar *)"item")) {
-			parse_rss_item(podcast, list, doc, node);
-		}
+	if (!strcmp(name, "title")) {
+		podcast_feed_text_begin(p, PODCAST_TEXT_STR, &p->title);
+	} else if (!strcmp(name, "author")) {
+		p->author_depth = p->depth;
+		p->author_done = 0;
+	} else if (!strcmp(name, "subtitle") || /* Atom 1.0 */
+		   !strcmp(name, "tagline")) {  /* Atom 0.3 */
+		podcast_feed_text_begin(p, PODCAST_TEXT_STR, &p->desc);
+	} else if (!strcmp(name, "entry")) {
+		p->item = podcast_item_new();
+		p->item_depth = p->depth;
 	}
 }
 
-void
-parse_atom_item(podcast_t * podcast, GSList ** list, xmlDocPtr doc, xmlNodePtr entry) {
+static void
+podcast_feed_start_element(void * ctx, const xmlChar * localname, const xmlChar * prefix,
+			   const xmlChar * URI, int nb_namespaces, const xmlChar ** namespaces,
+			   int nb_attributes, int nb_defaulted, const xmlChar ** attributes) {
+
+	podcast_feed_parser_t * p = (podcast_feed_parser_t *)ctx;
+	char * name = (char *)localname;
 
-	podcast_item_t * pitem;
-	xmlNodePtr node;
+	++p->depth;
 
-	if ((pitem = podcast_item_new()) == NULL) {
+	/* markup within text is skipped, along with its own text */
+	if (p->text_type != PODCAST_TEXT_NONE) {
 		return;
 	}
 
-	for (node = entry->xmlChildrenNode; node != NULL; node = node->next) {
-		if (!xmlStrcmp(node->name, (const xmlChar *)"title")) {
-                        pitem->title = (char *)xmlNodeListGetString(doc, node->xmlChildrenNode, 1);
-		} else if (!xmlStrcmp(node->name, (const xmlChar *)"summary")) {
-			if (pitem->desc) {
-				free(pitem->desc);
-			}
-                        pitem->desc = (char *)xmlNodeListGetString(doc, node->xmlChildrenNode, 1);
-		} else if (pitem->url == NULL && !xmlStrcmp(node->name, (const xmlChar *)"link")) {
-			xmlChar * rel = NULL;
-			if ((rel = xmlGetProp(node, (const xmlChar *)"rel")) != NULL &&
-			    !xmlStrcmp(rel, (const xmlChar *)"enclosure")) {
-				xmlChar * len;
-				if ((len = xmlGetProp(node, (const xmlChar *)"length")) != NULL) {
-					sscanf((char *)len, "%u", &pitem->size);
-					xmlFree(len);
-				}
-				pitem->url = (char *)xmlGetProp(node, (const xmlChar *)"href");
-			}
-			if (rel != NULL) {
-				xmlFree(rel);
-			}
-		} else if (!xmlStrcmp(node->name, (const xmlChar *)"updated") ||  /* Atom 1.0 */
-			   !xmlStrcmp(node->name, (const xmlChar *)"modified")) { /* Atom 0.3 */
-			xmlChar * tmp = xmlNodeListGetString(doc, node->xmlChildrenNode, 1);
-			pitem->date = parse_atom_date((char *)tmp);
-			xmlFree(tmp);
+	if (p->depth == 1) {
+		if (!strcmp(name, "rss")) {
+			p->format = PODCAST_FEED_RSS;
+		} else if (!strcmp(name, "feed")) {
+			p->format = PODCAST_FEED_ATOM;
+			p->channel_depth = p->depth;
+		} else {
+			fprintf(stderr, "unknown feed format: %s\n", name);
+			p->format = PODCAST_FEED_OTHER;
+			xmlStopParser(p->ctxt);
 		}
+		return;
 	}
 
-	if (pitem->url == NULL) {
-		podcast_item_free(pitem);
-		return;
+	if (p->format == PODCAST_FEED_RSS) {
+		podcast_rss_start(p, name, nb_attributes, attributes);
+	} else if (p->format == PODCAST_FEED_ATOM) {
+		podcast_atom_start(p, name, nb_attributes, attributes);
 	}
+}
 
-	string_remove_html(pitem->desc);
+static void
+podcast_feed_end_element(void * ctx, const xmlChar * localname,
+			 const xmlChar * prefix, const xmlChar * URI) {
 
-	if (pitem->title == NULL) {
-		pitem->title = strdup(_("Untitled"));
+	podcast_feed_parser_t * p = (podcast_feed_parser_t *)ctx;
+
+	if (p->text_type != PODCAST_TEXT_NONE) {
+		if (p->depth == p->text_depth) {
+			podcast_feed_text_end(p);
+		}
+	} else if (p->item != NULL && p->depth == p->item_depth) {
+		podcast_feed_item_end(p);
+	} else if (p->depth == p->author_depth) {
+		p->author_depth = 0;
+	} else if (p->format == PODCAST_FEED_RSS && p->depth == p->channel_depth) {
+		p->channel_depth = 0;
+		p->channel_done = 1;
 	}
 
-	if (g_slist_find_custom(*list, pitem->url, podcast_item_compare_url) == NULL) {
-		*list = g_slist_prepend(*list, pitem);
-	} else {
-		podcast_item_free(pitem);
+	--p->depth;
+}
+
+static void
+podcast_feed_characters(void * ctx, const xmlChar * ch, int len) {
+
+	podcast_feed_parser_t * p = (podcast_feed_parser_t *)ctx;
+
+	if (p->text_type != PODCAST_TEXT_NONE && p->depth == p->text_depth) {
+		g_string_append_len(p->text, (const gchar *)ch, len);
 	}
 }
 
-void
-parse_atom(podcast_t * podcast, GSList ** list, xmlDocPtr doc, xmlNodePtr feed) {
+static void
+podcast_feed_parser_free(podcast_feed_parser_t * p) {
 
-	xmlNodePtr node;
+	GSList * node;
 
-	for (node = feed->xmlChildrenNode; node != NULL; node = node->next) {
+	if (p->item) {
+		podcast_item_free(p->item);
+	}
+	if (p->title) {
+		free(p->title);
+	}
+	if (p->author) {
+		free(p->author);
+	}
+	if (p->desc) {
+		free(p->desc);
+	}
+	for (node = p->items; node; node = node->next) {
+		podcast_item_free((podcast_item_t *)node->data);
+	}
+	g_slist_free(p->items);
+	g_string_free(p->text, TRUE);
+}
 
-		if (!xmlStrcmp(node->name, (const xmlChar *)"title")) {
-			if (podcast->title) {
-				free(podcast->title);
-			}
-                        podcast->title = (char *)xmlNodeListGetString(doc, node->xmlChildrenNode, 1);
-		} else if (!xmlStrcmp(node->name, (const xmlChar *)"author")) {
-			xmlNodePtr n;
-			for (n = node->xmlChildrenNode; n; n = n->next) {
-				if (!xmlStrcmp(n->name, (const xmlChar *)"name")) {
-					if (podcast->author) {
-						free(podcast->author);
-					}
-					podcast->author = (char *)xmlNodeListGetString(doc, n->xmlChildrenNode, 1);
-					break;
-				}
-			}
-		} else if (!xmlStrcmp(node->name, (const xmlChar *)"subtitle") || /* Atom 1.0 */
-			   !xmlStrcmp(node->name, (const xmlChar *)"tagline")) {  /* Atom 0.3 */
-			if (podcast->desc) {
-				free(podcast->desc);
-			}
-                        podcast->desc = (char *)xmlNodeListGetString(doc, node->xmlChildrenNode, 1);
+/* Hand the channel data and the new items of a completely parsed
+ * feed over to podcast and list.
+ */
+static void
+podcast_feed_commit(podcast_t * podcast, podcast_feed_parser_t * p, GSList ** list) {
+
+	GSList * node;
+
+	if (p->title) {
+		if (podcast->title) {
+			free(podcast->title);
 		}
+		podcast->title = p->title;
+		p->title = NULL;
+	}
+	if (p->author) {
+		if (podcast->author) {
+			free(podcast->author);
+		}
+		podcast->author = p->author;
+		p->author = NULL;
+	}
+	if (p->desc) {
+		if (podcast->desc) {
+			free(podcast->desc);
+		}
+		podcast->desc = p->desc;
+		p->desc = NULL;
 	}
 
 	if (podcast->title == NULL) {
@@ -645,56 +1032,229 @@ parse_atom(podcast_t * podcast, GSList ** list, xmlDocPtr doc, xmlNodePtr feed)
 
 	string_remove_html(podcast->desc);
 
-	for (node = feed->xmlChildrenNode; node != NULL; node = node->next) {
-		if (!xmlStrcmp(node->name, (const xmlChar *)"entry")) {
-			parse_atom_item(podcast, list, doc, node);
+	for (node = p->items; node; node = node->next) {
+		podcast_item_t * pitem = (podcast_item_t *)node->data;
+		if (g_slist_find_custom(*list, pitem->url, podcast_item_compare_url) == NULL) {
+			*list = g_slist_prepend(*list, pitem);
+			podcast->refresh.new_items++;
+		} else {
+			podcast_item_free(pitem);
 		}
 	}
+	g_slist_free(p->items);
+	p->items = NULL;
+}
+
+/* headers == NULL forgets the validators, so that the next refresh
+ * gets the whole feed again. */
+void
+podcast_save_validators(podcast_t * podcast, http_header_t * headers) {
+
+	if (podcast->etag) {
+		free(podcast->etag);
+	}
+	podcast->etag = (headers != NULL && headers->etag != NULL) ?
+		strdup(headers->etag) : NULL;
+
+	if (podcast->last_modified) {
+		free(podcast->last_modified);
+	}
+	podcast->last_modified = (headers != NULL && headers->last_modified != NULL) ?
+		strdup(headers->last_modified) : NULL;
 }
 
+/* Fetch the feed and parse it as it arrives, adding new items to list.
+ * The request is conditional on the validators of the previous fetch;
+ * if the feed hasn't changed, list is left alone.
+ *
+ * Return -1 on error, 0 otherwise.
+ */
 int
 podcast_parse(podcast_t * podcast, GSList ** list) {
 
-	xmlDocPtr doc;
-	xmlNodePtr node;
-	char filename[MAXLEN];
-	char * file;
+	http_session_t * session;
+	xmlSAXHandler sax;
+	xmlParserCtxtPtr ctxt;
+	podcast_feed_parser_t parser;
+	GTimer * timer;
+	char buf[BUFSIZE];
+	double parse_time = 0.0;
+	double t;
+	int credit = 3;
+	int n_read;
+	int ret;
 
-	file = podcast_file_from_url(podcast->url);
-	arr_snprintf(filename, "%s/.%s", podcast->dir, file);
-	free(file);
+	memset(&podcast->refresh, 0, sizeof(podcast_refresh_t));
 
-	if (podcast_generic_download(podcast, podcast->url, filename, NULL, NULL) < 0) {
-		return -1;
+	while (1) {
+
+		if (podcast->state == PODCAST_STATE_ABORTED) {
+			return -1;
+		}
+
+		if ((session = httpc_new()) == NULL) {
+			return -1;
+		}
+
+		session->keep_alive = 1;
+		session->if_none_match = podcast->etag;
+		session->if_modified_since = podcast->last_modified;
+
+		timer = g_timer_new();
+		ret = httpc_init(session, NULL, podcast->url,
+				 options.inet_use_proxy,
+				 options.inet_proxy,
+				 options.inet_proxy_port,
+				 options.inet_noproxy_domains, 0L);
+
+		if (ret == HTTPC_OK || ret == HTTPC_NOT_MODIFIED) {
+			break;
+		}
+
+		fprintf(stderr, "podcast_parse: httpc_init failed, ret = %d\n", ret);
+		g_timer_destroy(timer);
+		httpc_del(session);
+
+		if (--credit == 0) {
+			return -1;
+		}
 	}
 
-	doc = xmlParseFile(filename);
-	if (doc == NULL) {
-		unlink(filename);
-		return -1;
+	podcast->refresh.connect_ms = 1000 * g_timer_elapsed(timer, NULL);
+	g_timer_start(timer);
+
+	if (ret == HTTPC_NOT_MODIFIED) {
+		podcast->refresh.not_modified = 1;
+		httpc_close(session);
+		httpc_del(session);
+		g_timer_destroy(timer);
+		return 0;
 	}
 
-	node = xmlDocGetRootElement(doc);
-	if (node == NULL) {
-		xmlFreeDoc(doc);
-		unlink(filename);
+	memset(&sax, 0, sizeof(xmlSAXHandler));
+	sax.initialized = XML_SAX2_MAGIC;
+	sax.startElementNs = podcast_feed_start_element;
+	sax.endElementNs = podcast_feed_end_element;
+	sax.characters = podcast_feed_characters;
+	sax.cdataBlock = podcast_feed_characters;
+
+	memset(&parser, 0, sizeof(podcast_feed_parser_t));
+	parser.text = g_string_new(NULL);
+
+	if ((ctxt = xmlCreatePushParserCtxt(&sax, &parser, NULL, 0, podcast->url)) == NULL) {
+		fprintf(stderr, "podcast_parse: xmlCreatePushParserCtxt failed\n");
+		podcast_feed_parser_free(&parser);
+		httpc_close(session);
+		httpc_del(session);
+		g_timer_destroy(timer);
 		return -1;
 	}
+	parser.ctxt = ctxt;
+
+	while ((n_read = httpc_read(session, buf, BUFSIZE)) > 0) {
+
+		podcast->refresh.bytes += n_read;
+
+		t = g_timer_elapsed(timer, NULL);
+		ret = xmlParseChunk(ctxt, buf, n_read, 0);
+		parse_time += g_timer_elapsed(timer, NULL) - t;
+
+		if (ret != 0 || podcast->state == PODCAST_STATE_ABORTED) {
+			break;
+		}
+	}
+
+	if (n_read == 0) {
+		t = g_timer_elapsed(timer, NULL);
+		xmlParseChunk(ctxt, NULL, 0, 1);
+		parse_time += g_timer_elapsed(timer, NULL) - t;
+	}
 
-	if (!xmlStrcmp(node->name, (const xmlChar *)"rss")) {
-		parse_rss(podcast, list, doc, node);
-	} else if (!xmlStrcmp(node->name, (const xmlChar *)"feed")) {
-		parse_atom(podcast, list, doc, node);
+	if (parser.format == PODCAST_FEED_OTHER) {
+		/* nothing to take from it, but the fetch itself was fine */
+		podcast_save_validators(podcast, &session->headers);
+		ret = 0;
+	} else if (n_read == 0 && ctxt->wellFormed && parser.format != PODCAST_FEED_UNKNOWN &&
+		   podcast->state != PODCAST_STATE_ABORTED) {
+		podcast_feed_commit(podcast, &parser, list);
+		podcast_save_validators(podcast, &session->headers);
+		ret = 0;
 	} else {
-		fprintf(stderr, "unknown feed format: %s\n", node->name);
+		if (podcast->state != PODCAST_STATE_ABORTED) {
+			fprintf(stderr, "podcast_parse: unable to read feed %s\n", podcast->url);
+		}
+		ret = -1;
 	}
 
-	xmlFreeDoc(doc);
-	unlink(filename);
+	xmlFreeParserCtxt(ctxt);
+	podcast_feed_parser_free(&parser);
+	httpc_close(session);
+	httpc_del(session);
+
+	podcast->refresh.transfer_ms = 1000 * g_timer_elapsed(timer, NULL);
+	podcast->refresh.parse_ms = 1000 * parse_time;
+	g_timer_destroy(timer);
+
+	return ret;
+}
+
+static int
+podcast_url_host(char * url, char * host, size_t host_size) {
+
+	char * p;
+	size_t len;
+
+	if (!httpc_is_url(url)) {
+		return -1;
+	}
+
+	url += strlen("http://");
+	len = ((p = strchr(url, '/')) != NULL) ? (size_t)(p - url) : strlen(url);
+	if (len + 1 > host_size) {
+		return -1;
+	}
+	g_strlcpy(host, url, len + 1);
+	return 0;
+}
+
+/* Wait for a free connection slot to host. Return -1 if the podcast
+ * got aborted meanwhile.
+ */
+static int
+podcast_host_acquire(podcast_t * podcast, char * host) {
+
+	int n;
+
+	AQUALUNG_MUTEX_LOCK(podcast_hosts_mutex)
+	while ((n = GPOINTER_TO_INT(g_hash_table_lookup(podcast_hosts, host))) >= PODCAST_HOST_CONNECTIONS &&
+	       podcast->state != PODCAST_STATE_ABORTED) {
+		AQUALUNG_COND_WAIT(podcast_hosts_cond, podcast_hosts_mutex)
+	}
+	if (podcast->state == PODCAST_STATE_ABORTED) {
+		AQUALUNG_MUTEX_UNLOCK(podcast_hosts_mutex)
+		return -1;
+	}
+	g_hash_table_insert(podcast_hosts, strdup(host), GINT_TO_POINTER(n + 1));
+	AQUALUNG_MUTEX_UNLOCK(podcast_hosts_mutex)
 
 	return 0;
 }
 
+static void
+podcast_host_release(char * host) {
+
+	int n;
+
+	AQUALUNG_MUTEX_LOCK(podcast_hosts_mutex)
+	n = GPOINTER_TO_INT(g_hash_table_lookup(podcast_hosts, host));
+	if (n > 1) {
+		g_hash_table_insert(podcast_hosts, strdup(host), GINT_TO_POINTER(n - 1));
+	} else {
+		g_hash_table_remove(podcast_hosts, host);
+	}
+	AQUALUNG_COND_BROADCAST(podcast_hosts_cond)
+	AQUALUNG_MUTEX_UNLOCK(podcast_hosts_mutex)
+}
 
 GSList *
 podcast_list_remove_item(podcast_t * podcast, GSList * list, GSList * litem) {
@@ -716,52 +1276,9 @@ podcast_list_remove_item(podcast_t * podcast, GSList * list, GSList * litem) {
 	return g_slist_delete_link(list, litem);
 }
 
+/* Items in busy are being downloaded and are never removed. */
 void
-podcast_item_download(podcast_download_t * pd, GSList ** list, GSList * node) {
-
-	podcast_item_t * item = (podcast_item_t *)node->data;
-	char * file;
-	char path[MAXLEN];
-	float duration;
-	struct stat statbuf;	
-
-
-	file = podcast_file_from_url(item->url);
-	arr_snprintf(path, "%s/%s", pd->podcast->dir, file);
-	free(file);
-
-	pd->ncurrent++;
-	pd->percent = 0;
-
-	store_podcast_update_podcast_download(pd);
-
-	if (podcast_generic_download(pd->podcast, item->url, path, store_podcast_update_podcast_download, pd) < 0) {
-		goto failed;
-	}
-
-	if (stat(path, &statbuf) < 0) {
-		goto failed;
-	}
-
-	if ((duration = get_file_duration(path)) < 0.0f) {
-		goto failed;
-	}
-
-	item->duration = duration;
-	item->size = statbuf.st_size;
-	item->file = strdup(path);
-
-	pd->podcast->items = g_slist_prepend(pd->podcast->items, item);
-	store_podcast_add_item(pd->podcast, item);
-
-	return;
-
- failed:
-	*list = podcast_list_remove_item(pd->podcast, *list, node);
-}
-
-void
-podcast_apply_limits(podcast_t * podcast, GSList ** list) {
+podcast_apply_limits(podcast_t * podcast, GSList ** list, GSList * busy) {
 
 	GSList * node;
 	unsigned size = 0;
@@ -775,6 +1292,7 @@ podcast_apply_limits(podcast_t * podcast, GSList ** list) {
 
 	node = g_slist_last(*list);
 	while (*list != NULL &&
+	       g_slist_find(busy, node->data) == NULL &&
 	       ((podcast->flags & PODCAST_DATE_LIMIT &&
 		 podcast->last_checked - ((podcast_item_t *)node->data)->date > podcast->date_limit)
 		||
@@ -791,44 +1309,220 @@ podcast_apply_limits(podcast_t * podcast, GSList ** list) {
 	}
 }
 
-int
-podcast_download_next(podcast_download_t * pd, GSList ** list) {
+static void
+podcast_worker_progress(void * data, int percent) {
+
+	podcast_worker_t * worker = (podcast_worker_t *)data;
+	podcast_fetch_t * fetch = worker->fetch;
+	int sum = 0;
+	int n = 0;
+	int i;
+
+	AQUALUNG_MUTEX_LOCK(fetch->mutex)
+	worker->percent = percent;
+	for (i = 0; i < fetch->n_workers; i++) {
+		if (fetch->workers[i].item != NULL) {
+			sum += fetch->workers[i].percent;
+			++n;
+		}
+	}
+	fetch->pd->percent = (n > 0) ? sum / n : 0;
+	AQUALUNG_MUTEX_UNLOCK(fetch->mutex)
+
+	store_podcast_update_podcast_download(fetch->pd);
+}
+
+static int
+podcast_item_download(podcast_worker_t * worker, podcast_item_t * item, char * path) {
+
+	podcast_t * podcast = worker->fetch->pd->podcast;
+	char host[MAXLEN];
+	float duration;
+	struct stat statbuf;
+	int ret;
+
+	if (podcast_url_host(item->url, host, CHAR_ARRAY_SIZE(host)) < 0) {
+		return -1;
+	}
+
+	if (podcast_host_acquire(podcast, host) < 0) {
+		return -1;
+	}
+	ret = podcast_generic_download(podcast, item->url, path, 1,
+				       podcast_worker_progress, worker);
+	podcast_host_release(host);
+
+	if (ret < 0) {
+		return -1;
+	}
+
+	if (stat(path, &statbuf) < 0) {
+		return -1;
+	}
+
+	if ((duration = get_file_duration(path)) < 0.0f) {
+		return -1;
+	}
+
+	item->duration = duration;
+	item->size = statbuf.st_size;
+	return 0;
+}
+
+/* Return the next item waiting for download, NULL if there is none. */
+static podcast_item_t *
+podcast_fetch_next(podcast_fetch_t * fetch) {
 
 	GSList * node;
+	int i;
 
-	for (node = *list; node; node = node->next) {
+	if (fetch->pd->podcast->state == PODCAST_STATE_ABORTED) {
+		return NULL;
+	}
+
+	for (node = fetch->list; node; node = node->next) {
 		podcast_item_t * item = (podcast_item_t *)node->data;
 
-		if (pd->podcast->state == PODCAST_STATE_ABORTED) {
-			if (item->file == NULL) {
-				podcast_item_free(item);
-			}
+		if (item->file != NULL) {
 			continue;
 		}
+		for (i = 0; i < fetch->n_workers; i++) {
+			if (fetch->workers[i].item == item) {
+				break;
+			}
+		}
+		if (i == fetch->n_workers) {
+			return item;
+		}
+	}
+
+	return NULL;
+}
+
+static GSList *
+podcast_fetch_busy(podcast_fetch_t * fetch) {
+
+	GSList * busy = NULL;
+	int i;
+
+	for (i = 0; i < fetch->n_workers; i++) {
+		if (fetch->workers[i].item != NULL) {
+			busy = g_slist_prepend(busy, fetch->workers[i].item);
+		}
+	}
+	return busy;
+}
+
+void *
+podcast_download_worker(void * arg) {
+
+	podcast_worker_t * worker = (podcast_worker_t *)arg;
+	podcast_fetch_t * fetch = worker->fetch;
+	podcast_t * podcast = fetch->pd->podcast;
+	podcast_item_t * item;
+
+	AQUALUNG_MUTEX_LOCK(fetch->mutex)
+	while ((item = podcast_fetch_next(fetch)) != NULL) {
+
+		char path[MAXLEN];
+		char * file;
+		GSList * busy;
+		int ret;
+
+		file = podcast_file_from_url(item->url);
+		arr_snprintf(path, "%s/%s", podcast->dir, file);
+		free(file);
+
+		worker->item = item;
+		worker->percent = 0;
+		fetch->pd->ncurrent++;
+		AQUALUNG_MUTEX_UNLOCK(fetch->mutex)
+
+		store_podcast_update_podcast_download(fetch->pd);
+		ret = podcast_item_download(worker, item, path);
+
+		AQUALUNG_MUTEX_LOCK(fetch->mutex)
+		worker->item = NULL;
+
+		if (ret == 0) {
+			item->file = strdup(path);
+			podcast->items = g_slist_prepend(podcast->items, item);
+			store_podcast_add_item(podcast, item);
+		} else {
+			fetch->list = podcast_list_remove_item(podcast, fetch->list,
+							       g_slist_find(fetch->list, item));
+			fetch->n_failed++;
+		}
+
+		busy = podcast_fetch_busy(fetch);
+		podcast_apply_limits(podcast, &fetch->list, busy);
+		g_slist_free(busy);
+	}
+	AQUALUNG_MUTEX_UNLOCK(fetch->mutex)
 
+	return NULL;
+}
+
+/* Download the items of list that have no file yet, several at a time.
+ * Return the number of failed downloads.
+ */
+int
+podcast_fetch_items(podcast_download_t * pd, GSList ** list) {
+
+	podcast_fetch_t fetch;
+	GSList * node;
+	int i;
+
+	memset(&fetch, 0, sizeof(podcast_fetch_t));
+	fetch.pd = pd;
+	fetch.list = *list;
+	fetch.n_workers = (pd->ndownloads < PODCAST_DOWNLOAD_WORKERS) ?
+		pd->ndownloads : PODCAST_DOWNLOAD_WORKERS;
+
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_init(&fetch.mutex, NULL);
+#else
+	fetch.mutex = g_mutex_new();
+#endif /* HAVE_LIBPTHREAD */
+
+	for (i = 0; i < fetch.n_workers; i++) {
+		fetch.workers[i].fetch = &fetch;
+		AQUALUNG_THREAD_CREATE(fetch.workers[i].thread_id, NULL,
+				       podcast_download_worker, &fetch.workers[i])
+	}
+	for (i = 0; i < fetch.n_workers; i++) {
+		AQUALUNG_THREAD_JOIN(fetch.workers[i].thread_id)
+	}
+
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_destroy(&fetch.mutex);
+#else
+	g_mutex_free(fetch.mutex);
+#endif /* HAVE_LIBPTHREAD */
+
+	/* leftovers of an aborted update */
+	for (node = fetch.list; node; node = node->next) {
+		podcast_item_t * item = (podcast_item_t *)node->data;
 		if (item->file == NULL) {
-			podcast_item_download(pd, list, node);
-			return 1;
+			podcast_item_free(item);
 		}
 	}
 
-	return 0;
+	*list = fetch.list;
+	return fetch.n_failed;
 }
 
-void *
-podcast_update_thread(void * arg) {
+static void
+podcast_refresh(podcast_t * podcast) {
 
-	podcast_t * podcast = (podcast_t *)arg;
 	podcast_download_t * pd;
 
 	GSList * node;
 	GTimeVal tval;
 	GSList * list;
 
-	AQUALUNG_THREAD_DETACH();
-
 	if ((pd = podcast_download_new(podcast)) == NULL) {
-		return NULL;
+		return;
 	}
 
 	list = g_slist_copy(podcast->items);
@@ -842,7 +1536,7 @@ podcast_update_thread(void * arg) {
 	g_get_current_time(&tval);
 	podcast->last_checked = tval.tv_sec;
 
-	podcast_apply_limits(podcast, &list);
+	podcast_apply_limits(podcast, &list, NULL);
 
 	for (node = list; node; node = node->next) {
 		if (((podcast_item_t *)node->data)->file == NULL) {
@@ -850,27 +1544,101 @@ podcast_update_thread(void * arg) {
 		}
 	}
 
-	while (podcast_download_next(pd, &list)) {
-		podcast_apply_limits(podcast, &list);
+	if (pd->ndownloads > 0 && podcast_fetch_items(pd, &list) > 0) {
+		/* failed items are only retried if the feed is read again */
+		podcast_save_validators(podcast, NULL);
 	}
 
  finish:
 	g_slist_free(list);
 
 	store_podcast_update_podcast(pd);
+}
+
+void *
+podcast_refresh_worker(void * arg) {
+
+	podcast_t * podcast;
+
+	AQUALUNG_THREAD_DETACH();
+
+	while (1) {
+
+		AQUALUNG_MUTEX_LOCK(podcast_refresh_mutex)
+		if (podcast_refresh_queue == NULL) {
+			--podcast_refresh_workers;
+			AQUALUNG_MUTEX_UNLOCK(podcast_refresh_mutex)
+			break;
+		}
+		podcast = (podcast_t *)podcast_refresh_queue->data;
+		podcast_refresh_queue = g_slist_delete_link(podcast_refresh_queue,
+							    podcast_refresh_queue);
+		if (podcast->state == PODCAST_STATE_PENDING) {
+			podcast->state = PODCAST_STATE_UPDATE;
+		}
+		AQUALUNG_MUTEX_UNLOCK(podcast_refresh_mutex)
+
+		podcast_refresh(podcast);
+	}
 
 	return NULL;
 }
 
+/* Queue podcast for refreshing. At most PODCAST_REFRESH_WORKERS feeds
+ * are refreshed at the same time, the rest wait in PENDING state.
+ */
 void
 podcast_update(podcast_t * podcast) {
 
-	if (podcast->state == PODCAST_STATE_IDLE || podcast->state == PODCAST_STATE_PENDING) {
+	AQUALUNG_THREAD_DECLARE(thread_id)
+	int spawn = 0;
+
+	if (podcast_hosts == NULL) {
+		podcast_hosts = g_hash_table_new_full(g_str_hash, g_str_equal, free, NULL);
+#ifndef HAVE_LIBPTHREAD
+		podcast_hosts_mutex = g_mutex_new();
+		podcast_hosts_cond = g_cond_new();
+		podcast_refresh_mutex = g_mutex_new();
+#endif /* !HAVE_LIBPTHREAD */
+	}
+
+	AQUALUNG_MUTEX_LOCK(podcast_refresh_mutex)
+	if ((podcast->state == PODCAST_STATE_IDLE || podcast->state == PODCAST_STATE_PENDING) &&
+	    g_slist_find(podcast_refresh_queue, podcast) == NULL) {
+
+		podcast->state = PODCAST_STATE_PENDING;
+		podcast_refresh_queue = g_slist_append(podcast_refresh_queue, podcast);
 
-		AQUALUNG_THREAD_DECLARE(thread_id)
+		if (podcast_refresh_workers < PODCAST_REFRESH_WORKERS) {
+			++podcast_refresh_workers;
+			spawn = 1;
+		}
+	}
+	AQUALUNG_MUTEX_UNLOCK(podcast_refresh_mutex)
 
-		podcast->state = PODCAST_STATE_UPDATE;
-		AQUALUNG_THREAD_CREATE(thread_id, NULL, podcast_update_thread, podcast);
+	if (spawn) {
+		AQUALUNG_THREAD_CREATE(thread_id, NULL, podcast_refresh_worker, NULL);
 	}
 }
 
+
+/* Abort the refresh of podcast, waking any download waiting for a
+ * connection slot so that it notices.
+ */
+void
+podcast_abort(podcast_t * podcast) {
+
+	if (podcast->state != PODCAST_STATE_PENDING && podcast->state != PODCAST_STATE_UPDATE) {
+		return;
+	}
+
+	if (podcast_hosts == NULL) {
+		podcast->state = PODCAST_STATE_ABORTED;
+		return;
+	}
+
+	AQUALUNG_MUTEX_LOCK(podcast_hosts_mutex)
+	podcast->state = PODCAST_STATE_ABORTED;
+	AQUALUNG_COND_BROADCAST(podcast_hosts_cond)
+	AQUALUNG_MUTEX_UNLOCK(podcast_hosts_mutex)
+}
@@ -23,6 +23,8 @@
 
 #include <glib.h>
 
+#include "httpc.h"
+
 
 typedef struct {
 
@@ -52,6 +54,18 @@ enum {
 	PODCAST_STATE_ABORTED
 };
 
+/* timing of the last feed refresh */
+typedef struct {
+
+	unsigned connect_ms;  /* until the response headers arrived */
+	unsigned transfer_ms; /* reading the feed, parsing included */
+	unsigned parse_ms;    /* of which spent in the parser */
+	unsigned bytes;
+	int not_modified;     /* server answered 304 */
+	int new_items;
+
+} podcast_refresh_t;
+
 typedef struct {
 
 	char * dir;
@@ -60,6 +74,10 @@ typedef struct {
 	char * desc;
 	char * url;
 
+	/* validators of the last fetched feed, for conditional requests */
+	char * etag;
+	char * last_modified;
+
 	unsigned check_interval; /* sec */
 	unsigned last_checked;   /* sec */
 
@@ -72,6 +90,8 @@ typedef struct {
 	int state;
 	GSList * items;
 
+	podcast_refresh_t refresh;
+
 } podcast_t;
 
 podcast_t * podcast_new(void);
@@ -82,6 +102,8 @@ void podcast_free(podcast_t * podcast);
 void podcast_item_free(podcast_item_t * item);
 
 void podcast_update(podcast_t * podcast);
+void podcast_abort(podcast_t * podcast);
+void podcast_save_validators(podcast_t * podcast, http_header_t * headers);
 
 
 #endif /* AQUALUNG_PODCAST_H */
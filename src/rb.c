@@ -22,6 +22,11 @@
 
 #include <config.h>
 
+/* mlock() comes with mlockall() */
+#if defined(HAVE_MLOCKALL) && !defined(USE_MLOCK)
+#define USE_MLOCK
+#endif /* HAVE_MLOCKALL && !USE_MLOCK */
+
 #include <stdlib.h>
 #include <string.h>
 #ifdef USE_MLOCK
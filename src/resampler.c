@@ -0,0 +1,554 @@
+/*                                                     -*- linux-c -*-
+    Copyright (C) 2026 Aqualung contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+    $Id$
+*/
+
+#include <config.h>
+
+#ifdef HAVE_SRC
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif /* __SSE__ */
+
+#include "resampler.h"
+
+
+/* Polyphase windowed sinc: for an out/in rate ratio L/M the input is
+ * (virtually) upsampled by L, lowpass filtered and taken every M-th
+ * sample, so each output frame is one dot product of the input history
+ * with one of the L filter phases.
+ */
+
+#define RS_MAX_PHASES 1024  /* ratios needing more are approximated */
+#define RS_MAX_TAPS   1024
+#define RS_MAX_TABLES 8    /* filter banks kept around for rate changes */
+
+#define RS_ERR_BASE   1000
+#define RS_ERR_MALLOC (RS_ERR_BASE + 0)
+#define RS_ERR_RATIO  (RS_ERR_BASE + 1)
+#define RS_ERR_TYPE   (RS_ERR_BASE + 2)
+#define RS_ERR_CHAN   (RS_ERR_BASE + 3)
+
+
+typedef struct {
+	const char * name;
+	const char * description;
+	int taps;        /* per phase when not downsampling */
+	double beta;     /* Kaiser window */
+} rs_quality_t;
+
+/* indexed by type - RESAMPLER_POLYPHASE_BEST */
+static const rs_quality_t qualities[] = {
+	{ "Polyphase Sinc (Best)",
+	  "Aqualung's SSE polyphase sinc converter, 128 taps per phase, 90% BW.",
+	  128, 10.0 },
+	{ "Polyphase Sinc (Medium)",
+	  "Aqualung's SSE polyphase sinc converter, 80 taps per phase, 86% BW.",
+	  80, 8.5 },
+	{ "Polyphase Sinc (Fastest)",
+	  "Aqualung's SSE polyphase sinc converter, 48 taps per phase, 81% BW.",
+	  48, 7.0 },
+};
+
+#define N_QUALITIES ((int)(sizeof(qualities) / sizeof(qualities[0])))
+
+
+typedef struct {
+	int L, M;
+	int taps;       /* multiple of 4 */
+	float * coef;   /* L rows of taps, oldest input sample first */
+} rs_table_t;
+
+typedef struct {
+	const rs_quality_t * q;
+	int channels;
+	rs_table_t tables[RS_MAX_TABLES];
+	int n_tables;
+	int next_table;
+	rs_table_t * table;
+	float ** buf;  /* input history, one row per channel */
+	long buf_len;
+	long buf_size;
+	long long pos;  /* next output, in 1/L input frames from buf[c][0] */
+	int drained;    /* end of input seen, trailing silence appended */
+	long end;       /* where that silence starts in buf */
+} polyphase_t;
+
+struct _resampler_t {
+	SRC_STATE * src;
+	polyphase_t * pp;
+};
+
+
+#define IS_LIBRARY_TYPE(type) ((type) >= SRC_SINC_BEST_QUALITY && (type) <= SRC_LINEAR)
+#define IS_POLYPHASE_TYPE(type) ((type) >= RESAMPLER_POLYPHASE_BEST && \
+				 (type) < RESAMPLER_POLYPHASE_BEST + N_QUALITIES)
+
+
+const char *
+resampler_get_name(int type) {
+
+	if (IS_LIBRARY_TYPE(type)) {
+		return src_get_name(type);
+	}
+	if (IS_POLYPHASE_TYPE(type)) {
+		return qualities[type - RESAMPLER_POLYPHASE_BEST].name;
+	}
+	return NULL;
+}
+
+
+const char *
+resampler_get_description(int type) {
+
+	if (IS_LIBRARY_TYPE(type)) {
+		return src_get_description(type);
+	}
+	if (IS_POLYPHASE_TYPE(type)) {
+		return qualities[type - RESAMPLER_POLYPHASE_BEST].description;
+	}
+	return NULL;
+}
+
+
+const char *
+resampler_strerror(int error) {
+
+	switch (error) {
+	case RS_ERR_MALLOC:
+		return "Out of memory.";
+	case RS_ERR_RATIO:
+		return "Conversion ratio out of range.";
+	case RS_ERR_TYPE:
+		return "No such converter type.";
+	case RS_ERR_CHAN:
+		return "Bad channel count.";
+	}
+	return src_strerror(error);
+}
+
+
+/* zeroth order modified Bessel function of the first kind */
+static double
+bessel_i0(double x) {
+
+	double sum = 1.0;
+	double term = 1.0;
+	int k;
+
+	for (k = 1; k < 64; k++) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+		if (term < sum * 1e-12) {
+			break;
+		}
+	}
+	return sum;
+}
+
+
+/* best L/M approximation of ratio with L <= RS_MAX_PHASES */
+static void
+ratio_to_fraction(double ratio, int * L, int * M) {
+
+	long p0 = 0, q0 = 1, p1 = 1, q1 = 0;
+	double x = ratio;
+	int i;
+
+	*L = 1;
+	*M = 1;
+	for (i = 0; i < 32; i++) {
+		long a = (long)floor(x);
+		long p2 = a * p1 + p0;
+		long q2 = a * q1 + q0;
+
+		if (p2 > RS_MAX_PHASES || q2 > 64 * RS_MAX_PHASES) {
+			break;
+		}
+		*L = p2;
+		*M = q2;
+		if (fabs((double)p2 / q2 - ratio) < 1e-9 * ratio || x - a < 1e-9) {
+			break;
+		}
+		p0 = p1; q0 = q1;
+		p1 = p2; q1 = q2;
+		x = 1.0 / (x - a);
+	}
+}
+
+
+static int
+table_build(rs_table_t * t, const rs_quality_t * q, int L, int M) {
+
+	double bw = (L < M) ? (double)L / M : 1.0;
+	double atten = q->beta / 0.1102 + 8.7;
+	/* Kaiser's estimate of the transition width, relative to Nyquist;
+	 * center it so the stopband starts at the lower Nyquist frequency
+	 */
+	double width = 2.0 * (atten - 7.95) / (14.36 * q->taps);
+	double cutoff = bw * (1.0 - width / 2.0) / L;  /* of the upsampled rate's Nyquist */
+	double center, i0_beta = bessel_i0(q->beta);
+	int taps = ceil(q->taps / bw);
+	int n_coef, p, i;
+
+	taps = (taps + 3) & ~3;
+	if (taps > RS_MAX_TAPS) {
+		taps = RS_MAX_TAPS;
+	}
+	n_coef = L * taps;
+	center = (n_coef - 1) / 2.0;
+
+	if ((t->coef = malloc(n_coef * sizeof(float))) == NULL) {
+		return RS_ERR_MALLOC;
+	}
+	t->L = L;
+	t->M = M;
+	t->taps = taps;
+
+	for (p = 0; p < L; p++) {
+		float * row = t->coef + p * taps;
+		double sum = 0.0;
+
+		for (i = 0; i < taps; i++) {
+			/* row[i] weighs input frame idx - (taps-1-i) */
+			double n = p + (double)(taps - 1 - i) * L;
+			double x = n - center;
+			double r = x / (center + 0.5);
+			double h = (x == 0.0) ? 1.0 : sin(M_PI * cutoff * x) / (M_PI * cutoff * x);
+
+			h *= bessel_i0(q->beta * sqrt((r * r < 1.0) ? 1.0 - r * r : 0.0)) / i0_beta;
+			row[i] = h;
+			sum += h;
+		}
+		/* unity gain at DC for every phase */
+		for (i = 0; i < taps; i++) {
+			row[i] /= sum;
+		}
+	}
+	return 0;
+}
+
+
+static void
+polyphase_reset(polyphase_t * pp) {
+
+	int c;
+
+	if (pp->table == NULL) {
+		return;
+	}
+
+	/* half a filter of silence so that output frame 0 lines up with input frame 0 */
+	pp->buf_len = pp->table->taps / 2;
+	for (c = 0; c < pp->channels; c++) {
+		memset(pp->buf[c], 0, pp->buf_len * sizeof(float));
+	}
+	pp->pos = (long long)pp->table->L * pp->table->taps - 1;
+	pp->drained = 0;
+}
+
+
+static int
+polyphase_grow(polyphase_t * pp, long size) {
+
+	int c;
+
+	if (size <= pp->buf_size) {
+		return 0;
+	}
+	size += size / 2;
+	for (c = 0; c < pp->channels; c++) {
+		float * buf = realloc(pp->buf[c], size * sizeof(float));
+		if (buf == NULL) {
+			return RS_ERR_MALLOC;
+		}
+		pp->buf[c] = buf;
+	}
+	pp->buf_size = size;
+	return 0;
+}
+
+
+/* switch to the filter bank for ratio, building it on first use */
+static int
+polyphase_set_ratio(polyphase_t * pp, double ratio) {
+
+	rs_table_t * t;
+	int L, M, i, err;
+
+	ratio_to_fraction(ratio, &L, &M);
+	if (pp->table != NULL && pp->table->L == L && pp->table->M == M) {
+		return 0;
+	}
+
+	for (i = 0; i < pp->n_tables; i++) {
+		if (pp->tables[i].L == L && pp->tables[i].M == M) {
+			break;
+		}
+	}
+	if (i == pp->n_tables) {
+		if (pp->n_tables < RS_MAX_TABLES) {
+			i = pp->n_tables++;
+		} else {
+			i = pp->next_table;
+			pp->next_table = (pp->next_table + 1) % RS_MAX_TABLES;
+			free(pp->tables[i].coef);
+		}
+		if ((err = table_build(pp->tables + i, pp->q, L, M)) != 0) {
+			memset(pp->tables + i, 0, sizeof(rs_table_t));
+			pp->table = NULL;
+			return err;
+		}
+	}
+
+	t = pp->tables + i;
+	if ((err = polyphase_grow(pp, t->taps)) != 0) {
+		return err;
+	}
+	pp->table = t;
+	polyphase_reset(pp);
+	return 0;
+}
+
+
+static inline float
+dot(const float * a, const float * b, int n) {
+
+	int i;
+#ifdef __SSE__
+	__m128 s0 = _mm_setzero_ps();
+	__m128 s1 = _mm_setzero_ps();
+	float r[4];
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+		s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+	}
+	if (i < n) {
+		s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+	}
+	_mm_storeu_ps(r, _mm_add_ps(s0, s1));
+	return (r[0] + r[1]) + (r[2] + r[3]);
+#else
+	float s = 0.0f;
+
+	for (i = 0; i < n; i++) {
+		s += a[i] * b[i];
+	}
+	return s;
+#endif /* __SSE__ */
+}
+
+
+static int
+polyphase_process(polyphase_t * pp, SRC_DATA * data) {
+
+	rs_table_t * t;
+	const float * in = data->data_in;
+	float * out = data->data_out;
+	int ch = pp->channels;
+	long n_in = data->input_frames;
+	long n_out = 0;
+	long i, drop;
+	long long pos;
+	int c, err, L, M, taps;
+
+	if ((err = polyphase_set_ratio(pp, data->src_ratio)) != 0) {
+		return err;
+	}
+	if ((err = polyphase_grow(pp, pp->buf_len + n_in)) != 0) {
+		return err;
+	}
+
+	for (c = 0; c < ch; c++) {
+		float * b = pp->buf[c] + pp->buf_len;
+		for (i = 0; i < n_in; i++) {
+			b[i] = in[i * ch + c];
+		}
+	}
+	pp->buf_len += n_in;
+	data->input_frames_used = n_in;
+
+	t = pp->table;
+	L = t->L;
+	M = t->M;
+	taps = t->taps;
+	pos = pp->pos;
+
+	/* half a filter of silence at the end too, so that the output
+	   reaches up to the last input frame */
+	if (data->end_of_input && !pp->drained) {
+		if ((err = polyphase_grow(pp, pp->buf_len + taps / 2)) != 0) {
+			return err;
+		}
+		for (c = 0; c < ch; c++) {
+			memset(pp->buf[c] + pp->buf_len, 0, taps / 2 * sizeof(float));
+		}
+		pp->end = pp->buf_len;
+		pp->buf_len += taps / 2;
+		pp->drained = 1;
+	}
+
+	while (n_out < data->output_frames) {
+		long idx = pos / L;
+		const float * h = t->coef + (pos - (long long)idx * L) * taps;
+
+		if (idx >= pp->buf_len) {
+			break;
+		}
+		/* no output centered on the silence */
+		if (pp->drained && pos + 1 >= (long long)(pp->end + taps / 2) * L) {
+			break;
+		}
+		for (c = 0; c < ch; c++) {
+			out[c] = dot(h, pp->buf[c] + idx - taps + 1, taps);
+		}
+		out += ch;
+		n_out++;
+		pos += M;
+	}
+
+	/* keep only the history the next output frame needs */
+	drop = pos / L - (taps - 1);
+	if (drop > pp->buf_len) {
+		drop = pp->buf_len;
+	}
+	if (drop > 0) {
+		for (c = 0; c < ch; c++) {
+			memmove(pp->buf[c], pp->buf[c] + drop, (pp->buf_len - drop) * sizeof(float));
+		}
+		pp->buf_len -= drop;
+		pp->end -= drop;
+		pos -= (long long)drop * L;
+	}
+	pp->pos = pos;
+
+	data->output_frames_gen = n_out;
+	return 0;
+}
+
+
+static void
+polyphase_delete(polyphase_t * pp) {
+
+	int i;
+
+	for (i = 0; i < pp->n_tables; i++) {
+		free(pp->tables[i].coef);
+	}
+	for (i = 0; i < pp->channels; i++) {
+		free(pp->buf[i]);
+	}
+	free(pp->buf);
+	free(pp);
+}
+
+
+resampler_t *
+resampler_new(int type, int channels, int * error) {
+
+	resampler_t * rs;
+
+	if ((rs = calloc(1, sizeof(resampler_t))) == NULL) {
+		*error = RS_ERR_MALLOC;
+		return NULL;
+	}
+
+	if (IS_LIBRARY_TYPE(type)) {
+		if ((rs->src = src_new(type, channels, error)) == NULL) {
+			free(rs);
+			return NULL;
+		}
+		return rs;
+	}
+
+	if (!IS_POLYPHASE_TYPE(type)) {
+		*error = RS_ERR_TYPE;
+		free(rs);
+		return NULL;
+	}
+	if (channels < 1) {
+		*error = RS_ERR_CHAN;
+		free(rs);
+		return NULL;
+	}
+	if ((rs->pp = calloc(1, sizeof(polyphase_t))) == NULL ||
+	    (rs->pp->buf = calloc(channels, sizeof(float *))) == NULL) {
+		*error = RS_ERR_MALLOC;
+		free(rs->pp);
+		free(rs);
+		return NULL;
+	}
+	rs->pp->q = qualities + (type - RESAMPLER_POLYPHASE_BEST);
+	rs->pp->channels = channels;
+
+	*error = 0;
+	return rs;
+}
+
+
+resampler_t *
+resampler_delete(resampler_t * rs) {
+
+	if (rs == NULL) {
+		return NULL;
+	}
+	if (rs->src != NULL) {
+		src_delete(rs->src);
+	}
+	if (rs->pp != NULL) {
+		polyphase_delete(rs->pp);
+	}
+	free(rs);
+	return NULL;
+}
+
+
+int
+resampler_process(resampler_t * rs, SRC_DATA * data) {
+
+	if (rs->src != NULL) {
+		return src_process(rs->src, data);
+	}
+	if (data->src_ratio <= 0.0) {
+		return RS_ERR_RATIO;
+	}
+	return polyphase_process(rs->pp, data);
+}
+
+
+int
+resampler_reset(resampler_t * rs) {
+
+	if (rs->src != NULL) {
+		return src_reset(rs->src);
+	}
+	polyphase_reset(rs->pp);
+	return 0;
+}
+
+#endif /* HAVE_SRC */
+
+
+// vim: shiftwidth=8:tabstop=8:softtabstop=8 :
@@ -0,0 +1,64 @@
+/*                                                     -*- linux-c -*-
+    Copyright (C) 2026 Aqualung contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+    $Id$
+*/
+
+#ifndef AQUALUNG_RESAMPLER_H
+#define AQUALUNG_RESAMPLER_H
+
+#ifdef HAVE_SRC
+
+#include <samplerate.h>
+
+
+/* Sample rate converters by type number: 0-4 are the libsamplerate
+ * converters (SRC_SINC_BEST_QUALITY to SRC_LINEAR), the in-tree polyphase
+ * ones have fixed numbers after them, so a saved src_type means the same
+ * converter whichever libsamplerate we run with.
+ * resampler_get_name() returns NULL past the last type.
+ */
+#define RESAMPLER_POLYPHASE_BEST    5
+#define RESAMPLER_POLYPHASE_MEDIUM  6
+#define RESAMPLER_POLYPHASE_FASTEST 7
+
+typedef struct _resampler_t resampler_t;
+
+const char * resampler_get_name(int type);
+const char * resampler_get_description(int type);
+
+resampler_t * resampler_new(int type, int channels, int * error);
+resampler_t * resampler_delete(resampler_t * rs);
+
+/* Same contract as src_process(). The polyphase converters always take
+ * all of the input and keep whatever did not fit into data_out for the
+ * next call. With end_of_input set they drain the filter history; keep
+ * calling with no input until output_frames_gen is 0.
+ */
+int resampler_process(resampler_t * rs, SRC_DATA * data);
+
+/* Forget the stream history, e.g. when the input rate changes. */
+int resampler_reset(resampler_t * rs);
+
+const char * resampler_strerror(int error);
+
+#endif /* HAVE_SRC */
+
+
+#endif /* AQUALUNG_RESAMPLER_H */
+
+// vim: shiftwidth=8:tabstop=8:softtabstop=8 :
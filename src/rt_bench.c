@@ -0,0 +1,411 @@
+/*                                                     -*- linux-c -*-
+    Copyright (C) 2026 Aqualung contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+    $Id$
+*/
+
+/* Statistics of the null output driver, and a workload replayer that
+ * stands in for the GUI so runs can be scripted:
+ *
+ *   aqualung -o null -r 48000 --period 256 -W tracks=50,play=8,seeks=2 *.flac > rt.tsv
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <glib.h>
+
+#ifdef HAVE_LADSPA
+#include <ladspa.h>
+#include "plugin.h"
+#endif /* HAVE_LADSPA */
+
+#include "common.h"
+#include "rb.h"
+#include "options.h"
+#include "metadata.h"
+#include "decoder/file_decoder.h"
+#include "rt_bench.h"
+
+
+#ifdef NULL_DRIVER
+
+/* durations above this many microseconds share the last bin */
+#define RT_BENCH_MAX_US    20000
+#define RT_BENCH_FILL_BINS 10
+
+
+extern options_t options;
+extern int src_type_parsed;
+extern unsigned long out_SR;
+
+extern rb_t * rb;
+extern msgq_t * q_disk2out;
+extern msgq_t * q_out2disk;
+extern msgq_t * q_gui2disk;
+extern msgq_t * q_disk2gui;
+
+#ifdef HAVE_LADSPA
+extern volatile int plugin_lock;
+extern int n_plugins;
+extern plugin_instance * plugin_vect[MAX_PLUGINS];
+#endif /* HAVE_LADSPA */
+
+
+/* written by the output thread only, read after it has been joined */
+static unsigned int callback_hist[RT_BENCH_MAX_US + 1];
+static unsigned int wakeup_hist[RT_BENCH_MAX_US + 1];
+static unsigned long fill_hist[RT_BENCH_FILL_BINS];
+static unsigned long n_periods;
+static unsigned long n_underruns;
+static unsigned long n_late;
+static long callback_max_ns;
+static long wakeup_max_ns;
+
+
+static void
+hist_add(unsigned int * hist, long ns) {
+
+	long us = ns / 1000;
+
+	if (us < 0) {
+		us = 0;
+	} else if (us > RT_BENCH_MAX_US) {
+		us = RT_BENCH_MAX_US;
+	}
+	hist[us]++;
+}
+
+
+void
+rt_bench_period(long callback_ns, long wakeup_ns, float fill, int underrun, int late) {
+
+	int bin = fill * RT_BENCH_FILL_BINS;
+
+	if (bin >= RT_BENCH_FILL_BINS) {
+		bin = RT_BENCH_FILL_BINS - 1;
+	} else if (bin < 0) {
+		bin = 0;
+	}
+
+	hist_add(callback_hist, callback_ns);
+	hist_add(wakeup_hist, wakeup_ns);
+	fill_hist[bin]++;
+
+	if (callback_ns > callback_max_ns) {
+		callback_max_ns = callback_ns;
+	}
+	if (wakeup_ns > wakeup_max_ns) {
+		wakeup_max_ns = wakeup_ns;
+	}
+
+	n_periods++;
+	n_underruns += underrun;
+	n_late += late;
+}
+
+
+/* in microseconds, with 1 us resolution */
+static int
+hist_percentile(unsigned int * hist, double p) {
+
+	unsigned long want = p * n_periods;
+	unsigned long sum = 0;
+	int i;
+
+	if (n_periods == 0) {
+		return 0;
+	}
+	for (i = 0; i < RT_BENCH_MAX_US; i++) {
+		sum += hist[i];
+		if (sum > want) {
+			break;
+		}
+	}
+	return i;
+}
+
+
+static void
+report_msgq(FILE * f, char * name, msgq_t * q) {
+
+	msgq_stats_t stats;
+
+	msgq_get_stats(q, &stats);
+	fprintf(f, "msgq\t%s\t%u\t%u\t%u\n", name, stats.n_sent, stats.n_full, stats.max_depth);
+}
+
+
+void
+rt_bench_report(FILE * f, thread_info_t * info, int period) {
+
+	double period_us = 1e6 * period / info->out_SR;
+	int i;
+
+	fprintf(f, "#null\trate\tchannels\tperiod\tperiod_us\tperiods\tunderruns\tlate"
+		"\tcb_p50_us\tcb_p90_us\tcb_p99_us\tcb_p999_us\tcb_max_us\tcb_max_pct"
+		"\twake_p50_us\twake_p99_us\twake_max_us\n");
+	fprintf(f, "null\t%lu\t%d\t%d\t%.1f\t%lu\t%lu\t%lu\t%d\t%d\t%d\t%d\t%.1f\t%.1f\t%d\t%d\t%.1f\n",
+		info->out_SR, info->out_channels, period, period_us,
+		n_periods, n_underruns, n_late,
+		hist_percentile(callback_hist, 0.5), hist_percentile(callback_hist, 0.9),
+		hist_percentile(callback_hist, 0.99), hist_percentile(callback_hist, 0.999),
+		callback_max_ns / 1e3, 100.0 * callback_max_ns / 1e3 / period_us,
+		hist_percentile(wakeup_hist, 0.5), hist_percentile(wakeup_hist, 0.99),
+		wakeup_max_ns / 1e3);
+
+	fprintf(f, "#fill\tfrom_pct\tto_pct\tperiods\n");
+	for (i = 0; i < RT_BENCH_FILL_BINS; i++) {
+		fprintf(f, "fill\t%d\t%d\t%lu\n", 100 * i / RT_BENCH_FILL_BINS,
+			100 * (i + 1) / RT_BENCH_FILL_BINS, fill_hist[i]);
+	}
+
+	fprintf(f, "#msgq\tname\tsent\tfull\tmax_depth\n");
+	report_msgq(f, "disk2out", q_disk2out);
+	report_msgq(f, "out2disk", q_out2disk);
+	report_msgq(f, "gui2disk", q_gui2disk);
+	report_msgq(f, "disk2gui", q_disk2gui);
+	fflush(f);
+}
+
+
+typedef struct {
+	int tracks;    /* track changes before stopping */
+	double play;   /* seconds to play of each track, 0 for all of it */
+	int seeks;     /* random seeks per track */
+	unsigned int seed;
+} workload_t;
+
+
+static double
+now(void) {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+#ifdef HAVE_LADSPA
+/* file.so:index, running with every knob at its lower bound */
+static int
+add_plugin(char * spec) {
+
+	plugin_instance * instance;
+	const LADSPA_PortRangeHint * hints;
+	char * colon = strrchr(spec, ':');
+	int k;
+
+	if (colon == NULL) {
+		fprintf(stderr, "rt_bench: plugin %s: missing :<index>\n", spec);
+		return -1;
+	}
+	*colon = '\0';
+
+	if (n_plugins >= MAX_PLUGINS) {
+		fprintf(stderr, "rt_bench: at most %d plugins\n", MAX_PLUGINS);
+		return -1;
+	}
+	if ((instance = instantiate(spec, atoi(colon + 1))) == NULL) {
+		return -1;
+	}
+	connect_port(instance);
+	activate(instance);
+
+	hints = instance->descriptor->PortRangeHints;
+	for (k = 0; k < MAX_KNOBS && k < instance->descriptor->PortCount; k++) {
+		if (LADSPA_IS_HINT_BOUNDED_BELOW(hints[k].HintDescriptor)) {
+			instance->knobs[k] = hints[k].LowerBound;
+			if (LADSPA_IS_HINT_SAMPLE_RATE(hints[k].HintDescriptor)) {
+				instance->knobs[k] *= out_SR;
+			}
+		}
+	}
+	instance->is_bypassed = 0;
+
+	while (plugin_lock)
+		;
+	plugin_vect[n_plugins] = instance;
+	while (plugin_lock)
+		;
+	n_plugins++;
+
+	return 0;
+}
+#endif /* HAVE_LADSPA */
+
+
+static int
+parse_workload(char * str, workload_t * w, int n_files) {
+
+	char buf[MAXLEN];
+	char * s;
+	char * saveptr;
+	char * val;
+
+	w->tracks = n_files;
+	w->play = 0.0;
+	w->seeks = 0;
+	w->seed = 1;
+
+	arr_strlcpy(buf, str);
+	for (s = strtok_r(buf, ",", &saveptr); s != NULL; s = strtok_r(NULL, ",", &saveptr)) {
+		if ((val = strchr(s, '=')) == NULL) {
+			fprintf(stderr, "rt_bench: %s: expected key=value\n", s);
+			return -1;
+		}
+		*val++ = '\0';
+
+		if (strcmp(s, "tracks") == 0) {
+			w->tracks = atoi(val);
+		} else if (strcmp(s, "play") == 0) {
+			w->play = atof(val);
+		} else if (strcmp(s, "seeks") == 0) {
+			w->seeks = atoi(val);
+		} else if (strcmp(s, "seed") == 0) {
+			w->seed = strtoul(val, NULL, 10);
+		} else if (strcmp(s, "ladspa") == 0) {
+#ifdef HAVE_LADSPA
+			if (add_plugin(val)) {
+				return -1;
+			}
+#else
+			fprintf(stderr, "rt_bench: compiled without LADSPA support\n");
+			return -1;
+#endif /* HAVE_LADSPA */
+		} else {
+			fprintf(stderr, "rt_bench: unknown workload key %s\n", s);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+
+static void
+send_cue(char * filename) {
+
+	cue_t cue;
+
+	cue.filename = strdup(filename);
+	cue.voladj = 0.0f;
+	disk_send_cue(&cue);
+}
+
+
+int
+rt_bench_run(thread_info_t * info, char * workload, char ** files, int n_files) {
+
+	workload_t w;
+	fileinfo_t fileinfo;
+	message_t msg;
+	int track = 0;
+	int seeks_done = 0;
+	int stopping = 0;
+	int next = 0;
+	double t, track_start = 0.0, track_len = 0.0;
+
+	memset(&fileinfo, 0, sizeof(fileinfo_t));
+
+	if (n_files == 0) {
+		fprintf(stderr, "rt_bench: no files to play\n");
+		return -1;
+	}
+
+	out_SR = info->out_SR;
+#ifdef HAVE_SRC
+	if (!src_type_parsed) {
+		options.src_type = 4;
+	}
+#endif /* HAVE_SRC */
+
+	if (parse_workload(workload, &w, n_files)) {
+		disk_send_cmd(CMD_FINISH);
+		return -1;
+	}
+
+	send_cue(files[0]);
+
+	while (1) {
+		t = now();
+
+		while (msgq_recv(q_disk2gui, &msg)) {
+			switch (msg.cmd) {
+			case CMD_FILEREQ:
+				next = !stopping;
+				break;
+			case CMD_FILEINFO:
+				fileinfo = msg.u.fileinfo;
+				free(fileinfo.format_str);
+				track_start = t;
+				track_len = (w.play > 0.0) ? w.play :
+					(double)fileinfo.total_samples / fileinfo.sample_rate;
+				seeks_done = 0;
+				break;
+			case CMD_STATUS:
+			case CMD_METABLOCK:  /* the decoder owns the metadata */
+				break;
+			default:
+				fprintf(stderr, "rt_bench: recv'd unknown command %d\n", msg.cmd);
+				break;
+			}
+		}
+
+		if (!stopping && track_start > 0.0 && w.play > 0.0 && t - track_start >= w.play) {
+			next = 1;
+		}
+
+		if (next) {
+			next = 0;
+			track_start = 0.0;
+			if (++track < w.tracks) {
+				send_cue(files[track % n_files]);
+			} else {
+				disk_send_cmd(CMD_STOPWOFL);
+				stopping = 1;
+			}
+		}
+
+		if (!stopping && track_start > 0.0 && seeks_done < w.seeks &&
+		    fileinfo.total_samples > 0 &&
+		    t - track_start >= (seeks_done + 1) * track_len / (w.seeks + 1)) {
+
+			disk_send_seek((double)rand_r(&w.seed) / RAND_MAX *
+				       (fileinfo.total_samples - 1));
+			seeks_done++;
+		}
+
+		/* let the output play out what is left */
+		if (stopping && rb_read_space(rb) == 0) {
+			break;
+		}
+
+		msgq_wait(q_disk2gui, 10);
+	}
+
+	disk_send_cmd(CMD_FINISH);
+	return 0;
+}
+
+#endif /* NULL_DRIVER */
+
+
+// vim: shiftwidth=8:tabstop=8:softtabstop=8 :
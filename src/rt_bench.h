@@ -0,0 +1,53 @@
+/*                                                     -*- linux-c -*-
+    Copyright (C) 2026 Aqualung contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+    $Id$
+*/
+
+#ifndef AQUALUNG_RT_BENCH_H
+#define AQUALUNG_RT_BENCH_H
+
+#include <stdio.h>
+
+#include "core.h"
+
+
+#ifdef NULL_DRIVER
+
+/* Called by the null output once per period: callback_ns is the time
+ * spent producing the period, wakeup_ns how late the thread woke up,
+ * fill the ringbuffer fill (0..1) before reading. underrun is set when
+ * the ringbuffer could not cover the period while streaming, late when
+ * the period was finished after the device would have needed it.
+ */
+void rt_bench_period(long callback_ns, long wakeup_ns, float fill, int underrun, int late);
+
+/* Print the statistics gathered so far as tab separated lines. */
+void rt_bench_report(FILE * f, thread_info_t * info, int period);
+
+/* Play the files through the disk thread without the GUI, following a
+ * comma separated workload description like "tracks=20,play=10,seeks=3".
+ * Returns when the workload is done and the disk thread is finished.
+ */
+int rt_bench_run(thread_info_t * info, char * workload, char ** files, int n_files);
+
+#endif /* NULL_DRIVER */
+
+
+#endif /* AQUALUNG_RT_BENCH_H */
+
+// vim: shiftwidth=8:tabstop=8:softtabstop=8 :
@@ -68,6 +68,8 @@ int record_yes;
 int track_yes;
 int comment_yes;
 
+static guint search_timeout_tag = 0;
+
 static void
 get_toggle_buttons_state(void) {
 
@@ -114,6 +116,11 @@ close_button_clicked(GtkWidget * widget, gpointer data) {
                           (artist_yes * SEARCH_F_AN) | (record_yes * SEARCH_F_RT) | (track_yes * SEARCH_F_TT) |
                           (comment_yes * SEARCH_F_CO);
 
+	if (search_timeout_tag) {
+		g_source_remove(search_timeout_tag);
+		search_timeout_tag = 0;
+	}
+
 	clear_search_store();
         gtk_widget_destroy(search_window);
         search_window = NULL;
@@ -129,6 +136,11 @@ search_window_close(GtkWidget * widget, gpointer * data) {
                           (artist_yes * SEARCH_F_AN) | (record_yes * SEARCH_F_RT) | (track_yes * SEARCH_F_TT) |
                           (comment_yes * SEARCH_F_CO);
 
+	if (search_timeout_tag) {
+		g_source_remove(search_timeout_tag);
+		search_timeout_tag = 0;
+	}
+
 	clear_search_store();
         search_window = NULL;
         return 0;
@@ -154,22 +166,386 @@ sfac_clicked(GtkWidget * widget, gpointer data) {
         return TRUE;
 }
 
-static gint
-search_button_clicked(GtkWidget * widget, gpointer data) {
+/* Prebuilt index over the file stores of the Music Store. Every artist,
+ * record and track node gets one entry holding its name and comment,
+ * both verbatim and case-folded. A trigram inverted index over the
+ * folded strings narrows each query down to a handful of candidates,
+ * so a search is cheap enough to run on every keystroke.
+ *
+ * The index is dropped whenever the music store changes and is rebuilt
+ * lazily by the next search.
+ */
+
+enum {
+	SEARCH_LEVEL_ARTIST,
+	SEARCH_LEVEL_RECORD,
+	SEARCH_LEVEL_TRACK
+};
+
+/* result ranks, best first */
+enum {
+	SEARCH_RANK_EXACT,
+	SEARCH_RANK_PREFIX,
+	SEARCH_RANK_WORD,
+	SEARCH_RANK_SUBSTRING
+};
+
+#define SEARCH_DELAY_MS 150
+
+typedef struct {
+	GtkTreePath * path;
+	int level;
+	int artist_idx;
+	int record_idx;
+	char * name;
+	char * name_fold;
+	char * comment;
+	char * comment_fold;
+} search_entry_t;
 
-	int valid;
-	const char * key_string = gtk_entry_get_text(GTK_ENTRY(searchkey_entry));
-	char key[MAXLEN];
-	GPatternSpec * pattern;
+static GArray * search_entries = NULL;
+static GHashTable * search_trigrams = NULL;
+static int search_index_valid = 0;
+static int search_index_signals = 0;
+
+
+static void
+search_posting_free(gpointer data) {
+
+	g_array_free((GArray *)data, TRUE);
+}
+
+static void
+search_index_free(void) {
+
+	guint i;
+
+	if (search_entries != NULL) {
+		for (i = 0; i < search_entries->len; i++) {
+			search_entry_t * entry = &g_array_index(search_entries, search_entry_t, i);
+			gtk_tree_path_free(entry->path);
+			g_free(entry->name);
+			g_free(entry->name_fold);
+			g_free(entry->comment);
+			g_free(entry->comment_fold);
+		}
+		g_array_free(search_entries, TRUE);
+		search_entries = NULL;
+	}
+
+	if (search_trigrams != NULL) {
+		g_hash_table_destroy(search_trigrams);
+		search_trigrams = NULL;
+	}
+
+	search_index_valid = 0;
+}
+
+void
+search_index_invalidate(void) {
+
+	search_index_valid = 0;
+}
+
+static void
+search_index_row_changed_cb(GtkTreeModel * model, GtkTreePath * path, GtkTreeIter * iter, gpointer data) {
+
+	search_index_invalidate();
+}
+
+static void
+search_index_row_deleted_cb(GtkTreeModel * model, GtkTreePath * path, gpointer data) {
+
+	search_index_invalidate();
+}
+
+static void
+search_index_rows_reordered_cb(GtkTreeModel * model, GtkTreePath * path, GtkTreeIter * iter,
+			       gpointer new_order, gpointer data) {
+
+	search_index_invalidate();
+}
+
+static guint
+search_trigram_key(const char * s) {
+
+	return (guint)(guchar)s[0] | ((guint)(guchar)s[1] << 8) | ((guint)(guchar)s[2] << 16);
+}
+
+static void
+search_index_add_trigrams(const char * str, guint idx) {
+
+	const char * p;
+
+	if (str == NULL) {
+		return;
+	}
+
+	for (p = str; p[0] != '\0' && p[1] != '\0' && p[2] != '\0'; p++) {
+
+		gpointer key = GUINT_TO_POINTER(search_trigram_key(p));
+		GArray * posting = (GArray *)g_hash_table_lookup(search_trigrams, key);
+
+		if (posting == NULL) {
+			posting = g_array_new(FALSE, FALSE, sizeof(guint));
+			g_hash_table_insert(search_trigrams, key, posting);
+		}
+		/* entries are added in index order, so postings stay sorted */
+		if (posting->len == 0 || g_array_index(posting, guint, posting->len - 1) != idx) {
+			g_array_append_val(posting, idx);
+		}
+	}
+}
+
+static int
+search_index_add(GtkTreeIter * iter, int level, int artist_idx, int record_idx, char * comment) {
+
+	search_entry_t entry;
+	guint idx = search_entries->len;
+
+	gtk_tree_model_get(GTK_TREE_MODEL(music_store), iter, MS_COL_NAME, &entry.name, -1);
+
+	entry.path = gtk_tree_model_get_path(GTK_TREE_MODEL(music_store), iter);
+	entry.level = level;
+	entry.artist_idx = artist_idx;
+	entry.record_idx = record_idx;
+	entry.name_fold = g_utf8_casefold(entry.name, -1);
+
+	if (comment != NULL && comment[0] != '\0') {
+		entry.comment = g_strdup(comment);
+		entry.comment_fold = g_utf8_casefold(comment, -1);
+	} else {
+		entry.comment = NULL;
+		entry.comment_fold = NULL;
+	}
+
+	g_array_append_val(search_entries, entry);
+
+	search_index_add_trigrams(entry.name_fold, idx);
+	search_index_add_trigrams(entry.comment_fold, idx);
+
+	return idx;
+}
+
+static void
+search_index_build(void) {
 
-	int h, i, j, k;
 	GtkTreeIter store_iter;
 	GtkTreeIter artist_iter;
 	GtkTreeIter record_iter;
 	GtkTreeIter track_iter;
-	GtkTreeIter sfac_iter;
+	gboolean store_valid;
 
-        get_toggle_buttons_state();
+	if (search_index_valid) {
+		return;
+	}
+
+	if (!search_index_signals) {
+		g_signal_connect(G_OBJECT(music_store), "row-changed",
+				 G_CALLBACK(search_index_row_changed_cb), NULL);
+		g_signal_connect(G_OBJECT(music_store), "row-inserted",
+				 G_CALLBACK(search_index_row_changed_cb), NULL);
+		g_signal_connect(G_OBJECT(music_store), "row-deleted",
+				 G_CALLBACK(search_index_row_deleted_cb), NULL);
+		g_signal_connect(G_OBJECT(music_store), "rows-reordered",
+				 G_CALLBACK(search_index_rows_reordered_cb), NULL);
+		search_index_signals = 1;
+	}
+
+	search_index_free();
+	search_entries = g_array_new(FALSE, FALSE, sizeof(search_entry_t));
+	search_trigrams = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, search_posting_free);
+
+	store_valid = gtk_tree_model_get_iter_first(GTK_TREE_MODEL(music_store), &store_iter);
+	for (; store_valid; store_valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(music_store), &store_iter)) {
+
+		gboolean artist_valid;
+
+		if (iter_get_store_type(&store_iter) != STORE_TYPE_FILE) {
+			continue;
+		}
+
+		artist_valid = gtk_tree_model_iter_children(GTK_TREE_MODEL(music_store), &artist_iter, &store_iter);
+		for (; artist_valid; artist_valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(music_store), &artist_iter)) {
+
+			artist_data_t * artist_data;
+			gboolean record_valid;
+			int artist_idx;
+
+			gtk_tree_model_get(GTK_TREE_MODEL(music_store), &artist_iter, MS_COL_DATA, &artist_data, -1);
+			artist_idx = search_index_add(&artist_iter, SEARCH_LEVEL_ARTIST, -1, -1, artist_data->comment);
+
+			record_valid = gtk_tree_model_iter_children(GTK_TREE_MODEL(music_store), &record_iter, &artist_iter);
+			for (; record_valid; record_valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(music_store), &record_iter)) {
+
+				record_data_t * record_data;
+				gboolean track_valid;
+				int record_idx;
+
+				gtk_tree_model_get(GTK_TREE_MODEL(music_store), &record_iter, MS_COL_DATA, &record_data, -1);
+				record_idx = search_index_add(&record_iter, SEARCH_LEVEL_RECORD,
+							      artist_idx, -1, record_data->comment);
+
+				track_valid = gtk_tree_model_iter_children(GTK_TREE_MODEL(music_store), &track_iter, &record_iter);
+				for (; track_valid; track_valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(music_store), &track_iter)) {
+
+					track_data_t * track_data;
+
+					gtk_tree_model_get(GTK_TREE_MODEL(music_store), &track_iter, MS_COL_DATA, &track_data, -1);
+					search_index_add(&track_iter, SEARCH_LEVEL_TRACK,
+							 artist_idx, record_idx, track_data->comment);
+				}
+			}
+		}
+	}
+
+	search_index_valid = 1;
+}
+
+static int
+search_posting_contains(GArray * posting, guint idx) {
+
+	guint lo = 0;
+	guint hi = posting->len;
+
+	while (lo < hi) {
+		guint mid = lo + (hi - lo) / 2;
+		guint val = g_array_index(posting, guint, mid);
+		if (val == idx) {
+			return 1;
+		} else if (val < idx) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return 0;
+}
+
+/* Returns the sorted list of entries that contain every trigram found in
+ * the wildcard-free runs of (folded) key, or NULL if key has no trigram
+ * to filter with and every entry is a candidate.
+ */
+static GArray *
+search_index_candidates(const char * key) {
+
+	GPtrArray * postings = g_ptr_array_new();
+	GArray * shortest = NULL;
+	GArray * result;
+	const char * p;
+	guint i, j;
+
+	for (p = key; p[0] != '\0' && p[1] != '\0' && p[2] != '\0'; p++) {
+
+		GArray * posting;
+
+		if (p[0] == '*' || p[0] == '?' || p[1] == '*' || p[1] == '?' || p[2] == '*' || p[2] == '?') {
+			continue;
+		}
+
+		posting = (GArray *)g_hash_table_lookup(search_trigrams, GUINT_TO_POINTER(search_trigram_key(p)));
+		if (posting == NULL) {
+			g_ptr_array_free(postings, TRUE);
+			return g_array_new(FALSE, FALSE, sizeof(guint));
+		}
+		if (shortest == NULL || posting->len < shortest->len) {
+			shortest = posting;
+		}
+		g_ptr_array_add(postings, posting);
+	}
+
+	if (shortest == NULL) {
+		g_ptr_array_free(postings, TRUE);
+		return NULL;
+	}
+
+	result = g_array_new(FALSE, FALSE, sizeof(guint));
+	for (i = 0; i < shortest->len; i++) {
+
+		guint idx = g_array_index(shortest, guint, i);
+
+		for (j = 0; j < postings->len; j++) {
+			GArray * posting = (GArray *)g_ptr_array_index(postings, j);
+			if (posting != shortest && !search_posting_contains(posting, idx)) {
+				break;
+			}
+		}
+		if (j == postings->len) {
+			g_array_append_val(result, idx);
+		}
+	}
+
+	g_ptr_array_free(postings, TRUE);
+	return result;
+}
+
+static int
+search_match_rank(GPatternSpec * pattern, const char * literal, const char * text) {
+
+	const char * pos;
+
+	if (text == NULL || !g_pattern_match_string(pattern, text)) {
+		return -1;
+	}
+
+	if (literal == NULL || (pos = strstr(text, literal)) == NULL) {
+		return SEARCH_RANK_SUBSTRING;
+	}
+	if (pos == text) {
+		return (strcmp(text, literal) == 0) ? SEARCH_RANK_EXACT : SEARCH_RANK_PREFIX;
+	}
+	if (!g_unichar_isalnum(g_utf8_get_char(g_utf8_prev_char(pos)))) {
+		return SEARCH_RANK_WORD;
+	}
+	return SEARCH_RANK_SUBSTRING;
+}
+
+static void
+search_add_result(search_entry_t * entry, int rank) {
+
+	GtkTreeIter iter;
+	char * artist_name = "";
+	char * record_name = "";
+	char * track_name = "";
+
+	switch (entry->level) {
+	case SEARCH_LEVEL_ARTIST:
+		artist_name = entry->name;
+		break;
+	case SEARCH_LEVEL_RECORD:
+		artist_name = g_array_index(search_entries, search_entry_t, entry->artist_idx).name;
+		record_name = entry->name;
+		break;
+	case SEARCH_LEVEL_TRACK:
+		artist_name = g_array_index(search_entries, search_entry_t, entry->artist_idx).name;
+		record_name = g_array_index(search_entries, search_entry_t, entry->record_idx).name;
+		track_name = entry->name;
+		break;
+	}
+
+	gtk_list_store_append(search_store, &iter);
+	gtk_list_store_set(search_store, &iter,
+			   0, artist_name,
+			   1, record_name,
+			   2, track_name,
+			   3, (gpointer)gtk_tree_path_copy(entry->path),
+			   4, rank,
+			   -1);
+}
+
+static void
+search_run(void) {
+
+	const char * key_string = gtk_entry_get_text(GTK_ENTRY(searchkey_entry));
+	char * key_fold;
+	char key[MAXLEN];
+	const char * literal;
+	GPatternSpec * pattern;
+	GArray * candidates;
+	gint sort_column;
+	GtkSortType sort_order;
+	guint i, n;
+	int valid;
 
 	clear_search_store();
 
@@ -181,223 +557,86 @@ search_button_clicked(GtkWidget * widget, gpointer data) {
 		}
 	}
 	if (!valid) {
-		return TRUE;
+		return;
 	}
 
-	if (!casesens) {
-		key_string = g_utf8_strup(key_string, -1);
-	}
+	search_index_build();
+
+	key_fold = g_utf8_casefold(key_string, -1);
+	literal = casesens ? key_string : key_fold;
 
 	if (exactonly) {
-		arr_strlcpy(key, key_string);
+		arr_strlcpy(key, literal);
 	} else {
-		arr_snprintf(key, "*%s*", key_string);
+		arr_snprintf(key, "*%s*", literal);
 	}
-
 	pattern = g_pattern_spec_new(key);
 
+	/* the rank is only refined for keys without wildcards */
+	if (strpbrk(literal, "*?") != NULL) {
+		literal = NULL;
+	}
 
-	h = 0;
-	while (gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(music_store), &store_iter, NULL, h++)) {
+	candidates = search_index_candidates(key_fold);
+	n = (candidates != NULL) ? candidates->len : search_entries->len;
 
-		if (iter_get_store_type(&store_iter) != STORE_TYPE_FILE) {
-			continue;
-		}
+	/* don't resort the list on every append */
+	if (!gtk_tree_sortable_get_sort_column_id(GTK_TREE_SORTABLE(search_store), &sort_column, &sort_order)) {
+		sort_column = 4;
+		sort_order = GTK_SORT_ASCENDING;
+	}
+	gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(search_store),
+					     GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID, GTK_SORT_ASCENDING);
 
-		i = 0;
-		while (gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(music_store),
-						     &artist_iter, &store_iter, i++)) {
+	for (i = 0; i < n; i++) {
 
-			char * artist_name;
-			artist_data_t * artist_data;
+		guint idx = (candidates != NULL) ? g_array_index(candidates, guint, i) : i;
+		search_entry_t * entry = &g_array_index(search_entries, search_entry_t, idx);
+		int name_rank = -1;
+		int comment_rank = -1;
 
+		if ((entry->level == SEARCH_LEVEL_ARTIST && artist_yes) ||
+		    (entry->level == SEARCH_LEVEL_RECORD && record_yes) ||
+		    (entry->level == SEARCH_LEVEL_TRACK && track_yes)) {
+			name_rank = search_match_rank(pattern, literal,
+						      casesens ? entry->name : entry->name_fold);
+		}
+		if (comment_yes) {
+			comment_rank = search_match_rank(pattern, literal,
+							 casesens ? entry->comment : entry->comment_fold);
+		}
 
-			gtk_tree_model_get(GTK_TREE_MODEL(music_store), &artist_iter,
-					   MS_COL_NAME, &artist_name,
-					   MS_COL_DATA, &artist_data, -1);
+		/* a comment hit ranks just below a name hit of the same kind */
+		if (name_rank >= 0 && (comment_rank < 0 || name_rank <= comment_rank)) {
+			search_add_result(entry, 2 * name_rank);
+		} else if (comment_rank >= 0) {
+			search_add_result(entry, 2 * comment_rank + 1);
+		}
+	}
 
-			if (artist_yes) {
-				char * tmp = NULL;
-				if (casesens) {
-					tmp = strdup(artist_name);
-				} else {
-					tmp = g_utf8_strup(artist_name, -1);
-				}
-				if (g_pattern_match_string(pattern, tmp)) {
-
-					GtkTreeIter iter;
-					GtkTreePath * path;
-
-					path = gtk_tree_model_get_path(GTK_TREE_MODEL(music_store),
-								       &artist_iter);
-					gtk_list_store_append(search_store, &iter);
-					gtk_list_store_set(search_store, &iter,
-							   0, artist_name,
-							   1, "",
-							   2, "",
-							   3, (gpointer)path,
-							   -1);
-				}
-				g_free(tmp);
-			}
+	gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(search_store), sort_column, sort_order);
 
-			if (comment_yes && artist_data->comment != NULL) {
-				char * tmp = NULL;
-				if (casesens) {
-					tmp = strdup(artist_data->comment);
-				} else {
-					tmp = g_utf8_strup(artist_data->comment, -1);
-				}
-				if (g_pattern_match_string(pattern, tmp)) {
-
-					GtkTreeIter iter;
-					GtkTreePath * path;
-
-					path = gtk_tree_model_get_path(GTK_TREE_MODEL(music_store),
-								       &artist_iter);
-					gtk_list_store_append(search_store, &iter);
-					gtk_list_store_set(search_store, &iter,
-							   0, artist_name,
-							   1, "",
-							   2, "",
-							   3, (gpointer)path,
-							   -1);
-				}
-				g_free(tmp);
-			}
+	if (candidates != NULL) {
+		g_array_free(candidates, TRUE);
+	}
+	g_pattern_spec_free(pattern);
+	g_free(key_fold);
+}
 
-			j = 0;
-			while (gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(music_store), &record_iter,
-							     &artist_iter, j++)) {
+static gint
+search_button_clicked(GtkWidget * widget, gpointer data) {
 
-				char * record_name;
-				record_data_t * record_data;
+	GtkTreeIter sfac_iter;
 
-				gtk_tree_model_get(GTK_TREE_MODEL(music_store), &record_iter,
-						   MS_COL_NAME, &record_name,
-						   MS_COL_DATA, &record_data, -1);
-				
-				if (record_yes) {
-					char * tmp = NULL;
-					if (casesens) {
-						tmp = strdup(record_name);
-					} else {
-						tmp = g_utf8_strup(record_name, -1);
-					}
-					if (g_pattern_match_string(pattern, tmp)) {
-						
-						GtkTreeIter iter;
-						GtkTreePath * path;
-						
-						path = gtk_tree_model_get_path(GTK_TREE_MODEL(music_store),
-									       &record_iter);
-						gtk_list_store_append(search_store, &iter);
-						gtk_list_store_set(search_store, &iter,
-								   0, artist_name,
-								   1, record_name,
-								   2, "",
-								   3, (gpointer)path,
-								   -1);
-					}
-					g_free(tmp);
-				}
-				
-				if (comment_yes && record_data->comment != NULL) {
-					char * tmp = NULL;
-					if (casesens) {
-						tmp = strdup(record_data->comment);
-					} else {
-						tmp = g_utf8_strup(record_data->comment, -1);
-					}
-					if (g_pattern_match_string(pattern, tmp)) {
-						
-						GtkTreeIter iter;
-						GtkTreePath * path;
-						
-						path = gtk_tree_model_get_path(GTK_TREE_MODEL(music_store),
-									       &record_iter);
-						gtk_list_store_append(search_store, &iter);
-						gtk_list_store_set(search_store, &iter,
-								   0, artist_name,
-								   1, record_name,
-								   2, "",
-								   3, (gpointer)path,
-								   -1);
-					}
-					g_free(tmp);
-				}
-				
-				k = 0;
-				while (gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(music_store),
-								     &track_iter, &record_iter, k++)) {
-					
-					char * track_name;
-					track_data_t * track_data;
-					
-					gtk_tree_model_get(GTK_TREE_MODEL(music_store), &track_iter,
-							   MS_COL_NAME, &track_name,
-							   MS_COL_DATA, &track_data, -1);
-					
-					if (track_yes) {
-						char * tmp = NULL;
-						if (casesens) {
-							tmp = strdup(track_name);
-						} else {
-							tmp = g_utf8_strup(track_name, -1);
-						}
-						if (g_pattern_match_string(pattern, tmp)) {
-							
-							GtkTreeIter iter;
-							GtkTreePath * path;
-							
-							path = gtk_tree_model_get_path(GTK_TREE_MODEL(music_store),
-										       &track_iter);
-							gtk_list_store_append(search_store, &iter);
-							gtk_list_store_set(search_store, &iter,
-									   0, artist_name,
-									   1, record_name,
-									   2, track_name,
-									   3, (gpointer)path,
-									   -1);
-						}
-						g_free(tmp);
-					}
-					
-					if (comment_yes && track_data->comment != NULL) {
-						char * tmp = NULL;
-						if (casesens) {
-							tmp = strdup(track_data->comment);
-						} else {
-							tmp = g_utf8_strup(track_data->comment, -1);
-						}
-						if (g_pattern_match_string(pattern, tmp)) {
-							
-							GtkTreeIter iter;
-							GtkTreePath * path;
-							
-							path = gtk_tree_model_get_path(GTK_TREE_MODEL(music_store),
-										       &track_iter);
-							gtk_list_store_append(search_store, &iter);
-							gtk_list_store_set(search_store, &iter,
-									   0, artist_name,
-									   1, record_name,
-									   2, track_name,
-									   3, (gpointer)path,
-									   -1);
-						}
-						g_free(tmp);
-					}
-
-					g_free(track_name);
-				}
-				g_free(record_name);
-			}
-			g_free(artist_name);
-		}
+	if (search_timeout_tag) {
+		g_source_remove(search_timeout_tag);
+		search_timeout_tag = 0;
 	}
-		
-	g_pattern_spec_free(pattern);
-	
+
+        get_toggle_buttons_state();
+
+	search_run();
+
 	if (selectfc) {
 		if (gtk_tree_model_get_iter_first(GTK_TREE_MODEL(search_store), &sfac_iter) == TRUE) {
 			gtk_tree_selection_select_iter(search_select, &sfac_iter);
@@ -410,6 +649,31 @@ search_button_clicked(GtkWidget * widget, gpointer data) {
 }
 
 
+static gboolean
+search_timeout_cb(gpointer data) {
+
+	search_timeout_tag = 0;
+
+        get_toggle_buttons_state();
+
+	/* picking the first hit would close the window while typing */
+	if (!selectfc) {
+		search_run();
+	}
+
+	return FALSE;
+}
+
+static void
+searchkey_changed(GtkEditable * editable, gpointer data) {
+
+	if (search_timeout_tag) {
+		g_source_remove(search_timeout_tag);
+	}
+	search_timeout_tag = aqualung_timeout_add(SEARCH_DELAY_MS, search_timeout_cb, NULL);
+}
+
+
 void
 search_selection_changed(GtkTreeSelection * treeselection, gpointer user_data) {
 
@@ -501,6 +765,7 @@ search_dialog(void) {
         searchkey_entry = gtk_entry_new();
         gtk_widget_show(searchkey_entry);
         gtk_box_pack_start(GTK_BOX(hbox), searchkey_entry, TRUE, TRUE, 5);
+        g_signal_connect(G_OBJECT(searchkey_entry), "changed", G_CALLBACK(searchkey_changed), NULL);
 
 
 	table = gtk_table_new(5, 2, FALSE);
@@ -575,13 +840,14 @@ search_dialog(void) {
         gtk_container_add(GTK_CONTAINER(search_viewport), search_scrwin);
 
 
-        search_store = gtk_list_store_new(4,
+        search_store = gtk_list_store_new(5,
 					  G_TYPE_STRING,   /* artist */
 					  G_TYPE_STRING,   /* record */
 					  G_TYPE_STRING,   /* track */
-					  G_TYPE_POINTER); /* * GtkTreePath */
+					  G_TYPE_POINTER,  /* * GtkTreePath */
+					  G_TYPE_INT);     /* rank */
 
-        gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(search_store), 0, GTK_SORT_ASCENDING);
+        gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(search_store), 4, GTK_SORT_ASCENDING);
 
         search_list = gtk_tree_view_new_with_model(GTK_TREE_MODEL(search_store));
         gtk_widget_show(search_list);     
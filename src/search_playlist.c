@@ -28,6 +28,7 @@
 #include <gdk/gdkkeysyms.h>
 #include <gtk/gtk.h>
 
+#include "athread.h"
 #include "common.h"
 #include "utils_gui.h"
 #include "playlist.h"
@@ -63,6 +64,43 @@ static int casesens;
 static int exactonly;
 static int selectfc;
 
+
+/* Searches run on a worker thread over a snapshot of all playlist rows
+ * taken on the GUI thread. Matches are handed back in batches through
+ * the idle queue; batches of a superseded search are dropped by
+ * comparing generations.
+ */
+
+#define SEARCH_BATCH_SIZE 256
+#define SEARCH_DELAY_MS   150
+
+typedef struct {
+	playlist_t * pl;
+	GtkTreePath * path;
+	char * text;  /* folded, unless the search is case sensitive */
+} search_row_t;
+
+typedef struct {
+	GArray * rows;     /* snapshot of the rows to search */
+	GArray * batch;    /* matches not yet passed to the GUI */
+	GPatternSpec * pattern;
+	guint generation;
+	int sync;
+	volatile int cancel;
+} search_job_t;
+
+typedef struct {
+	guint generation;
+	GArray * matches;
+} search_batch_t;
+
+static AQUALUNG_THREAD_DECLARE(search_thread_id)
+static search_job_t * search_job = NULL;
+static guint search_generation = 0;
+static guint search_timeout_tag = 0;
+
+static void search_cancel(void);
+
 static void
 get_toggle_buttons_state(void) {
 
@@ -103,6 +141,7 @@ close_button_clicked(GtkWidget * widget, gpointer data) {
         get_toggle_buttons_state();
         options.search_pl_flags = (casesens * SEARCH_F_CS) | (exactonly * SEARCH_F_EM) | (selectfc * SEARCH_F_SF);
 
+	search_cancel();
 	clear_search_store();
         gtk_widget_destroy(search_window);
         search_window = NULL;
@@ -116,6 +155,7 @@ search_window_close(GtkWidget * widget, gpointer * data) {
         get_toggle_buttons_state();
         options.search_pl_flags = (casesens * SEARCH_F_CS) | (exactonly * SEARCH_F_EM) | (selectfc * SEARCH_F_SF);
 
+	search_cancel();
 	clear_search_store();
         search_window = NULL;
         return 0;
@@ -139,57 +179,218 @@ sfac_clicked(GtkWidget * widget, gpointer data) {
 }
 
 
-void
-search_foreach(playlist_t * pl, GPatternSpec * pattern, GtkTreeIter * list_iter, int album_node) {
+static void
+search_rows_free(GArray * rows) {
+
+	guint i;
+
+	for (i = 0; i < rows->len; i++) {
+		search_row_t * row = &g_array_index(rows, search_row_t, i);
+		if (row->path != NULL) {
+			gtk_tree_path_free(row->path);
+		}
+		g_free(row->text);
+	}
+	g_array_free(rows, TRUE);
+}
 
-	char text[MAXLEN];
-	char * tmp = NULL;
+static void
+search_job_free(search_job_t * job) {
+
+	search_rows_free(job->rows);
+	search_rows_free(job->batch);
+	g_pattern_spec_free(job->pattern);
+	g_free(job);
+}
+
+static void
+search_snapshot_add(GArray * rows, playlist_t * pl, GtkTreeIter * iter, int album_node) {
+
+	search_row_t row;
 	playlist_data_t * pldata;
 
-	gtk_tree_model_get(GTK_TREE_MODEL(pl->store), list_iter, PL_COL_DATA, &pldata, -1);
-	if (album_node) {
-		arr_snprintf(text, "%s: %s", pldata->artist, pldata->album);
+	gtk_tree_model_get(GTK_TREE_MODEL(pl->store), iter, PL_COL_DATA, &pldata, -1);
+
+	row.pl = pl;
+	row.path = gtk_tree_model_get_path(GTK_TREE_MODEL(pl->store), iter);
+
+	if (casesens) {
+		char text[MAXLEN];
+		playlist_data_get_search_text(text, CHAR_ARRAY_SIZE(text), pldata, album_node);
+		row.text = g_strdup(text);
 	} else {
-		playlist_data_get_display_name(text, CHAR_ARRAY_SIZE(text), pldata);
+		row.text = g_strdup(playlist_data_get_fold(pldata, album_node));
 	}
 
-	if (casesens) {
-		tmp = strdup(text);
+	g_array_append_val(rows, row);
+}
+
+static GArray *
+search_snapshot(void) {
+
+	GArray * rows = g_array_new(FALSE, FALSE, sizeof(search_row_t));
+	GList * node;
+
+	for (node = playlists; node; node = node->next) {
+
+		playlist_t * pl = (playlist_t *)node->data;
+		GtkTreeIter list_iter;
+		gboolean valid;
+
+		valid = gtk_tree_model_get_iter_first(GTK_TREE_MODEL(pl->store), &list_iter);
+		for (; valid; valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(pl->store), &list_iter)) {
+
+			GtkTreeIter iter;
+			gboolean child_valid;
+
+			if (!gtk_tree_model_iter_has_child(GTK_TREE_MODEL(pl->store), &list_iter)) {
+				search_snapshot_add(rows, pl, &list_iter, 0/*track node*/);
+				continue;
+			}
+
+			search_snapshot_add(rows, pl, &list_iter, 1/*album node*/);
+
+			child_valid = gtk_tree_model_iter_children(GTK_TREE_MODEL(pl->store), &iter, &list_iter);
+			for (; child_valid; child_valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(pl->store), &iter)) {
+				search_snapshot_add(rows, pl, &iter, 0/*track node*/);
+			}
+		}
+	}
+
+	return rows;
+}
+
+/* runs on the GUI thread */
+static void
+search_batch_add(search_batch_t * batch) {
+
+	guint i;
+
+	if (batch->generation == search_generation && search_window != NULL) {
+
+		for (i = 0; i < batch->matches->len; i++) {
+
+			search_row_t * match = &g_array_index(batch->matches, search_row_t, i);
+			playlist_data_t * pldata;
+			GtkTreeIter list_iter;
+			GtkTreeIter iter;
+			char text[MAXLEN];
+
+			/* the playlist may have changed since the snapshot */
+			if (g_list_find(playlists, match->pl) == NULL ||
+			    !gtk_tree_model_get_iter(GTK_TREE_MODEL(match->pl->store), &list_iter, match->path)) {
+				continue;
+			}
+
+			gtk_tree_model_get(GTK_TREE_MODEL(match->pl->store), &list_iter, PL_COL_DATA, &pldata, -1);
+			playlist_data_get_search_text(text, CHAR_ARRAY_SIZE(text), pldata,
+				gtk_tree_model_iter_has_child(GTK_TREE_MODEL(match->pl->store), &list_iter));
+
+			gtk_list_store_append(search_store, &iter);
+			gtk_list_store_set(search_store, &iter, 0, text,
+					   1, (gpointer)match->path, 2, match->pl->name, 3, (gpointer)match->pl, -1);
+			match->path = NULL;
+		}
+	}
+
+	search_rows_free(batch->matches);
+	g_free(batch);
+}
+
+static gboolean
+search_batch_cb(gpointer data) {
+
+	search_batch_add((search_batch_t *)data);
+	return FALSE;
+}
+
+static void
+search_job_flush(search_job_t * job) {
+
+	search_batch_t * batch;
+
+	if (job->batch->len == 0) {
+		return;
+	}
+
+	batch = g_new(search_batch_t, 1);
+	batch->generation = job->generation;
+	batch->matches = job->batch;
+	job->batch = g_array_new(FALSE, FALSE, sizeof(search_row_t));
+
+	if (job->sync) {
+		search_batch_add(batch);
 	} else {
-		tmp = g_utf8_strup(text, -1);
+		aqualung_idle_add(search_batch_cb, batch);
 	}
+}
 
-	if (g_pattern_match_string(pattern, tmp)) {
+static void
+search_job_run(search_job_t * job) {
 
-		GtkTreeIter iter;
-		GtkTreePath * path;
+	guint i;
+
+	for (i = 0; i < job->rows->len && !job->cancel; i++) {
+
+		search_row_t * row = &g_array_index(job->rows, search_row_t, i);
+
+		if (g_pattern_match_string(job->pattern, row->text)) {
 
-		path = gtk_tree_model_get_path(GTK_TREE_MODEL(pl->store), list_iter);
-		gtk_list_store_append(search_store, &iter);
-		gtk_list_store_set(search_store, &iter, 0, text,
-				   1, (gpointer)path, 2, pl->name, 3, (gpointer)pl, -1);
+			search_row_t match;
+
+			match.pl = row->pl;
+			match.path = gtk_tree_path_copy(row->path);
+			match.text = NULL;
+			g_array_append_val(job->batch, match);
+
+			if (job->batch->len >= SEARCH_BATCH_SIZE) {
+				search_job_flush(job);
+			}
+		}
 	}
 
-	g_free(tmp);
+	if (!job->cancel) {
+		search_job_flush(job);
+	}
 }
 
-static gint
-search_button_clicked(GtkWidget * widget, gpointer data) {
+static void *
+search_thread(void * arg) {
 
-	int valid;
-	const char * key_string = gtk_entry_get_text(GTK_ENTRY(searchkey_entry));
-	char key[MAXLEN];
-	GPatternSpec * pattern;
+	search_job_run((search_job_t *)arg);
+	return NULL;
+}
 
-	int i;
-	GtkTreeIter list_iter;
-	GtkTreeIter sfac_iter;
+static void
+search_cancel(void) {
 
-	GList * node = NULL;
+	if (search_timeout_tag) {
+		g_source_remove(search_timeout_tag);
+		search_timeout_tag = 0;
+	}
 
+	if (search_job != NULL) {
+		search_job->cancel = 1;
+		AQUALUNG_THREAD_JOIN(search_thread_id)
+		search_job_free(search_job);
+		search_job = NULL;
+	}
 
-        get_toggle_buttons_state();
+	/* drop batches of the cancelled search still in the idle queue */
+	++search_generation;
+}
+
+static void
+search_start(int sync) {
+
+	int i;
+	int valid;
+	const char * key_string = gtk_entry_get_text(GTK_ENTRY(searchkey_entry));
+	char * key_fold = NULL;
+	char key[MAXLEN];
+	search_job_t * job;
 
+	search_cancel();
 	clear_search_store();
 
 	valid = 0;
@@ -200,11 +401,11 @@ search_button_clicked(GtkWidget * widget, gpointer data) {
 		}
 	}
 	if (!valid) {
-		return TRUE;
+		return;
 	}
 
 	if (!casesens) {
-		key_string = g_utf8_strup(key_string, -1);
+		key_string = key_fold = g_utf8_casefold(key_string, -1);
 	}
 
 	if (exactonly) {
@@ -212,35 +413,34 @@ search_button_clicked(GtkWidget * widget, gpointer data) {
 	} else {
 		arr_snprintf(key, "*%s*", key_string);
 	}
+	g_free(key_fold);
+
+	job = g_new(search_job_t, 1);
+	job->rows = search_snapshot();
+	job->batch = g_array_new(FALSE, FALSE, sizeof(search_row_t));
+	job->pattern = g_pattern_spec_new(key);
+	job->generation = search_generation;
+	job->sync = sync;
+	job->cancel = 0;
+
+	if (sync) {
+		search_job_run(job);
+		search_job_free(job);
+	} else {
+		search_job = job;
+		AQUALUNG_THREAD_CREATE(search_thread_id, NULL, search_thread, job)
+	}
+}
 
-	pattern = g_pattern_spec_new(key);
-
-	for (node = playlists; node; node = node->next) {
-
-		playlist_t * pl = (playlist_t *)node->data;
-
-		i = 0;
-		while (gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(pl->store),
-						     &list_iter, NULL, i++)) {
-
-			if (gtk_tree_model_iter_has_child(GTK_TREE_MODEL(pl->store), &list_iter)) {
-
-				int j = 0;
-				GtkTreeIter iter;
+static gint
+search_button_clicked(GtkWidget * widget, gpointer data) {
 
-				search_foreach(pl, pattern, &list_iter, 1/*album node*/);
+	GtkTreeIter sfac_iter;
 
-				while (gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(pl->store),
-								     &iter, &list_iter, j++)) {
-					search_foreach(pl, pattern, &iter, 0/*track node*/);
-				}
-			} else {
-				search_foreach(pl, pattern, &list_iter, 0/*track node*/);
-			}
-		}
-	}
+        get_toggle_buttons_state();
 
-	g_pattern_spec_free(pattern);
+	/* the first match has to be known before closing the window */
+	search_start(selectfc);
 
         if (selectfc) {
                 
@@ -253,6 +453,30 @@ search_button_clicked(GtkWidget * widget, gpointer data) {
         return TRUE;
 }
 
+static gboolean
+search_timeout_cb(gpointer data) {
+
+	search_timeout_tag = 0;
+
+        get_toggle_buttons_state();
+
+	/* picking the first match would close the window while typing */
+	if (!selectfc) {
+		search_start(0);
+	}
+
+	return FALSE;
+}
+
+static void
+searchkey_changed(GtkEditable * editable, gpointer data) {
+
+	if (search_timeout_tag) {
+		g_source_remove(search_timeout_tag);
+	}
+	search_timeout_tag = aqualung_timeout_add(SEARCH_DELAY_MS, search_timeout_cb, NULL);
+}
+
 
 static void
 search_selection_changed(GtkTreeSelection * treeselection, gpointer user_data) {
@@ -362,6 +586,7 @@ search_playlist_dialog(void) {
         searchkey_entry = gtk_entry_new();
         gtk_widget_show(searchkey_entry);
         gtk_box_pack_start(GTK_BOX(hbox), searchkey_entry, TRUE, TRUE, 5);
+        g_signal_connect(G_OBJECT(searchkey_entry), "changed", G_CALLBACK(searchkey_changed), NULL);
 
 
 	table = gtk_table_new(4, 2, FALSE);
@@ -0,0 +1,325 @@
+/*                                                     -*- linux-c -*-
+    Copyright (C) 2026 Aqualung contributors
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+    $Id$
+*/
+
+/* Sample rate converter benchmark: run every converter type over the
+ * common rate pairs and print tab separated speed and quality figures.
+ *
+ *   make -C src src_bench
+ *   src/src_bench [-s seconds] [-c channels] [-t type] > src.tsv
+ *
+ * snr_1k_db and snr_hf_db are signal to noise+distortion of a 1 kHz
+ * tone and of a tone at 40% of the lower rate; alias_db is how far a
+ * tone above the output Nyquist frequency is pushed down when
+ * downsampling.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+
+#ifdef HAVE_SRC
+
+#include "resampler.h"
+
+
+#define BLOCKSIZE 4096
+
+static const int rates[] = { 44100, 48000, 88200, 96000, 192000 };
+#define N_RATES (sizeof(rates) / sizeof(rates[0]))
+
+static double seconds = 10.0;
+static int channels = 2;
+
+
+static double
+cpu_time(void) {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* Convert n_in frames of in; returns the number of output frames, or
+ * -1 on error. *cpu gets the processor time spent converting.
+ */
+static long
+convert(int type, int in_SR, int out_SR, float * in, long n_in,
+	float * out, long out_size, double * cpu) {
+
+	resampler_t * rs;
+	SRC_DATA data;
+	long done_in = 0, done_out = 0;
+	double t;
+	int err;
+
+	if ((rs = resampler_new(type, channels, &err)) == NULL) {
+		fprintf(stderr, "src_bench: type %d: %s\n", type, resampler_strerror(err));
+		return -1;
+	}
+
+	t = cpu_time();
+	while (done_in < n_in) {
+		long n = (n_in - done_in > BLOCKSIZE) ? BLOCKSIZE : n_in - done_in;
+
+		data.data_in = in + done_in * channels;
+		data.input_frames = n;
+		data.data_out = out + done_out * channels;
+		data.output_frames = out_size - done_out;
+		data.src_ratio = (double)out_SR / in_SR;
+		data.end_of_input = 0;
+		if ((err = resampler_process(rs, &data)) != 0) {
+			fprintf(stderr, "src_bench: type %d: %s\n", type, resampler_strerror(err));
+			resampler_delete(rs);
+			return -1;
+		}
+		done_in += data.input_frames_used;
+		done_out += data.output_frames_gen;
+		if (data.input_frames_used == 0 && data.output_frames_gen == 0) {
+			break;
+		}
+	}
+	*cpu = cpu_time() - t;
+
+	resampler_delete(rs);
+	return done_out;
+}
+
+
+static void
+make_tone(float * buf, long n, double freq, int rate) {
+
+	long i;
+	int c;
+
+	for (i = 0; i < n; i++) {
+		float x = 0.5 * sin(2.0 * M_PI * freq * i / rate);
+		for (c = 0; c < channels; c++) {
+			buf[i * channels + c] = x;
+		}
+	}
+}
+
+
+/* Least squares fit of a tone at freq to channel 0 of buf, skipping the
+ * filter transients at both ends. Returns the power of the fitted tone
+ * and of the residual.
+ */
+static void
+fit_tone(float * buf, long n, double freq, int rate, double * p_tone, double * p_rest) {
+
+	long skip = rate / 10;
+	long i;
+	double ss = 0.0, sc = 0.0, cc = 0.0, xs = 0.0, xc = 0.0, xx = 0.0;
+	double a, b, det;
+
+	if (n <= 2 * skip) {
+		*p_tone = *p_rest = 0.0;
+		return;
+	}
+
+	for (i = skip; i < n - skip; i++) {
+		double s = sin(2.0 * M_PI * freq * i / rate);
+		double c = cos(2.0 * M_PI * freq * i / rate);
+		double x = buf[i * channels];
+
+		ss += s * s;
+		sc += s * c;
+		cc += c * c;
+		xs += x * s;
+		xc += x * c;
+		xx += x * x;
+	}
+	det = ss * cc - sc * sc;
+	a = (xs * cc - xc * sc) / det;
+	b = (xc * ss - xs * sc) / det;
+
+	n -= 2 * skip;
+	*p_tone = (a * a * ss + 2.0 * a * b * sc + b * b * cc) / n;
+	*p_rest = xx / n - *p_tone;
+	if (*p_rest < 1e-30) {
+		*p_rest = 1e-30;
+	}
+}
+
+
+static double
+snr_db(int type, int in_SR, int out_SR, double freq, float * in, float * out, long out_size) {
+
+	long n_in = in_SR;  /* one second */
+	long n_out;
+	double cpu, p_tone, p_rest;
+
+	make_tone(in, n_in, freq, in_SR);
+	if ((n_out = convert(type, in_SR, out_SR, in, n_in, out, out_size, &cpu)) < 0) {
+		return 0.0;
+	}
+	fit_tone(out, n_out, freq, out_SR, &p_tone, &p_rest);
+	return 10.0 * log10(p_tone / p_rest);
+}
+
+
+/* level of an out of band tone after downsampling, relative to its input level */
+static double
+alias_db(int type, int in_SR, int out_SR, float * in, float * out, long out_size) {
+
+	double freq = 0.5 * (out_SR / 2.0 + in_SR / 2.0);  /* halfway between the Nyquists */
+	long n_in = in_SR;
+	long n_out, i;
+	long skip = out_SR / 10;
+	double cpu, p = 0.0;
+
+	make_tone(in, n_in, freq, in_SR);
+	if ((n_out = convert(type, in_SR, out_SR, in, n_in, out, out_size, &cpu)) < 2 * skip) {
+		return 0.0;
+	}
+	for (i = skip; i < n_out - skip; i++) {
+		p += out[i * channels] * out[i * channels];
+	}
+	p /= n_out - 2 * skip;
+	if (p < 1e-30) {
+		p = 1e-30;
+	}
+	return 10.0 * log10(p / 0.125);  /* 0.5 amplitude sine */
+}
+
+
+static void
+bench(int type, int in_SR, int out_SR) {
+
+	long n_in = seconds * in_SR;
+	long n_alloc = (n_in > in_SR) ? n_in : in_SR;  /* the tones take a second */
+	long out_size = n_alloc * ((double)out_SR / in_SR) + BLOCKSIZE * 8;
+	float * in = malloc(n_alloc * channels * sizeof(float));
+	float * out = malloc(out_size * channels * sizeof(float));
+	double cpu;
+	int lower = (in_SR < out_SR) ? in_SR : out_SR;
+	long i;
+	unsigned int seed = 1;
+
+	if (in == NULL || out == NULL) {
+		fprintf(stderr, "src_bench: malloc error\n");
+		exit(1);
+	}
+
+	/* white noise keeps every code path busy */
+	for (i = 0; i < n_in * channels; i++) {
+		in[i] = (double)rand_r(&seed) / RAND_MAX - 0.5;
+	}
+	if (convert(type, in_SR, out_SR, in, n_in, out, out_size, &cpu) < 0) {
+		free(in);
+		free(out);
+		return;
+	}
+
+	printf("src\t%d\t%s\t%d\t%d\t%.1f\t%.1f\t%.1f",
+	       type, resampler_get_name(type), in_SR, out_SR,
+	       (cpu > 0.0) ? seconds / cpu : 0.0,
+	       snr_db(type, in_SR, out_SR, 1000.0, in, out, out_size),
+	       snr_db(type, in_SR, out_SR, 0.4 * lower, in, out, out_size));
+	if (out_SR < in_SR) {
+		printf("\t%.1f\n", alias_db(type, in_SR, out_SR, in, out, out_size));
+	} else {
+		printf("\t-\n");
+	}
+	fflush(stdout);
+
+	free(in);
+	free(out);
+}
+
+
+static void
+usage(void) {
+
+	fprintf(stderr,
+		"usage: src_bench [-s seconds] [-c channels] [-t type]\n"
+		"  -s  seconds of noise per run for the speed figure (default 10)\n"
+		"  -c  channels (default 2)\n"
+		"  -t  only this converter type (default all)\n"
+		"\nConverter types:\n");
+}
+
+
+int
+main(int argc, char ** argv) {
+
+	int c, type, i, j;
+	int only = -1;
+
+	while ((c = getopt(argc, argv, "s:c:t:h")) != -1) {
+		switch (c) {
+		case 's':
+			seconds = atof(optarg);
+			break;
+		case 'c':
+			channels = atoi(optarg);
+			break;
+		case 't':
+			only = atoi(optarg);
+			break;
+		default:
+			usage();
+			for (type = 0; resampler_get_name(type) != NULL; type++) {
+				fprintf(stderr, "  %d: %s\n", type, resampler_get_name(type));
+			}
+			return 1;
+		}
+	}
+	if (seconds <= 0.0 || channels < 1) {
+		usage();
+		return 1;
+	}
+
+	printf("#src\ttype\tname\tin_rate\tout_rate\tx_realtime\tsnr_1k_db\tsnr_hf_db\talias_db\n");
+	for (type = 0; resampler_get_name(type) != NULL; type++) {
+		if (only >= 0 && type != only) {
+			continue;
+		}
+		for (i = 0; i < N_RATES; i++) {
+			for (j = 0; j < N_RATES; j++) {
+				if (i != j) {
+					bench(type, rates[i], rates[j]);
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+#else
+
+int
+main(int argc, char ** argv) {
+
+	fprintf(stderr, "src_bench: Aqualung is compiled without Sample Rate Converter support.\n");
+	return 1;
+}
+
+#endif /* HAVE_SRC */
+
+
+// vim: shiftwidth=8:tabstop=8:softtabstop=8 :
@@ -286,6 +286,11 @@ podcast_dialog(podcast_t ** podcast, int create) {
 	GtkWidget * date_spin;
 	GtkWidget * size_spin;
 
+	int flags = 0;
+	unsigned count_limit = 0;
+	unsigned date_limit = 0;
+	unsigned size_limit = 0;
+
         dialog = gtk_dialog_new_with_buttons(create ? _("Subscribe to new feed") : _("Edit feed settings"),
 					     GTK_WINDOW(browser_window),
 					     GTK_DIALOG_DESTROY_WITH_PARENT | GTK_DIALOG_NO_SEPARATOR,
@@ -378,6 +383,11 @@ podcast_dialog(podcast_t ** podcast, int create) {
 			(*podcast)->dir = strdup(dir);
 			(*podcast)->url = strdup(url);
 			arr_strlcpy(options.podcastdir, dir);
+		} else {
+			flags = (*podcast)->flags;
+			count_limit = (*podcast)->count_limit;
+			date_limit = (*podcast)->date_limit;
+			size_limit = (*podcast)->size_limit;
 		}
 
 		if (options.podcasts_autocheck || create) {
@@ -393,6 +403,15 @@ podcast_dialog(podcast_t ** podcast, int create) {
 		(*podcast)->date_limit = gtk_spin_button_get_value(GTK_SPIN_BUTTON(date_spin)) * 86400;
 		(*podcast)->size_limit = gtk_spin_button_get_value(GTK_SPIN_BUTTON(size_spin)) * 1024 * 1024;
 
+		/* a 304 would skip the items the old limits dropped */
+		if (!create &&
+		    ((flags ^ (*podcast)->flags) & (PODCAST_COUNT_LIMIT | PODCAST_DATE_LIMIT | PODCAST_SIZE_LIMIT) ||
+		     count_limit != (*podcast)->count_limit ||
+		     date_limit != (*podcast)->date_limit ||
+		     size_limit != (*podcast)->size_limit)) {
+			podcast_save_validators(*podcast, NULL);
+		}
+
 		gtk_widget_destroy(dialog);
 		return 1;
 	} else {
@@ -772,9 +791,7 @@ podcast_feed__abort_cb(gpointer data) {
 	if (gtk_tree_selection_get_selected(music_select, NULL, &iter)) {
 		podcast_t * podcast;
 		gtk_tree_model_get(GTK_TREE_MODEL(music_store), &iter, MS_COL_DATA, &podcast, -1);
-		if (podcast->state == PODCAST_STATE_UPDATE) {
-			podcast->state = PODCAST_STATE_ABORTED;
-		}
+		podcast_abort(podcast);
 	}
 }
 
@@ -833,13 +850,6 @@ podcast_feed__remove_cb(gpointer data) {
 	}
 }
 
-gboolean
-podcast_delayed_update_cb(gpointer data) {
-
-	podcast_update((podcast_t *)data);
-	return FALSE;
-}
-
 /* data != NULL indicates automatic update */
 void
 podcast_store__update_cb(gpointer data) {
@@ -879,9 +889,8 @@ podcast_store__update_cb(gpointer data) {
 			}
 		}
 
-		podcast->state = PODCAST_STATE_PENDING;
 		gtk_tree_store_set(music_store, &iter, MS_COL_NAME, _("Updating..."), -1);
-		aqualung_timeout_add(1000 * i, podcast_delayed_update_cb, podcast);
+		podcast_update(podcast);
 	}
 }
 
@@ -1331,6 +1340,28 @@ set_comment_text(GtkTreeIter * tree_iter, GtkTextIter * text_iter, GtkTextBuffer
 	if (comment != NULL && comment[0] != '\0') {
 		gtk_text_buffer_insert(buffer, text_iter, comment, -1);
 	}
+
+	if (level == 2) {
+		podcast_refresh_t * refresh = &((podcast_t *)data)->refresh;
+		char str[MAXLEN];
+
+		if (refresh->not_modified) {
+			arr_snprintf(str, _("Last refresh: feed not modified (%u ms)"),
+				     refresh->connect_ms);
+		} else if (refresh->bytes > 0) {
+			arr_snprintf(str, _("Last refresh: %u new items, %.1f KB in %u ms "
+					    "(connect %u ms, parse %u ms)"),
+				     refresh->new_items, refresh->bytes / 1024.0,
+				     refresh->connect_ms + refresh->transfer_ms,
+				     refresh->connect_ms, refresh->parse_ms);
+		} else {
+			return;
+		}
+		if (comment != NULL && comment[0] != '\0') {
+			gtk_text_buffer_insert(buffer, text_iter, "\n\n", -1);
+		}
+		gtk_text_buffer_insert(buffer, text_iter, str, -1);
+	}
 }
 
 static void
@@ -1959,6 +1990,12 @@ save_podcast(xmlDocPtr doc, xmlNodePtr root, GtkTreeIter * pod_iter) {
 	xml_save_str(node, "author", podcast->author);
 	xml_save_str(node, "desc", podcast->desc);
 	xml_save_str(node, "url", podcast->url);
+	if (podcast->etag) {
+		xml_save_str(node, "etag", podcast->etag);
+	}
+	if (podcast->last_modified) {
+		xml_save_str(node, "last_modified", podcast->last_modified);
+	}
 
 	xml_save_int(node, "flags", podcast->flags);
 	xml_save_uint(node, "check_interval", podcast->check_interval);
@@ -2075,6 +2112,8 @@ parse_podcast(xmlDocPtr doc, xmlNodePtr cur, GtkTreeIter * iter_store) {
 		xml_load_str_dup(doc, cur, "author", &podcast->author);
 		xml_load_str_dup(doc, cur, "desc", &podcast->desc);
 		xml_load_str_dup(doc, cur, "url", &podcast->url);
+		xml_load_str_dup(doc, cur, "etag", &podcast->etag);
+		xml_load_str_dup(doc, cur, "last_modified", &podcast->last_modified);
 
 		xml_load_int(doc, cur, "flags", &podcast->flags);
 		xml_load_uint(doc, cur, "check_interval", &podcast->check_interval);